@@ -1,5 +1,6 @@
 #include "GlobalHeader.h"
 #include "HashFunction.h"
+#include "HashKernels.h"
 
 CHashFunction::CHashFunction(UINT eAlgorithm)
 {
@@ -21,9 +22,11 @@ CryptoPP::HashFunction* CHashFunction::GetHashFunction(UINT eAlgorithm)
 {
 	switch(eAlgorithm & eHashFunkt)
 	{
-		case eSHA1:			return new CryptoPP::SHA1;
+		case eSHA1:			if(CryptoPP::HashFunction* pFunction = CHashKernels::NewSHA1()) return pFunction;
+							return new CryptoPP::SHA1;
 		case eSHA224:		return new CryptoPP::SHA224;
-		case eSHA256:		return new CryptoPP::SHA256;
+		case eSHA256:		if(CryptoPP::HashFunction* pFunction = CHashKernels::NewSHA256()) return pFunction;
+							return new CryptoPP::SHA256;
 		case eSHA384:		return new CryptoPP::SHA384;
 		case eSHA512:		return new CryptoPP::SHA512;
 		case eTiger:		return new CryptoPP::Tiger;
@@ -0,0 +1,361 @@
+#include "GlobalHeader.h"
+#include "HashKernels.h"
+
+#if defined(_M_X64) || defined(__x86_64__) || defined(_M_IX86) || defined(__i386__)
+#define HASH_KERNELS_X86
+#if defined(_MSC_VER)
+#include <intrin.h>
+#define HASH_TARGET_SHA
+#else
+#include <cpuid.h>
+#include <immintrin.h>
+#define HASH_TARGET_SHA __attribute__((target("sha,sse4.1,ssse3")))
+#endif
+#elif (defined(__aarch64__) || defined(_M_ARM64)) && defined(__ARM_FEATURE_CRYPTO)
+// Note: the ARM kernels are only available when the build enables the crypto extensions (-march=armv8-a+crypto)
+#define HASH_KERNELS_ARM
+#include <arm_neon.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+typedef void (*THashBlocks)(CryptoPP::word32* pState, const byte* pData, size_t uBlocks);
+
+static const CryptoPP::word32 SHA256_K[64] = {
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#ifdef HASH_KERNELS_X86
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// x86 SHA extensions
+
+static bool HasSHANI()
+{
+#if defined(_MSC_VER)
+	int Info[4];
+	__cpuid(Info, 0);
+	if(Info[0] < 7)
+		return false;
+	__cpuidex(Info, 7, 0);
+	bool bSHA = (Info[1] & (1 << 29)) != 0;
+	__cpuid(Info, 1);
+	return bSHA && (Info[2] & (1 << 19)) != 0 && (Info[2] & (1 << 9)) != 0; // SSE4.1 and SSSE3
+#else
+	unsigned int a, b, c, d;
+	if(__get_cpuid_max(0, NULL) < 7)
+		return false;
+	__cpuid_count(7, 0, a, b, c, d);
+	bool bSHA = (b & (1 << 29)) != 0;
+	__cpuid(1, a, b, c, d);
+	return bSHA && (c & (1 << 19)) != 0 && (c & (1 << 9)) != 0; // SSE4.1 and SSSE3
+#endif
+}
+
+// Note: the message words are kept in M[Group % 4], the compiler unrolls the groups and keeps them in registers
+#define SHA1_GROUP(g, Ecur, Enext) \
+	if(g < 4) \
+		M[g % 4] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pData + 16 * (g % 4))), MASK); \
+	Ecur = (g == 0) ? _mm_add_epi32(Ecur, M[0]) : _mm_sha1nexte_epu32(Ecur, M[g % 4]); \
+	Enext = ABCD; \
+	if(g >= 3 && g <= 18) \
+		M[(g + 1) % 4] = _mm_sha1msg2_epu32(M[(g + 1) % 4], M[g % 4]); \
+	ABCD = _mm_sha1rnds4_epu32(ABCD, Ecur, g / 5); \
+	if(g >= 1 && g <= 16) \
+		M[(g + 3) % 4] = _mm_sha1msg1_epu32(M[(g + 3) % 4], M[g % 4]); \
+	if(g >= 2 && g <= 17) \
+		M[(g + 2) % 4] = _mm_xor_si128(M[(g + 2) % 4], M[g % 4]);
+
+HASH_TARGET_SHA static void SHA1_Blocks_SHANI(CryptoPP::word32* pState, const byte* pData, size_t uBlocks)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0001020304050607ULL, 0x08090a0b0c0d0e0fULL);
+
+	__m128i ABCD = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)pState), 0x1B);
+	__m128i E0 = _mm_set_epi32(pState[4], 0, 0, 0);
+	__m128i E1;
+	__m128i M[4];
+
+	for(; uBlocks > 0; uBlocks--, pData += 64)
+	{
+		__m128i ABCD_SAVE = ABCD;
+		__m128i E0_SAVE = E0;
+
+		SHA1_GROUP(0, E0, E1)	SHA1_GROUP(1, E1, E0)	SHA1_GROUP(2, E0, E1)	SHA1_GROUP(3, E1, E0)
+		SHA1_GROUP(4, E0, E1)	SHA1_GROUP(5, E1, E0)	SHA1_GROUP(6, E0, E1)	SHA1_GROUP(7, E1, E0)
+		SHA1_GROUP(8, E0, E1)	SHA1_GROUP(9, E1, E0)	SHA1_GROUP(10, E0, E1)	SHA1_GROUP(11, E1, E0)
+		SHA1_GROUP(12, E0, E1)	SHA1_GROUP(13, E1, E0)	SHA1_GROUP(14, E0, E1)	SHA1_GROUP(15, E1, E0)
+		SHA1_GROUP(16, E0, E1)	SHA1_GROUP(17, E1, E0)	SHA1_GROUP(18, E0, E1)	SHA1_GROUP(19, E1, E0)
+
+		E0 = _mm_sha1nexte_epu32(E0, E0_SAVE);
+		ABCD = _mm_add_epi32(ABCD, ABCD_SAVE);
+	}
+
+	_mm_storeu_si128((__m128i*)pState, _mm_shuffle_epi32(ABCD, 0x1B));
+	pState[4] = _mm_extract_epi32(E0, 3);
+}
+
+#define SHA256_GROUP(g) \
+	if(g < 4) \
+		M[g % 4] = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)(pData + 16 * (g % 4))), MASK); \
+	MSG = _mm_add_epi32(M[g % 4], _mm_loadu_si128((const __m128i*)&SHA256_K[4 * g])); \
+	STATE1 = _mm_sha256rnds2_epu32(STATE1, STATE0, MSG); \
+	if(g >= 3 && g <= 14) \
+		M[(g + 1) % 4] = _mm_sha256msg2_epu32(_mm_add_epi32(M[(g + 1) % 4], _mm_alignr_epi8(M[g % 4], M[(g + 3) % 4], 4)), M[g % 4]); \
+	STATE0 = _mm_sha256rnds2_epu32(STATE0, STATE1, _mm_shuffle_epi32(MSG, 0x0E)); \
+	if(g >= 1 && g <= 12) \
+		M[(g + 3) % 4] = _mm_sha256msg1_epu32(M[(g + 3) % 4], M[g % 4]);
+
+HASH_TARGET_SHA static void SHA256_Blocks_SHANI(CryptoPP::word32* pState, const byte* pData, size_t uBlocks)
+{
+	const __m128i MASK = _mm_set_epi64x(0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL);
+
+	__m128i TMP = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&pState[0]), 0xB1);	// CDAB
+	__m128i STATE1 = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i*)&pState[4]), 0x1B);	// EFGH
+	__m128i STATE0 = _mm_alignr_epi8(TMP, STATE1, 8);										// ABEF
+	STATE1 = _mm_blend_epi16(STATE1, TMP, 0xF0);											// CDGH
+	__m128i MSG;
+	__m128i M[4];
+
+	for(; uBlocks > 0; uBlocks--, pData += 64)
+	{
+		__m128i ABEF_SAVE = STATE0;
+		__m128i CDGH_SAVE = STATE1;
+
+		SHA256_GROUP(0)		SHA256_GROUP(1)		SHA256_GROUP(2)		SHA256_GROUP(3)
+		SHA256_GROUP(4)		SHA256_GROUP(5)		SHA256_GROUP(6)		SHA256_GROUP(7)
+		SHA256_GROUP(8)		SHA256_GROUP(9)		SHA256_GROUP(10)	SHA256_GROUP(11)
+		SHA256_GROUP(12)	SHA256_GROUP(13)	SHA256_GROUP(14)	SHA256_GROUP(15)
+
+		STATE0 = _mm_add_epi32(STATE0, ABEF_SAVE);
+		STATE1 = _mm_add_epi32(STATE1, CDGH_SAVE);
+	}
+
+	TMP = _mm_shuffle_epi32(STATE0, 0x1B);					// FEBA
+	STATE1 = _mm_shuffle_epi32(STATE1, 0xB1);				// DCHG
+	STATE0 = _mm_blend_epi16(TMP, STATE1, 0xF0);			// DCBA
+	STATE1 = _mm_alignr_epi8(STATE1, TMP, 8);				// HGFE
+	_mm_storeu_si128((__m128i*)&pState[0], STATE0);
+	_mm_storeu_si128((__m128i*)&pState[4], STATE1);
+}
+
+#endif
+
+#ifdef HASH_KERNELS_ARM
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// ARMv8 crypto extensions
+
+static bool HasARMv8SHA(bool bSHA2)
+{
+#if defined(__linux__)
+	unsigned long HwCaps = getauxval(AT_HWCAP);
+	return (HwCaps & (bSHA2 ? HWCAP_SHA2 : HWCAP_SHA1)) != 0;
+#elif defined(__APPLE__)
+	return true; // all 64 bit apple cpus have them
+#else
+	return false;
+#endif
+}
+
+static void SHA1_Blocks_ARM(CryptoPP::word32* pState, const byte* pData, size_t uBlocks)
+{
+	static const CryptoPP::word32 K[4] = {0x5A827999, 0x6ED9EBA1, 0x8F1BBCDC, 0xCA62C1D6};
+
+	uint32x4_t ABCD = vld1q_u32(pState);
+	uint32_t E = pState[4];
+
+	for(; uBlocks > 0; uBlocks--, pData += 64)
+	{
+		uint32x4_t ABCD_SAVE = ABCD;
+		uint32_t E_SAVE = E;
+
+		uint32x4_t M[4];
+		for(int i = 0; i < 4; i++)
+			M[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(pData + 16 * i)));
+
+		for(int g = 0; g < 20; g++)
+		{
+			uint32x4_t W = vaddq_u32(M[g % 4], vdupq_n_u32(K[g / 5]));
+			uint32_t ENext = vsha1h_u32(vgetq_lane_u32(ABCD, 0));
+			if(g < 5)
+				ABCD = vsha1cq_u32(ABCD, E, W);
+			else if(g < 10 || g >= 15)
+				ABCD = vsha1pq_u32(ABCD, E, W);
+			else
+				ABCD = vsha1mq_u32(ABCD, E, W);
+			E = ENext;
+
+			if(g < 16) // prepare the words for group g + 4
+				M[g % 4] = vsha1su1q_u32(vsha1su0q_u32(M[g % 4], M[(g + 1) % 4], M[(g + 2) % 4]), M[(g + 3) % 4]);
+		}
+
+		E += E_SAVE;
+		ABCD = vaddq_u32(ABCD, ABCD_SAVE);
+	}
+
+	vst1q_u32(pState, ABCD);
+	pState[4] = E;
+}
+
+static void SHA256_Blocks_ARM(CryptoPP::word32* pState, const byte* pData, size_t uBlocks)
+{
+	uint32x4_t STATE0 = vld1q_u32(&pState[0]);
+	uint32x4_t STATE1 = vld1q_u32(&pState[4]);
+
+	for(; uBlocks > 0; uBlocks--, pData += 64)
+	{
+		uint32x4_t ABCD_SAVE = STATE0;
+		uint32x4_t EFGH_SAVE = STATE1;
+
+		uint32x4_t M[4];
+		for(int i = 0; i < 4; i++)
+			M[i] = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8(pData + 16 * i)));
+
+		for(int g = 0; g < 16; g++)
+		{
+			uint32x4_t W = vaddq_u32(M[g % 4], vld1q_u32(&SHA256_K[4 * g]));
+			uint32x4_t TMP = STATE0;
+			STATE0 = vsha256hq_u32(STATE0, STATE1, W);
+			STATE1 = vsha256h2q_u32(STATE1, TMP, W);
+
+			if(g < 12) // prepare the words for group g + 4
+				M[g % 4] = vsha256su1q_u32(vsha256su0q_u32(M[g % 4], M[(g + 1) % 4]), M[(g + 2) % 4], M[(g + 3) % 4]);
+		}
+
+		STATE0 = vaddq_u32(STATE0, ABCD_SAVE);
+		STATE1 = vaddq_u32(STATE1, EFGH_SAVE);
+	}
+
+	vst1q_u32(&pState[0], STATE0);
+	vst1q_u32(&pState[4], STATE1);
+}
+
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// CryptoPP wrappers, only the block function is replaced, padding and output stay with CryptoPP
+
+static THashBlocks g_SHA1Blocks = NULL;
+static THashBlocks g_SHA256Blocks = NULL;
+static const char* g_KernelName = "none";
+static bool g_KernelFailed = false;
+
+class CSHA1Accelerated: public CryptoPP::SHA1
+{
+protected:
+	size_t HashMultipleBlocks(const CryptoPP::word32* input, size_t length)
+	{
+		g_SHA1Blocks(m_state, (const byte*)input, length / 64);
+		return length % 64;
+	}
+};
+
+class CSHA256Accelerated: public CryptoPP::SHA256
+{
+protected:
+	size_t HashMultipleBlocks(const CryptoPP::word32* input, size_t length)
+	{
+		g_SHA256Blocks(m_state, (const byte*)input, length / 64);
+		return length % 64;
+	}
+};
+
+static bool SelfTest(CryptoPP::HashFunction* pTest, CryptoPP::HashFunction* pReference)
+{
+	// Note: odd sizes make sure the partial blocks and the padding go through the accelerated path too
+	byte Data[1000];
+	for(size_t i = 0; i < sizeof(Data); i++)
+		Data[i] = (byte)(i * 7 + 3);
+
+	bool bOK = true;
+	for(size_t Size = 0; Size <= sizeof(Data) && bOK; Size += 111)
+	{
+		byte TestKey[64];
+		byte RefKey[64];
+		pTest->Update(Data, Size);
+		pTest->Final(TestKey);
+		pReference->Update(Data, Size);
+		pReference->Final(RefKey);
+		bOK = memcmp(TestKey, RefKey, pReference->DigestSize()) == 0;
+	}
+
+	delete pTest;
+	delete pReference;
+	return bOK;
+}
+
+struct SHashKernelSetup
+{
+	SHashKernelSetup()
+	{
+#ifdef HASH_KERNELS_X86
+		if(HasSHANI())
+		{
+			g_SHA1Blocks = SHA1_Blocks_SHANI;
+			g_SHA256Blocks = SHA256_Blocks_SHANI;
+			g_KernelName = "SHA-NI";
+		}
+#endif
+#ifdef HASH_KERNELS_ARM
+		if(HasARMv8SHA(false))
+			g_SHA1Blocks = SHA1_Blocks_ARM;
+		if(HasARMv8SHA(true))
+			g_SHA256Blocks = SHA256_Blocks_ARM;
+		if(g_SHA1Blocks || g_SHA256Blocks)
+			g_KernelName = "ARMv8";
+#endif
+
+		// Note: we must produce exactly the same hashes as the generic implementation, if not we dont use the kernel
+		if(g_SHA1Blocks && !SelfTest(new CSHA1Accelerated, new CryptoPP::SHA1))
+		{
+			g_SHA1Blocks = NULL;
+			g_KernelFailed = true;
+		}
+		if(g_SHA256Blocks && !SelfTest(new CSHA256Accelerated, new CryptoPP::SHA256))
+		{
+			g_SHA256Blocks = NULL;
+			g_KernelFailed = true;
+		}
+		if(!g_SHA1Blocks && !g_SHA256Blocks)
+			g_KernelName = "none";
+	}
+} g_HashKernelSetup;
+
+bool CHashKernels::HasSHA1()
+{
+	return g_SHA1Blocks != NULL;
+}
+
+bool CHashKernels::HasSHA256()
+{
+	return g_SHA256Blocks != NULL;
+}
+
+const char* CHashKernels::GetName()
+{
+	return g_KernelName;
+}
+
+bool CHashKernels::HasFailed()
+{
+	return g_KernelFailed;
+}
+
+CryptoPP::HashFunction* CHashKernels::NewSHA1()
+{
+	return g_SHA1Blocks ? new CSHA1Accelerated : NULL;
+}
+
+CryptoPP::HashFunction* CHashKernels::NewSHA256()
+{
+	return g_SHA256Blocks ? new CSHA256Accelerated : NULL;
+}
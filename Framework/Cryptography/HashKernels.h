@@ -0,0 +1,20 @@
+#pragma once
+
+#include "AbstractKey.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Hardware accelerated SHA-1 and SHA-256 block functions (x86 SHA extensions and ARMv8 crypto extensions),
+// the CPU is checked once at startup, without support the generic CryptoPP implementations are used
+
+class NEOHELPER_EXPORT CHashKernels
+{
+public:
+	static bool				HasSHA1();
+	static bool				HasSHA256();
+	static const char*		GetName();
+	static bool				HasFailed();	// a kernel of this cpu did not pass the self test and is not used
+
+	// Note: these return NULL when there is no accelerated implementation available
+	static CryptoPP::HashFunction* NewSHA1();
+	static CryptoPP::HashFunction* NewSHA256();
+};
@@ -122,6 +122,7 @@ struct SCurTick
 {
 	SCurTick()	{Timer.start();}
 	uint64 Get(){return Timer.elapsed();}
+	uint64 GetNs(){return Timer.nsecsElapsed();}
 	QElapsedTimer Timer;
 }	g_CurTick;
 
@@ -130,6 +131,11 @@ uint64 GetCurTick()
 	return g_CurTick.Get();
 }
 
+uint64 GetCurTickNs()
+{
+	return g_CurTick.GetNs();
+}
+
 UINT MkTick(UINT& uCounter)
 {
 	uCounter++;
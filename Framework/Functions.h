@@ -65,6 +65,7 @@ int vswprintf_l(wchar_t * _String, size_t _Count, const wchar_t * _Format, va_li
 
 NEOHELPER_EXPORT time_t GetTime();
 NEOHELPER_EXPORT uint64 GetCurTick();
+NEOHELPER_EXPORT uint64 GetCurTickNs();
 
 enum EEProcessTicks
 {
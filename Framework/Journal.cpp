@@ -0,0 +1,366 @@
+#include "GlobalHeader.h"
+#include "Journal.h"
+#include <QCryptographicHash>
+#ifdef WIN32
+   #include <windows.h>
+   #include <io.h>
+#else
+   #include <unistd.h>
+   #include <stdio.h>
+#endif
+
+#define JOURNAL_MAGIC		0x4E4C4A31 // NLJ1
+#define JOURNAL_HEADER		8
+#define RECORD_HEADER		(1 + 8 + 4)
+#define RECORD_DIGEST		16
+
+CJournal::CJournal()
+{
+	m_pFile = NULL;
+	m_bFailed = false;
+	m_uSize = 0;
+	m_uLiveSize = 0;
+	m_uCommitted = 0;
+	m_uCommittedLive = 0;
+}
+
+CJournal::~CJournal()
+{
+	Close();
+}
+
+bool CJournal::Open(const QString& FileName, QMap<uint64, QByteArray>* pRecords)
+{
+	Close();
+
+	// Note: opening in ReadWrite mode would create a missing file, new logs must be made with Create
+	if(!QFile::exists(FileName))
+		return false;
+
+	m_FileName = FileName;
+	m_pFile = new QFile(FileName);
+	if(!m_pFile->open(QFile::ReadWrite))
+	{
+		delete m_pFile;
+		m_pFile = NULL;
+		return false;
+	}
+
+	QDataStream Stream(m_pFile);
+	quint32 Magic = 0;
+	quint32 Version = 0;
+	if(m_pFile->size() >= JOURNAL_HEADER)
+		Stream >> Magic >> Version;
+	if(Magic != JOURNAL_MAGIC || Version != 1)
+	{
+		// Note: we never wipe a file we can not parse, its up to the caller what to do with it
+		Close();
+		return false;
+	}
+
+	qint64 uOffset = JOURNAL_HEADER;
+	for(;;)
+	{
+		quint8 Type = 0;
+		quint64 ID = 0;
+		quint32 Length = 0;
+		if(m_pFile->size() - uOffset < RECORD_HEADER)
+			break;
+		Stream >> Type >> ID >> Length;
+		if((Type != eWrite && Type != eRemove) || m_pFile->size() - uOffset < RECORD_HEADER + (qint64)Length + RECORD_DIGEST)
+			break;
+
+		QByteArray Data = m_pFile->read(Length);
+		QByteArray RecordDigest = m_pFile->read(RECORD_DIGEST);
+		if(RecordDigest != MakeRecord((ERecord)Type, ID, Data).right(RECORD_DIGEST))
+			break;
+
+		qint64 uRecord = RECORD_HEADER + Length + RECORD_DIGEST;
+		m_uLiveSize -= m_Entries.value(ID).uSize;
+		if(Type == eWrite)
+		{
+			SEntry& Entry = m_Entries[ID];
+			Entry.Digest = Digest(Data);
+			Entry.uSize = uRecord;
+			m_uLiveSize += uRecord;
+			if(pRecords)
+				pRecords->insert(ID, Data);
+		}
+		else
+		{
+			m_Entries.remove(ID);
+			if(pRecords)
+				pRecords->remove(ID);
+		}
+		uOffset += uRecord;
+	}
+
+	// Note: anything behind the last complete record was torn by a crash
+	if(uOffset < m_pFile->size())
+		m_pFile->resize(uOffset);
+	m_pFile->seek(uOffset);
+	m_uSize = m_uCommitted = uOffset;
+	m_uCommittedLive = m_uLiveSize;
+	return true;
+}
+
+void CJournal::Close()
+{
+	if(!m_pFile)
+		return;
+	m_pFile->close();
+	delete m_pFile;
+	m_pFile = NULL;
+	m_Entries.clear();
+	m_Staged.clear();
+	m_bFailed = false;
+	m_uSize = 0;
+	m_uLiveSize = 0;
+	m_uCommitted = 0;
+	m_uCommittedLive = 0;
+}
+
+const CJournal::SEntry* CJournal::FindEntry(uint64 ID) const
+{
+	QMap<uint64, SEntry>::const_iterator I = m_Staged.find(ID);
+	if(I != m_Staged.end())
+		return I.value().uSize ? &I.value() : NULL;
+	I = m_Entries.find(ID);
+	return I != m_Entries.end() ? &I.value() : NULL;
+}
+
+QList<uint64> CJournal::GetIDs() const
+{
+	QList<uint64> IDs;
+	for(QMap<uint64, SEntry>::const_iterator I = m_Entries.begin(); I != m_Entries.end(); ++I)
+	{
+		if(!m_Staged.contains(I.key()))
+			IDs.append(I.key());
+	}
+	for(QMap<uint64, SEntry>::const_iterator I = m_Staged.begin(); I != m_Staged.end(); ++I)
+	{
+		if(I.value().uSize)
+			IDs.append(I.key());
+	}
+	return IDs;
+}
+
+bool CJournal::Write(uint64 ID, const QByteArray& Data)
+{
+	ASSERT(m_pFile);
+	if(m_bFailed)
+		return false; // Note: the log is back at the last commit, nothing more gets staged until Commit reported the failure
+
+	QByteArray DataDigest = Digest(Data);
+	const SEntry* pEntry = FindEntry(ID);
+	if(pEntry && pEntry->Digest == DataDigest)
+		return false; // unchanged
+
+	QByteArray Record = MakeRecord(eWrite, ID, Data);
+	if(m_pFile->write(Record) != Record.size())
+	{
+		Rollback();
+		m_bFailed = true;
+		return false;
+	}
+	m_uSize += Record.size();
+
+	if(pEntry)
+		m_uLiveSize -= pEntry->uSize;
+	SEntry& Entry = m_Staged[ID];
+	Entry.Digest = DataDigest;
+	Entry.uSize = Record.size();
+	m_uLiveSize += Record.size();
+	return true;
+}
+
+void CJournal::Remove(uint64 ID)
+{
+	ASSERT(m_pFile);
+	if(m_bFailed)
+		return;
+
+	const SEntry* pEntry = FindEntry(ID);
+	if(!pEntry)
+		return;
+
+	QByteArray Record = MakeRecord(eRemove, ID, QByteArray());
+	if(m_pFile->write(Record) != Record.size())
+	{
+		Rollback();
+		m_bFailed = true;
+		return;
+	}
+	m_uSize += Record.size();
+
+	m_uLiveSize -= pEntry->uSize;
+	m_Staged[ID] = SEntry();
+}
+
+bool CJournal::Commit()
+{
+	ASSERT(m_pFile);
+	if(m_bFailed || !Sync(m_pFile))
+	{
+		// Note: a record that did not make it to disk must not count as stored, else it would never be written again
+		Rollback();
+		m_bFailed = false;
+		return false;
+	}
+
+	for(QMap<uint64, SEntry>::iterator I = m_Staged.begin(); I != m_Staged.end(); ++I)
+	{
+		if(I.value().uSize)
+			m_Entries[I.key()] = I.value();
+		else
+			m_Entries.remove(I.key());
+	}
+	m_Staged.clear();
+	m_uCommitted = m_uSize;
+	m_uCommittedLive = m_uLiveSize;
+	return true;
+}
+
+void CJournal::Rollback()
+{
+	// Note: cut off whatever was written since the last commit, a partial record would otherwise hide everything appended behind it
+	m_pFile->resize(m_uCommitted);
+	m_pFile->seek(m_uCommitted);
+	m_Staged.clear();
+	m_uSize = m_uCommitted;
+	m_uLiveSize = m_uCommittedLive;
+}
+
+bool CJournal::NeedsCompaction() const
+{
+	// Note: allow the log to grow to twice the live data, but dont bother with small files
+	return m_uSize > 2 * m_uLiveSize + MB2B(1);
+}
+
+bool CJournal::Create(const QString& FileName, const QMap<uint64, QByteArray>& Records)
+{
+	Close();
+
+	m_FileName = FileName;
+	return Rewrite(Records);
+}
+
+bool CJournal::Compact(const QMap<uint64, QByteArray>& Records)
+{
+	ASSERT(m_pFile);
+	return Rewrite(Records);
+}
+
+bool CJournal::Rewrite(const QMap<uint64, QByteArray>& Records)
+{
+	m_bFailed = false; // Note: the full record set is written, so an earlier failed write does not matter anymore
+
+	QString TempName = m_FileName + ".tmp";
+	QFile* pTemp = new QFile(TempName);
+	if(!pTemp->open(QFile::WriteOnly | QFile::Truncate))
+	{
+		delete pTemp;
+		if(m_pFile)
+			Rollback();
+		return false;
+	}
+
+	QMap<uint64, SEntry> Entries;
+	qint64 uSize = JOURNAL_HEADER;
+	bool bWritten;
+	{
+		QDataStream Stream(pTemp);
+		Stream << (quint32)JOURNAL_MAGIC << (quint32)1;
+		bWritten = Stream.status() == QDataStream::Ok;
+	}
+	for(QMap<uint64, QByteArray>::const_iterator I = Records.begin(); I != Records.end(); ++I)
+	{
+		QByteArray Record = MakeRecord(eWrite, I.key(), I.value());
+		if(!bWritten || pTemp->write(Record) != Record.size())
+		{
+			bWritten = false;
+			break;
+		}
+		uSize += Record.size();
+
+		SEntry& Entry = Entries[I.key()];
+		Entry.Digest = Digest(I.value());
+		Entry.uSize = Record.size();
+	}
+
+	if(!bWritten || !Sync(pTemp))
+	{
+		pTemp->close();
+		pTemp->remove();
+		delete pTemp;
+		if(m_pFile)
+			Rollback();
+		return false;
+	}
+	pTemp->close();
+	delete pTemp;
+
+	// Note: the new file must be complete on disk before it replaces the old one, so at any time one of them is intact
+	if(m_pFile)
+		m_pFile->close();
+#ifdef WIN32
+	bool bOk = MoveFileExW((LPCWSTR)QDir::toNativeSeparators(TempName).utf16(), (LPCWSTR)QDir::toNativeSeparators(m_FileName).utf16(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+	bool bOk = rename(QFile::encodeName(TempName).constData(), QFile::encodeName(m_FileName).constData()) == 0;
+#endif
+	if(!bOk)
+	{
+		QFile::remove(TempName);
+		if(!m_pFile)
+			return false; // there was no log before, dont leave an empty one behind
+	}
+
+	if(!m_pFile)
+		m_pFile = new QFile(m_FileName);
+	if(!m_pFile->open(QFile::ReadWrite))
+	{
+		delete m_pFile;
+		m_pFile = NULL;
+		return false;
+	}
+	if(!bOk)
+	{
+		Rollback(); // Note: the old log stays in use, without what was staged since its last commit
+		return false;
+	}
+	m_pFile->seek(m_pFile->size());
+
+	m_Entries = Entries;
+	m_Staged.clear();
+	m_bFailed = false;
+	m_uSize = m_uCommitted = uSize;
+	m_uLiveSize = m_uCommittedLive = uSize - JOURNAL_HEADER;
+	return true;
+}
+
+QByteArray CJournal::MakeRecord(ERecord eType, uint64 ID, const QByteArray& Data)
+{
+	QByteArray Record;
+	Record.reserve(RECORD_HEADER + Data.size() + RECORD_DIGEST);
+	QDataStream Stream(&Record, QIODevice::WriteOnly);
+	Stream << (quint8)eType << (quint64)ID << (quint32)Data.size();
+	Stream.writeRawData(Data.constData(), Data.size());
+	Record.append(Digest(Record)); // Note: covers the header too, so a torn or garbled record is always detected
+	return Record;
+}
+
+QByteArray CJournal::Digest(const QByteArray& Data)
+{
+	return QCryptographicHash::hash(Data, QCryptographicHash::Md5);
+}
+
+bool CJournal::Sync(QFile* pFile)
+{
+	if(!pFile->flush())
+		return false;
+#ifdef WIN32
+	return _commit(pFile->handle()) == 0;
+#else
+	return fsync(pFile->handle()) == 0;
+#endif
+}
@@ -0,0 +1,79 @@
+#pragma once
+
+#include "./NeoHelper/neohelper_global.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// An append only log of binary records, each identified by a 64 bit ID, the last record for an ID wins.
+// Records are appended and made durable with Commit, a record that was torn by a crash is cut off on the next Open.
+// When the log grows much larger than the live data it is rewritten with Compact, the new file replaces the old one atomically.
+// Note: a new log is only ever written by Create through the same temp file, so a crash never leaves an empty or partial log behind.
+// Writes are staged until Commit succeeds, if a write or the sync fails the log is cut back to the last commit and the staged records are dropped,
+// so the next save writes them again.
+
+class NEOHELPER_EXPORT CJournal
+{
+public:
+	CJournal();
+	~CJournal();
+
+	/**
+	* Opens an existing log and reads all live records
+	* @return: false if the file does not exist, can not be opened for writing or is not a log we know, the file is left untouched
+	*/
+	bool				Open(const QString& FileName, QMap<uint64, QByteArray>* pRecords = NULL);
+	/**
+	* Writes a new log with the given records and opens it, an existing file is only replaced once the new one is on disk
+	*/
+	bool				Create(const QString& FileName, const QMap<uint64, QByteArray>& Records);
+	void				Close();
+	bool				IsOpen() const								{return m_pFile != NULL;}
+
+	// Note: a record is only written when its content differs from the last one stored for this ID
+	bool				Write(uint64 ID, const QByteArray& Data);
+	void				Remove(uint64 ID);
+	QList<uint64>		GetIDs() const;
+
+	/**
+	* Makes all records written since the last commit durable
+	* @return: false if a write or the sync failed, the log is than back at the last commit
+	*/
+	bool				Commit();
+
+	bool				NeedsCompaction() const;
+	bool				Compact(const QMap<uint64, QByteArray>& Records);
+
+	qint64				GetSize() const								{return m_uSize;}
+	qint64				GetLiveSize() const							{return m_uLiveSize;}
+
+protected:
+	enum ERecord
+	{
+		eWrite = 1,
+		eRemove = 2
+	};
+
+	struct SEntry
+	{
+		SEntry() : uSize(0) {}
+		QByteArray		Digest;
+		qint64			uSize;		// Note: in m_Staged 0 marks a removed record
+	};
+
+	const SEntry*		FindEntry(uint64 ID) const;
+	void				Rollback();
+
+	static QByteArray	MakeRecord(ERecord eType, uint64 ID, const QByteArray& Data);
+	static QByteArray	Digest(const QByteArray& Data);
+	static bool			Sync(QFile* pFile);
+	bool				Rewrite(const QMap<uint64, QByteArray>& Records);
+
+	QString				m_FileName;
+	QFile*				m_pFile;
+	QMap<uint64, SEntry> m_Entries;		// committed records
+	QMap<uint64, SEntry> m_Staged;		// records written since the last commit
+	bool				m_bFailed;		// a write failed since the last commit
+	qint64				m_uSize;		// bytes in the log
+	qint64				m_uLiveSize;	// bytes of the records that are still current
+	qint64				m_uCommitted;	// m_uSize at the last commit
+	qint64				m_uCommittedLive;
+};
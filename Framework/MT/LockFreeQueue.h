@@ -0,0 +1,64 @@
+#pragma once
+
+#include <QAtomicPointer>
+
+/**********************************************************************************************
+* CLockFreeQueue
+* A queue that can be filled from any number of threads without locking,
+* but only one thread may take entries out of it.
+* Push links the new node in with a single atomic exchange, the consumer owns everything behind the tail.
+*/
+
+template <class T>
+class CLockFreeQueue
+{
+public:
+	CLockFreeQueue()
+	{
+		m_pTail = new SNode();
+		m_Head.fetchAndStoreOrdered(m_pTail);
+	}
+	~CLockFreeQueue()
+	{
+		T Value;
+		while(Pop(Value));
+		delete m_pTail;
+	}
+
+	void				Push(const T& Value)
+	{
+		SNode* pNode = new SNode(Value);
+		SNode* pPrev = m_Head.fetchAndStoreOrdered(pNode);
+		// Note: untill this store the consumer sees the queue ending at pPrev, it will pick up pNode on its next Pop
+		pPrev->pNext.fetchAndStoreRelease(pNode);
+	}
+
+	// Note: this may only be called from the consumer thread
+	bool				Pop(T& Value)
+	{
+		SNode* pTail = m_pTail;
+#if QT_VERSION < 0x050000
+		SNode* pNext = pTail->pNext;
+#else
+		SNode* pNext = pTail->pNext.loadAcquire();
+#endif
+		if(!pNext)
+			return false;
+		Value = pNext->Value;
+		pNext->Value = T();
+		m_pTail = pNext; // the node we took the value from becomes the new stub
+		delete pTail;
+		return true;
+	}
+
+protected:
+	struct SNode
+	{
+		SNode(const T& v = T()) : Value(v) {}
+		QAtomicPointer<SNode>	pNext;
+		T						Value;
+	};
+
+	QAtomicPointer<SNode>	m_Head;		// last pushed node, written by the producers
+	SNode*					m_pTail;	// stub node, only touched by the consumer
+};
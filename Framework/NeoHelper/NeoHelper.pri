@@ -25,16 +25,20 @@ HEADERS += ./GlobalHeader.h \
     ../Tracker.h \
     ../Types.h \
     ../Xml.h \
+    ../Journal.h \
     ../TempFile.h \
+    ../UdpBatch.h \
     ../Cryptography/PrivateKey.h \
     ../Cryptography/PublicKey.h \
     ../Cryptography/AbstractKey.h \
     ../Cryptography/AsymmetricKey.h \
     ../Cryptography/HashFunction.h \
+    ../Cryptography/HashKernels.h \
     ../Cryptography/KeyExchange.h \
     ../Cryptography/SymmetricKey.h \
     ../MT/ThreadEx.h \
     ../MT/ThreadLock.h \
+    ../MT/LockFreeQueue.h \
     ../IPC/IPCClient.h \
     ../IPC/IPCServer.h \
     ../IPC/IPCSocket.h \
@@ -66,11 +70,14 @@ SOURCES += ./GlobalHeader.cpp \
     ../Strings.cpp \
     ../TempFile.cpp \
     ../Tracker.cpp \
+    ../UdpBatch.cpp \
     ../Xml.cpp \
+    ../Journal.cpp \
     ../Cryptography/PrivateKey.cpp \
     ../Cryptography/PublicKey.cpp \
     ../Cryptography/AbstractKey.cpp \
     ../Cryptography/HashFunction.cpp \
+    ../Cryptography/HashKernels.cpp \
     ../Cryptography/KeyExchange.cpp \
     ../Cryptography/SymmetricKey.cpp \
     ../MT/ThreadEx.cpp \
@@ -42,7 +42,7 @@ CONFIG(release, debug|release):contains(QMAKE_HOST.arch, x86_64):LIBS += \
 CONFIG(release, debug|release):!contains(QMAKE_HOST.arch, x86_64):LIBS += \
     -L../../../NeoLoader/crypto++/Win32/DLL_Output/Release/ \
     -L../../../NeoLoader/zlib/win32/Release/
-LIBS += -lqjson -lqbencode -lcryptopp -lzlib
+LIBS += -lqjson -lqbencode -lcryptopp -lzlib -lws2_32
 }
 
 !win32:{
@@ -55,6 +55,8 @@ CSettings::CSettings(const QString& Name, QMap<QString, SSetting> DefaultValues,
 	m_DefaultValues = DefaultValues;
 	sync();
 
+	SSnapshot* pSnapshot = new SSnapshot();
+
 	foreach (const QString& Key, m_DefaultValues.uniqueKeys())
 	{
 		const SSetting& Setting = m_DefaultValues[Key];
@@ -65,7 +67,23 @@ CSettings::CSettings(const QString& Name, QMap<QString, SSetting> DefaultValues,
 			else
 				setValue(Key, Setting.Value);
 		}
+
+		if(Setting.IsBlob())
+			continue;
+
+		m_SlotKeys.append(Key.toLatin1());
+		m_Slots.insert(SStrRef(m_SlotKeys.last().constData()), pSnapshot->Values.size());
+		pSnapshot->Values.append(QVariant());
+		pSnapshot->Numbers.append(0);
+		SetSlot(pSnapshot, pSnapshot->Values.size() - 1, Key, value(Key));
 	}
+
+	m_Snapshot.fetchAndStoreOrdered(pSnapshot);
+}
+
+CSettings::~CSettings()
+{
+	delete LoadSnapshot();
 }
 
 bool CSettings::SetSetting(const QString &key, const QVariant &value)
@@ -78,13 +96,56 @@ bool CSettings::SetSetting(const QString &key, const QVariant &value)
 #endif
 	setValue(key, value);
 
-	m_Cache_bool.clear();
-	m_Cache_qint32.clear();
-	m_Cache_quint32.clear();
-	m_Cache_quint64.clear();
+	UpdateSnapshot(key, value);
 	return true;
 }
 
+void CSettings::UpdateSnapshot(const QString& key, const QVariant& value)
+{
+	int Slot = GetSlot(key.toLatin1().constData());
+	if(Slot == -1)
+		return;
+
+	SSnapshot* pOld = LoadSnapshot();
+	SSnapshot* pNew = new SSnapshot(*pOld);
+	SetSlot(pNew, Slot, key, value);
+
+	m_Snapshot.fetchAndStoreOrdered(pNew);
+
+	// Note: a reader registers with the current epoch and only loads the snapshot once the epoch is confirmed,
+	//			so after the epoch was advanced only the readers counted for the old one may still use the old snapshot,
+	//			new readers count for the new epoch, hence this wait is short, a reader holds a snapshot only for a single lookup
+	int Epoch = m_Epoch.fetchAndAddOrdered(1);
+	while(!m_Readers[Epoch & 1].testAndSetOrdered(0, 0))
+		QThread::yieldCurrentThread();
+	delete pOld;
+}
+
+void CSettings::SetSlot(SSnapshot* pSnapshot, int Slot, const QString& key, const QVariant& value)
+{
+	pSnapshot->Values[Slot] = value;
+
+	// Note: the ini file gives us back strings, so the type of the default value decides how to read it
+	QVariant::Type Type = m_DefaultValues[key].Value.type();
+	if(Type == QVariant::Bool)
+		pSnapshot->Numbers[Slot] = value.toBool() ? 1 : 0;
+	else if(Type == QVariant::ULongLong)
+		pSnapshot->Numbers[Slot] = (qint64)value.toULongLong();
+	else
+		pSnapshot->Numbers[Slot] = value.toLongLong();
+}
+
+QVariant CSettings::GetVariant(const SStrRef& key)
+{
+	int Slot = GetSlot(key);
+	if(Slot != -1)
+	{
+		SReader Snapshot(this);
+		return Snapshot->Values.at(Slot);
+	}
+	return GetSetting(key);
+}
+
 QVariant CSettings::GetSetting(const QString &key)
 {
 	QMutexLocker Locker(&m_Mutex);
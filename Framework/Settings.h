@@ -5,6 +5,8 @@
 #include <QSettings>
 #include <QVariant>
 #include <QMutex>
+#include <QAtomicPointer>
+#include <QVector>
 #include "Types.h"
 #include <QStringList>
 
@@ -20,7 +22,7 @@ public:
 		SStrRef(const char* pRef)
 		 : Ref(pRef) {}
 
-		bool operator < (const SStrRef& Other) const {return strcmp(Ref, Other.Ref) < 0;}
+		bool operator < (const SStrRef& Other) const {return strcmp(Ref, Other.Ref) < 0;}
 		bool operator == (const SStrRef& Other) const {return strcmp(Ref, Other.Ref) == 0;}
 
 		operator QString() const {return QString(Ref);}
@@ -90,6 +92,7 @@ public:
 	static void			InitSettingsEnvironment(const QString& Orga, const QString& Name, const QString& Domain);
 
 	CSettings(const QString& Name, QMap<QString, SSetting> DefaultValues, QObject* qObject = NULL);
+	~CSettings();
 
 	static QString		GetAppDir()									{return m_sAppDir;}
 	static QString		GetSettingsDir()							{return m_sConfigDir;} 
@@ -101,44 +104,104 @@ public:
 	void				SetBlob(const QString& key, const QByteArray& value);
 	QByteArray			GetBlob(const QString& key);
 
-#define IMPL_CFG_CACHE_GET(x,y,z) \
+	/**
+	* All declared settings, except blobs, have a slot in a snapshot that is replaced as a whole when a setting changes,
+	* readers take the current snapshot without locking.
+	* The slot of a key does not change for the lifetime of the object, so hot paths can look it up once and use GetValue.
+	*/
+	int					GetSlot(const SStrRef& key) const			{QMap<SStrRef, int>::const_iterator I = m_Slots.find(key); return I != m_Slots.end() ? I.value() : -1;}
+	qint64				GetValue(int Slot) const					{SReader Snapshot(this); return Snapshot->Numbers.at(Slot);}
+
+#define IMPL_CFG_GET(x,y,z) \
 	x					Get##y(const SStrRef& key) \
 	{ \
-		QMutexLocker Locker(&m_Mutex); \
-		QMap<SStrRef, x>::Iterator I =  m_Cache_##x.find(key); \
-		if(I != m_Cache_##x.end()) \
-			return I.value(); \
-		Locker.unlock(); \
-		x val = GetSetting(key).to##z(); \
-		Locker.relock(); \
-		m_Cache_##x.insert(key, val); \
-		return val; \
+		int Slot = GetSlot(key); \
+		if(Slot != -1) \
+			return (x)GetValue(Slot); \
+		return GetSetting(key).to##z(); \
 	}
-	IMPL_CFG_CACHE_GET(bool, Bool, Bool);
-	IMPL_CFG_CACHE_GET(qint32, Int, Int);
-	IMPL_CFG_CACHE_GET(quint32, UInt, UInt);
-	IMPL_CFG_CACHE_GET(quint64, UInt64, ULongLong);
-#undef IMPL_CFG_CACHE_GET
-
-	const QString		GetString(const QString& key)				{return GetSetting(key).toString();}
-	const QStringList	GetStringList(const QString& key)			{return GetSetting(key).toStringList();}
+	IMPL_CFG_GET(bool, Bool, Bool);
+	IMPL_CFG_GET(qint32, Int, Int);
+	IMPL_CFG_GET(quint32, UInt, UInt);
+	IMPL_CFG_GET(quint64, UInt64, ULongLong);
+#undef IMPL_CFG_GET
+
+	// Note: literal keys are looked up as they are, only composed keys must be converted first
+	const QString		GetString(const char* key)					{return GetVariant(key).toString();}
+	const QString		GetString(const QString& key)				{return GetVariant(key.toLatin1().constData()).toString();}
+	const QStringList	GetStringList(const char* key)				{return GetVariant(key).toStringList();}
+	const QStringList	GetStringList(const QString& key)			{return GetVariant(key.toLatin1().constData()).toStringList();}
 
 	const QStringList 	ListSettings()								{QMutexLocker Locker(&m_Mutex); return QSettings::allKeys();}
 	const QStringList 	ListGroupes()								{QMutexLocker Locker(&m_Mutex); return QSettings::childGroups();}
 	const QStringList 	ListKeys(const QString& Root);
 
 protected:
+	struct SSnapshot
+	{
+		QVector<qint64>		Numbers;	// integer value of every slot, bools are 0 or 1
+		QVector<QVariant>	Values;
+	};
+
+	// Note: readers are counted per epoch while they use a snapshot, a writer replaces the snapshot, starts a new epoch
+	//			and deletes the old snapshot once the readers of the previous epoch are gone, see UpdateSnapshot
+	struct SReader
+	{
+		SReader(const CSettings* pSettings)
+		{
+			m_pSettings = pSettings;
+			for(;;)
+			{
+				m_Epoch = m_pSettings->LoadEpoch();
+				m_pSettings->m_Readers[m_Epoch & 1].ref();
+				if(m_pSettings->LoadEpoch() == m_Epoch)
+					break;
+				m_pSettings->m_Readers[m_Epoch & 1].deref(); // a writer started a new epoch in between, register with that one
+			}
+			m_pSnapshot = m_pSettings->LoadSnapshot();
+		}
+		~SReader()											{m_pSettings->m_Readers[m_Epoch & 1].deref();}
+
+		const SSnapshot*	operator->() const				{return m_pSnapshot;}
+
+	protected:
+		const CSettings*	m_pSettings;
+		const SSnapshot*	m_pSnapshot;
+		int					m_Epoch;
+	};
+
+	SSnapshot*			LoadSnapshot() const
+	{
+#if QT_VERSION < 0x050000
+		return m_Snapshot;
+#else
+		return m_Snapshot.loadAcquire();
+#endif
+	}
+	int					LoadEpoch() const
+	{
+#if QT_VERSION < 0x050000
+		return m_Epoch;
+#else
+		return m_Epoch.loadAcquire();
+#endif
+	}
+	// Note: all writes must go through SetSetting, or the snapshot would not see the new value
+	using QSettings::setValue;
+
+	QVariant			GetVariant(const SStrRef& key);
+	void				UpdateSnapshot(const QString& key, const QVariant& value);
+	void				SetSlot(SSnapshot* pSnapshot, int Slot, const QString& key, const QVariant& value);
+
 	QMutex				m_Mutex;
 	QString				m_sName;
 	QMap<QString, SSetting> m_DefaultValues;
 
-#define IMPL_CFG_CACHE(x) \
-	QMap<SStrRef, x>		m_Cache_##x;
-	IMPL_CFG_CACHE(bool)
-	IMPL_CFG_CACHE(qint32)
-	IMPL_CFG_CACHE(quint32)
-	IMPL_CFG_CACHE(quint64)
-#undef IMPL_CFG_CACHE
+	QList<QByteArray>	m_SlotKeys;		// storage for the keys m_Slots refers to
+	QMap<SStrRef, int>	m_Slots;		// fixed after construction
+	QAtomicPointer<SSnapshot> m_Snapshot;
+	QAtomicInt			m_Epoch;
+	mutable QAtomicInt	m_Readers[2];	// readers of the current and the previous epoch
 
 	static void			InitInstalled();
 
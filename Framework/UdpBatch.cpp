@@ -0,0 +1,240 @@
+#include "GlobalHeader.h"
+#include "UdpBatch.h"
+
+#ifndef WIN32
+   #include <unistd.h>
+   #include <cstring>
+   #include <errno.h>
+   #include <sys/types.h>
+   #include <sys/socket.h>
+   #include <sys/uio.h>
+   #include <netinet/in.h>
+   #define WSAGetLastError() errno
+   #define WSAECONNRESET ECONNRESET
+   #define WSAEMSGSIZE EMSGSIZE
+#ifdef __linux__
+   #define USE_MMSG
+#endif
+#else
+   #include <winsock2.h>
+   #include <ws2tcpip.h>
+   typedef int socklen_t;
+#endif
+
+struct CUdpBatch::SAddress
+{
+	sockaddr_storage	sa;
+	socklen_t			len;
+};
+
+struct CUdpBatch::SHeaders
+{
+#ifdef USE_MMSG
+	SHeaders(int Slots)
+	{
+		Recv = new mmsghdr[Slots];
+		RecvVec = new iovec[Slots];
+		Send = new mmsghdr[Slots];
+		SendVec = new iovec[Slots];
+	}
+	~SHeaders()
+	{
+		delete [] Recv;
+		delete [] RecvVec;
+		delete [] Send;
+		delete [] SendVec;
+	}
+
+	mmsghdr*			Recv;
+	iovec*				RecvVec;
+	mmsghdr*			Send;
+	iovec*				SendVec;
+#endif
+};
+
+CUdpBatch::CUdpBatch(int Slots, int SlotSize)
+{
+	m_Socket = INVALID_SOCKET;
+	m_Slots = Slots;
+	m_SlotSize = SlotSize;
+
+	m_RecvData = new byte[Slots * SlotSize];
+	m_RecvLength = new int[Slots];
+	m_RecvAddress = new SAddress[Slots];
+
+#ifdef USE_MMSG
+	m_SendData = new byte[Slots * SlotSize];
+	m_SendLength = new int[Slots];
+	m_SendAddress = new SAddress[Slots];
+	m_Headers = new SHeaders(Slots);
+#else
+	// Note: without sendmmsg there is nothing to gain from collecting datagrams, they are sent right away
+	m_SendData = NULL;
+	m_SendLength = NULL;
+	m_SendAddress = NULL;
+	m_Headers = NULL;
+#endif
+	m_SendCount = 0;
+}
+
+CUdpBatch::~CUdpBatch()
+{
+	delete [] m_RecvData;
+	delete [] m_RecvLength;
+	delete [] m_RecvAddress;
+
+	delete [] m_SendData;
+	delete [] m_SendLength;
+	delete [] m_SendAddress;
+	delete m_Headers;
+}
+
+void CUdpBatch::SetSocket(SOCKET Socket)
+{
+	// Note: datagrams queued for the old socket are dropped
+	m_Socket = Socket;
+	m_SendCount = 0;
+}
+
+const struct sockaddr* CUdpBatch::GetAddress(int Index, int* pLength) const
+{
+	if(pLength)
+		*pLength = (int)m_RecvAddress[Index].len;
+	return (const struct sockaddr*)&m_RecvAddress[Index].sa;
+}
+
+int CUdpBatch::Receive()
+{
+	if(m_Socket == INVALID_SOCKET)
+		return 0;
+
+#ifdef USE_MMSG
+	for(int i=0; i < m_Slots; i++)
+	{
+		m_Headers->RecvVec[i].iov_base = m_RecvData + i * m_SlotSize;
+		m_Headers->RecvVec[i].iov_len = m_SlotSize;
+
+		memset(&m_Headers->Recv[i], 0, sizeof(mmsghdr));
+		m_Headers->Recv[i].msg_hdr.msg_iov = &m_Headers->RecvVec[i];
+		m_Headers->Recv[i].msg_hdr.msg_iovlen = 1;
+		m_Headers->Recv[i].msg_hdr.msg_name = &m_RecvAddress[i].sa;
+		m_Headers->Recv[i].msg_hdr.msg_namelen = sizeof(sockaddr_storage);
+	}
+
+	for(;;)
+	{
+		int Count = recvmmsg(m_Socket, m_Headers->Recv, m_Slots, MSG_DONTWAIT, NULL);
+		if(Count < 0)
+		{
+			// ECONNRESET - a previous send resulted in an ICMP Port Unreachable message
+			if(errno == EINTR || errno == ECONNRESET)
+				continue;
+			// any other error (such as EWOULDBLOCK) means there is nothing to receive
+			return 0;
+		}
+
+		for(int i=0; i < Count; i++)
+		{
+			m_RecvAddress[i].len = m_Headers->Recv[i].msg_hdr.msg_namelen;
+			m_RecvLength[i] = (m_Headers->Recv[i].msg_hdr.msg_flags & MSG_TRUNC) ? -1 : (int)m_Headers->Recv[i].msg_len;
+		}
+		return Count;
+	}
+#else
+	int Count = 0;
+	while(Count < m_Slots)
+	{
+		socklen_t sa_len = sizeof(sockaddr_storage);
+		int Length = recvfrom(m_Socket, (char*)m_RecvData + Count * m_SlotSize, m_SlotSize, 0, (struct sockaddr*)&m_RecvAddress[Count].sa, &sa_len);
+		if(Length < 0)
+		{
+			int err = WSAGetLastError();
+			// ECONNRESET - On a UDP-datagram socket
+			// this error indicates a previous send operation
+			// resulted in an ICMP Port Unreachable message.
+			if (err == WSAECONNRESET)
+				continue;
+			// EMSGSIZE - The message was too large to fit into the slot and was truncated.
+			if (err == WSAEMSGSIZE)
+				Length = -1;
+			else // any other error (such as EWOULDBLOCK) results in breaking the loop
+				break;
+		}
+		else if(Length >= m_SlotSize)
+			Length = -1; // Note: posix truncates silently, a full slot may be a truncated datagram
+
+		m_RecvAddress[Count].len = sa_len;
+		m_RecvLength[Count] = Length;
+		Count++;
+	}
+	return Count;
+#endif
+}
+
+void CUdpBatch::Send(const byte* pData, size_t uLength, const struct sockaddr* sa, int sa_len)
+{
+	if(m_Socket == INVALID_SOCKET)
+		return;
+
+#ifdef USE_MMSG
+	if(uLength > (size_t)m_SlotSize)
+	{
+		Flush(); // keep the order
+		SendOne(pData, uLength, sa, sa_len);
+		return;
+	}
+
+	if(m_SendCount >= m_Slots)
+		Flush();
+
+	memcpy(m_SendData + m_SendCount * m_SlotSize, pData, uLength);
+	m_SendLength[m_SendCount] = (int)uLength;
+	memcpy(&m_SendAddress[m_SendCount].sa, sa, sa_len);
+	m_SendAddress[m_SendCount].len = sa_len;
+	m_SendCount++;
+#else
+	SendOne(pData, uLength, sa, sa_len);
+#endif
+}
+
+int CUdpBatch::Flush()
+{
+#ifdef USE_MMSG
+	for(int i=0; i < m_SendCount; i++)
+	{
+		m_Headers->SendVec[i].iov_base = m_SendData + i * m_SlotSize;
+		m_Headers->SendVec[i].iov_len = m_SendLength[i];
+
+		memset(&m_Headers->Send[i], 0, sizeof(mmsghdr));
+		m_Headers->Send[i].msg_hdr.msg_iov = &m_Headers->SendVec[i];
+		m_Headers->Send[i].msg_hdr.msg_iovlen = 1;
+		m_Headers->Send[i].msg_hdr.msg_name = &m_SendAddress[i].sa;
+		m_Headers->Send[i].msg_hdr.msg_namelen = m_SendAddress[i].len;
+	}
+
+	int Sent = 0;
+	while(Sent < m_SendCount)
+	{
+		int Count = sendmmsg(m_Socket, m_Headers->Send + Sent, m_SendCount - Sent, MSG_DONTWAIT);
+		if(Count < 0)
+		{
+			if(errno == EINTR)
+				continue;
+			if(errno == EAGAIN || errno == EWOULDBLOCK)
+				break; // the send buffer is full, drop the rest just like sendto would
+			Sent++; // Note: this datagram failed on its own (bad address, unreachable), skip it and go on with the rest
+			continue;
+		}
+		Sent += Count;
+	}
+	m_SendCount = 0;
+	return Sent;
+#else
+	return 0;
+#endif
+}
+
+int CUdpBatch::SendOne(const byte* pData, size_t uLength, const struct sockaddr* sa, int sa_len)
+{
+	return sendto(m_Socket, (const char*)pData, (int)uLength, 0, sa, sa_len);
+}
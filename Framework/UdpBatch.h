@@ -0,0 +1,68 @@
+#pragma once
+
+#include "./NeoHelper/neohelper_global.h"
+
+#ifndef WIN32
+#ifndef SOCKET
+   #define SOCKET int
+#endif
+#ifndef INVALID_SOCKET
+   #define INVALID_SOCKET (-1)
+#endif
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Batched datagram io for a non blocking UDP socket, received datagrams land in a ring of fixed
+// size slots and outgoing ones are collected in a second ring untill Flush is called or the ring is full.
+// On linux a whole ring is moved with one recvmmsg/sendmmsg call, elsewhere we fall back to one call per datagram.
+// Note: the slots should be sized to the largest datagram the protocol uses, not to the UDP maximum,
+//			both rings are allocated up front, so 32 slots of 64KB would cost 4MB per socket.
+
+class NEOHELPER_EXPORT CUdpBatch
+{
+public:
+	CUdpBatch(int Slots = 32, int SlotSize = 4*1024);
+	~CUdpBatch();
+
+	void				SetSocket(SOCKET Socket);
+	SOCKET				GetSocket() const						{return m_Socket;}
+	int					GetSlots() const						{return m_Slots;}
+
+	/**
+	* Receives up to GetSlots() datagrams, GetLength is -1 for a datagram that did not fit into its slot
+	* @return: number of datagrams received, 0 if there are none waiting
+	*/
+	int					Receive();
+	const byte*			GetData(int Index) const				{return m_RecvData + Index * m_SlotSize;}
+	int					GetLength(int Index) const				{return m_RecvLength[Index];}
+	const struct sockaddr* GetAddress(int Index, int* pLength) const;
+
+	/**
+	* Copies the datagram into the send ring, the ring is flushed when it gets full,
+	* datagrams that dont fit into a slot are sent directly after the ring was flushed
+	*/
+	void				Send(const byte* pData, size_t uLength, const struct sockaddr* sa, int sa_len);
+	int					Flush();
+	int					GetPending() const						{return m_SendCount;}
+
+protected:
+	struct SAddress;
+
+	int					SendOne(const byte* pData, size_t uLength, const struct sockaddr* sa, int sa_len);
+
+	SOCKET				m_Socket;
+	int					m_Slots;
+	int					m_SlotSize;
+
+	byte*				m_RecvData;
+	int*				m_RecvLength;
+	SAddress*			m_RecvAddress;
+
+	byte*				m_SendData;
+	int*				m_SendLength;
+	SAddress*			m_SendAddress;
+	int					m_SendCount;
+
+	struct SHeaders;
+	SHeaders*			m_Headers;		// mmsghdr arrays on linux
+};
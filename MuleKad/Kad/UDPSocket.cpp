@@ -40,11 +40,13 @@
 CUDPSocket*	CUDPSocket::m_Instance = NULL;
 
 CUDPSocket::CUDPSocket(uint16_t UDPPort, uint32_t UDPKey)
+ : m_Batch(32, 8*1024)
 {
 	ASSERT(m_Instance == NULL);
 	m_Instance = this;
 
 	m_UDPKey = UDPKey;
+	m_Batching = false;
 
 	// initialise IP v4 socket
     struct sockaddr_in sin;
@@ -63,11 +65,23 @@ CUDPSocket::CUDPSocket(uint16_t UDPPort, uint32_t UDPKey)
 			closesocket(m_socket);
 			m_socket = -1;
 		}
+		else
+		{
+#ifdef WIN32
+			u_long iMode = 1;
+			ioctlsocket(m_socket, FIONBIO, &iMode);
+#else
+			int iMode = fcntl(m_socket, F_GETFL, 0);
+			fcntl(m_socket, F_SETFL, iMode | O_NONBLOCK);
+#endif
+			m_Batch.SetSocket(m_socket);
+		}
     }
 }
 
 CUDPSocket::~CUDPSocket()
 {
+	m_Batch.SetSocket(INVALID_SOCKET);
 	closesocket(m_socket);
 	m_socket = -1;
 
@@ -76,36 +90,30 @@ CUDPSocket::~CUDPSocket()
 
 void CUDPSocket::Process()
 {
+	// Note: answers to the received packets are collected and sent all at once at the end
+	m_Batching = true;
 	for(;;)
 	{
-		fd_set readfds;
-        struct timeval tv;
-        tv.tv_sec = 0;
-        tv.tv_usec = 0;
-
-        FD_ZERO(&readfds);
-        FD_SET(m_socket, &readfds);
-        if(select(m_socket + 1, &readfds, NULL, NULL, &tv) == SOCKET_ERROR) 
+		int Count = m_Batch.Receive();
+		for(int i=0; i < Count; i++)
 		{
-			LogLine(LOG_ERROR, _T("Socket select failed"));
-			break;
-        }
-		if(!FD_ISSET(m_socket, &readfds))
-			break;
+			int len = m_Batch.GetLength(i);
+			if(len < 0)
+				continue; // to large for a kad packet
 
-		struct sockaddr_in from;
-		socklen_t fromlen = sizeof(from);
-		char* buf = new char [8*1024];
-		size_t len = recvfrom(m_socket, buf, 8*1024 - 1, 0, (struct sockaddr*)&from, &fromlen);
-        
-#ifndef WIN32
-		ProcessPacket(ntohl(from.sin_addr.s_addr), ntohs(from.sin_port), (uint8_t*)buf, len);
+			const struct sockaddr_in* from = (const struct sockaddr_in*)m_Batch.GetAddress(i, NULL);
+#ifndef WIN32
+			ProcessPacket(ntohl(from->sin_addr.s_addr), ntohs(from->sin_port), (uint8_t*)m_Batch.GetData(i), len);
 #else
-		ProcessPacket(ntohl(from.sin_addr.S_un.S_addr), ntohs(from.sin_port), (uint8_t*)buf, len);
+			ProcessPacket(ntohl(from->sin_addr.S_un.S_addr), ntohs(from->sin_port), (uint8_t*)m_Batch.GetData(i), len);
 #endif
+		}
 
-		delete [] buf;
+		if(Count < m_Batch.GetSlots())
+			break;
     }
+	m_Batching = false;
+	m_Batch.Flush();
 }
 
 void CUDPSocket::SendPacket(char*& buf, size_t& len, uint32_t ip, uint16_t port, bool bEncrypt, const uint8_t* pachTargetClientHashORKadID, bool bKad, uint32_t nReceiverVerifyKey)
@@ -119,7 +127,9 @@ void CUDPSocket::SendPacket(char*& buf, size_t& len, uint32_t ip, uint16_t port,
 	to.sin_family = AF_INET;
 	to.sin_addr.s_addr = ntohl(ip);
 	to.sin_port = ntohs(port);
-	sendto(m_socket, buf, len, 0, (struct sockaddr*)&to, tolen);
+	m_Batch.Send((const byte*)buf, len, (struct sockaddr*)&to, tolen);
+	if(!m_Batching)
+		m_Batch.Flush();
 }
 
 void CUDPSocket::ProcessPacket(uint32_t ip, uint16_t port, uint8_t* buffer, size_t length)
@@ -32,6 +32,7 @@
    #include <sys/types.h>
    #include <sys/socket.h>
    #include <netinet/in.h>
+   #include <fcntl.h>
    #define SOCKET int
    #define SOCKET_ERROR (-1)
    #define closesocket close
@@ -41,6 +42,8 @@
    #include <wspiapi.h>
 #endif
 
+#include "../../Framework/UdpBatch.h"
+
 class CPacket;
 
 class CUDPSocket
@@ -65,6 +68,8 @@ public:
 protected:
 	uint32_t			m_UDPKey;
 	SOCKET				m_socket;
+	CUdpBatch			m_Batch;
+	bool				m_Batching;
 
 	static CUDPSocket*	m_Instance;
 };
@@ -195,7 +195,7 @@ void CMuleKad::OnRequestRecived(const QString& Command, const QVariant& Paramete
 		{
 			QVariantMap Options = Request["Options"].toMap();
 			foreach(const QString& Key, Options.keys())
-				m_Settings->setValue(Key, Options[Key]);
+				m_Settings->SetSetting(Key, Options[Key]);
 		}
 		else
 		{
@@ -224,7 +224,7 @@ CModernGUI::~CModernGUI()
 {
 	theGUI->Cfg()->SetBlob("Gui/Widget_HSplitter",m_pSplitter->saveState());
 
-	theGUI->Cfg()->setValue("Gui/Widget_ShowTabs", m_pDetailTabs->isChecked());
+	theGUI->Cfg()->SetSetting("Gui/Widget_ShowTabs", m_pDetailTabs->isChecked());
 
 	delete m_pSummaryWnd;
 	delete m_pFileListWnd;
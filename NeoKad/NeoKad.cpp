@@ -339,7 +339,7 @@ void CNeoKad::OnRequestRecived(const QString& Command, const QVariant& Parameter
 		{
 			QVariantMap Options = Request["Options"].toMap();
 			foreach(const QString& Key, Options.keys())
-				m_Settings->setValue(Key, Options[Key]);
+				m_Settings->SetSetting(Key, Options[Key]);
 		}
 		else
 		{
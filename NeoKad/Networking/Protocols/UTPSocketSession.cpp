@@ -7,7 +7,7 @@
 
 
 CUTPSocketListner::CUTPSocketListner(CSmartSocket* pSocket)
- : CSocketListner(pSocket)
+ : CSocketListner(pSocket), m_Batch(32, 4*1024) // Note: our packets stay below the MTU (MSS 1402)
 {
 	m_bIPv6 = false;
 	m_Port = 0;
@@ -23,6 +23,7 @@ CUTPSocketListner::CUTPSocketListner(CSmartSocket* pSocket)
 #endif
 
 	m_Socket = INVALID_SOCKET;
+	m_Batching = false;
 	m_RecvKey = pSocket->GetRecvKey();
 	m_NextCleanUp = 0;
 }
@@ -55,6 +56,8 @@ void CUTPSocketListner::Close()
 {
 	if(m_Socket != INVALID_SOCKET)
 	{
+		m_Batch.Flush();
+		m_Batch.SetSocket(INVALID_SOCKET);
 		closesocket(m_Socket);
 		m_Socket = INVALID_SOCKET;
 	}
@@ -120,6 +123,8 @@ bool CUTPSocketListner::Bind(uint16 Port, const CAddress& IP)
 	fcntl(m_Socket, F_SETFL, iMode | O_NONBLOCK);
 #endif
 
+	m_Batch.SetSocket(m_Socket);
+
 	m_Port = Port;
 	LogLine(LOG_SUCCESS, L"%s Socket is listening at port %d", m_bIPv6 ? L"UTPv6" : L"UTP", m_Port);
 	return true;
@@ -234,31 +239,22 @@ void CUTPSocketListner::Process()
 
 	if (FD_ISSET(m_Socket, &r))*/
 	{
-		byte buffer[0xFFFF];
-		sockaddr_in6 sa; // sockaddr_in is smaller
-		socklen_t sa_len = sizeof(sa);
-
 		for (;;) 
 		{
-			int len = recvfrom(m_Socket, (char*)buffer, sizeof(buffer), 0, (struct sockaddr*)&sa, &sa_len);
-			if (len < 0) 
+			int Count = m_Batch.Receive();
+			for(int i=0; i < Count; i++)
 			{
-				int err = WSAGetLastError();
-				// ECONNRESET - On a UDP-datagram socket
-				// this error indicates a previous send operation
-				// resulted in an ICMP Port Unreachable message.
-				if (err == ECONNRESET) 
-					continue;
-				// EMSGSIZE - The message was too large to fit into
-				// the buffer pointed to by the buf parameter and was
-				// truncated.
-				if (err == EMSGSIZE) 
-					continue;
-				// any other error (such as EWOULDBLOCK) results in breaking the loop
-				break;
+				int len = m_Batch.GetLength(i);
+				if(len < 0)
+					continue; // the message was too large and got truncated
+
+				int sa_len = 0;
+				const struct sockaddr* sa = m_Batch.GetAddress(i, &sa_len);
+				Recv(m_Batch.GetData(i), len, sa, sa_len);
 			}
 
-			Recv(buffer, len, (struct sockaddr*)&sa, sa_len);
+			if(Count < m_Batch.GetSlots())
+				break; // Note: a ring that was not filled means the socket is drained
 		}
 	}
 	/*if (FD_ISSET(m_Socket, &e)) 
@@ -556,7 +552,9 @@ void CUTPSocketListner::Send(const byte* Buff, size_t uSize, const struct sockad
 
 	RC4.ProcessData(pBuffer + 8, pBuffer + 8, uLength - 8);
 
-	sendto(m_Socket, Buffer, (int)uLength, 0, (struct sockaddr*)sa, sa_len);
+	m_Batch.Send((const byte*)Buffer, uLength, sa, sa_len);
+	if(!m_Batching)
+		m_Batch.Flush();
 }
 
 bool CUTPSocketListner::SendTo(const CBuffer& Packet, const CSafeAddress& Address)
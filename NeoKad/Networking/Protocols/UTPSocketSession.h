@@ -25,6 +25,8 @@
    #include <wspiapi.h>
 #endif
 
+#include "../../../Framework/UdpBatch.h"
+
 class CUTPSocketListner: public CSocketListner
 {
 public:
@@ -36,6 +38,9 @@ public:
 
 	virtual void					Process();
 
+	virtual void					StartBatch()	{m_Batching = true;}
+	virtual void					FlushBatch()	{m_Batching = false; m_Batch.Flush();}
+
 	virtual	CSocketSession*			CreateSession(const CSafeAddress& Address, bool bRendevouz = false, bool bEmpty = false);
 
 	virtual CSafeAddress::EProtocol	GetProtocol()	{return m_Port == 0 ? CSafeAddress::eInvalid : (m_bIPv6 ? CSafeAddress::eUTP_IP6 : CSafeAddress::eUTP_IP4);}
@@ -52,6 +57,8 @@ protected:
 	bool							m_bIPv6;
 	uint16							m_Port;
 	SOCKET							m_Socket;
+	CUdpBatch						m_Batch;
+	bool							m_Batching;
 
 	struct SPassKey
 	{
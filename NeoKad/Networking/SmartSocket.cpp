@@ -42,7 +42,10 @@ void CSmartSocket::Process(bool bSecond)
 	m_DownManager->Process();
 
 	for(ListnerMap::iterator I = m_Listners.begin(); I != m_Listners.end(); I++)
+	{
+		I->second->StartBatch();
 		I->second->Process();
+	}
 
 	for(list<CPointer<CSocketSession> >::iterator I = m_Sessions.begin(); I != m_Sessions.end();)
 	{
@@ -54,6 +57,9 @@ void CSmartSocket::Process(bool bSecond)
 		else
 			I++;
 	}
+
+	for(ListnerMap::iterator I = m_Listners.begin(); I != m_Listners.end(); I++)
+		I->second->FlushBatch();
 }
 
 void CSmartSocket::ProcessPacket(const string& Name, const CVariant& Packet, CComChannel* pChannel)
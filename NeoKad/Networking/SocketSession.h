@@ -57,6 +57,10 @@ public:
 
 	virtual void					Process() = 0;
 
+	// Note: listeners that can send datagrams in batches collect them from StartBatch untill FlushBatch
+	virtual void					StartBatch()	{}
+	virtual void					FlushBatch()	{}
+
 	virtual	CSocketSession*			CreateSession(const CSafeAddress& Address, bool bRendevouz = false, bool bEmpty = false) = 0;
 	virtual	bool					SendPacket(const string& Name, const CVariant& Packet, const CSafeAddress& Address);
 
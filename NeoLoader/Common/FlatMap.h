@@ -0,0 +1,170 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// A sorted map stored in two contiguous arrays, keys and values are kept apart so that a lookup
+// only touches the keys. It offers the part of the QMap interface the range maps use,
+// iterators are positions in the arrays and are invalidated by any insert or erase.
+
+template <typename K, typename V>
+class CFlatMap
+{
+public:
+	class iterator
+	{
+	public:
+		iterator() {m_pMap = NULL; m_Index = 0;}
+		iterator(CFlatMap* pMap, int Index) {m_pMap = pMap; m_Index = Index;}
+
+		const K&		key() const						{return m_pMap->m_Keys.at(m_Index);}
+		V&				value() const					{return m_pMap->m_Values[m_Index];}
+		V&				operator*() const				{return value();}
+		int				index() const					{return m_Index;}
+		CFlatMap*		map() const						{return m_pMap;}
+
+		iterator&		operator++()					{m_Index++; return *this;}
+		iterator		operator++(int)					{iterator Old = *this; m_Index++; return Old;}
+		iterator&		operator--()					{m_Index--; return *this;}
+		iterator		operator--(int)					{iterator Old = *this; m_Index--; return Old;}
+		bool			operator==(const iterator& I) const	{return m_Index == I.m_Index;}
+		bool			operator!=(const iterator& I) const	{return m_Index != I.m_Index;}
+
+	protected:
+		CFlatMap*		m_pMap;
+		int				m_Index;
+	};
+
+	class const_iterator
+	{
+	public:
+		const_iterator() {m_pMap = NULL; m_Index = 0;}
+		const_iterator(const CFlatMap* pMap, int Index) {m_pMap = pMap; m_Index = Index;}
+		const_iterator(const iterator& I) {m_pMap = I.map(); m_Index = I.index();}
+
+		const K&		key() const						{return m_pMap->m_Keys.at(m_Index);}
+		const V&		value() const					{return m_pMap->m_Values.at(m_Index);}
+		const V&		operator*() const				{return value();}
+		int				index() const					{return m_Index;}
+
+		const_iterator&	operator++()					{m_Index++; return *this;}
+		const_iterator	operator++(int)					{const_iterator Old = *this; m_Index++; return Old;}
+		const_iterator&	operator--()					{m_Index--; return *this;}
+		const_iterator	operator--(int)					{const_iterator Old = *this; m_Index--; return Old;}
+		bool			operator==(const const_iterator& I) const	{return m_Index == I.m_Index;}
+		bool			operator!=(const const_iterator& I) const	{return m_Index != I.m_Index;}
+
+	protected:
+		const CFlatMap*	m_pMap;
+		int				m_Index;
+	};
+
+	iterator			begin()							{return iterator(this, 0);}
+	iterator			end()							{return iterator(this, m_Keys.size());}
+	const_iterator		begin() const					{return const_iterator(this, 0);}
+	const_iterator		end() const						{return const_iterator(this, m_Keys.size());}
+	const_iterator		constBegin() const				{return begin();}
+	const_iterator		constEnd() const				{return end();}
+
+	int					size() const					{return m_Keys.size();}
+	bool				empty() const					{return m_Keys.isEmpty();}
+	bool				isEmpty() const					{return m_Keys.isEmpty();}
+	void				clear()							{m_Keys.clear(); m_Values.clear();}
+	void				reserve(int Size)				{m_Keys.reserve(Size); m_Values.reserve(Size);}
+
+	const K&			keyAt(int Index) const			{return m_Keys.at(Index);}
+	V&					valueAt(int Index)				{return m_Values[Index];}
+	const V&			valueAt(int Index) const		{return m_Values.at(Index);}
+
+	/**
+	* @return: index of the first key equal to or greater than Key, size() if there is none
+	*/
+	int					lowerIndex(const K& Key) const
+	{
+		// Note: ranges are mostly appended or looked up at the end, so check the last key first
+		int Count = m_Keys.size();
+		if(Count == 0 || m_Keys.at(Count - 1) < Key)
+			return Count;
+		return (int)(std::lower_bound(m_Keys.constBegin(), m_Keys.constEnd(), Key) - m_Keys.constBegin());
+	}
+
+	iterator			lowerBound(const K& Key)		{return iterator(this, lowerIndex(Key));}
+	const_iterator		lowerBound(const K& Key) const	{return const_iterator(this, lowerIndex(Key));}
+	iterator			upperBound(const K& Key)		{return iterator(this, (int)(std::upper_bound(m_Keys.constBegin(), m_Keys.constEnd(), Key) - m_Keys.constBegin()));}
+	const_iterator		upperBound(const K& Key) const	{return const_iterator(this, (int)(std::upper_bound(m_Keys.constBegin(), m_Keys.constEnd(), Key) - m_Keys.constBegin()));}
+
+	iterator			find(const K& Key)
+	{
+		int Index = lowerIndex(Key);
+		return (Index < m_Keys.size() && m_Keys.at(Index) == Key) ? iterator(this, Index) : end();
+	}
+	const_iterator		find(const K& Key) const
+	{
+		int Index = lowerIndex(Key);
+		return (Index < m_Keys.size() && m_Keys.at(Index) == Key) ? const_iterator(this, Index) : end();
+	}
+	bool				contains(const K& Key) const	{return find(Key) != end();}
+
+	iterator			insertAt(int Index, const K& Key, const V& Value)
+	{
+		ASSERT(Index == 0 || m_Keys.at(Index - 1) < Key);
+		ASSERT(Index == m_Keys.size() || Key < m_Keys.at(Index));
+		m_Keys.insert(Index, Key);
+		m_Values.insert(Index, Value);
+		return iterator(this, Index);
+	}
+
+	iterator			insert(const K& Key, const V& Value)
+	{
+		int Index = lowerIndex(Key);
+		if(Index < m_Keys.size() && m_Keys.at(Index) == Key)
+		{
+			m_Values[Index] = Value;
+			return iterator(this, Index);
+		}
+		return insertAt(Index, Key, Value);
+	}
+
+	V&					operator[](const K& Key)
+	{
+		int Index = lowerIndex(Key);
+		if(Index == m_Keys.size() || m_Keys.at(Index) != Key)
+			insertAt(Index, Key, V());
+		return m_Values[Index];
+	}
+
+	void				removeAt(int Index)				{m_Keys.remove(Index); m_Values.remove(Index);}
+
+	/**
+	* Overwrites an entry in place, the caller must keep the keys sorted
+	*/
+	void				setAt(int Index, const K& Key, const V& Value)
+	{
+		m_Keys[Index] = Key;
+		m_Values[Index] = Value;
+	}
+
+	/**
+	* Inserts Diff blank entries at To or if Diff is negative removes the -Diff entries befoure To,
+	* the entries after To are moved once, the blanks must be filled with setAt
+	*/
+	void				splice(int To, int Diff)
+	{
+		if(Diff > 0)
+		{
+			m_Keys.insert(To, Diff, K());
+			m_Values.insert(To, Diff, V());
+		}
+		else if(Diff < 0)
+		{
+			m_Keys.remove(To + Diff, -Diff);
+			m_Values.remove(To + Diff, -Diff);
+		}
+	}
+	iterator			erase(iterator I)				{removeAt(I.index()); return I;}
+
+protected:
+	QVector<K>			m_Keys;
+	QVector<V>			m_Values;
+};
@@ -1,5 +1,6 @@
 #pragma once
 
+#include "FlatMap.h"
 
 template <typename V>
 class CRangeMap
@@ -19,7 +20,7 @@ public:
 	};
 
 	typedef V					ValueType;
-	typedef QMap<uint64,V>		MapType;
+	typedef CFlatMap<uint64,V>	MapType;	// Note: key is the end of a range, the value the state of everything befoure it down to the previous key
 
 	struct SIterHint
 	{
@@ -126,38 +127,26 @@ public:
 		ASSERT(uBegin < uEnd);
 
 		// Get begin and end of teh range
-		typename MapType::iterator End = m_PartMap.lowerBound(uEnd); // get the end of the part
-		if(End == m_PartMap.end())
+		int End = m_PartMap.lowerIndex(uEnd); // get the end of the part
+		if(End == m_PartMap.size())
 		{
 			ASSERT(0);
 			return;
 		}
-		if(End.key() != uEnd) 
-			End = m_PartMap.insert(uEnd,End.value()); 
-		typename MapType::iterator Begin = m_PartMap.lowerBound(uBegin); // get the begin of the part
-		if(Begin == m_PartMap.end())
-		{
-			ASSERT(0);
-			return;
-		}
-		if(Begin.key() != uBegin)
-			Begin = m_PartMap.insert(uBegin,Begin.value()); 
-
-		// update valie
-		ASSERT(Begin != End);
-		for(typename MapType::iterator Part = End; Part != Begin ;Part--)
-			Part.value() = MakeState(Part.value(), uState, eMode); 
-
-		// clear duplicates
-		typename MapType::iterator Part = Begin == m_PartMap.begin() ? Begin : --Begin;
-		typename MapType::iterator PartEnd = ++End == m_PartMap.end() ? End : ++End;
-		typename MapType::iterator PrevPart = Part;
-		for(Part++; Part != PartEnd; Part++)
-		{
-			if(MatchState(PrevPart.value(), Part.value()) || PrevPart.key() == 0) // range anding with 0 is not real
-				m_PartMap.erase(PrevPart);
-			PrevPart = Part;
-		}
+		int Begin = m_PartMap.lowerIndex(uBegin); // get the begin of the part
+		ASSERT(Begin <= End);
+
+		// Note: the affected window reaches from the part befoure the range to the part after it,
+		//			its new content is counted first and then written in place, so the following parts are moved at most once
+		int First = Begin == 0 ? Begin : Begin - 1;
+		int Last = m_PartMap.keyAt(End) == uEnd ? Min(End + 2, m_PartMap.size()) : End + 1;
+
+		int Diff = SpliceRange(First, Last, Begin, End, uBegin, uEnd, uState, eMode, false) - (Last - First);
+		if(Diff > 0)
+			m_PartMap.splice(Last, Diff);
+		SpliceRange(First, Last, Begin, End, uBegin, uEnd, uState, eMode, true);
+		if(Diff < 0)
+			m_PartMap.splice(Last, Diff);
 	}
 
 	/**
@@ -384,6 +373,67 @@ protected:
 	virtual	ValueType	MergeState(ValueType uCur, ValueType uState, EMerge eMode) const = 0;
 	virtual QString		State2Str(ValueType uCur) const = 0;
 
+	/**
+	* Builds the new content of the window from First to Last, with the range set and the duplicates cleared
+	* @param: bWrite: if false the entries are only counted, else they are written from First on, there must be room for all of them
+	* @return: count of entries in the new window
+	*/
+	int					SpliceRange(int First, int Last, int Begin, int End, uint64 uBegin, uint64 uEnd, ValueType uState, ESet eMode, bool bWrite)
+	{
+		int Count = 0;
+		bool bPending = false;
+		uint64 uPendingKey = 0;
+		ValueType uPendingValue = ValueType();
+
+		uint64 uNextKey = m_PartMap.keyAt(First);
+		ValueType uNextValue = m_PartMap.valueAt(First);
+		for(int Part = First; Part < Last; Part++)
+		{
+			// Note: the splits let the written entries run up to one part ahead, so that one is read befoure anything gets written
+			uint64 uKey = uNextKey;
+			ValueType uValue = uNextValue;
+			if(Part + 1 < Last)
+			{
+				uNextKey = m_PartMap.keyAt(Part + 1);
+				uNextValue = m_PartMap.valueAt(Part + 1);
+			}
+
+			uint64 Keys[3];
+			ValueType Values[3];
+			int New = 0;
+			if(Part == Begin && uKey != uBegin) // split the part at the begin
+			{
+				Keys[New] = uBegin;
+				Values[New++] = uValue;
+			}
+			if(Part == End && uKey != uEnd) // split the part at the end
+			{
+				Keys[New] = uEnd;
+				Values[New++] = MakeState(uValue, uState, eMode);
+			}
+			Keys[New] = uKey;
+			Values[New++] = (uKey > uBegin && uKey <= uEnd) ? MakeState(uValue, uState, eMode) : uValue;
+
+			// clear duplicates, an entry is kept once we know it differs from the next one
+			for(int i = 0; i < New; i++)
+			{
+				if(bPending && !MatchState(uPendingValue, Values[i]) && uPendingKey != 0) // range anding with 0 is not real
+				{
+					if(bWrite)
+						m_PartMap.setAt(First + Count, uPendingKey, uPendingValue);
+					Count++;
+				}
+				bPending = true;
+				uPendingKey = Keys[i];
+				uPendingValue = Values[i];
+			}
+		}
+		ASSERT(bPending);
+		if(bWrite)
+			m_PartMap.setAt(First + Count, uPendingKey, uPendingValue);
+		return Count + 1;
+	}
+
 	MapType				m_PartMap;
 	uint64				m_Revision;
 };
@@ -0,0 +1,250 @@
+#include "GlobalHeader.h"
+#include "BlockCache.h"
+#include "IOManager.h"
+
+const uint64 CBlockCache::BlockSize;
+
+CBlockCache::CBlockCache()
+{
+	m_First = NULL;
+	m_Last = NULL;
+	m_uSize = 0;
+	m_uBudget = 0;
+	m_uReadAhead = 0;
+}
+
+CBlockCache::~CBlockCache()
+{
+	while(m_First)
+		Remove(m_First);
+}
+
+void CBlockCache::SetBudget(uint64 uBudget)
+{
+	QMutexLocker Locker(&m_Mutex);
+	m_uBudget = uBudget;
+	Shrink();
+}
+
+qint64 CBlockCache::Read(CAbstractIO* File, uint64 Offset, char* Data, qint64 Length)
+{
+	if(Length <= 0)
+		return 0;
+
+	uint64 FileID = File->GetFileID();
+	uint64 uFileSize = File->GetSize();
+	if(Offset >= uFileSize)
+		return 0;
+	if(Offset + Length > uFileSize)
+		Length = uFileSize - Offset;
+
+	uint64 uFirst = Offset / BlockSize;
+	uint64 uLast = (Offset + Length - 1) / BlockSize;
+
+	QVector<QByteArray> Blocks(uLast - uFirst + 1);
+
+	QMutexLocker Locker(&m_Mutex);
+	SFileStats& Stats = m_Stats[FileID];
+	bool bSequential = IsSequential(Stats, Offset, Length);
+	uint64 uReadAhead = m_uReadAhead;
+
+	uint64 uMissFirst = -1;
+	uint64 uMissLast = 0;
+	for(uint64 uIndex = uFirst; uIndex <= uLast; uIndex++)
+	{
+		if(SBlock* pBlock = Find(SBlockKey(FileID, uIndex)))
+			Blocks[uIndex - uFirst] = pBlock->Data;
+		else
+		{
+			if(uMissFirst == -1)
+				uMissFirst = uIndex;
+			uMissLast = uIndex;
+		}
+	}
+
+	if(uMissFirst == -1)
+		Stats.Hits++;
+	else
+	{
+		Stats.Misses++;
+
+		// extend the read when the request stream is sequential
+		uint64 uReadLast = uMissLast;
+		if(bSequential)
+		{
+			uint64 uMaxIndex = (uFileSize - 1) / BlockSize;
+			for(uint64 uIndex = uMissLast + 1; uIndex <= uMissLast + uReadAhead / BlockSize && uIndex <= uMaxIndex; uIndex++)
+			{
+				if(m_Blocks.contains(SBlockKey(FileID, uIndex)))
+					break;
+				uReadLast = uIndex;
+			}
+			Stats.ReadAhead += uReadLast - uMissLast;
+		}
+		uint64 uGeneration = m_Generations.value(FileID);
+		Locker.unlock();
+
+		uint64 uReadBegin = uMissFirst * BlockSize;
+		uint64 uReadEnd = Min((uReadLast + 1) * BlockSize, uFileSize);
+		QByteArray Buffer;
+		Buffer.resize(uReadEnd - uReadBegin);
+		qint64 Read = File->Read(uReadBegin, Buffer.data(), Buffer.size());
+		if(Read != Buffer.size())
+			return File->Read(Offset, Data, Length); // Note: something is odd, dont cache anything
+
+		Locker.relock();
+		// Note: if the file was purged while we were reading, the data may already be outdated, we return it but dont cache it
+		bool bPurged = m_Generations.value(FileID) != uGeneration;
+		for(uint64 uIndex = uMissFirst; uIndex <= uReadLast; uIndex++)
+		{
+			uint64 uPos = (uIndex - uMissFirst) * BlockSize;
+			QByteArray Block = Buffer.mid(uPos, BlockSize);
+			if(uIndex <= uLast)
+				Blocks[uIndex - uFirst] = Block;
+			if(!bPurged && !m_Blocks.contains(SBlockKey(FileID, uIndex)))
+				Insert(SBlockKey(FileID, uIndex), Block);
+		}
+		Shrink();
+	}
+	Locker.unlock();
+
+	// Note: blocks we found before the read may have been evicted in the mean time, we hold a reference so they are still valid
+	qint64 Copied = 0;
+	for(uint64 uIndex = uFirst; uIndex <= uLast; uIndex++)
+	{
+		const QByteArray& Block = Blocks[uIndex - uFirst];
+		uint64 uBlockBegin = uIndex * BlockSize;
+		uint64 uFrom = Max(Offset, uBlockBegin) - uBlockBegin;
+		uint64 uTo = Min(Offset + Length, uBlockBegin + Block.size()) - uBlockBegin;
+		if(uTo <= uFrom)
+			break;
+		memcpy(Data + Copied, Block.data() + uFrom, uTo - uFrom);
+		Copied += uTo - uFrom;
+	}
+	return Copied;
+}
+
+bool CBlockCache::IsSequential(SFileStats& Stats, uint64 Offset, uint64 Length)
+{
+	bool bSequential = false;
+	int i = 0;
+	for(; i < Stats.Streams.size(); i++)
+	{
+		uint64 uNext = Stats.Streams[i];
+		if(Offset + BlockSize >= uNext && Offset <= uNext + BlockSize)
+		{
+			bSequential = true;
+			Stats.Streams.removeAt(i);
+			break;
+		}
+	}
+	Stats.Streams.prepend(Offset + Length);
+	while(Stats.Streams.size() > 8)
+		Stats.Streams.removeLast();
+	return bSequential;
+}
+
+void CBlockCache::Purge(uint64 FileID)
+{
+	QMutexLocker Locker(&m_Mutex);
+	for(SBlock* pBlock = m_First; pBlock; )
+	{
+		SBlock* pNext = pBlock->Next;
+		if(pBlock->Key.FileID == FileID)
+			Remove(pBlock);
+		pBlock = pNext;
+	}
+	m_Stats.remove(FileID);
+	m_Generations[FileID]++;
+}
+
+CBlockCache::SBlock* CBlockCache::Find(const SBlockKey& Key)
+{
+	SBlock* pBlock = m_Blocks.value(Key);
+	if(pBlock && pBlock != m_First)
+	{
+		// move to front
+		Unlink(pBlock);
+		pBlock->Next = m_First;
+		m_First->Prev = pBlock;
+		m_First = pBlock;
+	}
+	return pBlock;
+}
+
+void CBlockCache::Insert(const SBlockKey& Key, const QByteArray& Data)
+{
+	SBlock* pBlock = new SBlock;
+	pBlock->Key = Key;
+	pBlock->Data = Data;
+	pBlock->Prev = NULL;
+	pBlock->Next = m_First;
+	if(m_First)
+		m_First->Prev = pBlock;
+	m_First = pBlock;
+	if(!m_Last)
+		m_Last = pBlock;
+	m_Blocks.insert(Key, pBlock);
+	m_uSize += Data.size();
+}
+
+void CBlockCache::Unlink(SBlock* pBlock)
+{
+	if(pBlock->Prev)
+		pBlock->Prev->Next = pBlock->Next;
+	else
+		m_First = pBlock->Next;
+	if(pBlock->Next)
+		pBlock->Next->Prev = pBlock->Prev;
+	else
+		m_Last = pBlock->Prev;
+	pBlock->Prev = NULL;
+	pBlock->Next = NULL;
+}
+
+void CBlockCache::Remove(SBlock* pBlock)
+{
+	Unlink(pBlock);
+	m_Blocks.remove(pBlock->Key);
+	m_uSize -= pBlock->Data.size();
+	delete pBlock;
+}
+
+void CBlockCache::Shrink()
+{
+	while(m_Last && m_uSize > m_uBudget)
+		Remove(m_Last);
+}
+
+QVariantMap CBlockCache::GetStats() const
+{
+	QMutexLocker Locker(&m_Mutex);
+
+	QVariantMap Cache;
+	Cache["Size"] = m_uSize;
+	Cache["Budget"] = m_uBudget;
+	Cache["Blocks"] = m_Blocks.size();
+
+	uint64 uHits = 0;
+	uint64 uMisses = 0;
+	QVariantList Files;
+	for(QMap<uint64, SFileStats>::const_iterator I = m_Stats.begin(); I != m_Stats.end(); I++)
+	{
+		const SFileStats& Stats = I.value();
+		uHits += Stats.Hits;
+		uMisses += Stats.Misses;
+
+		QVariantMap File;
+		File["ID"] = I.key();
+		File["Hits"] = Stats.Hits;
+		File["Misses"] = Stats.Misses;
+		File["ReadAhead"] = Stats.ReadAhead;
+		File["HitRate"] = (Stats.Hits + Stats.Misses) ? (100 * Stats.Hits) / (Stats.Hits + Stats.Misses) : 0; // in %
+		Files.append(File);
+	}
+	Cache["Hits"] = uHits;
+	Cache["Misses"] = uMisses;
+	Cache["HitRate"] = (uHits + uMisses) ? (100 * uHits) / (uHits + uMisses) : 0; // in %
+	Cache["Files"] = Files;
+	return Cache;
+}
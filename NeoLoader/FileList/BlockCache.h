@@ -0,0 +1,78 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+class CAbstractIO;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Shared LRU cache of file blocks used to serve uploads of complete (read only) files,
+// sequential request streams are detected per file and trigger a read ahead
+
+class CBlockCache
+{
+public:
+	CBlockCache();
+	~CBlockCache();
+
+	static const uint64		BlockSize = KB2B(128);
+
+	void					SetBudget(uint64 uBudget);
+	uint64					GetBudget()						{QMutexLocker Locker(&m_Mutex); return m_uBudget;}
+	void					SetReadAhead(uint64 uReadAhead)	{QMutexLocker Locker(&m_Mutex); m_uReadAhead = uReadAhead;}
+	bool					IsEnabled()						{QMutexLocker Locker(&m_Mutex); return m_uBudget >= BlockSize;}
+
+	qint64					Read(CAbstractIO* File, uint64 Offset, char* Data, qint64 Length);
+	void					Purge(uint64 FileID);
+
+	QVariantMap				GetStats() const;
+
+protected:
+	struct SBlockKey
+	{
+		SBlockKey(uint64 ID = 0, uint64 uIndex = 0) : FileID(ID), Index(uIndex) {}
+		bool operator==(const SBlockKey& Other) const {return FileID == Other.FileID && Index == Other.Index;}
+		friend uint qHash(const SBlockKey& Key) {return qHash(Key.FileID) ^ qHash(Key.Index);}
+
+		uint64				FileID;
+		uint64				Index;
+	};
+
+	struct SBlock
+	{
+		SBlockKey			Key;
+		QByteArray			Data;
+		SBlock*				Prev;
+		SBlock*				Next;
+	};
+
+	struct SFileStats
+	{
+		SFileStats()
+		{
+			Hits = 0;
+			Misses = 0;
+			ReadAhead = 0;
+		}
+		uint64				Hits;
+		uint64				Misses;
+		uint64				ReadAhead;		// blocks read in advance
+		QList<uint64>		Streams;		// expected next offsets of the recent request streams
+	};
+
+	SBlock*					Find(const SBlockKey& Key);
+	void					Insert(const SBlockKey& Key, const QByteArray& Data);
+	void					Unlink(SBlock* pBlock);
+	void					Remove(SBlock* pBlock);
+	void					Shrink();
+	bool					IsSequential(SFileStats& Stats, uint64 Offset, uint64 Length);
+
+	mutable QMutex			m_Mutex;
+	QHash<SBlockKey, SBlock*> m_Blocks;
+	SBlock*					m_First;		// most recently used
+	SBlock*					m_Last;			// least recently used
+	uint64					m_uSize;
+	uint64					m_uBudget;
+	uint64					m_uReadAhead;
+
+	QMap<uint64, SFileStats> m_Stats;
+	QHash<uint64, uint64>	m_Generations;	// bumped by Purge, a read that started befoure a purge must not cache what it read
+};
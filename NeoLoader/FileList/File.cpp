@@ -116,6 +116,7 @@ bool CFile::AddFromFile(const QString& FilePath)
 void CFile::SetFileName(const QString& FileName)
 {
 	m_FileName = FileName;
+	Reindex();
 
 	SetProperty("Streamable", (Split2(m_FileName, ".", true).second.indexOf(QRegExp(theCore->Cfg()->GetString("Content/Streamable")), Qt::CaseInsensitive) == 0));
 
@@ -228,6 +229,8 @@ void CFile::CalculateHashes(bool bAll)
 		//	NewHashes.append(CFileHash::HashType2Str(HashTigerTree));
 		//}
 	}
+	if(!NewHashes.isEmpty())
+		Reindex();
 
 	QList<CFileHashPtr> List;
 	foreach(const CFileHashPtr& pHash, m_HashMap)
@@ -436,6 +439,7 @@ void CFile::SetFilePath(const QString& FilePath)
 		m_FilePath = tmpFilePath.replace("//", "/");
 	}
 	while(tmpFilePath != m_FilePath);
+	Reindex();
 
 	QStringList Shared = theCore->Cfg()->GetStringList("Content/Shared");
 	Shared.append(theCore->GetIncomingDir(false));
@@ -588,7 +592,10 @@ void CFile::SetPartMap(CPartMapPtr pMap)
 
 	m_Parts = pMap;
 	if(m_Downloader)
+	{
 		connect(m_Parts.data(), SIGNAL(Change(bool)), m_Downloader, SLOT(OnChange(bool)));
+		connect(m_Parts.data(), SIGNAL(RangeChanged(uint64, uint64)), m_Downloader, SLOT(OnRangeChanged(uint64, uint64)));
+	}
 
 	emit MetadataLoaded();
 
@@ -611,6 +618,7 @@ bool CFile::AddTorrentFromFile(const QByteArray& Torrent)
 	}
 	ASSERT(!m_Torrents.contains(pTorrent->GetInfoHash()));
 	m_Torrents[pTorrent->GetInfoHash()] = pTorrent;
+	Reindex();
 
 	return true;
 }
@@ -630,6 +638,7 @@ bool CFile::MakeTorrent(uint64 uPieceLength, bool bMerkle, const QString& Name,
 		return false;
 	}
 	m_Torrents.insert(EMPTY_INFO_HASH, pTorrent);
+	Reindex();
 	
 	QList<CFileHashPtr> List;
 	List.append(pTorrent->GetHash());
@@ -665,6 +674,7 @@ bool CFile::AddTorrent(const QByteArray &TorrentData)
 		}
 		
 		m_Torrents[pTorrent->GetHash()->GetHash()] = pTorrent;
+		Reindex();
 	}
 	else
 	{
@@ -676,6 +686,7 @@ bool CFile::AddTorrent(const QByteArray &TorrentData)
 		}
 
 		m_Torrents.insert(EMPTY_INFO_HASH, pTorrent);
+		Reindex();
 	
 		QList<CFileHashPtr> List;
 		List.append(pTorrent->GetHash());
@@ -712,6 +723,7 @@ void CFile::TorrentHashed(CTorrent* pTorrent, bool bSuccess)
 			break;		
 		}
 	}
+	Reindex();
 }
 
 CTorrent* CFile::GetTorrent(const QByteArray& InfoHash)
@@ -851,7 +863,11 @@ void CFile::OnDataWriten(uint64 Offset, uint64 Length, bool bOk, void* Aux)
 	ASSERT((m_Parts->GetRange(uBegin, uEnd) & (Part::Available | Part::Verified)) == 0);
 
 	if(!bOk)
+	{
+		if(m_Inspector)
+			m_Inspector->OnDataWriten(uBegin, uEnd, false);
 		return;
+	}
 
 	// clear hashing flags as new data must be newly hashed
 	if(pJoinedParts)
@@ -865,9 +881,9 @@ void CFile::OnDataWriten(uint64 Offset, uint64 Length, bool bOk, void* Aux)
 	else
 		m_Parts->SetRange(uBegin, uEnd, Part::Available, CPartMap::eAdd);
 
-	// Reset all hashing results for this range
+	// Reset all hashing results for this range and apply the in memory verification
 	if(m_Inspector)
-		m_Inspector->ResetRange(uBegin, uEnd);
+		m_Inspector->OnDataWriten(uBegin, uEnd, true);
 }
 
 void CFile::OnAllocation(uint64 Progress, bool Finished)
@@ -878,6 +894,8 @@ void CFile::OnAllocation(uint64 Progress, bool Finished)
 
 void CFile::OnFileHashed()
 {
+	Reindex(); // the hashing job has set the hash values
+
 	if(CJoinedPartMap* pParts = qobject_cast<CJoinedPartMap*>(m_Parts.data()))
 	{
 		QMap<uint64, SPartMapLink*> Links = pParts->GetJoints();
@@ -910,6 +928,7 @@ void CFile::OnFileHashed()
 			MetaData.WriteQData(pFileHash->GetHash());
 		}
 		pHashTreeEx->SetMetaHash(pHashTreeEx->HashMetaData(MetaData.ToByteArray()));
+		Reindex(); // the meta hash gives the XNeo hash its value
 
 		theCore->m_Hashing->SaveHash(pHashTreeEx);
 	}
@@ -963,6 +982,7 @@ bool CFile::CompleteFromSolid(const QString& FileName)
 			LogLine(LOG_ERROR, tr("File %1 could not be removed").arg(m_FilePath));
 
 		m_FilePath = FilePath;
+		Reindex();
 
 	
 		if(CJoinedPartMap* pJoinedParts = qobject_cast<CJoinedPartMap*>(m_Parts.data()))
@@ -1251,8 +1271,12 @@ void CFile::Enable()
 		if(!m_Inspector)
 			m_Inspector = new CHashInspector(this);
 		m_Downloader = new CPartDownloader(this);
+		connect(m_FileStats, SIGNAL(AvailChanged(uint64, uint64)), m_Downloader, SLOT(OnAvailChanged(uint64, uint64)));
 		if(m_Parts)
+		{
 			connect(m_Parts.data(), SIGNAL(Change(bool)), m_Downloader, SLOT(OnChange(bool)));
+			connect(m_Parts.data(), SIGNAL(RangeChanged(uint64, uint64)), m_Downloader, SLOT(OnRangeChanged(uint64, uint64)));
+		}
 	}
 }
 
@@ -1347,7 +1371,7 @@ void CFile::UnRemove(CFileHashPtr pFileHash)
 {
 	ASSERT(IsRemoved());
 
-	m_pMasterHash = pFileHash;
+	SetMasterHash(pFileHash);
 	m_Status = pFileHash ? eComplete : eIncomplete;
 
 	if(IsIncomplete())
@@ -1958,6 +1982,7 @@ void CFile::AddHash(CFileHashPtr pFileHash)
 
 		m_HashMap.insert(pFileHash->GetType(), pFileHash);
 	}
+	Reindex();
 }
 
 CFileHashPtr CFile::GetHashPtr(EFileHashType Type)
@@ -2107,6 +2132,46 @@ void CFile::DelHash(CFileHashPtr pFileHash)
 #endif
 	else
 		m_HashMap.remove(pFileHash->GetType());
+	Reindex();
+}
+
+void CFile::SetMasterHash(CFileHashPtr pMasterHash)
+{
+	m_pMasterHash = pMasterHash;
+	Reindex();
+}
+
+void CFile::Reindex()
+{
+	if(CFileList* pList = GetList())
+		pList->Reindex(this);
+}
+
+QByteArray CFile::MakeHashKey(const CFileHash* pFileHash)
+{
+	QByteArray Key(1, (char)pFileHash->GetType());
+#ifndef NO_HOSTERS
+	if(pFileHash->GetType() == HashArchive)
+		Key.append(pFileHash->GetHash().left(ARCH_PREFIX_LEN));
+	else
+#endif
+		Key.append(pFileHash->GetHash());
+	return Key;
+}
+
+QList<QByteArray> CFile::GetHashKeys()
+{
+	// Note: this must give the same keys for which CompareHash would return true
+	QList<QByteArray> Keys;
+	foreach(const CFileHashPtr& pHash, m_HashMap)
+		Keys.append(MakeHashKey(pHash.data()));
+	foreach(const QByteArray& InfoHash, m_Torrents.keys())
+		Keys.append(QByteArray(1, (char)HashTorrent) + InfoHash);
+#ifndef NO_HOSTERS
+	foreach(const QByteArray& Prefix, m_Archives.keys())
+		Keys.append(QByteArray(1, (char)HashArchive) + Prefix);
+#endif
+	return Keys;
 }
 
 bool CFile::SelectMasterHash()
@@ -2460,6 +2525,7 @@ bool CFile::CheckDuplicate()
 			}
 
 			m_FilePath = ""; // prevetn deleting file on disc
+			Reindex();
 			m_Status = eDuplicate;
 			return true; // please delete this
 		}
@@ -82,11 +82,14 @@ public:
 	virtual CFileHashPtr			GetHashPtrEx(EFileHashType Type, const QByteArray& Hash);
 	virtual bool					CompareHash(const CFileHash* pFileHash);
 	virtual void					DelHash(CFileHashPtr pFileHash);
+	virtual QList<QByteArray>		GetHashKeys();
+	static QByteArray				MakeHashKey(const CFileHash* pFileHash);
+	void							Reindex();
 	virtual void					Purge(CFileHashPtr pFileHash);
 	virtual QList<CFileHashPtr>		GetListForHashing(bool bEmpty = false);
 
 	virtual bool					SelectMasterHash();
-	virtual void					SetMasterHash(CFileHashPtr pMasterHash) {m_pMasterHash = pMasterHash;}
+	virtual void					SetMasterHash(CFileHashPtr pMasterHash);
 	virtual CFileHashPtr&			GetMasterHash()						{return m_pMasterHash;}
 
 	virtual void					CleanUpHashes();
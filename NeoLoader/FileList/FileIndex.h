@@ -0,0 +1,104 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Secondary indexes of a file list by hash, name and path, they only preselect candidates, every lookup still checks the file itself.
+// Files that changed are marked with Reindex and refreshed before the next lookup.
+// T must provide GetHashKeys(), GetFileName() and GetFilePath().
+
+template <class T>
+class CFileIndex
+{
+public:
+	void					Add(T* pFile)							{Unindex(pFile); Index(pFile);}
+	void					Remove(T* pFile)						{Unindex(pFile); m_Dirty.remove(pFile);}
+	void					Reindex(T* pFile)						{m_Dirty.insert(pFile);}
+	bool					IsDirty(T* pFile) const					{return m_Dirty.contains(pFile);}
+	int						GetCount() const						{return m_Indexed.size();}
+
+	void					Update()
+	{
+		foreach(T* pFile, m_Dirty)
+		{
+			Unindex(pFile);
+			Index(pFile);
+		}
+		m_Dirty.clear();
+	}
+
+	QList<T*>				FindByHash(const QByteArray& HashKey)	{Update(); return m_HashIndex.values(HashKey);}
+	QList<T*>				FindByName(const QString& FileName)		{Update(); return m_NameIndex.values(GetNameKey(FileName));}
+	QList<T*>				FindByPath(const QString& FilePath)		{Update(); return m_PathIndex.values(GetPathKey(FilePath));}
+
+	/**
+	* Compares the index entries against the files, this is O(n) and meant for tests
+	* @return: the number of files that changed without calling Reindex, they are marked for reindexing
+	*/
+	int						Verify()
+	{
+		QList<T*> Stale;
+		for(typename QHash<T*, SEntry>::iterator I = m_Indexed.begin(); I != m_Indexed.end(); ++I)
+		{
+			T* pFile = I.key();
+			if(m_Dirty.contains(pFile))
+				continue;
+
+			QSet<QByteArray> HashKeys;
+			foreach(const QByteArray& HashKey, pFile->GetHashKeys())
+				HashKeys.insert(HashKey);
+			QSet<QByteArray> Indexed;
+			foreach(const QByteArray& HashKey, I.value().HashKeys)
+				Indexed.insert(HashKey);
+
+			if(HashKeys != Indexed || I.value().NameKey != GetNameKey(pFile->GetFileName()) || I.value().PathKey != GetPathKey(pFile->GetFilePath()))
+				Stale.append(pFile);
+		}
+		foreach(T* pFile, Stale)
+			m_Dirty.insert(pFile);
+		return Stale.size();
+	}
+
+	static QString			GetNameKey(const QString& FileName)		{return FileName.toCaseFolded();}
+#ifdef WIN32
+	static QString			GetPathKey(const QString& FilePath)		{return FilePath.toCaseFolded();}
+#else
+	static QString			GetPathKey(const QString& FilePath)		{return FilePath;}
+#endif
+
+protected:
+	void					Index(T* pFile)
+	{
+		SEntry& Entry = m_Indexed[pFile];
+		Entry.HashKeys = pFile->GetHashKeys();
+		foreach(const QByteArray& HashKey, Entry.HashKeys)
+			m_HashIndex.insert(HashKey, pFile);
+		Entry.NameKey = GetNameKey(pFile->GetFileName());
+		m_NameIndex.insert(Entry.NameKey, pFile);
+		Entry.PathKey = GetPathKey(pFile->GetFilePath());
+		m_PathIndex.insert(Entry.PathKey, pFile);
+	}
+
+	void					Unindex(T* pFile)
+	{
+		typename QHash<T*, SEntry>::iterator I = m_Indexed.find(pFile);
+		if(I == m_Indexed.end())
+			return;
+		foreach(const QByteArray& HashKey, I.value().HashKeys)
+			m_HashIndex.remove(HashKey, pFile);
+		m_NameIndex.remove(I.value().NameKey, pFile);
+		m_PathIndex.remove(I.value().PathKey, pFile);
+		m_Indexed.erase(I);
+	}
+
+	struct SEntry
+	{
+		QList<QByteArray>	HashKeys;
+		QString				NameKey;
+		QString				PathKey;
+	};
+	QHash<T*, SEntry>		m_Indexed;		// the keys each file is currently listed under
+	QMultiHash<QByteArray, T*> m_HashIndex;
+	QMultiHash<QString, T*>	m_NameIndex;
+	QMultiHash<QString, T*>	m_PathIndex;
+	QSet<T*>				m_Dirty;
+};
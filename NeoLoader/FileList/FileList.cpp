@@ -11,6 +11,7 @@ CFileList::CFileList(QObject* qObject)
  : QObjectEx(qObject)
 {
 	m_LastID = 0;
+	m_LastIndexed = 0;
 
 	m_AllLists.insert(this);
 }
@@ -39,6 +40,17 @@ void CFileList::Process(UINT Tick)
 		if(I.value()->IsStarted())
 			I.value()->Process(Tick);
 	}
+
+	// Note: a hash value can also change without the file telling us, e.g. when metadata arrive,
+	//			so we recheck a few files on every tick, that way the whole list is refreshed every few minutes
+	QMap<uint64, CFile*>::iterator J = m_FileMap.upperBound(m_LastIndexed);
+	for(int i = 0; i < Min(m_FileMap.size(), 64); i++, J++)
+	{
+		if(J == m_FileMap.end())
+			J = m_FileMap.begin();
+		m_Index.Reindex(J.value());
+		m_LastIndexed = J.key();
+	}
 }
 
 void CFileList::AddFile(CFile* pFile)
@@ -53,21 +65,32 @@ CFile* CFileList::GetFileByID(uint64 FileID)
 	return m_FileMap.value(FileID);
 }
 
+// Note: this allows to walk the list in slices without copying it, NULL marks the end of the list
+CFile* CFileList::GetNextFile(uint64 FileID)
+{
+	QMap<uint64, CFile*>::iterator I = m_FileMap.upperBound(FileID);
+	if(I == m_FileMap.end())
+		return NULL;
+	return I.value();
+}
+
 CFile* CFileList::GetFileByHash(const CFileHash* pFileHash, bool bAlsoRemoved)
 {
 	if(!pFileHash)
 		return NULL;
-	foreach(CFile* pFile, m_FileMap)
+	CFile* pFound = NULL;
+	foreach(CFile* pFile, m_Index.FindByHash(CFile::MakeHashKey(pFileHash)))
 	{
 		if(pFile->IsDuplicate())
 			continue;
 		if(!bAlsoRemoved && pFile->IsRemoved())
 			continue;
 
-		if(pFile->CompareHash(pFileHash))
-			return pFile;
+		// Note: when more than one file matches we return the one with the lowest ID, just like a scan of m_FileMap would
+		if(pFile->CompareHash(pFileHash) && (!pFound || pFile->GetFileID() < pFound->GetFileID()))
+			pFound = pFile;
 	}
-	return NULL;
+	return pFound;
 }
 
 QList<CFile*> CFileList::FindDuplicates(CFile* pFile, bool bNoDuplicates)
@@ -83,8 +106,15 @@ QList<CFile*> CFileList::FindDuplicates(CFile* pFile, bool bNoDuplicates)
 
 QList<CFile*> CFileList::GetFilesByHash(const QList<CFileHashPtr>& Hashes, uint64 uFileSize, bool bNoDuplicates)
 {
+	QMap<uint64, CFile*> Candidates;
+	foreach(CFileHashPtr pHash, Hashes)
+	{
+		foreach(CFile* pFile, m_Index.FindByHash(CFile::MakeHashKey(pHash.data())))
+			Candidates.insert(pFile->GetFileID(), pFile);
+	}
+
 	QList<CFile*> Files;
-	for (QMap<uint64, CFile*>::Iterator I = m_FileMap.begin(); I != m_FileMap.end(); ++I)
+	for (QMap<uint64, CFile*>::Iterator I = Candidates.begin(); I != Candidates.end(); ++I)
 	{
 		CFile* pCurFile = I.value();
 
@@ -95,7 +125,6 @@ QList<CFile*> CFileList::GetFilesByHash(const QList<CFileHashPtr>& Hashes, uint6
 		if(bNoDuplicates && pCurFile->IsDuplicate())
 			continue; // we are looking for active duplicates, ignore passive ones
 
-		// Note: the code below is not obtimized (GetAllHashes) but it seams fast enough
 		foreach(CFileHashPtr pHash, Hashes)
 		{
 			if(pCurFile->CompareHash(pHash.data()))
@@ -113,8 +142,8 @@ QList<CFile*> CFileList::GetFilesByHash(const QList<CFileHashPtr>& Hashes, uint6
 
 QList<CFile*> CFileList::GetFilesByName(const QString& FileName, bool bArchives)
 {
-	QList<CFile*> Files;
-	foreach(CFile* pFile, m_FileMap)
+	QMap<uint64, CFile*> Files;
+	foreach(CFile* pFile, m_Index.FindByName(FileName))
 	{
 		if(FileName.compare(pFile->GetFileName(), Qt::CaseInsensitive) == 0)
 		{
@@ -123,10 +152,10 @@ QList<CFile*> CFileList::GetFilesByName(const QString& FileName, bool bArchives)
 				continue;
 #endif
 
-			Files.append(pFile);
+			Files.insert(pFile->GetFileID(), pFile);
 		}
 	}
-	return Files;
+	return Files.values();
 }
 
 CFile* CFileList::GetFileByProperty(const QString& Name, const QVariant& Value)
@@ -142,27 +171,28 @@ CFile* CFileList::GetFileByProperty(const QString& Name, const QVariant& Value)
 CFile* CFileList::GetArchiveFile(const QString& FileName)
 {
 #ifndef NO_HOSTERS
-	foreach(CFile* pFile, m_FileMap)
-	{
-		if(pFile->IsArchive() && FileName.compare(pFile->GetFileName(), Qt::CaseInsensitive) == 0)
-			return pFile;
-	}
+	QList<CFile*> Files = GetFilesByName(FileName, true);
+	if(!Files.isEmpty())
+		return Files.first();
 #endif
 	return NULL;
 }
 
 CFile* CFileList::GetFileByPath(const QString& FilePath)
 {
-	foreach(CFile* pFile, m_FileMap)
+	CFile* pFound = NULL;
+	foreach(CFile* pFile, m_Index.FindByPath(FilePath))
 	{
 #ifdef WIN32
-		if(FilePath.compare(pFile->GetFilePath(), Qt::CaseInsensitive) == 0)
+		if(FilePath.compare(pFile->GetFilePath(), Qt::CaseInsensitive) != 0)
 #else
-		if(FilePath.compare(pFile->GetFilePath(), Qt::CaseSensitive) == 0)
+		if(FilePath.compare(pFile->GetFilePath(), Qt::CaseSensitive) != 0)
 #endif
-			return pFile;
+			continue;
+		if(!pFound || pFile->GetFileID() < pFound->GetFileID())
+			pFound = pFile;
 	}
-	return NULL;
+	return pFound;
 }
 
 void CFileList::RemoveFile(CFile* pFile)
@@ -188,16 +218,25 @@ QList<CFile*> CFileList::GetFilesBySourceUrl(const QString& sUrl)
 	return FileList;
 }
 
+void CFileList::Reindex(CFile* pFile)
+{
+	// Note: files that are still being loaded are not listed yet, they get indexed when they are
+	if(m_FileMap.value(pFile->GetFileID()) == pFile)
+		m_Index.Reindex(pFile);
+}
+
 void CFileList::ListFile(CFile* pFile)
 {
 	pFile->setParent(this);
 	m_FileMap.insert(pFile->GetFileID(), pFile);
+	m_Index.Add(pFile);
 }
 
 void CFileList::UnlistFile(CFile* pFile)
 {
 	//uint64 FileID = m_FileMap.key(pFile);
 	m_FileMap.remove(pFile->GetFileID());
+	m_Index.Remove(pFile);
 }
 
 uint64 CFileList::AllocID(uint64 FileID)
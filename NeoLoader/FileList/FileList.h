@@ -2,6 +2,7 @@
 
 #include "../../Framework/ObjectEx.h"
 #include "./Hashing/FileHash.h"
+#include "FileIndex.h"
 
 class CFile;
 class CFileHash;
@@ -20,7 +21,9 @@ public:
 
 	virtual void					AddFile(CFile* pFile);
 	virtual QList<CFile*>			GetFiles()							{return m_FileMap.values();}
+	virtual int						GetFileCount()						{return m_FileMap.count();}
 	virtual CFile*					GetFileByID(uint64 FileID);
+	virtual CFile*					GetNextFile(uint64 FileID);
 	virtual CFile*					GetFileByHash(const CFileHash* pFileHash, bool bAlsoRemoved = false);
 	virtual QList<CFile*>			FindDuplicates(CFile* pFile, bool bNoDuplicates = false);
 	virtual QList<CFile*>			GetFilesByHash(const QList<CFileHashPtr>& Hashes, uint64 uFileSize, bool bNoDuplicates = false);
@@ -33,6 +36,9 @@ public:
 
 	virtual QList<CFile*>			GetFilesBySourceUrl(const QString& sUrl);
 
+	// Note: files call this when their hashes, name or path changed, the indexes are updated before the next lookup
+	virtual void					Reindex(CFile* pFile);
+
 	static	uint64					AllocID(uint64 FileID = 0);
 	static	void					ReleaseID(uint64 FileID);
 	static	CFile*					GetFile(uint64 FileID);
@@ -49,6 +55,9 @@ protected:
 	QMap<uint64, CFile*>			m_FileMap;
 	uint64							m_LastID;
 
+	CFileIndex<CFile>				m_Index;
+	uint64							m_LastIndexed;
+
 	static QSet<uint64>				m_FileIDs;
 	static QSet<CFileList*>			m_AllLists;
 };
@@ -17,6 +17,7 @@
 #include "../FileTransfer/FileGrabber.h"
 #include "../FileTransfer/DownloadManager.h"
 #include "../FileTransfer/HashInspector.h"
+#include <QElapsedTimer>
 
 CFileManager::CFileManager(QObject* qObject)
  : CFileList(qObject)
@@ -28,24 +29,10 @@ void CFileManager::Resume()
 {
 	LoadFromFile();
 
-	QHash<QString, CFile*> PathMap;
-	foreach(CFile* pFile, m_FileMap)
-	{
-#ifdef WIN32
-		PathMap.insert(pFile->GetFilePath().toLower(), pFile);
-#else
-		PathMap.insert(pFile->GetFilePath(), pFile);
-#endif
-	}
-	
 	QStringList FilePaths = FindSharedFiles();
 	foreach(const QString& FilePath, FilePaths)
 	{
-#ifdef WIN32
-		CFile* pFile = PathMap.value(FilePath.toLower());
-#else
-		CFile* pFile = PathMap.value(FilePath);
-#endif
+		CFile* pFile = GetFileByPath(FilePath);
 		if(pFile && !pFile->CheckModification())
 			continue;
 		AddFromFile(FilePath); // this already starts the file
@@ -418,24 +405,10 @@ CFile* CFileManager::MergeTorrent(CTorrent* pTorrent)
 
 void CFileManager::ScanShare()
 {
-	QHash<QString, CFile*> PathMap;
-	foreach(CFile* pFile, m_FileMap)
-	{
-#ifdef WIN32
-		PathMap.insert(pFile->GetFilePath().toLower(), pFile);
-#else
-		PathMap.insert(pFile->GetFilePath(), pFile);
-#endif
-	}
-	
 	QStringList FilePaths = FindSharedFiles();
 	foreach(const QString& FilePath, FilePaths)
 	{
-#ifdef WIN32
-		if(CFile* pFile = PathMap.value(FilePath.toLower()))
-#else
-		if(CFile* pFile = PathMap.value(FilePath))
-#endif
+		if(CFile* pFile = GetFileByPath(FilePath))
 		{
 			if(pFile->IsRemoved())
 			{
@@ -556,17 +529,85 @@ CFile* CFileManager::AddFromFile(const QString& FilePath)
 
 void CFileManager::StoreToFile()
 {
-	CXml::Write(Store(), theCore->Cfg()->GetSettingsDir() + "/FileList.xml");
+	QString FileList = theCore->Cfg()->GetSettingsDir() + "/FileList.dat";
+	if(!m_Journal.IsOpen() && QFile::exists(FileList))
+	{
+		// Note: LoadFromFile moves a list it can not read aside, so this one we did not load, we must not replace it
+		LogLine(LOG_ERROR, tr("failed to open file list for writing"));
+		return;
+	}
+
+	QElapsedTimer Timer;
+	Timer.start();
+
+	// Note: every file is serialized, but only the ones that changed since the last save are written
+	QMap<uint64, QByteArray> Records;
+	int Written = 0;
+	for (QMap<uint64, CFile*>::Iterator I = m_FileMap.begin(); I != m_FileMap.end(); ++I)
+	{
+		QByteArray Data;
+		QDataStream Stream(&Data, QIODevice::WriteOnly);
+		Stream.setVersion(QDataStream::Qt_4_8);
+		Stream << QVariant(I.value()->Store());
+		if(!m_Journal.IsOpen() || m_Journal.Write(I.key(), Data))
+			Written++;
+		Records.insert(I.key(), Data);
+	}
+
+	bool bOk;
+	if(!m_Journal.IsOpen()) // Note: the first journal is written completely to a temp file and than moved in place
+		bOk = m_Journal.Create(FileList, Records);
+	else
+	{
+		foreach(uint64 FileID, m_Journal.GetIDs())
+		{
+			if(!m_FileMap.contains(FileID))
+				m_Journal.Remove(FileID);
+		}
+
+		bOk = m_Journal.NeedsCompaction() ? m_Journal.Compact(Records) : m_Journal.Commit();
+	}
+	if(!bOk)
+		LogLine(LOG_ERROR, tr("failed to save file list to disk"));
 
 	m_LastSave = GetTime();
-	LogLine(LOG_DEBUG, tr("saved file list to disk"));
+	LogLine(LOG_DEBUG, tr("saved file list to disk, %1 of %2 files written in %3 ms").arg(Written).arg(m_FileMap.count()).arg(Timer.elapsed()));
 }
 
 void CFileManager::LoadFromFile()
 {
-	Load(CXml::Read(theCore->Cfg()->GetSettingsDir() + "/FileList.xml").toList());
+	QElapsedTimer Timer;
+	Timer.start();
+
+	QString FileList = theCore->Cfg()->GetSettingsDir() + "/FileList.dat";
+	QMap<uint64, QByteArray> Records;
+	if(QFile::exists(FileList) && !m_Journal.Open(FileList, &Records))
+	{
+		// Note: we keep the file for inspection, but move it out of the way so the xml list gets imported and a new journal can be written
+		QString BadList = FileList + "." + QString::number(GetTime()) + ".bad";
+		if(QFile::rename(FileList, BadList))
+			LogLine(LOG_ERROR, tr("failed to open file list, moved it to %1").arg(BadList));
+		else
+			LogLine(LOG_ERROR, tr("failed to open file list"));
+	}
+
+	if(m_Journal.IsOpen())
+	{
+		QVariantList Files;
+		foreach(const QByteArray& Data, Records)
+		{
+			QVariant File;
+			QDataStream Stream(Data);
+			Stream.setVersion(QDataStream::Qt_4_8);
+			Stream >> File;
+			Files.append(File);
+		}
+		Load(Files);
+	}
+	else // Note: import the old xml list, the journal is created with the next save
+		Load(CXml::Read(theCore->Cfg()->GetSettingsDir() + "/FileList.xml").toList());
 
-	LogLine(LOG_DEBUG, tr("loaded file list from disk"));
+	LogLine(LOG_DEBUG, tr("loaded file list from disk, %1 files in %2 ms").arg(m_FileMap.count()).arg(Timer.elapsed()));
 	m_LastSave = GetTime();
 }
 
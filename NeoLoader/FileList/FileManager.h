@@ -1,6 +1,7 @@
 #pragma once
 
 #include "FileList.h"
+#include "../../Framework/Journal.h"
 class CTorrent;
 
 class CFileManager: public CFileList
@@ -31,4 +32,5 @@ protected:
 	CFile*							MergeTorrent(CTorrent* pTorrent);
 
 	time_t							m_LastSave;
+	CJournal						m_Journal;
 };
@@ -30,6 +30,7 @@ void CFileStats::SetupAvailMap()
 		m_HosterCache = CCacheMapPtr(new CCacheMap(FileSize));
 		m_HosterMap = CHosterMapPtr(new CHosterMap(FileSize));
 #endif
+		emit AvailChanged(0, FileSize);
 	}
 }
 
@@ -92,7 +93,7 @@ void CFileStats::AddTransfer(CTransfer* pTransfer)
 			while (pParts->IterateRanges(DiffIter))
 			{
 				if ((DiffIter.uState & Part::Available) != 0)
-					m_Availability->SetRange(DiffIter.uBegin, DiffIter.uEnd, 1, CAvailMap::eAdd);
+					ChangeAvail(DiffIter.uBegin, DiffIter.uEnd, CAvailMap::eAdd);
 #ifndef NO_HOSTERS
 				AddRange(DiffIter.uBegin, DiffIter.uEnd, (DiffIter.uState & Part::Available) != 0, bUpdateHosted, bUpdateCache, pHosterLink);
 #endif
@@ -130,7 +131,7 @@ void CFileStats::RemoveTransfer(CTransfer* pTransfer)
 			while (pParts->IterateRanges(DiffIter))
 			{
 				if ((DiffIter.uState & Part::Available) != 0)
-					m_Availability->SetRange(DiffIter.uBegin, DiffIter.uEnd, 1, CAvailMap::eClr);
+					ChangeAvail(DiffIter.uBegin, DiffIter.uEnd, CAvailMap::eClr);
 #ifndef NO_HOSTERS
 				DelRange(DiffIter.uBegin, DiffIter.uEnd, (DiffIter.uState & Part::Available) != 0, bUpdateHosted, bUpdateCache, pHosterLink);
 #endif
@@ -165,7 +166,7 @@ void CFileStats::UpdateAvail(CTransfer* pTransfer, const CAvailDiff& AvailDiff,
 		const SAvailDiff& Diff = AvailDiff.At(i);
 
 		if((Diff.uNew & Part::Available) != 0)
-			m_Availability->SetRange(Diff.uBegin, Diff.uEnd, 1, CAvailMap::eAdd);
+			ChangeAvail(Diff.uBegin, Diff.uEnd, CAvailMap::eAdd);
 
 #ifndef NO_HOSTERS
 		AddRange(Diff.uBegin, Diff.uEnd, (Diff.uNew & Part::Available) != 0, bUpdateHosted, bUpdateCache, pHosterLink);
@@ -173,7 +174,7 @@ void CFileStats::UpdateAvail(CTransfer* pTransfer, const CAvailDiff& AvailDiff,
 		if(!b1st) // if this is not the first time we have a part mal clear the old state
 		{
 			if((Diff.uOld & Part::Available) != 0)
-				m_Availability->SetRange(Diff.uBegin, Diff.uEnd, 1, CAvailMap::eClr);
+				ChangeAvail(Diff.uBegin, Diff.uEnd, CAvailMap::eClr);
 
 #ifndef NO_HOSTERS
 			DelRange(Diff.uBegin, Diff.uEnd, (Diff.uOld & Part::Available) != 0, bUpdateHosted, bUpdateCache, pHosterLink);
@@ -187,6 +188,12 @@ void CFileStats::UpdateAvail(CTransfer* pTransfer, const CAvailDiff& AvailDiff,
 #endif
 }
 
+void CFileStats::ChangeAvail(uint64 uBegin, uint64 uEnd, CAvailMap::ESet eMode)
+{
+	m_Availability->SetRange(uBegin, uEnd, 1, eMode);
+	emit AvailChanged(uBegin, uEnd);
+}
+
 double CFileStats::GetAvailStats()
 {
 	CFile* pFile = GetFile();
@@ -55,7 +55,12 @@ public:
 
 	CFile*							GetFile() const			{CFile* pFile = qobject_cast<CFile*>(parent()); ASSERT(pFile); return pFile;}
 
+signals:
+	void							AvailChanged(uint64 uBegin, uint64 uEnd);
+
 protected:
+	void							ChangeAvail(uint64 uBegin, uint64 uEnd, CAvailMap::ESet eMode);
+
 #ifndef NO_HOSTERS
 	void							AddRange(uint64 uBegin, uint64 uEnd, bool bTest, bool bUpdateHosted, bool bUpdateCache, CHosterLink* pHosterLink);
 	void							DelRange(uint64 uBegin, uint64 uEnd, bool bTest, bool bUpdateHosted, bool bUpdateCache, CHosterLink* pHosterLink);
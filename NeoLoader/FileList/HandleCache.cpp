@@ -0,0 +1,148 @@
+#include "GlobalHeader.h"
+#include "HandleCache.h"
+#ifndef WIN32
+#include <sys/resource.h>
+#endif
+
+CHandleCache::CHandleCache()
+{
+	m_First = NULL;
+	m_Last = NULL;
+	m_Count = 0;
+	m_Limit = GetDefaultLimit();
+
+	m_Opens = 0;
+	m_Closes = 0;
+	m_Evictions = 0;
+	m_Failed = 0;
+}
+
+int CHandleCache::GetDefaultLimit()
+{
+#ifdef WIN32
+	return 512; // Note: windows handles are not limited in a relevant way
+#else
+	// Note: the descriptors are shared with the sockets, so we take only a quarter of them
+	struct rlimit Limit;
+	if(getrlimit(RLIMIT_NOFILE, &Limit) != 0 || Limit.rlim_cur == RLIM_INFINITY)
+		return 256;
+	return Max((int)(Limit.rlim_cur / 4), 16);
+#endif
+}
+
+void CHandleCache::SetLimit(int Limit)
+{
+	QMutexLocker Locker(&m_Mutex);
+	m_Limit = Limit > 0 ? Limit : GetDefaultLimit();
+	Shrink();
+}
+
+bool CHandleCache::Open(SFileHandle* pHandle, const QString& FileName, QFile::OpenMode Mode)
+{
+	// Note: enter here only if the handle mutex is locked
+	ASSERT(pHandle->pFile == NULL);
+	QFile* pFile = new QFile(FileName);
+	if(!pFile->open(Mode))
+	{
+		delete pFile;
+		QMutexLocker Locker(&m_Mutex);
+		m_Failed++;
+		return false;
+	}
+
+	QMutexLocker Locker(&m_Mutex);
+	pHandle->pFile = pFile;
+	Link(pHandle);
+	m_Opens++;
+	Shrink();
+	return true;
+}
+
+void CHandleCache::Touch(SFileHandle* pHandle)
+{
+	QMutexLocker Locker(&m_Mutex);
+	if(pHandle->pFile && pHandle != m_First)
+	{
+		Unlink(pHandle);
+		Link(pHandle);
+	}
+}
+
+void CHandleCache::Close(SFileHandle* pHandle)
+{
+	// Note: enter here only if the handle mutex is locked
+	if(!pHandle->pFile)
+		return;
+
+	QMutexLocker Locker(&m_Mutex);
+	Unlink(pHandle);
+	m_Closes++;
+	Locker.unlock();
+
+	pHandle->pFile->close();
+	delete pHandle->pFile;
+	pHandle->pFile = NULL;
+}
+
+void CHandleCache::Link(SFileHandle* pHandle)
+{
+	pHandle->Prev = NULL;
+	pHandle->Next = m_First;
+	if(m_First)
+		m_First->Prev = pHandle;
+	m_First = pHandle;
+	if(!m_Last)
+		m_Last = pHandle;
+	m_Count++;
+}
+
+void CHandleCache::Unlink(SFileHandle* pHandle)
+{
+	if(pHandle->Prev)
+		pHandle->Prev->Next = pHandle->Next;
+	else
+		m_First = pHandle->Next;
+	if(pHandle->Next)
+		pHandle->Next->Prev = pHandle->Prev;
+	else
+		m_Last = pHandle->Prev;
+	pHandle->Prev = NULL;
+	pHandle->Next = NULL;
+	m_Count--;
+}
+
+void CHandleCache::Shrink()
+{
+	// Note: we only try to lock the owners, a handle that is currently in use is skipped,
+	//			this way we can not deadlock with a thread that holds its handle and waits for us
+	for(SFileHandle* pHandle = m_Last; pHandle && m_Count > m_Limit; )
+	{
+		SFileHandle* pPrev = pHandle->Prev;
+		if(pHandle->pMutex->tryLock())
+		{
+			Unlink(pHandle);
+			m_Closes++;
+			m_Evictions++;
+
+			pHandle->pFile->close();
+			delete pHandle->pFile;
+			pHandle->pFile = NULL;
+			pHandle->pMutex->unlock();
+		}
+		pHandle = pPrev;
+	}
+}
+
+QVariantMap CHandleCache::GetStats() const
+{
+	QMutexLocker Locker(&m_Mutex);
+
+	QVariantMap Stats;
+	Stats["Open"] = m_Count;
+	Stats["Limit"] = m_Limit;
+	Stats["Opens"] = m_Opens;
+	Stats["Closes"] = m_Closes;
+	Stats["Evictions"] = m_Evictions;
+	Stats["Failed"] = m_Failed;
+	return Stats;
+}
@@ -0,0 +1,57 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// A file handle registered with the handle cache, the owner must hold pMutex when using pFile
+
+struct SFileHandle
+{
+	SFileHandle(QMutex* Mutex = NULL)
+	{
+		pMutex = Mutex;
+		pFile = NULL;
+		Prev = NULL;
+		Next = NULL;
+	}
+
+	QMutex*				pMutex;
+	QFile*				pFile;
+	SFileHandle*		Prev;
+	SFileHandle*		Next;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Global LRU of open file handles, when the limit is exceeded the least recently used handles are closed
+
+class CHandleCache
+{
+public:
+	CHandleCache();
+
+	static int				GetDefaultLimit();
+
+	void					SetLimit(int Limit);
+	int						GetLimit()						{QMutexLocker Locker(&m_Mutex); return m_Limit;}
+
+	bool					Open(SFileHandle* pHandle, const QString& FileName, QFile::OpenMode Mode);
+	void					Touch(SFileHandle* pHandle);
+	void					Close(SFileHandle* pHandle);
+
+	QVariantMap				GetStats() const;
+
+protected:
+	void					Link(SFileHandle* pHandle);
+	void					Unlink(SFileHandle* pHandle);
+	void					Shrink();
+
+	mutable QMutex			m_Mutex;
+	SFileHandle*			m_First;		// most recently used
+	SFileHandle*			m_Last;			// least recently used
+	int						m_Count;
+	int						m_Limit;
+
+	uint64					m_Opens;
+	uint64					m_Closes;
+	uint64					m_Evictions;
+	uint64					m_Failed;
+};
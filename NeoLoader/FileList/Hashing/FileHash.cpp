@@ -458,6 +458,32 @@ bool CFileHash::Calculate(QIODevice* pFile)
 	return false;
 }
 
+QList<TPair64> CFileHash::GetSegments(uint64 uTotalSize)
+{
+	QList<TPair64> Segments;
+	switch(GetType())
+	{
+		case HashMD5:
+		case HashSHA1:
+		case HashSHA2:
+			Segments.append(TPair64(0, uTotalSize));
+	}
+	return Segments;
+}
+
+void CFileHash::BeginSegment(CHashFunction& Hash)
+{
+	Hash.Reset();
+}
+
+bool CFileHash::Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize)
+{
+	if(Segments.size() != 1 || Segments.first().size() != GetSize())
+		return false;
+	SetHash((byte*)Segments.first().data());
+	return true;
+}
+
 //////////////////////////////
 // CFileHashEx
 
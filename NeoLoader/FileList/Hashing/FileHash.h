@@ -2,6 +2,7 @@
 
 class CFileHashTree;
 class CFileHashSet;
+class CHashFunction;
 
 #include "../PartMap.h"
 #include "../../../Framework/ObjectEx.h"
@@ -75,6 +76,8 @@ __inline uint64 DivUp(uint64 Size, uint64 Value)
 void* hash_malloc(size_t size);
 void hash_free(void* ptr);
 
+typedef QPair<uint64, uint64> TPair64;
+
 class CFileHash: public QObjectEx
 {
 	Q_OBJECT
@@ -123,6 +126,13 @@ public:
 	// operative part
 	virtual bool 				Calculate(QIODevice* pFile);
 
+	////////////////////////////////////////////////////////////////////////////////
+	// streaming part, the file is split into segments that are hashed from data fed in file order,
+	//	this way any number of hashes can be calculated in a single pass over the file
+	virtual QList<TPair64>		GetSegments(uint64 uTotalSize); // empty if the hash can not be streamed
+	virtual void				BeginSegment(CHashFunction& Hash);
+	virtual bool				Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize);
+
 protected:
 	friend class CHashingThread;
 
@@ -144,8 +154,6 @@ typedef QWeakPointer<CFileHash> CFileHashRef;
 //////////////////////////////
 // CFileHashEx
 
-typedef QPair<uint64, uint64> TPair64;
-
 class CFileHashEx: public CFileHash
 {
 	Q_OBJECT
@@ -186,6 +194,10 @@ public:
 	virtual void				ClearResult(uint64 uBegin, uint64 uEnd);
 	virtual bool				GetResult(uint64 uBegin, uint64 uEnd); // returns only positive results
 
+	// Note: a segment is the smallest range that can be verified on its own, eg. a part or a leaf
+	virtual TPair64				GetSegment(uint64 uOffset)	{return TPair64(0, 0);}
+	virtual bool				VerifySegment(uint64 uBegin, uint64 uEnd, const QByteArray& Hash) {return false;}
+
 	virtual QPair<uint32, uint32> IndexRange(uint64 uBegin, uint64 uEnd, bool bEnvelope = true);
 	virtual uint64				IndexOffset(uint32 Index);
 
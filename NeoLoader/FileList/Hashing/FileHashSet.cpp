@@ -1,6 +1,7 @@
 #include "GlobalHeader.h"
 #include "FileHashSet.h"
 #include "../../../Framework/Cryptography/HashFunction.h"
+#include "../IOManager.h"
 
 CFileHashSet::CFileHashSet(EFileHashType eType, uint64 TotalSize, uint64 PartSize)
 : CFileHashEx(eType, TotalSize), m_SetMutex(QReadWriteLock::Recursive)
@@ -170,7 +171,8 @@ bool CFileHashSet::Verify(QIODevice* pFile, CPartMap* pPartMap, uint64 uFrom, ui
 
 		if(Mode == eVerifyParts) // we want to hash only new parts
 		{
-			if(!m_StatusMap.isEmpty() && m_StatusMap.testBit(i)) 
+			// Note: parts may get verified from memory by the incremental hasher while we are running
+			if(GetResult(uBegin, uEnd)) 
 				continue; // already verified
 
 			if((pPartMap->GetRange(uBegin, uEnd) & Part::Available) == 0)
@@ -229,6 +231,106 @@ bool CFileHashSet::Calculate(QIODevice* pFile)
 	return CalculateRoot();
 }
 
+/** 
+* GetSegments: Sets up the hashset for a streamed calculation, every part is a segment
+*
+* @param: uTotalSize:	Size of the file
+* @return:				Part ranges in file order
+*/
+QList<TPair64> CFileHashSet::GetSegments(uint64 uTotalSize)
+{
+	Unload();
+
+	ASSERT(!m_TotalSize || m_TotalSize == uTotalSize);
+	m_TotalSize = uTotalSize;
+
+	QList<TPair64> Segments;
+	uint64 uPartSize = GetPartSize();
+	int Count = GetPartCount();
+	for(int i = 0; i < Count; i++)
+	{
+		uint64 uBegin = i * uPartSize;
+		uint64 uEnd = uBegin + uPartSize;
+		if(uEnd > m_TotalSize)
+			uEnd = m_TotalSize;
+		Segments.append(TPair64(uBegin, uEnd));
+	}
+	return Segments;
+}
+
+/** 
+* Calculate: Calculates a hashset from the part hashes of a streamed calculation
+*
+* @param: Segments:		Part hashes in file order
+* @param: uTotalSize:	Size of the file
+* @return:				true if it was posible to calculate
+*/
+bool CFileHashSet::Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize)
+{
+	Unload();
+
+	ASSERT(m_TotalSize == uTotalSize);
+	if(Segments.size() != GetPartCount())
+		return false;
+	
+	SetHash(NULL);
+
+	foreach(const QByteArray& Segment, Segments)
+	{
+		ASSERT(Segment.size() == m_uSize);
+		byte* pHash = (byte*)hash_malloc(m_uSize);
+		memcpy(pHash, Segment.data(), m_uSize);
+
+		QWriteLocker Locker(&m_SetMutex);
+		m_HashSet.append(pHash);
+	}
+
+	return CalculateRoot();
+}
+
+/** 
+* GetSegment: gets the part that contains the given offset
+*
+* @param: uOffset:	Offset in the file
+* @return:			Range of the part, or an empty range if we dont have a hash for it
+*/
+TPair64 CFileHashSet::GetSegment(uint64 uOffset)
+{
+	QReadLocker Locker(&m_SetMutex);
+
+	if(m_HashSet.isEmpty() || uOffset >= m_TotalSize)
+		return TPair64(0, 0);
+
+	uint64 uIndex = uOffset / m_PartSize;
+	if(uIndex >= m_HashSet.count())
+		return TPair64(0, 0);
+
+	uint64 uBegin = uIndex * m_PartSize;
+	return TPair64(uBegin, Min(uBegin + m_PartSize, m_TotalSize));
+}
+
+/** 
+* VerifySegment: compares a part hash calculated elsewhere with the hashset
+*
+* @param: uBegin:	Begin of the part
+* @param: uEnd:		end of the part
+* @param: Hash:		Calculated part hash
+* @return:			true if the hash matches
+*/
+bool CFileHashSet::VerifySegment(uint64 uBegin, uint64 uEnd, const QByteArray& Hash)
+{
+	QReadLocker Locker(&m_SetMutex);
+
+	if(m_HashSet.isEmpty() || uBegin % m_PartSize != 0 || Hash.size() != m_uSize)
+		return false;
+
+	uint64 uIndex = uBegin / m_PartSize;
+	if(uIndex >= m_HashSet.count() || uEnd != Min(uBegin + m_PartSize, m_TotalSize))
+		return false;
+
+	return memcmp(m_HashSet[uIndex], Hash.data(), m_uSize) == 0;
+}
+
 /** 
 * CalculatePart: Calculates a hashset for a specifyed part
 *
@@ -247,20 +349,29 @@ byte* CFileHashSet::CalculatePart(QIODevice* pFile, uint64 uBegin, uint64 uEnd)
 	CHashFunction Hash(GetAlgorithm());
 	ASSERT(Hash.IsValid());
 	
-	pFile->seek(uBegin);
-	quint64 uSize = uEnd - uBegin;
-	const size_t BuffSize = 16*1024;
-	char Buffer[BuffSize];
-	for(quint64 uPos = 0; uPos < uSize;)
+	// Note: read only files can be hashed strait from the mapping without copying
+	SMappedSlice Slice;
+	if(CManagedIO* pManaged = qobject_cast<CManagedIO*>(pFile))
+		Slice = pManaged->map(uBegin, uEnd - uBegin);
+	if(Slice.pData)
+		Hash.Add((byte*)Slice.pData, Slice.uSize);
+	else
 	{
-		quint64 uToGo = BuffSize;
-		if(uPos + uToGo > uSize)
-			uToGo = uSize - uPos;
-		qint64 uRead = pFile->read(Buffer, uToGo);
-		if(uRead < 1)
-			return NULL;
-		Hash.Add((byte*)Buffer, uRead);
-		uPos += uRead;
+		pFile->seek(uBegin);
+		quint64 uSize = uEnd - uBegin;
+		const size_t BuffSize = 16*1024;
+		char Buffer[BuffSize];
+		for(quint64 uPos = 0; uPos < uSize;)
+		{
+			quint64 uToGo = BuffSize;
+			if(uPos + uToGo > uSize)
+				uToGo = uSize - uPos;
+			qint64 uRead = pFile->read(Buffer, uToGo);
+			if(uRead < 1)
+				return NULL;
+			Hash.Add((byte*)Buffer, uRead);
+			uPos += uRead;
+		}
 	}
 
 	Hash.Finish();
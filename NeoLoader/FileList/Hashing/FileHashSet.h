@@ -31,6 +31,12 @@ public:
 	virtual bool				Verify(QIODevice* pFile, CPartMap* pPartMap, uint64 uFrom, uint64 uTo, EHashingMode Mode);
 	virtual bool 				Calculate(QIODevice* pFile);
 
+	virtual QList<TPair64>		GetSegments(uint64 uTotalSize);
+	virtual bool				Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize);
+
+	virtual TPair64				GetSegment(uint64 uOffset);
+	virtual bool				VerifySegment(uint64 uBegin, uint64 uEnd, const QByteArray& Hash);
+
 	virtual QByteArray			SaveBin();
 	virtual bool 				LoadBin(const QByteArray& Array);
 
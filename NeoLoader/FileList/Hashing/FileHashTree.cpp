@@ -1,6 +1,7 @@
 #include "GlobalHeader.h"
 #include "FileHashTree.h"
 #include "../../../Framework/Cryptography/HashFunction.h"
+#include "../IOManager.h"
 //#include <math.h>
 
 SHashTreeNode* allocNode(size_t uSize, SHashTreeNode* left = NULL, SHashTreeNode* right = NULL)
@@ -19,6 +20,22 @@ void freeNode(SHashTreeNode* ptr)
 	}
 }
 
+SHashTreeNode* cloneNode(SHashTreeNode* ptr, size_t uSize)
+{
+	if(!ptr)
+		return NULL;
+	SHashTreeNode* copy = allocNode(uSize, cloneNode(ptr->Left, uSize), cloneNode(ptr->Right, uSize));
+	memcpy(copy->pHash, ptr->pHash, uSize);
+	return copy;
+}
+
+uint32 countNodes(SHashTreeNode* ptr)
+{
+	if(!ptr)
+		return 0;
+	return 1 + countNodes(ptr->Left) + countNodes(ptr->Right);
+}
+
 SHashTreeNode::SHashTreeNode(size_t uSize, SHashTreeNode* left, SHashTreeNode* right)
 {
 	Left = left;
@@ -88,6 +105,7 @@ CFileHashTree::CFileHashTree(EFileHashType eType, uint64 TotalSize, uint64 Block
 	ASSERT(m_PartSize == -1 || eType == HashMule);
 
 	m_TreeRoot = NULL;
+	m_pTreeArray = NULL;
 }
 
 CFileHashTree::~CFileHashTree()
@@ -102,8 +120,7 @@ void CFileHashTree::Unload()
 {
 	QWriteLocker Locker(&m_TreeMutex);
 
-	freeNode(m_TreeRoot);
-	m_TreeRoot = NULL;
+	FreeTree();
 }
 
 ////////////////////////////////////////////////////////////////////////////////
@@ -180,6 +197,103 @@ bool CFileHashTree::Calculate(QIODevice* pFile)
 	return true;
 }
 
+/** 
+* GetSegments: Sets up the hashtree for a streamed calculation, every leaf is a segment
+*
+* @param: uTotalSize:	Size of the file
+* @return:				Leaf ranges in file order, or nothing if there are to many leafs to keep them in memory
+*/
+QList<TPair64> CFileHashTree::GetSegments(uint64 uTotalSize)
+{
+	ASSERT(!m_TotalSize || m_TotalSize == uTotalSize);
+	m_TotalSize = uTotalSize;
+
+	QList<TPair64> Leafs;
+	if(!m_TotalSize || DivUp(m_TotalSize, m_BlockSize) > 0x100000) // Note: tiny blocks are better hashed the classic way where the tree is trimmed on the fly
+		return Leafs;
+	CollectLeafs(0, GetTreeSize(), eLeft, Leafs);
+	return Leafs;
+}
+
+void CFileHashTree::BeginSegment(CHashFunction& Hash)
+{
+	Hash.Reset();
+
+	if(GetType() == HashTigerTree)
+	{
+		byte Mark[1];
+		Mark[0] = 0x00; //leaf hash mark.
+		Hash.Add(Mark,1);
+	}
+}
+
+/** 
+* Calculate: Calculates a hashtree from the leaf hashes of a streamed calculation
+*
+* @param: Segments:		Leaf hashes in file order
+* @param: uTotalSize:	Size of the file
+* @return:				true if it was posible to calculate
+*/
+bool CFileHashTree::Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize)
+{
+	Unload();
+
+	ASSERT(m_TotalSize == uTotalSize);
+
+	SetHash(NULL);
+
+	CHashFunction Hash(GetAlgorithm());
+	ASSERT(Hash.IsValid());
+
+	QList<QByteArray> Leafs = Segments;
+	SHashTreeNode* TreeRoot = CalculateRange(NULL,0,GetTreeSize(),eLeft,1, Hash, &Leafs);
+	ASSERT(Leafs.isEmpty());
+	if(!TreeRoot || !SetTree(TreeRoot))
+		return false;
+	return true;
+}
+
+/** 
+* GetSegment: gets the leaf that contains the given offset
+*
+* @param: uOffset:	Offset in the file
+* @return:			Range of the leaf, or an empty range if the tree is not resolved down to it
+*/
+TPair64 CFileHashTree::GetSegment(uint64 uOffset)
+{
+	QReadLocker Locker(&m_TreeMutex);
+
+	uint64 uBegin;
+	uint64 uEnd;
+	if(!FindLeaf(uOffset, uBegin, uEnd))
+		return TPair64(0, 0);
+	return TPair64(uBegin, uEnd);
+}
+
+/** 
+* VerifySegment: compares a leaf hash calculated elsewhere with the tree
+*
+* @param: uBegin:	Begin of the leaf
+* @param: uEnd:		end of the leaf
+* @param: Hash:		Calculated leaf hash
+* @return:			true if the hash matches
+*/
+bool CFileHashTree::VerifySegment(uint64 uBegin, uint64 uEnd, const QByteArray& Hash)
+{
+	QReadLocker Locker(&m_TreeMutex);
+
+	if(Hash.size() != m_uSize)
+		return false;
+
+	uint64 uLeafBegin;
+	uint64 uLeafEnd;
+	SHashTreeNode* Leaf = FindLeaf(uBegin, uLeafBegin, uLeafEnd);
+	if(!Leaf || uLeafBegin != uBegin || uLeafEnd != uEnd)
+		return false;
+
+	return memcmp(Leaf->pHash, Hash.data(), m_uSize) == 0;
+}
+
 bool CFileHashTree::SetTree(SHashTreeNode* TreeRoot)
 {
 	QWriteLocker Locker(&m_TreeMutex);
@@ -192,11 +306,85 @@ bool CFileHashTree::SetTree(SHashTreeNode* TreeRoot)
 		freeNode(TreeRoot);
 		return false;
 	}
-	freeNode(m_TreeRoot);
+	FreeTree();
 	m_TreeRoot = TreeRoot;
+	Flatten();
 	return true;
 }
 
+/** 
+* FreeTree: removes the current tree, the tree must be locked for writing
+*/
+void CFileHashTree::FreeTree()
+{
+	if(m_pTreeArray)
+	{
+		delete m_pTreeArray; // Note: the nodes in the flat storage dont own anything
+		m_pTreeArray = NULL;
+	}
+	else
+		freeNode(m_TreeRoot);
+	m_TreeRoot = NULL;
+}
+
+/** 
+* Flatten: moves a fully resolved tree into flat storage, partially known trees stay as they are
+*			as they may still get expanded by new leafs
+*/
+void CFileHashTree::Flatten()
+{
+	if(m_pTreeArray || !m_TreeRoot)
+		return;
+
+	uint64 TreeSize = GetTreeSize();
+	if(!IsFullyResolved(0, TreeSize, eLeft, m_TreeRoot, 0, TreeSize, m_BlockSize, 1))
+		return;
+
+	SHashTreeArray* pArray = new SHashTreeArray(m_uSize, countNodes(m_TreeRoot));
+	uint32 Index = 0;
+	SHashTreeNode* TreeRoot = CopyBranche(m_TreeRoot, pArray, Index);
+	ASSERT(Index == pArray->Count);
+
+	freeNode(m_TreeRoot);
+	m_TreeRoot = TreeRoot;
+	m_pTreeArray = pArray;
+}
+
+/** 
+* Unflatten: moves the tree back to individualy allocated nodes, this must be done befoure the tree is modifyed
+*/
+void CFileHashTree::Unflatten()
+{
+	if(!m_pTreeArray)
+		return;
+
+	SHashTreeNode* TreeRoot = cloneNode(m_TreeRoot, m_uSize);
+	delete m_pTreeArray;
+	m_pTreeArray = NULL;
+	m_TreeRoot = TreeRoot;
+}
+
+SHashTreeNode* CFileHashTree::CopyBranche(SHashTreeNode* Branche, SHashTreeArray* pArray, uint32& Index)
+{
+	ASSERT(Index < pArray->Count);
+	SHashTreeNode* Node = &pArray->pNodes[Index];
+	Node->pHash = pArray->pHashes + (Index * m_uSize);
+	Index++;
+
+	memcpy(Node->pHash, Branche->pHash, m_uSize);
+	if(Branche->IsLeaf())
+	{
+		Node->Left = NULL;
+		Node->Right = NULL;
+	}
+	else
+	{
+		Node->Left = CopyBranche(Branche->Left, pArray, Index);
+		Node->Right = CopyBranche(Branche->Right, pArray, Index);
+	}
+	return Node;
+}
+
 /** 
 * TrimTree: Trimms all brnaches below a gien depth, thos reducing the storage requirements for the tree
 *
@@ -205,6 +393,8 @@ bool CFileHashTree::SetTree(SHashTreeNode* TreeRoot)
 */
 void CFileHashTree::TrimTree(SHashTreeNode* Branche, int Depth)
 {
+	ASSERT(!m_pTreeArray); // Note: nodes in flat storage can not be freed individualy, call Unflatten first
+
 	if(Branche->IsLeaf())
 		return;
 
@@ -370,9 +560,10 @@ uint64 CFileHashTree::GetBrancheSize(uint64 uBegin, uint64 uEnd, EBalance Balanc
 * @param: uEnd:		end of the range
 * @Param: Balance:	specifyes how to balance the branche, it san be left or right depanding of if its the left or the right branche.
 * @param: Depth:	current depth
+* @param: pLeafs:	Optional precalculated leaf hashes in file order, when set the file is not read
 * @return:			Tree nodefor the given range towh set up sub noned down to leafs
 */
-SHashTreeNode* CFileHashTree::CalculateRange(QIODevice* pFile, uint64 uBegin, uint64 uEnd, EBalance Balance, int Depth, CHashFunction& Hash)
+SHashTreeNode* CFileHashTree::CalculateRange(QIODevice* pFile, uint64 uBegin, uint64 uEnd, EBalance Balance, int Depth, CHashFunction& Hash, QList<QByteArray>* pLeafs)
 {
 	ASSERT(uBegin < uEnd);
 
@@ -384,14 +575,29 @@ SHashTreeNode* CFileHashTree::CalculateRange(QIODevice* pFile, uint64 uBegin, ui
 	}
 
 	if(BrancheSize >= uEnd-uBegin) // this is aleady a leef
-		return CalculateLeaf(pFile, uBegin, uEnd, Hash);
+	{
+		if(!pLeafs)
+			return CalculateLeaf(pFile, uBegin, uEnd, Hash);
+
+		if(uBegin < m_TotalSize && (pLeafs->isEmpty() || pLeafs->first().size() != m_uSize))
+		{
+			ASSERT(0);
+			return NULL;
+		}
+		SHashTreeNode* Branche = allocNode(m_uSize);
+		if(uBegin >= m_TotalSize)
+			memset(Branche->pHash, 0, m_uSize); // file is not complete, or filling
+		else
+			memcpy(Branche->pHash, pLeafs->takeFirst().data(), m_uSize);
+		return Branche;
+	}
 
 	// this is a branche
 	Depth++;
-	SHashTreeNode* Left = CalculateRange(pFile, uBegin, uBegin + BrancheSize, eLeft, Depth, Hash);
+	SHashTreeNode* Left = CalculateRange(pFile, uBegin, uBegin + BrancheSize, eLeft, Depth, Hash, pLeafs);
 	if(!Left)
 		return NULL;
-	SHashTreeNode* Right = CalculateRange(pFile, uBegin + BrancheSize, uEnd, eRight, Depth, Hash);
+	SHashTreeNode* Right = CalculateRange(pFile, uBegin + BrancheSize, uEnd, eRight, Depth, Hash, pLeafs);
 	if(!Right)
 	{
 		freeNode(Left);
@@ -410,6 +616,83 @@ SHashTreeNode* CFileHashTree::CalculateRange(QIODevice* pFile, uint64 uBegin, ui
 	return Branche;
 }
 
+/** 
+* CollectLeafs: lists the leaf ranges of a given range, in the same order CalculateRange visits them
+*
+* @param: uBegin:	Begin of the range
+* @param: uEnd:		end of the range
+* @Param: Balance:	specifyes how to balance the branche
+* @param: Leafs:	list the ranges are appended to, leafs past the end of the file are skipped
+*/
+void CFileHashTree::CollectLeafs(uint64 uBegin, uint64 uEnd, EBalance Balance, QList<TPair64>& Leafs)
+{
+	uint64 BrancheSize = GetBrancheSize(uBegin, uEnd, Balance);
+	if(BrancheSize == 0)
+	{
+		ASSERT(0);
+		return;
+	}
+
+	if(BrancheSize >= uEnd-uBegin) // this is aleady a leef
+	{
+		if(uBegin < m_TotalSize)
+			Leafs.append(TPair64(uBegin, Min(uEnd, m_TotalSize)));
+		return;
+	}
+
+	CollectLeafs(uBegin, uBegin + BrancheSize, eLeft, Leafs);
+	CollectLeafs(uBegin + BrancheSize, uEnd, eRight, Leafs);
+}
+
+/** 
+* FindLeaf: finds the leaf node that contains a given offset, the tree must be locked
+*
+* @param: uOffset:	Offset in the file
+* @param: uBegin:	returns the begin of the leaf
+* @param: uEnd:		returns the end of the leaf, limited to the file size
+* @return:			the leaf node, or NULL if the tree is not resolved down to the leaf level
+*/
+SHashTreeNode* CFileHashTree::FindLeaf(uint64 uOffset, uint64& uBegin, uint64& uEnd)
+{
+	if(uOffset >= m_TotalSize)
+		return NULL;
+
+	SHashTreeNode* Branche = m_TreeRoot;
+	EBalance Balance = eLeft;
+	uBegin = 0;
+	uEnd = GetTreeSize();
+	while(Branche)
+	{
+		uint64 BrancheSize = GetBrancheSize(uBegin, uEnd, Balance);
+		if(BrancheSize == 0)
+			break;
+
+		if(BrancheSize >= uEnd-uBegin) // this is aleady a leef
+		{
+			if(uEnd > m_TotalSize) // HashTorrent
+				uEnd = m_TotalSize;
+			return Branche;
+		}
+
+		if(Branche->IsLeaf())
+			break; // this is a pseudo leef, we dont have deper data
+
+		if(uOffset < uBegin + BrancheSize)
+		{
+			Branche = Branche->Left;
+			uEnd = uBegin + BrancheSize;
+			Balance = eLeft;
+		}
+		else
+		{
+			Branche = Branche->Right;
+			uBegin += BrancheSize;
+			Balance = eRight;
+		}
+	}
+	return NULL;
+}
+
 /** 
 * CalculateLeaf: calculate a leaf hash
 *
@@ -438,22 +721,31 @@ SHashTreeNode* CFileHashTree::CalculateLeaf(QIODevice* pFile, uint64 uBegin, uin
 		Hash.Add(Mark,1);
 	}
 
-	if(pFile->pos() != uBegin)
-		pFile->seek(uBegin);
-
-	quint64 uSize = uEnd - uBegin;
-	const size_t BuffSize = 16*1024;
-	char Buffer[BuffSize];
-	for(quint64 uPos = 0; uPos < uSize;)
+	// Note: read only files can be hashed strait from the mapping without copying
+	SMappedSlice Slice;
+	if(CManagedIO* pManaged = qobject_cast<CManagedIO*>(pFile))
+		Slice = pManaged->map(uBegin, uEnd - uBegin);
+	if(Slice.pData)
+		Hash.Add((byte*)Slice.pData, Slice.uSize);
+	else
 	{
-		quint64 uToGo = BuffSize;
-		if(uPos + uToGo > uSize)
-			uToGo = uSize - uPos;
-		qint64 uRead = pFile->read(Buffer, uToGo);
-		if(uRead < 1)
-			return NULL;
-		Hash.Add((byte*)Buffer, uRead);
-		uPos += uRead;
+		if(pFile->pos() != uBegin)
+			pFile->seek(uBegin);
+
+		quint64 uSize = uEnd - uBegin;
+		const size_t BuffSize = 16*1024;
+		char Buffer[BuffSize];
+		for(quint64 uPos = 0; uPos < uSize;)
+		{
+			quint64 uToGo = BuffSize;
+			if(uPos + uToGo > uSize)
+				uToGo = uSize - uPos;
+			qint64 uRead = pFile->read(Buffer, uToGo);
+			if(uRead < 1)
+				return NULL;
+			Hash.Add((byte*)Buffer, uRead);
+			uPos += uRead;
+		}
 	}
 
 	Hash.Finish();
@@ -807,7 +1099,11 @@ bool CFileHashTree::AddLeafs(CFileHashTree* TreeRoot)
 	}
 
 	// Note: we must own TreeRoot exclusivly so that we can do with it what we want without locking
+	//			Merge moves nodes from one tree to the other, so none of them can be in flat storage
+	TreeRoot->Unflatten();
+	Unflatten();
 	Merge(TreeRoot->m_TreeRoot, m_TreeRoot); 
+	Flatten();
 
 	return true; // Merging must must nececerly succed as booth trees are already validated
 }
@@ -66,6 +66,29 @@ struct SHashTreeDump
 	byte* pHashes;
 };
 
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Flat storage for fully resolved trees, all nodes and thair hashes are kept in two arrays in pre order,
+// so every left child directly follows its parent and a tree walk does not jump around in memory
+
+struct SHashTreeArray
+{
+	SHashTreeArray(size_t uSize, uint32 uCount)
+	{
+		Count = uCount;
+		pNodes = (SHashTreeNode*)malloc(sizeof(SHashTreeNode) * Count);
+		pHashes = (byte*)malloc(uSize * Count);
+	}
+	~SHashTreeArray()
+	{
+		free(pNodes);
+		free(pHashes);
+	}
+
+	uint32 Count;
+	SHashTreeNode* pNodes;
+	byte* pHashes;
+};
+
 class CFileHashTree: public CFileHashEx
 {
 	Q_OBJECT
@@ -102,6 +125,13 @@ public:
 	virtual bool				Verify(QIODevice* pFile, CPartMap* pPartMap, uint64 uFrom, uint64 uTo, EHashingMode Mode);
 	virtual bool 				Calculate(QIODevice* pFile);
 
+	virtual QList<TPair64>		GetSegments(uint64 uTotalSize);
+	virtual void				BeginSegment(CHashFunction& Hash);
+	virtual bool				Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize);
+
+	virtual TPair64				GetSegment(uint64 uOffset);
+	virtual bool				VerifySegment(uint64 uBegin, uint64 uEnd, const QByteArray& Hash);
+
 	virtual bool				AddLeafs(CFileHashTree* TreeRoot);
 	virtual CFileHashTree*		GetLeafs(uint64 uFrom, uint64 uTo); 
 
@@ -112,6 +142,10 @@ public:
 
 protected:
 	virtual bool				SetTree(SHashTreeNode* TreeRoot);
+	virtual void				FreeTree();
+	virtual void				Flatten();
+	virtual void				Unflatten();
+	virtual SHashTreeNode*		CopyBranche(SHashTreeNode* Branche, SHashTreeArray* pArray, uint32& Index);
 
 	virtual uint64				GetTreeSize();
 	enum EBalance
@@ -120,7 +154,9 @@ protected:
 		eRight,
 	};
 	virtual uint64				GetBrancheSize(uint64 uBegin, uint64 uEnd, EBalance Balance);
-	virtual SHashTreeNode*		CalculateRange(QIODevice* pFile, uint64 uBegin, uint64 uEnd, EBalance Balance, int Depth, CHashFunction& Hash);
+	virtual SHashTreeNode*		CalculateRange(QIODevice* pFile, uint64 uBegin, uint64 uEnd, EBalance Balance, int Depth, CHashFunction& Hash, QList<QByteArray>* pLeafs = NULL);
+	virtual void				CollectLeafs(uint64 uBegin, uint64 uEnd, EBalance Balance, QList<TPair64>& Leafs);
+	virtual SHashTreeNode*		FindLeaf(uint64 uOffset, uint64& uBegin, uint64& uEnd);
 	virtual SHashTreeNode*		CalculateLeaf(QIODevice* pFile, uint64 uBegin, uint64 uEnd, CHashFunction& Hash);
 	virtual bool				CalculateTree(SHashTreeNode* Branche, CHashFunction& Hash);
 	virtual void				CalculateBranche(SHashTreeNode* Branche, CHashFunction& Hash);
@@ -143,6 +179,7 @@ protected:
 	uint64						m_BlockSize;
 	uint64						m_PartSize;
 	SHashTreeNode*				m_TreeRoot;
+	SHashTreeArray*				m_pTreeArray;	// set when m_TreeRoot lives in flat storage
 	int							m_DepthLimit;
 
 	mutable QReadWriteLock		m_TreeMutex;
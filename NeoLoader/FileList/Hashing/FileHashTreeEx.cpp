@@ -2,8 +2,6 @@
 #include "FileHashTreeEx.h"
 #include "../../../Framework/Cryptography/HashFunction.h"
 
-void freeNode(SHashTreeNode* ptr);
-
 CFileHashTreeEx::CFileHashTreeEx(EFileHashType eType, uint64 TotalSize, uint64 BlockSize, uint64 PartSize, int DepthLimit)
 : CFileHashTree(eType, TotalSize, BlockSize, PartSize, DepthLimit)
 {
@@ -12,8 +10,9 @@ CFileHashTreeEx::CFileHashTreeEx(EFileHashType eType, uint64 TotalSize, uint64 B
 bool CFileHashTreeEx::SetTree(SHashTreeNode* TreeRoot)
 {
 	QWriteLocker Locker(&m_TreeMutex);
-	freeNode(m_TreeRoot);
+	FreeTree();
 	m_TreeRoot = TreeRoot;
+	Flatten();
 	if(m_MetaHash.isEmpty())
 		return true;
 
@@ -52,6 +51,14 @@ bool CFileHashTreeEx::Calculate(QIODevice* pFile)
 	return true;
 }
 
+bool CFileHashTreeEx::Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize)
+{
+	if(!CFileHashTree::Calculate(Segments, uTotalSize))
+		return false;
+	SetHash(NULL); // clear hash let it be set when metadata are set
+	return true;
+}
+
 bool CFileHashTreeEx::Validate(const QByteArray& MetaHash, const QByteArray& RootHash)
 {
 	if(!IsValid())
@@ -82,8 +89,7 @@ bool CFileHashTreeEx::Validate()
 	else if(!Compare(Hash.GetKey()))
 	{
 		m_MetaHash.clear();
-		freeNode(m_TreeRoot);
-		m_TreeRoot = NULL;
+		FreeTree();
 		return false;
 	}
 	return true;
@@ -17,6 +17,7 @@ public:
 	virtual QByteArray			GetMetaHash() const			{QReadLocker Locker(&m_TreeMutex); return m_MetaHash;}
 
 	virtual bool 				Calculate(QIODevice* pFile);
+	virtual bool				Calculate(const QList<QByteArray>& Segments, uint64 uTotalSize);
 
 	virtual bool				Validate(const QByteArray& MetaHash, const QByteArray& RootHash);
 
@@ -9,6 +9,7 @@
 #include "FileHashSet.h"
 #include "FileHashTree.h"
 #include "FileHashTreeEx.h"
+#include "../../../Framework/Cryptography/HashFunction.h"
 
 /////////////////////////////////////////////////////////////////////////////////////
 // CHashingJob
@@ -81,29 +82,265 @@ void CVerifyPartsJob::Execute(CManagedIO* pDevice)
 // CVerifyPartsJob
 //
 
+struct CHashFileJob::SHashStream
+{
+	SHashStream(const CFileHashPtr& Hash, const QList<TPair64>& List)
+	 : pHash(Hash), Segments(List), Function(Hash->GetAlgorithm())
+	{
+		ASSERT(Function.IsValid());
+		Index = 0;
+		pHash->BeginSegment(Function);
+	}
+
+	void Add(uint64 uOffset, const byte* pData, uint64 uLength)
+	{
+		// Note: the segments are contiguous and the data comes in file order, so it always belongs to the current segment
+		while(Index < Segments.size())
+		{
+			uint64 uBegin = Segments.at(Index).first;
+			if(uOffset < uBegin) // when hashing a range, data before our first segment is skipped
+			{
+				uint64 uSkip = Min(uLength, uBegin - uOffset);
+				pData += uSkip;
+				uOffset += uSkip;
+				uLength -= uSkip;
+				if(uOffset < uBegin)
+					break;
+			}
+
+			uint64 uEnd = Segments.at(Index).second;
+			if(uOffset < uEnd && uLength > 0)
+			{
+				uint64 uToGo = Min(uLength, uEnd - uOffset);
+				Function.Add(pData, uToGo);
+				pData += uToGo;
+				uOffset += uToGo;
+				uLength -= uToGo;
+			}
+			if(uOffset < uEnd)
+				break; // we need more data
+
+			Function.Finish();
+			Results.append(Function.ToByteArray());
+			if(++Index < Segments.size())
+				pHash->BeginSegment(Function);
+		}
+	}
+
+	bool IsComplete() const {return Index >= Segments.size();}
+
+	CFileHashPtr			pHash;
+	QList<TPair64>			Segments;
+	int						Index;
+	CHashFunction			Function;
+	QList<QByteArray>		Results;
+};
+
 CHashFileJob::CHashFileJob(uint64 FileID, const QList<CFileHashPtr>& List)
  : CHashingJob(FileID, List)
 {
+	m_uProgress = 0;
+	m_pProgress = NULL;
 }
 	
 void CHashFileJob::Execute(CManagedIO* pDevice)
 {
 	pDevice->open(QIODevice::ReadOnly); // on this kind of devices open should never fail
+	m_uProgress = 0;
+	m_pProgress = pDevice;
 
+	// Note: all hashes that can be streamed are calculated with a single pass over the file
+	uint64 uTotalSize = pDevice->size();
+	QList<SHashStream*> Streams;
+	QList<CFileHashPtr> Others;
 	foreach(CFileHashPtr pHash, m_List)
 	{
 		if(!pHash)
 			continue; // this one is gone
 
-		if(!pHash->Calculate(pDevice))
-			m_pThread->LogLine(LOG_ERROR, tr("Hashing (%2) of %1 failed").arg(pDevice->fileName()).arg(CFileHash::HashType2Str(pHash->GetType())));
-		else if(pHash->IsComplete()) // else means we we need meta data and that will be done by CFile
-			m_pThread->SaveHash(pHash.data());
+		QList<TPair64> Segments;
+		if(uTotalSize)
+			Segments = pHash->GetSegments(uTotalSize);
+		if(Segments.isEmpty())
+			Others.append(pHash);
+		else
+			Streams.append(new SHashStream(pHash, Segments));
 	}
 
+	if(!Streams.isEmpty())
+	{
+		bool bRead = StreamFile(pDevice, Streams);
+		foreach(SHashStream* pStream, Streams)
+		{
+			OnCalculated(pDevice, pStream->pHash.data(), bRead && pStream->IsComplete() && pStream->pHash->Calculate(pStream->Results, uTotalSize));
+			delete pStream;
+		}
+	}
+
+	foreach(CFileHashPtr pHash, Others)
+		OnCalculated(pDevice, pHash.data(), pHash->Calculate(pDevice));
+
+	m_pProgress = NULL;
 	emit Finished();
 }
 
+bool CHashFileJob::StreamFile(CManagedIO* pDevice, QList<SHashStream*>& Streams)
+{
+	uint64 uTotalSize = pDevice->size();
+
+	// Note: a large file on a fast device is split into ranges hashed in parallel, 
+	//			this works only when all segments are small compared to the ranges
+	int Helpers = 0;
+	uint64 uSplitSize = theCore->Cfg()->GetUInt64("Content/HashingSplitSize");
+	if(uSplitSize && uTotalSize >= 2 * uSplitSize)
+	{
+		uint64 uMaxSegment = 0;
+		foreach(SHashStream* pStream, Streams)
+		{
+			foreach(const TPair64& Segment, pStream->Segments)
+				uMaxSegment = Max(uMaxSegment, Segment.second - Segment.first);
+		}
+		if(uMaxSegment * 4 <= uSplitSize)
+			Helpers = m_pThread->AcquireHelpers(m_FileID, Min(uTotalSize / uSplitSize, (uint64)64) - 1);
+	}
+	if(Helpers == 0)
+		return StreamRange(pDevice, 0, uTotalSize, Streams);
+
+	int Count = Helpers + 1;
+	uint64 uRangeSize = DivUp(DivUp(uTotalSize, Count), MB2B(1)) * MB2B(1);
+
+	// assign every segment to the range it begins in
+	QVector<QList<SHashStream*> > Ranges(Count);
+	QVector<TPair64> Bounds(Count, TPair64(-1, 0));
+	foreach(SHashStream* pStream, Streams)
+	{
+		QVector<QList<TPair64> > Segments(Count);
+		foreach(const TPair64& Segment, pStream->Segments)
+			Segments[Min(Segment.first / uRangeSize, (uint64)Count - 1)].append(Segment);
+		for(int i=0; i < Count; i++)
+		{
+			Ranges[i].append(new SHashStream(pStream->pHash, Segments[i]));
+			if(!Segments[i].isEmpty())
+			{
+				Bounds[i].first = Min(Bounds[i].first, Segments[i].first().first);
+				Bounds[i].second = Max(Bounds[i].second, Segments[i].last().second);
+			}
+		}
+	}
+
+	QList<CHashRangeWorker*> Workers;
+	for(int i=1; i < Count; i++)
+	{
+		CHashRangeWorker* pWorker = new CHashRangeWorker(this, Bounds[i].first, Bounds[i].second, &Ranges[i]);
+		Workers.append(pWorker);
+		pWorker->start();
+	}
+
+	bool bOk = StreamRange(pDevice, Bounds[0].first, Bounds[0].second, Ranges[0]);
+
+	foreach(CHashRangeWorker* pWorker, Workers)
+	{
+		pWorker->wait();
+		if(!pWorker->IsOk())
+			bOk = false;
+		delete pWorker;
+	}
+	m_pThread->ReleaseHelpers(Helpers);
+
+	// merge the segment hashes of all ranges
+	for(int j=0; j < Streams.size(); j++)
+	{
+		SHashStream* pStream = Streams[j];
+		bool bComplete = true;
+		for(int i=0; i < Count; i++)
+		{
+			SHashStream* pRange = Ranges[i].at(j);
+			pStream->Results.append(pRange->Results);
+			if(!pRange->IsComplete())
+				bComplete = false;
+			delete pRange;
+		}
+		pStream->Index = bComplete ? pStream->Segments.size() : 0;
+	}
+	return bOk;
+}
+
+bool CHashFileJob::StreamRange(CManagedIO* pDevice, uint64 uBegin, uint64 uEnd, QList<SHashStream*>& Streams)
+{
+	const uint64 BuffSize = MB2B(1);
+	QByteArray Buffer;
+	for(uint64 uOffset = uBegin; uOffset < uEnd;)
+	{
+		uint64 uToGo = Min(BuffSize, uEnd - uOffset);
+
+		const byte* pData = NULL;
+		SMappedSlice Slice = pDevice->map(uOffset, uToGo); // Note: read only files are hashed strait from the mapping
+		if(Slice.pData)
+			pData = (const byte*)Slice.pData;
+		else
+		{
+			if(Buffer.isEmpty())
+				Buffer.resize(BuffSize);
+			if(pDevice->pos() != uOffset)
+				pDevice->seek(uOffset);
+			qint64 uRead = pDevice->read(Buffer.data(), uToGo);
+			if(uRead < 1)
+				return false;
+			uToGo = uRead;
+			pData = (const byte*)Buffer.data();
+		}
+
+		foreach(SHashStream* pStream, Streams)
+			pStream->Add(uOffset, pData, uToGo);
+
+		uOffset += uToGo;
+		Progress(uToGo);
+	}
+	return true;
+}
+
+void CHashFileJob::Progress(uint64 uLength)
+{
+	QMutexLocker Locker(&m_ProgressMutex);
+	m_uProgress += uLength;
+	if(m_pProgress)
+		m_pProgress->progress(m_uProgress);
+}
+
+CHashRangeWorker::CHashRangeWorker(CHashFileJob* pJob, uint64 uBegin, uint64 uEnd, QList<CHashFileJob::SHashStream*>* pStreams, QObject* qObject)
+ : QThreadEx(qObject)
+{
+	m_pJob = pJob;
+	m_uBegin = uBegin;
+	m_uEnd = uEnd;
+	m_pStreams = pStreams;
+	m_bOk = false;
+}
+
+void CHashRangeWorker::run()
+{
+	if(m_uBegin >= m_uEnd)
+	{
+		m_bOk = true; // nothing to do
+		return;
+	}
+
+	if(CManagedIO* pDevice = theCore->m_IOManager->GetDevice(m_pJob->GetFileID()))
+	{
+		pDevice->open(QIODevice::ReadOnly); // Note: every range needs its own device as the position is not shared
+		m_bOk = m_pJob->StreamRange(pDevice, m_uBegin, m_uEnd, *m_pStreams);
+		delete pDevice;
+	}
+}
+
+void CHashFileJob::OnCalculated(CManagedIO* pDevice, CFileHash* pHash, bool bSuccess)
+{
+	if(!bSuccess)
+		m_pThread->LogLine(LOG_ERROR, tr("Hashing (%2) of %1 failed").arg(pDevice->fileName()).arg(CFileHash::HashType2Str(pHash->GetType())));
+	else if(pHash->IsComplete()) // else means we we need meta data and that will be done by CFile
+		m_pThread->SaveHash(pHash);
+}
+
 
 /////////////////////////////////////////////////////////////////////////////////////
 // CVerifyPartsJob
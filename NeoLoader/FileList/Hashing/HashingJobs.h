@@ -5,6 +5,7 @@
 #include "FileHash.h"
 class CManagedIO;
 class CHashingThread;
+class CHashRangeWorker;
 
 class CHashingJob: public QThreadEx
 {
@@ -65,6 +66,36 @@ public:
 	virtual int 			GetPriority()			{return 10;}
 
 protected:
+	friend class CHashRangeWorker;
+
+	struct SHashStream;
+	virtual bool			StreamFile(CManagedIO* pDevice, QList<SHashStream*>& Streams);
+	virtual bool			StreamRange(CManagedIO* pDevice, uint64 uBegin, uint64 uEnd, QList<SHashStream*>& Streams);
+	virtual void			OnCalculated(CManagedIO* pDevice, CFileHash* pHash, bool bSuccess);
+	virtual void			Progress(uint64 uLength);
+
+	QMutex					m_ProgressMutex;
+	uint64					m_uProgress;
+	CManagedIO*				m_pProgress;
+};
+
+class CHashRangeWorker: public QThreadEx
+{
+	Q_OBJECT
+
+public:
+	CHashRangeWorker(CHashFileJob* pJob, uint64 uBegin, uint64 uEnd, QList<CHashFileJob::SHashStream*>* pStreams, QObject* qObject = NULL);
+
+	void					run();
+
+	bool					IsOk()					{return m_bOk;}
+
+protected:
+	CHashFileJob*			m_pJob;
+	uint64					m_uBegin;
+	uint64					m_uEnd;
+	QList<CHashFileJob::SHashStream*>* m_pStreams;
+	bool					m_bOk;
 };
 
 class CImportPartsJob: public CHashingJob
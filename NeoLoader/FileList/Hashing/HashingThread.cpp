@@ -9,9 +9,11 @@
 #include "FileHashSet.h"
 #include "FileHashTree.h"
 #include "FileHashTreeEx.h"
+#include "../IOQueue.h"
 #include <QSqlDatabase>
 #include <QSqlQuery>
 #include <QSqlError>
+#include <QSqlRecord>
 
 CHashingThread::CHashingThread(QObject* qObject)
 : QThreadEx(qObject)
@@ -24,7 +26,7 @@ CHashingThread::CHashingThread(QObject* qObject)
 	m_DataBase->open();
 
 	m_DataBase->exec("pragma synchronous = off");
-	m_DataBase->exec("pragma journal_mode = off");
+	m_DataBase->exec("pragma journal_mode = wal"); // Note: lets the batched stores append to the log instead of rewriting pages in place
 	m_DataBase->exec("pragma locking_mode = exclusive");
 	m_DataBase->exec("pragma cache_size = 100000");
 
@@ -43,10 +45,10 @@ CHashingThread::CHashingThread(QObject* qObject)
 		//QString e3 = Query2.lastError().text();
 	}
 
-	m_HashingID = 0;
-	m_HashingOffset = 0;
 	m_HashingCount = 0;
-	m_LongJob = false;
+	m_Helpers = 0;
+	m_uPendingSince = 0;
+	m_uRetryAt = 0;
 
 	m_Stop = false;
 	//start();
@@ -56,6 +58,12 @@ CHashingThread::~CHashingThread()
 {
 	Stop();
 
+	// Note: if the last batch can not be writen the hashes are lost, they will be recalculated when needed
+	for(int i=0; i < 3 && !FlushHashes(); i++)
+		msleep(500);
+	foreach(QSqlQuery* pQuery, m_Queries)
+		delete pQuery;
+	m_Queries.clear();
 	m_DataBase->close();
 	delete m_DataBase;
 }
@@ -63,54 +71,160 @@ CHashingThread::~CHashingThread()
 void CHashingThread::Stop()
 {
 	m_Stop = true;
-	wait();
+	m_Mutex.lock();
+	m_Wait.wakeAll();
+	m_Mutex.unlock();
+	wait(); // Note: the pool only grows from within this thread
+
+	foreach(CHashingWorker* pWorker, m_Workers)
+	{
+		pWorker->wait();
+		delete pWorker;
+	}
+	m_Workers.clear();
 }
 
 void CHashingThread::run()
+{
+	ProcessJobs(0);
+}
+
+int CHashingThread::GetPoolSize()
+{
+	int PoolSize = theCore->Cfg()->GetInt("Content/HashingThreads");
+	if(PoolSize <= 0)
+		PoolSize = QThread::idealThreadCount();
+	return Max(PoolSize, 1);
+}
+
+void CHashingThread::ProcessJobs(int Index)
 {
 	while(!m_Stop)
 	{
-		// if the write buffer is getting full, take a longer break and suspend hashing
-		if(theCore->m_IOManager->IsWriteBufferFull(true))
+		if(Index == 0) // the hashing thread itself is the first worker, it grows the pool when needed
 		{
-			sleep(5);
-			continue;
+			FlushHashes(false);
+
+			int PoolSize = GetPoolSize();
+			QMutexLocker Locker(&m_Mutex);
+			while(m_Workers.size() < PoolSize - 1)
+			{
+				CHashingWorker* pWorker = new CHashingWorker(this, m_Workers.size() + 1);
+				m_Workers.append(pWorker);
+				pWorker->start();
+			}
 		}
 
-		m_Mutex.lock();
-		if(m_HashingQueue.isEmpty())
+		// if the write buffer is getting full, suspend hashing until it got flushed
+		if(theCore->m_IOManager->IsWriteBufferFull(true))
 		{
-			m_Mutex.unlock();
-			msleep(256);
+			msleep(500);
 			continue;
 		}
 
-		CHashingJobPtr pHashingJob = m_HashingQueue.takeFirst();
-
-		m_HashingOffset = 0;
-		m_LongJob = pHashingJob->IsLongJob();
-		m_HashingID = pHashingJob->GetFileID();
-
-		m_Mutex.unlock();
-		//if(!pHashingJob)
-		//	continue; // this one is gone
+		SActiveJob* pActive = TakeJob(Index);
+		if(!pActive)
+			continue;
 
-		if(CManagedIO* pDevice = theCore->m_IOManager->GetDevice(pHashingJob->GetFileID()))
+		if(CManagedIO* pDevice = theCore->m_IOManager->GetDevice(pActive->pJob->GetFileID()))
 		{
-			pDevice->tell(&m_HashingOffset); // set the position preview pointer
+			pDevice->tell(&pActive->uOffset); // set the position preview pointer
 			
-			pHashingJob->Execute(pDevice);
+			pActive->pJob->Execute(pDevice);
 
 			delete pDevice;
 		}
 		// else // file have been removed
 
-		m_HashingID = 0;
-		if(m_LongJob)
-			m_HashingCount--;
+		FinishJob(pActive);
 	}
 }
 
+CHashingThread::SActiveJob* CHashingThread::TakeJob(int Index)
+{
+	int PoolSize = GetPoolSize();
+	int PerDevice = Max(theCore->Cfg()->GetInt("Content/HashingPerDevice"), 1);
+
+	QMutexLocker Locker(&m_Mutex);
+	if(Index < PoolSize && m_ActiveJobs.size() + m_Helpers < PoolSize)
+	{
+		for(int i=0; i < m_HashingQueue.size(); i++)
+		{
+			const CHashingJobPtr& pHashingJob = m_HashingQueue.at(i);
+			if(m_ActiveJobs.contains(pHashingJob->GetFileID()))
+				continue; // Note: jobs for one file are always processed one after an other
+
+			// Note: an empty device means the file have been removed, such a job will be finished right away
+			QMap<uint64, QString>::iterator I = m_FileDevices.find(pHashingJob->GetFileID());
+			if(I == m_FileDevices.end())
+			{
+				QString Device;
+				if(CManagedIO* pDevice = theCore->m_IOManager->GetDevice(pHashingJob->GetFileID()))
+				{
+					QString FilePath = pDevice->fileName();
+					delete pDevice;
+					Device = CIOQueue::GetDeviceKey(FilePath);
+					if(!m_Rotational.contains(Device))
+						m_Rotational.insert(Device, CIOQueue::IsRotational(FilePath));
+				}
+				I = m_FileDevices.insert(pHashingJob->GetFileID(), Device);
+			}
+			QString Device = I.value();
+			bool bRotational = m_Rotational.value(Device, true);
+			if(!Device.isEmpty() && m_DeviceJobs.value(Device) >= (bRotational ? 1 : PerDevice))
+				continue; // this device is busy
+			m_FileDevices.erase(I);
+
+			SActiveJob* pActive = new SActiveJob;
+			pActive->pJob = m_HashingQueue.takeAt(i);
+			pActive->Device = Device;
+			pActive->bRotational = bRotational;
+			pActive->uOffset = 0;
+			m_ActiveJobs.insert(pActive->pJob->GetFileID(), pActive);
+			m_DeviceJobs[Device]++;
+			return pActive;
+		}
+	}
+
+	m_Wait.wait(&m_Mutex, 500);
+	return NULL;
+}
+
+void CHashingThread::FinishJob(SActiveJob* pActive)
+{
+	QMutexLocker Locker(&m_Mutex);
+	m_ActiveJobs.remove(pActive->pJob->GetFileID());
+	if(--m_DeviceJobs[pActive->Device] <= 0)
+		m_DeviceJobs.remove(pActive->Device);
+	if(pActive->pJob->IsLongJob())
+		m_HashingCount--;
+	delete pActive;
+
+	m_Wait.wakeAll(); // Note: jobs for the same file or device may be waiting
+}
+
+int CHashingThread::AcquireHelpers(uint64 FileID, int Wanted)
+{
+	int PoolSize = GetPoolSize();
+
+	QMutexLocker Locker(&m_Mutex);
+	SActiveJob* pActive = m_ActiveJobs.value(FileID);
+	if(!pActive || pActive->bRotational)
+		return 0; // Note: parallel reads of one file would only thrash a spinning disk
+	int Count = Min(Wanted, PoolSize - m_ActiveJobs.size() - m_Helpers);
+	if(Count <= 0)
+		return 0;
+	m_Helpers += Count;
+	return Count;
+}
+
+void CHashingThread::ReleaseHelpers(int Count)
+{
+	QMutexLocker Locker(&m_Mutex);
+	m_Helpers -= Count;
+	m_Wait.wakeAll();
+}
+
 bool CHashingThread::AddHashingJob(const CHashingJobPtr& pHashingJob)
 {
 	QMutexLocker Locker(&m_Mutex);
@@ -125,21 +239,25 @@ bool CHashingThread::AddHashingJob(const CHashingJobPtr& pHashingJob)
 			break;
 	}
 	m_HashingQueue.insert(i, pHashingJob);
+	m_Wait.wakeOne();
 	return true;
 }
 
 uint64 CHashingThread::GetProgress(CFile* pFile)
 {
-	if(m_LongJob && m_HashingID == pFile->GetFileID())
-		return m_HashingOffset;
+	QMutexLocker Locker(&m_Mutex);
+	SActiveJob* pActive = m_ActiveJobs.value(pFile->GetFileID());
+	if(pActive && pActive->pJob->IsLongJob())
+		return pActive->uOffset;
 	return -1;
 }
 
 bool CHashingThread::IsHashing(uint64 FileID)
 {
-	if(FileID == m_HashingID && m_LongJob)
-		return true;
 	QMutexLocker Locker(&m_Mutex);
+	SActiveJob* pActive = m_ActiveJobs.value(FileID);
+	if(pActive && pActive->pJob->IsLongJob())
+		return true;
 	foreach(const CHashingJobPtr& pHashingJob, m_HashingQueue)
 	{
 		if(pHashingJob->GetFileID() == FileID && pHashingJob->IsLongJob())
@@ -148,24 +266,53 @@ bool CHashingThread::IsHashing(uint64 FileID)
 	return false;
 }
 
+QSqlQuery* CHashingThread::GetQuery(const QString& Statement)
+{
+	QSqlQuery* &pQuery = m_Queries[Statement];
+	if(!pQuery)
+	{
+		pQuery = new QSqlQuery(*m_DataBase);
+		pQuery->prepare(Statement);
+	}
+	else
+		pQuery->finish(); // Note: release the result set of the previous execution but keep the statement prepared
+	return pQuery;
+}
+
+bool CHashingThread::SelectBlob(const QString& Statement, const QByteArray& Hash, QVariantList& Values)
+{
+	QSqlQuery* pQuery = GetQuery(Statement);
+	pQuery->bindValue(":hash", Hash);
+	pQuery->exec();
+#ifdef _DEBUG
+	QString e1 = pQuery->lastError().text();
+#endif
+
+	if(!pQuery->next())
+		return false; // not found in DB
+
+	for(int i=0; i < pQuery->record().count(); i++)
+		Values.append(pQuery->value(i));
+	pQuery->finish();
+	return true;
+}
+
 bool CHashingThread::LoadHash(CFileHash* pHash)
 {
-	QMutexLocker Locker(&m_Mutex);
+	QMutexLocker Locker(&m_DataBaseMutex);
 
+	// Note: a hash that is still waiting to be writen is taken from the pending stores
 	if(CFileHashSet* pHashSet = qobject_cast<CFileHashSet*>(pHash))
 	{
-		QSqlQuery Query1(*m_DataBase);
-		Query1.prepare("SELECT hashset FROM hashsets WHERE hash = :hash");
-		Query1.bindValue(":hash", pHashSet->GetHash());
-		Query1.exec();
-#ifdef _DEBUG
-		QString e1 = Query1.lastError().text();
-#endif
+		QMap<QByteArray, QByteArray>::iterator I = m_PendingSets.find(pHashSet->GetHash());
+		if(I != m_PendingSets.end())
+			return pHashSet->LoadBin(I.value());
 
-		if(!Query1.next())
+		QVariantList Values;
+		if(!SelectBlob("SELECT hashset FROM hashsets WHERE hash = :hash", pHashSet->GetHash(), Values))
 			return false; // not found in DB
 
-		return pHashSet->LoadBin(Query1.value(0).toByteArray());
+		return pHashSet->LoadBin(Values.at(0).toByteArray());
 	}
 	else if(CFileHashTree* pHashTree = qobject_cast<CFileHashTree*>(pHash))
 	{
@@ -173,113 +320,120 @@ bool CHashingThread::LoadHash(CFileHash* pHash)
 		QByteArray RootHash;
 		if(pHashTreeEx)
 		{
-			QSqlQuery Query1(*m_DataBase);
-			Query1.prepare("SELECT roothash, metahash FROM metahashes WHERE hash = :hash");
-			Query1.bindValue(":hash", pHashTreeEx->GetHash());
-			Query1.exec();
-#ifdef _DEBUG
-			QString e1 = Query1.lastError().text();
-#endif
-			if(!Query1.next())
-				return false; // not found in DB
-
-			RootHash = Query1.value(0).toByteArray();
-			pHashTreeEx->SetMetaHash(Query1.value(1).toByteArray());
+			QMap<QByteArray, QPair<QByteArray, QByteArray> >::iterator I = m_PendingMetas.find(pHashTreeEx->GetHash());
+			if(I != m_PendingMetas.end())
+			{
+				RootHash = I.value().first;
+				pHashTreeEx->SetMetaHash(I.value().second);
+			}
+			else
+			{
+				QVariantList Values;
+				if(!SelectBlob("SELECT roothash, metahash FROM metahashes WHERE hash = :hash", pHashTreeEx->GetHash(), Values))
+					return false; // not found in DB
+
+				RootHash = Values.at(0).toByteArray();
+				pHashTreeEx->SetMetaHash(Values.at(1).toByteArray());
+			}
 		}
 
-		QSqlQuery Query1(*m_DataBase);
-		Query1.prepare("SELECT hashtree FROM hashtrees WHERE hash = :hash");
-		Query1.bindValue(":hash", pHashTreeEx ? RootHash : pHashTree->GetHash());
-		Query1.exec();
-#ifdef _DEBUG
-		QString e1 = Query1.lastError().text();
-#endif
+		QByteArray Hash = pHashTreeEx ? RootHash : pHashTree->GetHash();
+		QMap<QByteArray, QByteArray>::iterator I = m_PendingTrees.find(Hash);
+		if(I != m_PendingTrees.end())
+			return pHashTree->LoadBin(I.value());
 
-		if(!Query1.next())
+		QVariantList Values;
+		if(!SelectBlob("SELECT hashtree FROM hashtrees WHERE hash = :hash", Hash, Values))
 			return false; // not found in DB
 
-		return pHashTree->LoadBin(Query1.value(0).toByteArray());
+		return pHashTree->LoadBin(Values.at(0).toByteArray());
 	}
 	return true; // nothing to be loaded
 }
 
 void CHashingThread::SaveHash(CFileHash* pHash)
 {
-	QMutexLocker Locker(&m_Mutex);
+	QMutexLocker Locker(&m_DataBaseMutex);
 
+	// Note: the blobs are serialized right away, the hash object may change or be gone by the time the batch is writen
 	if(CFileHashSet* pHashSet = qobject_cast<CFileHashSet*>(pHash))
-	{
-		QSqlQuery Query1(*m_DataBase);
-		Query1.prepare("SELECT hashset FROM hashsets WHERE hash = :hash");
-		Query1.bindValue(":hash", pHashSet->GetHash());
-		Query1.exec();
-#ifdef _DEBUG
-		QString e1 = Query1.lastError().text();
-#endif
-
-		bool Found = Query1.next();
-
-		QSqlQuery Query2(*m_DataBase);
-		if(Found)
-			Query2.prepare("UPDATE hashsets SET hashset = :hashset WHERE hash = :hash");
-		else
-			Query2.prepare("INSERT INTO hashsets (hash, hashset) VALUES (:hash, :hashset)");
-		Query2.bindValue(":hash", pHashSet->GetHash());
-		Query2.bindValue(":hashset", pHashSet->SaveBin());
-		Query2.exec();
-#ifdef _DEBUG
-		QString e2 = Query2.lastError().text();
-#endif
-	}
+		m_PendingSets.insert(pHashSet->GetHash(), pHashSet->SaveBin());
 	else if(CFileHashTree* pHashTree = qobject_cast<CFileHashTree*>(pHash))
 	{
 		CFileHashTreeEx* pHashTreeEx = qobject_cast<CFileHashTreeEx*>(pHash);
 		if(pHashTreeEx)
-		{
-			QSqlQuery Query1(*m_DataBase);
-			Query1.prepare("SELECT roothash, metahash FROM metahashes WHERE hash = :hash");
-			Query1.bindValue(":hash", pHashTreeEx->GetHash());
-			Query1.exec();
-#ifdef _DEBUG
-			QString e1 = Query1.lastError().text();
-#endif
+			m_PendingMetas.insert(pHashTreeEx->GetHash(), qMakePair(pHashTreeEx->GetRootHash(), pHashTreeEx->GetMetaHash()));
 
-			bool Found = Query1.next();
+		m_PendingTrees.insert(pHashTreeEx ? pHashTreeEx->GetRootHash() : pHashTree->GetHash(), pHashTree->SaveBin());
+	}
+	else
+		return;
 
-			QSqlQuery Query2(*m_DataBase);
-			if(Found)
-				Query2.prepare("UPDATE metahashes SET roothash = :roothash, metahashe = :metahashes WHERE hash = :hash");
-			else
-				Query2.prepare("INSERT INTO metahashes (hash, roothash, metahash) VALUES (:hash, :roothash, :metahash)");
-			Query2.bindValue(":hash", pHashTreeEx->GetHash());
-			Query2.bindValue(":roothash", pHashTreeEx->GetRootHash());
-			Query2.bindValue(":metahash", pHashTreeEx->GetMetaHash());
-			Query2.exec();
-#ifdef _DEBUG
-			QString e2 = Query2.lastError().text();
-#endif
-		}
+	if(m_uPendingSince == 0)
+		m_uPendingSince = GetCurTick();
+	if(m_PendingSets.size() + m_PendingTrees.size() >= BatchSize)
+		m_Wait.wakeAll(); // Note: the hashing thread will write the batch
+}
 
-		QSqlQuery Query1(*m_DataBase);
-		Query1.prepare("SELECT hashtree FROM hashtrees WHERE hash = :hash");
-		Query1.bindValue(":hash", pHashTreeEx ? pHashTreeEx->GetRootHash() : pHashTree->GetHash());
-		Query1.exec();
-#ifdef _DEBUG
-		QString e1 = Query1.lastError().text();
-#endif
+bool CHashingThread::FlushHashes(bool bForce)
+{
+	QMutexLocker Locker(&m_DataBaseMutex);
 
-		bool Found = Query1.next();
+	if(m_PendingSets.isEmpty() && m_PendingTrees.isEmpty() && m_PendingMetas.isEmpty())
+		return true;
+	if(!bForce && m_PendingSets.size() + m_PendingTrees.size() < BatchSize && GetCurTick() - m_uPendingSince < BatchDelay)
+		return true; // wait for more stores to collect
+	if(!bForce && GetCurTick() < m_uRetryAt)
+		return false; // the last attempt failed, dont hammer the database
+
+	// Note: the pending stores are only dropped once the whole batch is committed, on any error the transaction is rolled back and the batch retried later
+	QString Error;
+	if(!m_DataBase->transaction())
+		Error = m_DataBase->lastError().text();
+
+	QSqlQuery* pSetQuery = GetQuery("INSERT OR REPLACE INTO hashsets (hash, hashset) VALUES (:hash, :hashset)");
+	for(QMap<QByteArray, QByteArray>::iterator I = m_PendingSets.begin(); Error.isEmpty() && I != m_PendingSets.end(); I++)
+	{
+		pSetQuery->bindValue(":hash", I.key());
+		pSetQuery->bindValue(":hashset", I.value());
+		if(!pSetQuery->exec())
+			Error = pSetQuery->lastError().text();
+	}
 
-		QSqlQuery Query2(*m_DataBase);
-		if(Found)
-			Query2.prepare("UPDATE hashtrees SET hashtree = :hashtree WHERE hash = :hash");
-		else
-			Query2.prepare("INSERT INTO hashtrees (hash, hashtree) VALUES (:hash, :hashtree)");
-		Query2.bindValue(":hash", pHashTreeEx ? pHashTreeEx->GetRootHash() : pHashTree->GetHash());
-		Query2.bindValue(":hashtree", pHashTree->SaveBin());
-		Query2.exec();
-#ifdef _DEBUG
-		QString e2 = Query2.lastError().text();
-#endif
+	QSqlQuery* pMetaQuery = GetQuery("INSERT OR REPLACE INTO metahashes (hash, roothash, metahash) VALUES (:hash, :roothash, :metahash)");
+	for(QMap<QByteArray, QPair<QByteArray, QByteArray> >::iterator I = m_PendingMetas.begin(); Error.isEmpty() && I != m_PendingMetas.end(); I++)
+	{
+		pMetaQuery->bindValue(":hash", I.key());
+		pMetaQuery->bindValue(":roothash", I.value().first);
+		pMetaQuery->bindValue(":metahash", I.value().second);
+		if(!pMetaQuery->exec())
+			Error = pMetaQuery->lastError().text();
+	}
+
+	QSqlQuery* pTreeQuery = GetQuery("INSERT OR REPLACE INTO hashtrees (hash, hashtree) VALUES (:hash, :hashtree)");
+	for(QMap<QByteArray, QByteArray>::iterator I = m_PendingTrees.begin(); Error.isEmpty() && I != m_PendingTrees.end(); I++)
+	{
+		pTreeQuery->bindValue(":hash", I.key());
+		pTreeQuery->bindValue(":hashtree", I.value());
+		if(!pTreeQuery->exec())
+			Error = pTreeQuery->lastError().text();
+	}
+
+	if(Error.isEmpty() && !m_DataBase->commit())
+		Error = m_DataBase->lastError().text();
+
+	if(!Error.isEmpty())
+	{
+		m_DataBase->rollback();
+		m_uRetryAt = GetCurTick() + RetryDelay;
+		LogLine(LOG_ERROR, tr("Failed to store %1 hashes in the database, retrying later: %2").arg(m_PendingSets.size() + m_PendingTrees.size()).arg(Error));
+		return false;
 	}
-}
\ No newline at end of file
+
+	m_PendingSets.clear();
+	m_PendingMetas.clear();
+	m_PendingTrees.clear();
+	m_uPendingSince = 0;
+	m_uRetryAt = 0;
+	return true;
+}
@@ -4,12 +4,18 @@
 #include "../PartMap.h"
 #include "FileHash.h"
 class QSqlDatabase;
+class QSqlQuery;
 class CFile;
 class CHashingJob;
+class CHashingWorker;
 
 typedef QSharedPointer<CHashingJob> CHashingJobPtr;
 //typedef QWeakPointer<CHashingJob> CHashingJobRef;
 
+///////////////////////////////////////////////////////////////////////////////////////////////
+// The hashing thread runs a pool of workers, jobs of different files run in parallel,
+// the amount of concurrent jobs per physical device is limited so that spinning disks are not thrashed
+
 class CHashingThread: public QThreadEx
 {
 	Q_OBJECT
@@ -30,16 +36,74 @@ public:
 
 	bool						LoadHash(CFileHash* pHash);
 	void						SaveHash(CFileHash* pHash);
+	bool						FlushHashes(bool bForce = true);
+
+	// Note: a job can borrow idle pool capacity to hash a large file in parallel
+	int							AcquireHelpers(uint64 FileID, int Wanted);
+	void						ReleaseHelpers(int Count);
 
 protected:
+	friend class CHashingWorker;
+
+	struct SActiveJob
+	{
+		CHashingJobPtr			pJob;
+		QString					Device;
+		bool					bRotational;
+		volatile uint64			uOffset;
+	};
+
+	void						ProcessJobs(int Index);
+	SActiveJob*					TakeJob(int Index);
+	void						FinishJob(SActiveJob* pActive);
+	int							GetPoolSize();
+
 	QMutex						m_Mutex;
+	QWaitCondition				m_Wait;
 	QList<CHashingJobPtr>		m_HashingQueue;
+	QMap<uint64, SActiveJob*>	m_ActiveJobs;	// by file ID
+	QMap<QString, int>			m_DeviceJobs;	// active jobs per device
+	QMap<uint64, QString>		m_FileDevices;	// device of queued files
+	QMap<QString, bool>			m_Rotational;
+	int							m_Helpers;		// pool capacity lend to jobs
+
+	QList<CHashingWorker*>		m_Workers;
+
+	QSqlQuery*					GetQuery(const QString& Statement);
+	bool						SelectBlob(const QString& Statement, const QByteArray& Hash, QVariantList& Values);
+
+	QMutex						m_DataBaseMutex;
 	QSqlDatabase*				m_DataBase;
+	QMap<QString, QSqlQuery*>	m_Queries;		// prepared statements by SQL text
+
+	// Note: stores are collected here and writen by the hashing thread in one transaction
+	static const int			BatchSize = 256;
+	static const int			BatchDelay = 1000;	// ms
+	static const int			RetryDelay = 10000;	// ms
+	QMap<QByteArray, QByteArray> m_PendingSets;
+	QMap<QByteArray, QByteArray> m_PendingTrees;
+	QMap<QByteArray, QPair<QByteArray, QByteArray> > m_PendingMetas;
+	uint64						m_uPendingSince;
+	uint64						m_uRetryAt;		// a failed batch is retried not befoure this tick
 
 	volatile int				m_HashingCount;
-	volatile uint64				m_HashingID;
-	volatile uint64				m_HashingOffset;
-	volatile bool				m_LongJob;
 
 	volatile bool				m_Stop;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+class CHashingWorker: public QThreadEx
+{
+	Q_OBJECT
+
+public:
+	CHashingWorker(CHashingThread* pPool, int Index, QObject* qObject = NULL) : QThreadEx(qObject) {m_pPool = pPool; m_Index = Index;}
+
+	void						run()			{m_pPool->ProcessJobs(m_Index);}
+
+protected:
+	CHashingThread*				m_pPool;
+	int							m_Index;
 };
\ No newline at end of file
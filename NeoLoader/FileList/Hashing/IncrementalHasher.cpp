@@ -0,0 +1,190 @@
+#include "GlobalHeader.h"
+#include "IncrementalHasher.h"
+#include "../PartMap.h"
+
+CIncrementalHasher::CIncrementalHasher()
+{
+	m_uVerified = 0;
+	m_uMismatched = 0;
+}
+
+CIncrementalHasher::~CIncrementalHasher()
+{
+	Clear();
+}
+
+void CIncrementalHasher::AddData(const QList<CFileHashPtr>& Hashes, uint64 uOffset, const QByteArray& Data)
+{
+	// drop the states of hashes that are no longer in use
+	for(QMap<CFileHash*, SHashState*>::iterator I = m_States.begin(); I != m_States.end(); )
+	{
+		if(!Hashes.contains(I.value()->pHash))
+		{
+			delete I.value();
+			I = m_States.erase(I);
+		}
+		else
+			I++;
+	}
+
+	foreach(const CFileHashPtr& pHash, Hashes)
+	{
+		if(!qobject_cast<CFileHashEx*>(pHash.data()))
+			continue; // this hash has no parts to verify
+
+		SHashState* &pState = m_States[pHash.data()];
+		if(!pState)
+		{
+			pState = new SHashState;
+			pState->pHash = pHash;
+		}
+		AddData(pState, uOffset, (const byte*)Data.data(), Data.size());
+	}
+}
+
+void CIncrementalHasher::AddData(SHashState* pState, uint64 uOffset, const byte* pData, uint64 uLength)
+{
+	CFileHashEx* pHashEx = qobject_cast<CFileHashEx*>(pState->pHash.data());
+	while(uLength > 0)
+	{
+		SSegment* pSegment = FindSegment(pState, uOffset);
+		if(pSegment && pSegment->uNext != uOffset)
+		{
+			// Note: we missed some data or got some twice, this segment can not be completed in memory anymore
+			pState->Segments.remove(pSegment->uBegin);
+			delete pSegment;
+			pSegment = NULL;
+		}
+
+		uint64 uToGo;
+		if(!pSegment)
+		{
+			TPair64 Range = pHashEx->GetSegment(uOffset);
+			if(Range.first >= Range.second)
+				break; // we dont have a hash for this range
+
+			// Note: data that does not start a segment is left to the regular verification
+			if(uOffset == Range.first && !pHashEx->GetResult(Range.first, Range.second))
+				pSegment = StartSegment(pState, Range);
+			uToGo = Min(uLength, Range.second - uOffset);
+		}
+		else
+			uToGo = Min(uLength, pSegment->uEnd - uOffset);
+
+		if(pSegment)
+		{
+			pSegment->Function.Add(pData, uToGo);
+			pSegment->uNext += uToGo;
+			pSegment->uLastUse = GetCurTick();
+			if(pSegment->uNext >= pSegment->uEnd)
+				FinishSegment(pState, pSegment);
+		}
+
+		pData += uToGo;
+		uOffset += uToGo;
+		uLength -= uToGo;
+	}
+}
+
+CIncrementalHasher::SSegment* CIncrementalHasher::FindSegment(SHashState* pState, uint64 uOffset)
+{
+	QMap<uint64, SSegment*>::iterator I = pState->Segments.upperBound(uOffset);
+	if(I == pState->Segments.begin())
+		return NULL;
+	I--;
+	SSegment* pSegment = I.value();
+	return uOffset < pSegment->uEnd ? pSegment : NULL;
+}
+
+CIncrementalHasher::SSegment* CIncrementalHasher::StartSegment(SHashState* pState, const TPair64& Range)
+{
+	if(pState->Segments.size() >= MaxSegments)
+	{
+		// drop the segment that did not get any data for the longest time
+		SSegment* pOldest = NULL;
+		foreach(SSegment* pSegment, pState->Segments)
+		{
+			if(!pOldest || pSegment->uLastUse < pOldest->uLastUse)
+				pOldest = pSegment;
+		}
+		pState->Segments.remove(pOldest->uBegin);
+		delete pOldest;
+	}
+
+	SSegment* pSegment = new SSegment(pState->pHash->GetAlgorithm());
+	ASSERT(pSegment->Function.IsValid());
+	pSegment->uBegin = Range.first;
+	pSegment->uEnd = Range.second;
+	pSegment->uNext = Range.first;
+	pSegment->uLastUse = GetCurTick();
+	pState->pHash->BeginSegment(pSegment->Function);
+	pState->Segments.insert(pSegment->uBegin, pSegment);
+	return pSegment;
+}
+
+void CIncrementalHasher::FinishSegment(SHashState* pState, SSegment* pSegment)
+{
+	CFileHashEx* pHashEx = qobject_cast<CFileHashEx*>(pState->pHash.data());
+
+	pSegment->Function.Finish();
+	if(pHashEx->VerifySegment(pSegment->uBegin, pSegment->uEnd, pSegment->Function.ToByteArray()))
+		pState->Verified.insert(pSegment->uBegin, pSegment->uEnd); // Note: the result is set in Written, once the data is on disk
+	else // Note: we dont set a negative result, the regular verification will check the range from disk and handle the corruption
+		m_uMismatched += pSegment->uEnd - pSegment->uBegin;
+
+	pState->Segments.remove(pSegment->uBegin);
+	delete pSegment;
+}
+
+void CIncrementalHasher::Written(uint64 uBegin, uint64 uEnd, CPartMap* pParts)
+{
+	foreach(SHashState* pState, m_States)
+	{
+		CFileHashEx* pHashEx = qobject_cast<CFileHashEx*>(pState->pHash.data());
+		for(QMap<uint64, uint64>::iterator I = pState->Verified.begin(); I != pState->Verified.end() && I.key() < uEnd; )
+		{
+			// the segment is on disk when all of it is available, the bytes still in the write queue are only cached
+			if(I.value() > uBegin && (pParts->GetRange(I.key(), I.value()) & Part::Available) != 0)
+			{
+				pHashEx->SetResult(true, I.key(), I.value());
+				m_uVerified += I.value() - I.key();
+				I = pState->Verified.erase(I);
+			}
+			else
+				I++;
+		}
+	}
+}
+
+void CIncrementalHasher::Reset(uint64 uBegin, uint64 uEnd)
+{
+	foreach(SHashState* pState, m_States)
+	{
+		for(QMap<uint64, uint64>::iterator I = pState->Verified.begin(); I != pState->Verified.end() && I.key() < uEnd; )
+		{
+			if(I.value() > uBegin)
+				I = pState->Verified.erase(I);
+			else
+				I++;
+		}
+
+		for(QMap<uint64, SSegment*>::iterator I = pState->Segments.begin(); I != pState->Segments.end(); )
+		{
+			SSegment* pSegment = I.value();
+			if(pSegment->uBegin < uEnd && pSegment->uEnd > uBegin)
+			{
+				delete pSegment;
+				I = pState->Segments.erase(I);
+			}
+			else
+				I++;
+		}
+	}
+}
+
+void CIncrementalHasher::Clear()
+{
+	foreach(SHashState* pState, m_States)
+		delete pState;
+	m_States.clear();
+}
@@ -0,0 +1,61 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+#include "FileHash.h"
+
+class CPartMap;
+#include "../../../Framework/Cryptography/HashFunction.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Hashes downloaded data in memory as it arrives, a part or leaf that is received in order
+// is verified right away and does not have to be read back from disk later.
+// Segments that receive data out of order are dropped and left to the regular verification.
+// Note: a matching segment only gets its result once all its data is on disk, if a write fails the verdict is dropped.
+
+class CIncrementalHasher
+{
+public:
+	CIncrementalHasher();
+	~CIncrementalHasher();
+
+	static const int		MaxSegments = 64;	// open segments per hash
+
+	void					AddData(const QList<CFileHashPtr>& Hashes, uint64 uOffset, const QByteArray& Data);
+	void					Written(uint64 uBegin, uint64 uEnd, CPartMap* pParts);
+	void					Reset(uint64 uBegin, uint64 uEnd);
+	void					Clear();
+
+	uint64					GetVerified() const				{return m_uVerified;}
+	uint64					GetMismatched() const			{return m_uMismatched;}
+
+protected:
+	struct SSegment
+	{
+		SSegment(UINT Algorithm) : Function(Algorithm) {}
+
+		uint64				uBegin;
+		uint64				uEnd;
+		uint64				uNext;		// offset of the next byte we need
+		uint64				uLastUse;
+		CHashFunction		Function;
+	};
+
+	struct SHashState
+	{
+		~SHashState()		{foreach(SSegment* pSegment, Segments) delete pSegment;}
+
+		CFileHashPtr		pHash;
+		QMap<uint64, SSegment*> Segments;	// by segment begin
+		QMap<uint64, uint64> Verified;		// matching segments waiting for their data to be written, begin -> end
+	};
+
+	void					AddData(SHashState* pState, uint64 uOffset, const byte* pData, uint64 uLength);
+	SSegment*				FindSegment(SHashState* pState, uint64 uOffset);
+	SSegment*				StartSegment(SHashState* pState, const TPair64& Range);
+	void					FinishSegment(SHashState* pState, SSegment* pSegment);
+
+	QMap<CFileHash*, SHashState*> m_States;
+
+	uint64					m_uVerified;
+	uint64					m_uMismatched;
+};
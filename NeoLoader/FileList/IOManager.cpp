@@ -1,7 +1,15 @@
 #include "GlobalHeader.h"
 #include "IOManager.h"
+#include "IOQueue.h"
+#include "BlockCache.h"
 #include "../../Framework/OtherFunctions.h"
 #include "../NeoCore.h"
+#if defined(Q_OS_LINUX) || defined(Q_OS_MAC)
+#include <fcntl.h>
+#endif
+#ifndef WIN32
+#include <sys/mman.h>
+#endif
 
 int _uint64_type = qRegisterMetaType<uint64>("uint64");
 
@@ -13,13 +21,21 @@ CAbstractIO::CAbstractIO(const QString& Name)
 	m_FileName = Name;
 	m_FileSize = 0;
 
+	m_FileID = 0;
+
 	m_LastUse = 0;
+
+	m_DirtySince = 0;
+
+	m_pQueue = NULL;
 }
 
 CAbstractIO::~CAbstractIO() 
 {
 	foreach(CIOOperation* pOperation, m_Operations)
 		delete pOperation;
+	foreach(CWriteOperation* pOperation, m_Dirty)
+		delete pOperation;
 }
 
 void CAbstractIO::QueueOp(CIOOperation* pOperation)
@@ -28,8 +44,21 @@ void CAbstractIO::QueueOp(CIOOperation* pOperation)
 	m_Operations.insert(pOperation->GetOffset(), pOperation);
 }
 
+CIOOperation* CAbstractIO::TakeOp()
+{
+	QMutexLocker Locker(&m_QueueMutex);
+	if(m_Operations.isEmpty())
+		return NULL;
+	QMultiMap<uint64, CIOOperation*>::iterator I = m_Operations.begin();
+	CIOOperation* pOperation = I.value();
+	m_Operations.erase(I);
+	return pOperation;
+}
+
 void CAbstractIO::Execute()
 {
+	FlushWrites(true); // Note: cached writes are older than anythign in the queue
+
 	QMutexLocker Locker(&m_QueueMutex);
 	while(!m_Operations.isEmpty())
 	{
@@ -46,6 +75,159 @@ void CAbstractIO::Execute()
 	}
 }
 
+void CAbstractIO::CacheWrite(CWriteOperation* pOperation)
+{
+	QMutexLocker Locker(&m_QueueMutex);
+	if(m_Dirty.isEmpty())
+		m_DirtySince = GetCurTick();
+	m_Dirty.insert(pOperation->GetOffset(), pOperation);
+}
+
+void CAbstractIO::RequestFlush(uint64 uBegin, uint64 uEnd)
+{
+	QMutexLocker Locker(&m_QueueMutex);
+	m_Complete.append(qMakePair(uBegin, uEnd));
+}
+
+SFlushStats CAbstractIO::FlushWrites(bool bForce, uint64 uBlockSize, uint64 uDelay, uint64 uBegin, uint64 uEnd)
+{
+	SFlushStats Stats;
+
+	QMutexLocker Locker(&m_QueueMutex);
+
+	QList<QPair<uint64, uint64> > Complete;
+	// Note: a completed range is kept until no queued write overlaps it anymore, 
+	//			as the last writes of a part may still wait in the queue when the flush is requested
+	for(int i=0; i < m_Complete.size(); )
+	{
+		bool bPending = false;
+		for(QMultiMap<uint64, CIOOperation*>::iterator I = m_Operations.begin(); I != m_Operations.end() && I.key() < m_Complete[i].second; I++)
+		{
+			if(I.value()->IsWrite() && I.key() + I.value()->GetLength() > m_Complete[i].first)
+			{
+				bPending = true;
+				break;
+			}
+		}
+		if(bPending)
+		{
+			i++;
+			continue;
+		}
+
+		Complete.append(m_Complete.takeAt(i));
+	}
+
+	if(m_Dirty.isEmpty())
+		return Stats;
+
+	uint64 uNow = GetCurTick();
+	if(uNow - m_DirtySince >= uDelay)
+		bForce = true;
+
+	QMultiMap<uint64, CWriteOperation*>::iterator I = m_Dirty.begin();
+	while(I != m_Dirty.end())
+	{
+		// collect a run of adjacent writes
+		uint64 uRunBegin = I.key();
+		uint64 uRunEnd = uRunBegin;
+		QMultiMap<uint64, CWriteOperation*>::iterator J = I;
+		for(; J != m_Dirty.end() && J.key() == uRunEnd; J++)
+			uRunEnd += J.value()->GetLength();
+
+		bool bComplete = false;
+		for(int i=0; i < Complete.size() && !bComplete; i++)
+			bComplete = uRunBegin < Complete[i].second && uRunEnd > Complete[i].first;
+
+		bool bDue = bForce || uRunEnd - uRunBegin >= uBlockSize || (uRunBegin < uEnd && uRunEnd > uBegin);
+		if(!bDue && !bComplete)
+		{
+			I = J;
+			continue;
+		}
+
+		QList<CWriteOperation*> Run;
+		while(I != J)
+		{
+			Run.append(I.value());
+			I = m_Dirty.erase(I);
+		}
+
+		Locker.unlock();
+
+		QByteArray Buffer;
+		if(Run.size() == 1)
+			Buffer = Run.first()->GetData();
+		else
+		{
+			Buffer.reserve(uRunEnd - uRunBegin);
+			foreach(CWriteOperation* pOperation, Run)
+				Buffer.append(pOperation->GetData());
+		}
+
+		qint64 Writen = Write(uRunBegin, Buffer.data(), Buffer.size());
+		foreach(CWriteOperation* pOperation, Run)
+		{
+			pOperation->Finish(Writen == Buffer.size());
+			pOperation->deleteLater();
+		}
+
+		Stats.Operations += Run.size();
+		Stats.Calls++;
+		Stats.Bytes += Buffer.size();
+		if(!bDue)
+			Stats.Completed++;
+
+		Locker.relock();
+		I = m_Dirty.lowerBound(uRunEnd); // Note: the map may have changed while we ware writing
+	}
+
+	if(m_Dirty.isEmpty())
+		m_DirtySince = 0;
+	else if(bForce)
+		m_DirtySince = uNow;
+	return Stats;
+}
+
+bool CAbstractIO::HasDirty(uint64 uBegin, uint64 uEnd)
+{
+	QMutexLocker Locker(&m_QueueMutex);
+	for(QMultiMap<uint64, CWriteOperation*>::iterator I = m_Dirty.begin(); I != m_Dirty.end() && I.key() < uEnd; I++)
+	{
+		if(I.key() + I.value()->GetLength() > uBegin)
+			return true;
+	}
+	return false;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+void CReadOperation::Execute(CAbstractIO* File)
+{
+	// Note: mapped files are served directly from the page cache, the data is copyed once 
+	//			as the result is passed on with a queued signal and may outlive the mapping
+	SMappedSlice Slice = File->Map(m_Offset, m_Length);
+	if(Slice.pData)
+	{
+		emit DataRead(m_Offset, m_Length, QByteArray(Slice.pData, Slice.uSize), Slice.uSize == m_Length, m_Aux);
+		return;
+	}
+
+	// Note: only read only files are cached, so we never have to care about stale blocks
+	CBlockCache* pCache = m_Manager->m_BlockCache;
+	bool bCached = File->IsReadOnly() && pCache->IsEnabled();
+
+	QByteArray Data;
+	Data.resize(m_Length);
+	uint64 Length = bCached ? pCache->Read(File, m_Offset, Data.data(), Data.size()) : File->Read(m_Offset, Data.data(), Data.size());
+	bool bOk = Data.size() == Length;
+	if(Length == -1)
+		Length = 0;
+	Data.truncate(Length);
+	emit DataRead(m_Offset, m_Length, Data, bOk, m_Aux);
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////
 //
 
@@ -59,6 +241,10 @@ CIOManager::CIOManager(QObject* qObject)
 
 	m_PendingAllocation = 0;
 
+	m_BlockCache = new CBlockCache();
+	m_BlockCache->SetBudget(theCore->Cfg()->GetUInt64("Content/ReadCacheSize"));
+	m_BlockCache->SetReadAhead(theCore->Cfg()->GetUInt64("Content/ReadAhead"));
+
 	start();
 }
 
@@ -66,20 +252,35 @@ CIOManager::~CIOManager()
 {
 	Stop();
 
+	foreach(CIOQueue* pQueue, m_Queues)
+		delete pQueue;
+	m_Queues.clear();
+
 	foreach(CFileAllocator* pAllocator, m_PendingAllocations)
 		delete pAllocator;
 	m_PendingAllocations.clear();
+
+	delete m_BlockCache;
 }
 
 void CIOManager::Stop()
 {
+	m_WaitMutex.lock();
 	m_Stop = true;
+	m_Wait.wakeAll();
+	m_WaitMutex.unlock();
 	wait();
+
+	QMutexLocker Locker(&m_QueuesMutex);
+	foreach(CIOQueue* pQueue, m_Queues)
+		pQueue->Stop();
 }
 
 void CIOManager::run()
 {
-	int Counter = 0;
+	// Note: read and write operations are handled by the per device workers, 
+	//			this thread only does the allocation and the housekeeping
+	uint64 uLastProcess = 0;
 
 	while(!m_Stop)
 	{
@@ -108,42 +309,37 @@ void CIOManager::run()
 		m_AllocationsMutex.unlock();
 		// allocation END
 
-		if((Counter % 50) == 0) // twice a second
+		uint64 uNow = GetCurTick();
+		if(uNow - uLastProcess >= 500) // twice a second
 		{
-			QMutexLocker Locker(&m_FilesMutex);
+			uLastProcess = uNow;
+
+			uint64 uDelay = theCore->Cfg()->GetInt("Content/WriteBackDelay");
 
-			QMutexLocker ActiveLocker(&m_ActiveMutex);
+			m_BlockCache->SetBudget(theCore->Cfg()->GetUInt64("Content/ReadCacheSize"));
+			m_BlockCache->SetReadAhead(theCore->Cfg()->GetUInt64("Content/ReadAhead"));
+			CMappedIO::SetLimits(theCore->Cfg()->GetUInt64("Content/MapWindow"), theCore->Cfg()->GetUInt64("Content/MapLimit"));
+			CFileIO::SetHandleLimits(theCore->Cfg()->GetInt("Content/FileHandles"), SEC2MS(theCore->Cfg()->GetInt("Content/HandleTimeout")));
 
-			uint64 uNow = GetCurTick();
+			QMutexLocker Locker(&m_FilesMutex);
 			for(QMap<uint64, CIOPtr>::iterator I = m_Files.begin(); I != m_Files.end(); I++)
 			{
 				CIOPtr& pFile = *I;
 				pFile->Process();
 
-				bool bActive = m_ActiveFiles.contains(pFile);
-				if(pFile->GetQueueSize() > 0)
-				{
-					if(!bActive)
-						m_ActiveFiles.insert(pFile);
-				}
-				else if(bActive)
+				// wake the device worker for cached writes that are overdue
+				uint64 uSince = pFile->GetDirtySince();
+				if(uSince && uNow - uSince >= uDelay)
 				{
-					if(uNow - pFile->GetLastUse() > SEC2MS(5))
-						m_ActiveFiles.remove(pFile);
+					if(CIOQueue* pQueue = pFile->GetIOQueue())
+						pQueue->Schedule(pFile);
 				}
 			}
 		}
-		
-
-		m_ActiveMutex.lock();
-		for(QSet<CIOPtr>::iterator I = m_ActiveFiles.begin(); I != m_ActiveFiles.end(); I++)
-			(*I)->Execute();
-		m_ActiveMutex.unlock();
 
-		if(++Counter >= 100) // every second
-			Counter = 0;
-
-		msleep(10);
+		QMutexLocker Locker(&m_WaitMutex);
+		if(!m_Stop && !IsAllocationPending())
+			m_Wait.wait(&m_WaitMutex, 500);
 	}
 }
 
@@ -158,11 +354,41 @@ bool CIOManager::QueueOp(uint64 FileID, CIOOperation* pOperation)
 	if(CIOPtr File = GetFile(FileID))
 	{
 		File->QueueOp(pOperation);
+		if(CIOQueue* pQueue = File->GetIOQueue())
+			pQueue->Schedule(File);
 		return true;
 	}
 	return false;
 }
 
+CIOQueue* CIOManager::GetQueue(const QString& FilePath)
+{
+	QString Device = CIOQueue::GetDeviceKey(FilePath);
+
+	QMutexLocker Locker(&m_QueuesMutex);
+	CIOQueue* &pQueue = m_Queues[Device];
+	if(!pQueue)
+		pQueue = new CIOQueue(Device, theCore->Cfg()->GetInt("Content/IOThreads"));
+	return pQueue;
+}
+
+QVariantMap CIOManager::GetCacheStats() const
+{
+	QVariantMap Stats = m_BlockCache->GetStats();
+	Stats["Mapped"] = CMappedIO::GetStats();
+	Stats["Handles"] = CFileIO::GetHandleStats();
+	return Stats;
+}
+
+QVariantList CIOManager::GetDeviceStats() const
+{
+	QMutexLocker Locker(&m_QueuesMutex);
+	QVariantList DeviceStats;
+	foreach(CIOQueue* pQueue, m_Queues)
+		DeviceStats.append(pQueue->GetStats());
+	return DeviceStats;
+}
+
 void CIOManager::ReadData(QObject* Reciver, uint64 FileID, uint64 Offset, uint64 Length, void* Aux)
 {
 	CIOOperation* pOperation = new CReadOperation(this, Offset, Length, Aux);
@@ -177,22 +403,48 @@ void CIOManager::WriteData(QObject* Reciver, uint64 FileID, uint64 Offset, const
 	QueueOp(FileID, pOperation);
 }
 
+void CIOManager::FlushData(uint64 FileID, uint64 uBegin, uint64 uEnd)
+{
+	if(CIOPtr File = GetFile(FileID))
+	{
+		File->RequestFlush(uBegin, uEnd);
+		if(CIOQueue* pQueue = File->GetIOQueue())
+			pQueue->Schedule(File);
+	}
+}
+
 void CIOManager::InstallIO(uint64 FileID, const QString& FilePath, const QList<SMultiIO>* pSubFiles)
 {
 	int Pos = FilePath.lastIndexOf("/");
 	ASSERT(Pos != -1);
 	CreateDir(FilePath.left(Pos+1));
 
+	CIOQueue* pQueue = GetQueue(FilePath);
+
 	QMutexLocker Locker(&m_FilesMutex);
 	ASSERT(!m_Files.contains(FileID));
-	CIOPtr File = CIOPtr(pSubFiles ? (CAbstractIO*)new CMultiFileIO(FilePath, pSubFiles, this) : (CAbstractIO*)new CFileIO(FilePath));
+	CIOPtr File;
+	if(pSubFiles)
+		File = CIOPtr(new CMultiFileIO(FilePath, pSubFiles, this));
+	else if(theCore->Cfg()->GetBool("Content/MemoryMapping"))
+		File = CIOPtr(new CMappedIO(FilePath));
+	else
+		File = CIOPtr(new CFileIO(FilePath));
+	File->SetFileID(FileID);
+	File->SetIOQueue(pQueue);
 	m_Files.insert(FileID, File);
 }
 
 void CIOManager::ProtectIO(uint64 FileID, bool bSetReadOnly)
 {
 	if(CIOPtr File = GetFile(FileID))
+	{
+		if(bSetReadOnly)
+			File->FlushWrites(true);
+		else
+			m_BlockCache->Purge(FileID); // Note: we only cache read only files
 		return File->SetReadOnly(bSetReadOnly);
+	}
 }
 
 bool CIOManager::MoveIO(uint64 FileID, const QString& FilePath)
@@ -202,7 +454,23 @@ bool CIOManager::MoveIO(uint64 FileID, const QString& FilePath)
 	CreateDir(FilePath.left(Pos+1));
 
 	CIOPtr File = GetFile(FileID);
-	return File->Rename(FilePath);
+	File->FlushWrites(true);
+	m_BlockCache->Purge(FileID);
+	if(!File->Rename(FilePath))
+		return false;
+
+	CIOQueue* pQueue = GetQueue(FilePath);
+	CIOQueue* pOldQueue = File->GetIOQueue();
+	if(pQueue != pOldQueue)
+	{
+		// Note: the file moved to an other device, pending operations must follow it
+		File->SetIOQueue(pQueue);
+		if(pOldQueue)
+			pOldQueue->Remove(File);
+		if(File->GetQueueSize() > 0)
+			pQueue->Schedule(File);
+	}
+	return true;
 }
 
 CIOPtr CIOManager::TakeFile(uint64 FileID)
@@ -214,9 +482,13 @@ CIOPtr CIOManager::TakeFile(uint64 FileID)
 	m_AllocationsMutex.unlock();
 	m_FilesMutex.unlock();
 
-	m_ActiveMutex.lock();
-	m_ActiveFiles.remove(File);
-	m_ActiveMutex.unlock();
+	if(File)
+	{
+		if(CIOQueue* pQueue = File->GetIOQueue())
+			pQueue->Remove(File);
+	}
+
+	m_BlockCache->Purge(FileID);
 
 	return File;
 }
@@ -252,10 +524,20 @@ void CIOManager::Allocate(uint64 FileID, uint64 FileSize, QObject* Reciver)
 	QMutexLocker Locker(&m_AllocationsMutex);
 	if(m_PendingAllocations.contains(FileID))
 		return;
-	CFileAllocator* pAllocator = new CFileAllocator(this, FileSize);
+	CFileAllocator* pAllocator = new CFileAllocator(this, FileSize, CFileAllocator::Str2Mode(theCore->Cfg()->GetString("Content/AllocationMode")));
 	if(Reciver)
 		connect(pAllocator, SIGNAL(Allocation(uint64, bool)), Reciver, SLOT(OnAllocation(uint64, bool)));
 	m_PendingAllocations.insert(FileID, pAllocator);
+	Locker.unlock();
+
+	QMutexLocker WaitLocker(&m_WaitMutex);
+	m_Wait.wakeAll();
+}
+
+bool CIOManager::IsAllocationPending()
+{
+	QMutexLocker Locker(&m_AllocationsMutex);
+	return !m_PendingAllocations.isEmpty();
 }
 
 bool CIOManager::IsAllocating(uint64 FileID)
@@ -307,6 +589,20 @@ qint64 CIOManager::writeData(uint64 FileID, uint64 Offset, const char *data, qin
 	return -1;
 }
 
+SMappedSlice CIOManager::mapData(uint64 FileID, uint64 Offset, qint64 len)
+{
+	if(CIOPtr File = GetFile(FileID))
+		return File->Map(Offset, len);
+	return SMappedSlice();
+}
+
+bool CIOManager::allocate(uint64 FileID, uint64 uSize, bool bSparse)
+{
+	if(CIOPtr File = GetFile(FileID))
+		return File->Allocate(uSize, bSparse);
+	return false;
+}
+
 void CIOManager::close(uint64 FileID)
 {
 	if(CIOPtr File = GetFile(FileID))
@@ -316,17 +612,16 @@ void CIOManager::close(uint64 FileID)
 ///////////////////////////////////////////////////////////////////////////////////////////////
 // Multi File
 
-QMutex CFileIO::m_GlobalMutex;
-QList<CFileIO*> CFileIO::m_GlobalList;
+CHandleCache CFileIO::m_HandleCache;
+volatile uint64 CFileIO::m_uIdleTimeout = SEC2MS(300);
 
 CFileIO::CFileIO(const QString& Name)
- : CAbstractIO(Name)
+ : CAbstractIO(Name), m_ReadHandle(&m_FileMutex), m_WriteHandle(&m_FileMutex)
 {
-	m_pFile = NULL;
 	if(!QFile::exists(m_FileName))
 	{
 		QMutexLocker Locker(&m_FileMutex);
-		Open(QFile::ReadWrite | QFile::Unbuffered);
+		GetHandle(true);
 	}
 
 	m_FileSize = QFileInfo(Name).size();
@@ -338,12 +633,30 @@ CFileIO::~CFileIO()
 	Close();
 }
 
+void CFileIO::SetHandleLimits(int Limit, uint64 uIdleTimeout)
+{
+	m_HandleCache.SetLimit(Limit);
+	m_uIdleTimeout = uIdleTimeout;
+}
+
 void CFileIO::Process()
 {
-	if(m_pFile && GetCurTick() - m_LastUse > SEC2MS(5)) // C-ToDo: customize
+	// Note: handle pressure is dealt with by the handle cache, here we only release handles of files nobody uses anymore
+	if(m_uIdleTimeout && GetCurTick() - m_LastUse > m_uIdleTimeout)
 		Close();
 }
 
+void CFileIO::SetReadOnly(bool bReadOnly)
+{
+	if(bReadOnly)
+	{
+		QMutexLocker Locker(&m_FileMutex);
+		m_HandleCache.Close(&m_WriteHandle); // Note: reads will reopen the file read only
+	}
+
+	CAbstractIO::SetReadOnly(bReadOnly);
+}
+
 bool CFileIO::Rename(const QString & Name)
 {
 	Close();
@@ -367,14 +680,12 @@ qint64 CFileIO::Read(qint64 offset, char* data, qint64 maxSize)
 {
 	m_LastUse = GetCurTick();
 	QMutexLocker Locker(&m_FileMutex);
-	if(!m_pFile || !m_pFile->isOpen())
-	{
-		if(!Open(QFile::ReadOnly | QFile::Unbuffered))
-			return -1;
-	}
-	if(m_pFile->pos() != offset && !m_pFile->seek(offset))
+	QFile* pFile = GetHandle(false);
+	if(!pFile)
+		return -1;
+	if(pFile->pos() != offset && !pFile->seek(offset))
 		return -1;
-	return m_pFile->read(data, maxSize);
+	return pFile->read(data, maxSize);
 }
 
 qint64 CFileIO::Write(qint64 offset, const char* data, qint64 maxSize) 
@@ -384,15 +695,13 @@ qint64 CFileIO::Write(qint64 offset, const char* data, qint64 maxSize)
 
 	m_LastUse = GetCurTick();
 	QMutexLocker Locker(&m_FileMutex);
-	if(!m_pFile || !m_pFile->isOpen() || (m_pFile->openMode() & QFile::WriteOnly) == 0)
-	{
-		if(!Open(QFile::ReadWrite | QFile::Unbuffered))
-			return -1;
-	}
-	if(m_pFile->pos() != offset && !m_pFile->seek(offset))
+	QFile* pFile = GetHandle(true);
+	if(!pFile)
 		return -1;
-	qint64 ret = m_pFile->write(data, maxSize);
-	m_pFile->flush();
+	if(pFile->pos() != offset && !pFile->seek(offset))
+		return -1;
+	qint64 ret = pFile->write(data, maxSize);
+	pFile->flush();
 
 	//QMutexLocker Locker2(&m_Mutex); // m_FileSize is volatile
 	if(offset + maxSize > m_FileSize)
@@ -400,43 +709,246 @@ qint64 CFileIO::Write(qint64 offset, const char* data, qint64 maxSize)
 	return ret;
 }
 
-bool CFileIO::Open(QFile::OpenMode Mode)
+bool CFileIO::Allocate(uint64 uSize, bool bSparse)
 {
-	// Note: enter here only if if filemutex is locked
-	if(!m_pFile)
-	{
-		QMutexLocker Locker2(&m_Mutex); 
-		m_pFile = new QFile(m_FileName);
+	if(m_ReadOnly)
+		return false;
 
-		QMutexLocker LockerX(&m_GlobalMutex);
-		ASSERT(!m_GlobalList.contains(this));
-		m_GlobalList.append(this);
-		while(m_GlobalList.size() > 100)
+	m_LastUse = GetCurTick();
+	QMutexLocker Locker(&m_FileMutex);
+	QFile* pFile = GetHandle(true);
+	if(!pFile)
+		return false;
+
+	// Note: when the space can not be reserved we fail without touching the file, a plain resize would leave a sparse file behind,
+	//			the allocator than falls back to zero filling
+	bool bOk = false;
+	if(!bSparse)
+	{
+#if defined(Q_OS_LINUX)
+		// Note: unlike posix_fallocate, fallocate fails instead of writing zeros when the file system does not support it
+		if(fallocate(pFile->handle(), 0, 0, uSize) != 0)
+			return false;
+		bOk = true; // fallocate extended the file already
+#elif defined(Q_OS_MAC)
+		fstore_t Store = {F_ALLOCATECONTIG, F_PEOFPOSMODE, 0, (off_t)(uSize - m_FileSize), 0};
+		if(fcntl(pFile->handle(), F_PREALLOCATE, &Store) == -1)
 		{
-			CFileIO* pOld = m_GlobalList.first();
-			LockerX.unlock();
-			pOld->Close();
-			LockerX.relock();
+			Store.fst_flags = F_ALLOCATEALL;
+			if(fcntl(pFile->handle(), F_PREALLOCATE, &Store) == -1)
+				return false;
 		}
+		// Note: F_PREALLOCATE only reserves the space, the file size is set below
+#endif
+		// Note: on windows extending the file with SetEndOfFile reserves the clusters on NTFS
 	}
-	else
-		m_pFile->close();
+	if(!bOk)
+		bOk = pFile->resize(uSize);
 
-	return m_pFile->open(Mode);
+	if(bOk && uSize > m_FileSize)
+		m_FileSize = uSize;
+	return bOk;
+}
+
+QFile* CFileIO::GetHandle(bool bWrite)
+{
+	// Note: enter here only if if filemutex is locked
+	if(m_WriteHandle.pFile) // the read write handle serves reads as well
+	{
+		m_HandleCache.Touch(&m_WriteHandle);
+		return m_WriteHandle.pFile;
+	}
+	if(!bWrite && m_ReadHandle.pFile)
+	{
+		m_HandleCache.Touch(&m_ReadHandle);
+		return m_ReadHandle.pFile;
+	}
+
+	SFileHandle* pHandle = bWrite ? &m_WriteHandle : &m_ReadHandle;
+	if(!m_HandleCache.Open(pHandle, GetFileName(), bWrite ? (QFile::ReadWrite | QFile::Unbuffered) : (QFile::ReadOnly | QFile::Unbuffered)))
+		return NULL;
+	if(bWrite)
+		m_HandleCache.Close(&m_ReadHandle); // we dont need two handles for the same file
+	return pHandle->pFile;
 }
 
 void CFileIO::Close()
 {
 	QMutexLocker Locker(&m_FileMutex);
-	if(m_pFile)
+	m_HandleCache.Close(&m_ReadHandle);
+	m_HandleCache.Close(&m_WriteHandle);
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Memory Mapped File
+
+QMutex SMapWindow::GlobalMutex;
+uint64 SMapWindow::uTotalMapped = 0;
+volatile uint64 SMapWindow::uMapLimit = GB2B(1);
+
+SMapWindow::SMapWindow(const QSharedPointer<QFile>& File, uint64 Offset, uint64 Size)
+{
+	pFile = File;
+	uOffset = Offset;
+	uSize = Size;
+	pData = NULL;
+
+	QMutexLocker Locker(&GlobalMutex); // Note: QFile::map and unmap are not thread safe
+	if(uTotalMapped + uSize > uMapLimit)
+		return;
+	pData = pFile->map(uOffset, uSize);
+	if(pData)
+		uTotalMapped += uSize;
+}
+
+SMapWindow::~SMapWindow()
+{
+	if(!pData)
+		return;
+	QMutexLocker Locker(&GlobalMutex);
+	pFile->unmap(pData);
+	uTotalMapped -= uSize;
+}
+
+volatile uint64 CMappedIO::m_uWindowSize = MB2B(64);
+
+CMappedIO::CMappedIO(const QString& Name)
+ : CFileIO(Name)
+{
+}
+
+CMappedIO::~CMappedIO()
+{
+	Unmap();
+}
+
+void CMappedIO::SetLimits(uint64 uWindowSize, uint64 uMapLimit)
+{
+	m_uWindowSize = uWindowSize;
+	SMapWindow::uMapLimit = uMapLimit;
+}
+
+QVariantMap CMappedIO::GetStats()
+{
+	QMutexLocker Locker(&SMapWindow::GlobalMutex);
+	QVariantMap Stats;
+	Stats["Size"] = SMapWindow::uTotalMapped;
+	Stats["Limit"] = (uint64)SMapWindow::uMapLimit;
+	return Stats;
+}
+
+void CMappedIO::Process()
+{
+	if(GetCurTick() - m_LastUse > SEC2MS(5))
+		Unmap();
+
+	CFileIO::Process();
+}
+
+bool CMappedIO::Rename(const QString & Name)
+{
+	Unmap();
+
+	return CFileIO::Rename(Name);
+}
+
+void CMappedIO::SetReadOnly(bool bReadOnly)
+{
+	if(!bReadOnly)
+		Unmap(); // Note: writable files are never mapped
+
+	CFileIO::SetReadOnly(bReadOnly);
+}
+
+qint64 CMappedIO::Read(qint64 offset, char* data, qint64 maxSize)
+{
+	if(offset < m_FileSize)
+	{
+		SMappedSlice Slice = Map(offset, Min(maxSize, (qint64)(m_FileSize - offset)));
+		if(Slice.pData)
+		{
+			memcpy(data, Slice.pData, Slice.uSize);
+			return Slice.uSize;
+		}
+	}
+	return CFileIO::Read(offset, data, maxSize);
+}
+
+SMappedSlice CMappedIO::Map(qint64 offset, qint64 size)
+{
+	SMappedSlice Slice;
+	if(!m_ReadOnly || size <= 0 || offset + size > m_FileSize)
+		return Slice;
+
+	m_LastUse = GetCurTick();
+	if(CMapWindowPtr pWindow = MapWindow(offset, size))
+	{
+		Slice.pWindow = pWindow;
+		Slice.pData = (const char*)pWindow->pData + (offset - pWindow->uOffset);
+		Slice.uSize = size;
+	}
+	return Slice;
+}
+
+CMapWindowPtr CMappedIO::MapWindow(qint64 offset, qint64 size)
+{
+	QMutexLocker Locker(&m_MapMutex);
+
+	for(int i = m_Windows.size() - 1; i >= 0; i--)
 	{
-		m_pFile->close();
-		delete m_pFile;
-		m_pFile = NULL;
+		if(m_Windows.at(i)->Contains(offset, size))
+		{
+			CMapWindowPtr pWindow = m_Windows.takeAt(i);
+			m_Windows.append(pWindow);
+			return pWindow;
+		}
+	}
 
-		QMutexLocker LockerX(&m_GlobalMutex);
-		m_GlobalList.removeOne(this);
+	if(!m_pMapFile)
+	{
+		QSharedPointer<QFile> pFile = QSharedPointer<QFile>(new QFile(m_FileName));
+		if(!pFile->open(QFile::ReadOnly))
+			return CMapWindowPtr();
+		m_pMapFile = pFile;
 	}
+
+	// Note: windows are aligned so that they start on a page boundary and cover at least the requested range
+	uint64 uBegin = offset & ~(MB2B(1) - 1);
+	uint64 uEnd = Min(Max(uBegin + m_uWindowSize, (uint64)(offset + size)), (uint64)m_FileSize);
+
+	while(m_Windows.size() >= 4) // Note: windows in use by a slice stay mapped untill the slice is released
+		m_Windows.removeFirst();
+
+	CMapWindowPtr pWindow = CMapWindowPtr(new SMapWindow(m_pMapFile, uBegin, uEnd - uBegin));
+	if(!pWindow->IsValid() && !m_Windows.isEmpty())
+	{
+		// Note: we are at the address space limit, give up our own windows and try again
+		m_Windows.clear();
+		pWindow = CMapWindowPtr(new SMapWindow(m_pMapFile, uBegin, uEnd - uBegin));
+	}
+	if(!pWindow->IsValid())
+		return CMapWindowPtr();
+
+#ifndef WIN32
+	madvise(pWindow->pData, pWindow->uSize, MADV_SEQUENTIAL);
+#endif
+
+	m_Windows.append(pWindow);
+	return pWindow;
+}
+
+void CMappedIO::Unmap()
+{
+	QMutexLocker Locker(&m_MapMutex);
+	m_Windows.clear();
+	m_pMapFile.clear(); // Note: the file is closed when the last window is released
+}
+
+void CMappedIO::Close()
+{
+	Unmap();
+
+	CFileIO::Close();
 }
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -536,6 +1048,18 @@ qint64 CMultiFileIO::Write(qint64 offset, const char* data, qint64 len)
     return TotalWriten;
 }
 
+bool CMultiFileIO::Allocate(uint64 uSize, bool bSparse)
+{
+	ASSERT(uSize == m_FileSize);
+    for (int i = 0; i < m_SubFiles.size(); i++) 
+	{
+        const CIOManager::SMultiIO& SubFile = m_SubFiles.at(i);
+		if(!m_Manager->allocate(SubFile.FileID, SubFile.uFileSize, bSparse))
+			return false;
+	}
+	return true;
+}
+
 void CMultiFileIO::Close()
 {
     for (int i = 0; i < m_SubFiles.size(); i++) 
@@ -3,11 +3,63 @@
 
 #include "../../Framework/MT/ThreadEx.h"
 #include "../../Framework/MT/ThreadLock.h"
+#include "HandleCache.h"
 
 class CManagedIO;
+class CIOQueue;
+class CBlockCache;
 class CIOOperation;
+class CWriteOperation;
 class CFileAllocator;
 
+struct SMapWindow
+{
+	SMapWindow(const QSharedPointer<QFile>& File, uint64 Offset, uint64 Size);
+	~SMapWindow();
+
+	bool					IsValid() const		{return pData != NULL;}
+	bool					Contains(uint64 Offset, uint64 Size) const {return Offset >= uOffset && Offset + Size <= uOffset + uSize;}
+
+	QSharedPointer<QFile>	pFile;
+	uint64					uOffset;
+	uint64					uSize;
+	uchar*					pData;
+
+	// Note: the total mapped address space is bound, windows that would exceed the limit are not mapped
+	static QMutex			GlobalMutex;
+	static uint64			uTotalMapped;
+	static volatile uint64	uMapLimit;
+};
+
+typedef QSharedPointer<SMapWindow> CMapWindowPtr;
+
+struct SMappedSlice
+{
+	SMappedSlice() {pData = NULL; uSize = 0;}
+
+	// Note: the returned array is only valid as long as this slice is alive
+	QByteArray			ToByteArray() const		{return QByteArray::fromRawData(pData, uSize);}
+
+	CMapWindowPtr		pWindow; // keeps the mapping alive
+	const char*			pData;
+	qint64				uSize;
+};
+
+struct SFlushStats
+{
+	SFlushStats()
+	{
+		Operations = 0;
+		Calls = 0;
+		Bytes = 0;
+		Completed = 0;
+	}
+	int					Operations;
+	int					Calls;
+	uint64				Bytes;
+	int					Completed;	// calls issued early because they belong to a completed part
+};
+
 class CAbstractIO
 {
 public:
@@ -15,10 +67,18 @@ public:
 	virtual ~CAbstractIO();
 
 	virtual void		QueueOp(CIOOperation* pOperation);
+	virtual CIOOperation* TakeOp();
 	virtual void		Process()							{}
 
 	virtual void		Execute();
 
+	// write back cache
+	virtual void		CacheWrite(CWriteOperation* pOperation);
+	virtual SFlushStats	FlushWrites(bool bForce, uint64 uBlockSize = -1, uint64 uDelay = -1, uint64 uBegin = 0, uint64 uEnd = 0);
+	virtual bool		HasDirty(uint64 uBegin, uint64 uEnd);
+	virtual void		RequestFlush(uint64 uBegin, uint64 uEnd);
+	virtual uint64		GetDirtySince()						{QMutexLocker Locker(&m_QueueMutex); return m_DirtySince;}
+
 	virtual int			GetQueueSize()						{QMutexLocker Locker(&m_QueueMutex); return m_Operations.size();}
 
 	virtual QString		GetFileName() const					{QMutexLocker Locker(&m_Mutex); return m_FileName;}
@@ -27,9 +87,15 @@ public:
 
 	virtual qint64		GetSize() const						{return m_FileSize;}
 	virtual void		SetReadOnly(bool bReadOnly)			{m_ReadOnly = bReadOnly;}
+	virtual bool		IsReadOnly() const					{return m_ReadOnly;}
+
+	virtual void		SetFileID(uint64 FileID)			{m_FileID = FileID;}
+	virtual uint64		GetFileID() const					{return m_FileID;}
 
 	virtual qint64 		Read(qint64 offset, char* data, qint64 maxSize) = 0;
 	virtual qint64 		Write(qint64 offset, const char* data, qint64 maxSize) = 0;
+	virtual bool		Allocate(uint64 uSize, bool bSparse)	{return false;}
+	virtual SMappedSlice Map(qint64 offset, qint64 size)		{return SMappedSlice();}
 
 	virtual void		Close() = 0;
 
@@ -37,16 +103,25 @@ public:
 
 	virtual uint64		GetLastUse()						{return m_LastUse;}
 
+	virtual void		SetIOQueue(CIOQueue* pQueue)		{QMutexLocker Locker(&m_Mutex); m_pQueue = pQueue;}
+	virtual CIOQueue*	GetIOQueue() const					{QMutexLocker Locker(&m_Mutex); return m_pQueue;}
+
 protected:
 	mutable QMutex		m_Mutex;
+	uint64				m_FileID;
 	QString				m_FileName;
 	volatile uint64		m_FileSize;
 	volatile bool		m_ReadOnly;
 
 	QMutex				m_QueueMutex;
 	QMultiMap<uint64, CIOOperation*> m_Operations;
+	QMultiMap<uint64, CWriteOperation*> m_Dirty;
+	uint64				m_DirtySince;
+	QList<QPair<uint64, uint64> > m_Complete;	// ranges to be flushed as soon as thair writes are cached
 
 	volatile uint64		m_LastUse;
+
+	CIOQueue*			m_pQueue;
 };
 
 
@@ -68,6 +143,7 @@ public:
 
 	void					ReadData(QObject* Reciver, uint64 FileID, uint64 Offset, uint64 Length, void* Aux = NULL);
 	void					WriteData(QObject* Reciver, uint64 FileID, uint64 Offset, const QByteArray& Data, void* Aux = NULL);
+	void					FlushData(uint64 FileID, uint64 uBegin, uint64 uEnd);
 
 	struct SMultiIO
 	{
@@ -100,6 +176,9 @@ public:
 
 	int						GetAllocationCount()			{QMutexLocker Locker(&m_FilesMutex); return m_PendingAllocations.size();}
 
+	QVariantList			GetDeviceStats() const;
+	QVariantMap				GetCacheStats() const;
+
 protected:
 	friend class CManagedIO;
 	friend class CMultiFileIO;
@@ -115,17 +194,28 @@ protected:
 
 	CIOPtr					TakeFile(uint64 FileID);
 
+	CIOQueue*				GetQueue(const QString& FilePath);
+	bool					IsAllocationPending();
+
 	qint64					size(uint64 FileID) const;
 	qint64					readData(uint64 FileID, uint64 Offset, char *data, qint64 maxlen);
 	qint64					writeData(uint64 FileID, uint64 Offset, const char *data, qint64 len);
+	SMappedSlice			mapData(uint64 FileID, uint64 Offset, qint64 len);
+	bool					allocate(uint64 FileID, uint64 uSize, bool bSparse);
 	void					close(uint64 FileID);
 
 	bool					m_Stop;
 
 	mutable QMutex			m_FilesMutex;
 	QMap<uint64, CIOPtr>	m_Files;
-	mutable QMutex			m_ActiveMutex;
-	QSet<CIOPtr>			m_ActiveFiles;
+
+	mutable QMutex			m_QueuesMutex;
+	QMap<QString, CIOQueue*>m_Queues;
+
+	CBlockCache*			m_BlockCache;
+
+	QMutex					m_WaitMutex;
+	QWaitCondition			m_Wait;
 
 	mutable QMutex			m_AllocationsMutex;
 	QMap<uint64, CFileAllocator*>	m_PendingAllocations;
@@ -143,10 +233,37 @@ class CFileAllocator: public QObject
 	Q_OBJECT
 
 public:
-	CFileAllocator(CIOManager* Manager, uint64 uFileSize) {m_Manager = Manager; m_uFileSize = uFileSize;}
+	enum EMode
+	{
+		eSparse = 0,	// only set the file size, the file system allocates on write
+		eFallocate,		// reserve the space without writing anything, where the file system can not do that we zero fill
+		eZeroFill		// legacy, write zeros over the entire file
+	};
+
+	CFileAllocator(CIOManager* Manager, uint64 uFileSize, EMode Mode = eZeroFill) {m_Manager = Manager; m_uFileSize = uFileSize; m_Mode = Mode;}
+
+	static EMode		Str2Mode(const QString& Mode)
+	{
+		if(Mode.compare("Sparse", Qt::CaseInsensitive) == 0)
+			return eSparse;
+		if(Mode.compare("Fallocate", Qt::CaseInsensitive) == 0)
+			return eFallocate;
+		return eZeroFill;
+	}
 
 	virtual bool		Execute(CAbstractIO* File)
 	{
+		if(m_Mode != eZeroFill)
+		{
+			// Note: if the fast allocation fails we fall back to zero filling
+			if((uint64)File->GetSize() >= m_uFileSize || File->Allocate(m_uFileSize, m_Mode == eSparse))
+			{
+				emit Allocation(m_uFileSize, true);
+				return true;
+			}
+			m_Mode = eZeroFill;
+		}
+
 		static char Tmp[MB2B(2)] = {1};
 		if(Tmp[0]) memset(Tmp, 0, sizeof(Tmp));
 
@@ -178,6 +295,7 @@ signals:
 protected:
 	CIOManager* m_Manager;
 	uint64		m_uFileSize;
+	EMode		m_Mode;
 }; 
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -192,6 +310,8 @@ public:
 
 	virtual void		Execute(CAbstractIO* File) = 0;
 	virtual uint64		GetOffset() {return -1;}
+	virtual uint64		GetLength() {return 0;}
+	virtual bool		IsWrite() {return false;}
 
 signals:
 	void				DataRead(uint64 Offset, uint64 Length, const QByteArray& Data, bool bOk, void* Aux);
@@ -228,18 +348,9 @@ public:
 		m_Manager->m_PendingReadSize.fetchAndAddOrdered(-((int)m_Length));
 	}
 
-	virtual void		Execute(CAbstractIO* File)
-	{
-		QByteArray Data;
-		Data.resize(m_Length);
-		uint64 Length = File->Read(m_Offset, Data.data(), Data.size());
-		bool bOk = Data.size() == Length;
-		if(Length == -1)
-			Length = 0;
-		Data.truncate(Length);
-		emit DataRead(m_Offset, m_Length, Data, bOk, m_Aux);
-	}
+	virtual void		Execute(CAbstractIO* File);
 	virtual uint64		GetOffset() {return m_Offset;}
+	virtual uint64		GetLength() {return m_Length;}
 
 protected:
 	uint64		m_Offset;
@@ -267,10 +378,16 @@ public:
 	virtual void		Execute(CAbstractIO* File)
 	{
 		uint64 Length = File->Write(m_Offset, m_Data.data(), m_Data.size());
-		bool bOk = m_Data.size() == Length;
+		Finish(m_Data.size() == Length);
+	}
+	virtual void		Finish(bool bOk)
+	{
 		emit DataWriten(m_Offset, m_Data.size(), bOk, m_Aux);
 	}
+	const QByteArray&	GetData() const {return m_Data;}
 	virtual uint64		GetOffset() {return m_Offset;}
+	virtual uint64		GetLength() {return m_Data.size();}
+	virtual bool		IsWrite() {return true;}
 
 protected:
 	uint64		m_Offset;
@@ -305,6 +422,10 @@ public:
 	//virtual void		close()									{close();}
 
 	virtual void		tell(volatile uint64* offset)			{m_Offset = offset;}
+	virtual void		progress(qint64 offset)					{if(m_Offset) *m_Offset = offset;}
+
+	// Note: zero copy access to read only files, returns an empty slice if the range can not be mapped
+	virtual SMappedSlice map(qint64 offset, qint64 size)		{return m_Manager->mapData(m_FileID, offset, size);}
 
 protected:
 
@@ -391,19 +512,60 @@ public:
 
 	virtual qint64 		Read(qint64 offset, char* data, qint64 maxSize);
 	virtual qint64 		Write(qint64 offset, const char* data, qint64 maxSize);
+	virtual bool		Allocate(uint64 uSize, bool bSparse);
 
 	virtual void		Close();
 
+	virtual void		SetReadOnly(bool bReadOnly);
+
 	virtual bool		IsMulti() const		{return false;}
 
+	static void			SetHandleLimits(int Limit, uint64 uIdleTimeout);
+	static QVariantMap	GetHandleStats()	{return m_HandleCache.GetStats();}
+
 protected:
-	virtual bool		Open(QFile::OpenMode Mode);
+	virtual QFile*		GetHandle(bool bWrite);
 
 	QMutex				m_FileMutex;
-	QFile*				m_pFile;
+	SFileHandle			m_ReadHandle;
+	SFileHandle			m_WriteHandle;
+
+	static CHandleCache	m_HandleCache;
+	static volatile uint64 m_uIdleTimeout;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Memory Mapped File, used for read only files only, as long as the file is writable its a plain CFileIO
+
+class CMappedIO: public CFileIO
+{
+public:
+	CMappedIO(const QString& Name);
+	virtual ~CMappedIO();
+
+	virtual void		Process();
+
+	virtual bool 		Rename(const QString & Name);
+
+	virtual void		SetReadOnly(bool bReadOnly);
+
+	virtual qint64 		Read(qint64 offset, char* data, qint64 maxSize);
+	virtual SMappedSlice Map(qint64 offset, qint64 size);
+
+	virtual void		Close();
+
+	static void			SetLimits(uint64 uWindowSize, uint64 uMapLimit);
+	static QVariantMap	GetStats();
+
+protected:
+	virtual CMapWindowPtr MapWindow(qint64 offset, qint64 size);
+	virtual void		Unmap();
+
+	QMutex				m_MapMutex;
+	QSharedPointer<QFile> m_pMapFile;
+	QList<CMapWindowPtr> m_Windows; // most recently used last
 
-	static QMutex		m_GlobalMutex;
-	static QList<CFileIO*>m_GlobalList;
+	static volatile uint64 m_uWindowSize;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////
@@ -420,6 +582,7 @@ public:
 
 	virtual qint64 		Read(qint64 offset, char* data, qint64 maxSize);
 	virtual qint64 		Write(qint64 offset, const char* data, qint64 maxSize);
+	virtual bool		Allocate(uint64 uSize, bool bSparse);
 
 	virtual void		Close();
 
@@ -0,0 +1,263 @@
+#include "GlobalHeader.h"
+#include "IOQueue.h"
+#include "IOManager.h"
+#include "../NeoCore.h"
+#include <QElapsedTimer>
+#ifndef WIN32
+#include <sys/stat.h>
+#endif
+#ifdef Q_OS_LINUX
+#include <sys/sysmacros.h>
+#endif
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CIOQueue::CIOQueue(const QString& Device, int WorkerCount)
+{
+	m_Device = Device;
+	m_Stop = false;
+
+	for(int i=0; i < Max(WorkerCount, 1); i++)
+	{
+		CIOWorker* pWorker = new CIOWorker(this);
+		m_Workers.append(pWorker);
+		pWorker->start();
+	}
+}
+
+CIOQueue::~CIOQueue()
+{
+	Stop();
+
+	foreach(CIOWorker* pWorker, m_Workers)
+		delete pWorker;
+}
+
+QString CIOQueue::GetDeviceKey(const QString& FilePath)
+{
+#ifdef WIN32
+	// Note: on windows a volume is identifyed by its drive letter or by its UNC share
+	if(FilePath.startsWith("//") || FilePath.startsWith("\\\\"))
+	{
+		QStringList Path = QString(FilePath).replace("\\", "/").split("/", QString::SkipEmptyParts);
+		return "//" + Path.mid(0, 2).join("/").toLower();
+	}
+	return FilePath.left(2).toUpper();
+#else
+	QString Path = FilePath;
+	while(!Path.isEmpty())
+	{
+		struct stat Stat;
+		if(stat(Path.toLocal8Bit().constData(), &Stat) == 0)
+			return QString::number((quint64)Stat.st_dev);
+		int Pos = Path.lastIndexOf("/");
+		if(Pos <= 0)
+			break;
+		Path.truncate(Pos);
+	}
+	return "/";
+#endif
+}
+
+bool CIOQueue::IsRotational(const QString& FilePath)
+{
+#ifdef Q_OS_LINUX
+	QString Path = FilePath;
+	while(!Path.isEmpty())
+	{
+		struct stat Stat;
+		if(stat(Path.toLocal8Bit().constData(), &Stat) == 0)
+		{
+			// Note: for a partition the queue attributes are found at the parent block device
+			QString Dev = QString("/sys/dev/block/%1:%2/").arg(major(Stat.st_dev)).arg(minor(Stat.st_dev));
+			QFile File(Dev + "queue/rotational");
+			if(!File.exists())
+				File.setFileName(Dev + "../queue/rotational");
+			if(File.open(QFile::ReadOnly))
+				return File.readAll().trimmed() != "0";
+			return true;
+		}
+		int Pos = Path.lastIndexOf("/");
+		if(Pos <= 0)
+			break;
+		Path.truncate(Pos);
+	}
+#endif
+	return true; // Note: if we dont know, better be carefull
+}
+
+void CIOQueue::Schedule(const CIOPtr& File)
+{
+	QMutexLocker Locker(&m_Mutex);
+	if(m_Busy.contains(File) || m_Queued.contains(File))
+		return; // Note: busy files are rechecked by the worker on release
+	m_Queued.insert(File);
+	m_Pending.append(File);
+	m_Wait.wakeOne();
+}
+
+void CIOQueue::Remove(const CIOPtr& File)
+{
+	QMutexLocker Locker(&m_Mutex);
+	if(m_Queued.remove(File))
+		m_Pending.removeOne(File);
+}
+
+void CIOQueue::Stop()
+{
+	m_Mutex.lock();
+	m_Stop = true;
+	m_Wait.wakeAll();
+	m_Mutex.unlock();
+
+	foreach(CIOWorker* pWorker, m_Workers)
+		pWorker->wait();
+}
+
+CIOPtr CIOQueue::Dequeue()
+{
+	QMutexLocker Locker(&m_Mutex);
+	while(!m_Stop && m_Pending.isEmpty())
+		m_Wait.wait(&m_Mutex);
+	if(m_Stop)
+		return CIOPtr();
+
+	CIOPtr File = m_Pending.takeFirst();
+	m_Queued.remove(File);
+	m_Busy.insert(File);
+	return File;
+}
+
+void CIOQueue::Release(const CIOPtr& File)
+{
+	QMutexLocker Locker(&m_Mutex);
+	m_Busy.remove(File);
+	if(File->GetQueueSize() > 0 && !m_Queued.contains(File))
+	{
+		// Note: new operations arrived while we ware busy, put the file at the end to be fair to the others
+		m_Queued.insert(File);
+		m_Pending.append(File);
+		m_Wait.wakeOne();
+	}
+}
+
+void CIOQueue::Account(CIOOperation* pOperation, qint64 ServiceTime)
+{
+	QMutexLocker Locker(&m_Mutex);
+	if(pOperation->IsWrite())
+	{
+		m_Stats.WriteCount++;
+		m_Stats.WriteCalls++;
+		m_Stats.WriteBytes += pOperation->GetLength();
+	}
+	else
+	{
+		m_Stats.ReadCount++;
+		m_Stats.ReadBytes += pOperation->GetLength();
+	}
+	m_Stats.ServiceTime += ServiceTime;
+	if(m_Stats.MaxServiceTime < (uint64)ServiceTime)
+		m_Stats.MaxServiceTime = ServiceTime;
+}
+
+void CIOQueue::AccountCached()
+{
+	QMutexLocker Locker(&m_Mutex);
+	m_Stats.CachedWrites++;
+}
+
+void CIOQueue::AccountFlush(const SFlushStats& Stats, qint64 ServiceTime, bool bForRead)
+{
+	QMutexLocker Locker(&m_Mutex);
+	m_Stats.WriteCount += Stats.Operations;
+	m_Stats.WriteBytes += Stats.Bytes;
+	m_Stats.WriteCalls += Stats.Calls;
+	m_Stats.PartFlushes += Stats.Completed;
+	if(bForRead)
+		m_Stats.ReadFlushes++;
+	m_Stats.ServiceTime += ServiceTime;
+	if(m_Stats.MaxServiceTime < (uint64)ServiceTime)
+		m_Stats.MaxServiceTime = ServiceTime;
+}
+
+QVariantMap CIOQueue::GetStats() const
+{
+	QMutexLocker Locker(&m_Mutex);
+
+	int QueueDepth = 0;
+	foreach(const CIOPtr& File, m_Pending)
+		QueueDepth += File->GetQueueSize();
+	foreach(const CIOPtr& File, m_Busy)
+		QueueDepth += File->GetQueueSize() + 1;
+
+	QVariantMap Stats;
+	Stats["Device"] = m_Device;
+	Stats["Workers"] = m_Workers.size();
+	Stats["QueueDepth"] = QueueDepth;
+	Stats["ActiveFiles"] = m_Pending.size() + m_Busy.size();
+	Stats["ReadCount"] = m_Stats.ReadCount;
+	Stats["WriteCount"] = m_Stats.WriteCount;
+	Stats["ReadBytes"] = m_Stats.ReadBytes;
+	Stats["WriteBytes"] = m_Stats.WriteBytes;
+	Stats["WriteCalls"] = m_Stats.WriteCalls;
+	Stats["WriteMerged"] = m_Stats.WriteCount - m_Stats.WriteCalls;
+	Stats["CachedWrites"] = m_Stats.CachedWrites;
+	Stats["ReadFlushes"] = m_Stats.ReadFlushes;
+	Stats["PartFlushes"] = m_Stats.PartFlushes;
+	uint64 uCount = m_Stats.ReadCount + m_Stats.WriteCalls;
+	Stats["AvgServiceTime"] = uCount ? (m_Stats.ServiceTime / uCount) / 1000 : 0; // in us
+	Stats["MaxServiceTime"] = m_Stats.MaxServiceTime / 1000; // in us
+	return Stats;
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CIOWorker::CIOWorker(CIOQueue* pQueue, QObject* qObject)
+ : QThreadEx(qObject)
+{
+	m_pQueue = pQueue;
+}
+
+void CIOWorker::run()
+{
+	QElapsedTimer Timer;
+	while(CIOPtr File = m_pQueue->Dequeue())
+	{
+		uint64 uDelay = theCore->Cfg()->GetInt("Content/WriteBackDelay");
+		uint64 uBlockSize = theCore->Cfg()->GetInt("Content/WriteBackBlock");
+
+		while(CIOOperation* pOperation = File->TakeOp())
+		{
+			if(pOperation->IsWrite() && uDelay > 0)
+			{
+				File->CacheWrite((CWriteOperation*)pOperation);
+				m_pQueue->AccountCached();
+				continue;
+			}
+
+			if(!pOperation->IsWrite() && File->HasDirty(pOperation->GetOffset(), pOperation->GetOffset() + pOperation->GetLength()))
+			{
+				// Note: the read covers not yet writen data, so we must flush it first
+				Timer.start();
+				SFlushStats Stats = File->FlushWrites(false, -1, -1, pOperation->GetOffset(), pOperation->GetOffset() + pOperation->GetLength());
+				m_pQueue->AccountFlush(Stats, Timer.nsecsElapsed(), true);
+			}
+
+			Timer.start();
+			pOperation->Execute(File.data());
+			m_pQueue->Account(pOperation, Timer.nsecsElapsed());
+			pOperation->deleteLater();
+		}
+
+		// Note: when the cache gets full we flush everything, else only large runs and overdue data
+		bool bForce = theCore->m_IOManager->IsWriteBufferFull(true);
+		Timer.start();
+		SFlushStats Stats = File->FlushWrites(bForce, uBlockSize, uDelay);
+		if(Stats.Calls > 0)
+			m_pQueue->AccountFlush(Stats, Timer.nsecsElapsed());
+
+		m_pQueue->Release(File);
+	}
+}
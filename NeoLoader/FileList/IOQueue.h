@@ -0,0 +1,97 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+#include "../../Framework/MT/ThreadEx.h"
+
+class CAbstractIO;
+class CIOOperation;
+class CIOWorker;
+struct SFlushStats;
+
+typedef QSharedPointer<CAbstractIO> CIOPtr;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// One queue per physical device, files with pending operations are scheduled here
+// and serviced by a small set of worker threads that sleep until there is work to do
+
+class CIOQueue
+{
+public:
+	CIOQueue(const QString& Device, int WorkerCount);
+	~CIOQueue();
+
+	static QString			GetDeviceKey(const QString& FilePath);
+	static bool				IsRotational(const QString& FilePath);
+
+	const QString&			GetDevice() const				{return m_Device;}
+
+	void					Schedule(const CIOPtr& File);
+	void					Remove(const CIOPtr& File);
+
+	void					Stop();
+
+	QVariantMap				GetStats() const;
+
+protected:
+	friend class CIOWorker;
+
+	CIOPtr					Dequeue();
+	void					Release(const CIOPtr& File);
+	void					Account(CIOOperation* pOperation, qint64 ServiceTime);
+	void					AccountCached();
+	void					AccountFlush(const SFlushStats& Stats, qint64 ServiceTime, bool bForRead = false);
+
+	QString					m_Device;
+
+	mutable QMutex			m_Mutex;
+	QWaitCondition			m_Wait;
+	QList<CIOPtr>			m_Pending;
+	QSet<CIOPtr>			m_Queued;
+	QSet<CIOPtr>			m_Busy;
+	volatile bool			m_Stop;
+
+	QList<CIOWorker*>		m_Workers;
+
+	struct SStats
+	{
+		SStats()
+		{
+			ReadCount = 0;
+			WriteCount = 0;
+			ReadBytes = 0;
+			WriteBytes = 0;
+			WriteCalls = 0;
+			CachedWrites = 0;
+			ReadFlushes = 0;
+			PartFlushes = 0;
+			ServiceTime = 0;
+			MaxServiceTime = 0;
+		}
+		uint64				ReadCount;
+		uint64				WriteCount;
+		uint64				ReadBytes;
+		uint64				WriteBytes;
+		uint64				WriteCalls;		// actual write calls issued to the file
+		uint64				CachedWrites;	// write operations that went through the write back cache
+		uint64				ReadFlushes;	// flushes forced by reads of not yet writen data
+		uint64				PartFlushes;	// write calls issued early because a part got complete
+		uint64				ServiceTime;	// in ns
+		uint64				MaxServiceTime;	// in ns
+	}						m_Stats;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+class CIOWorker: public QThreadEx
+{
+	Q_OBJECT
+
+public:
+	CIOWorker(CIOQueue* pQueue, QObject* qObject = NULL);
+
+	void					run();
+
+protected:
+	CIOQueue*				m_pQueue;
+};
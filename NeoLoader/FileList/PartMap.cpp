@@ -61,6 +61,28 @@ QBitArray CPartMap::ToBitArray(uint64 uPartSize, uint64 uBlockSize, ValueType uT
 	return Array;
 }
 
+void CPartMap::SetRange(uint64 uBegin, uint64 uEnd, ValueType uState, ESet eMode)
+{
+	CRangeMap<SPartRange>::SetRange(uBegin, uEnd, uState, eMode);
+
+	if(IsPlanChange(uState, eMode))
+	{
+		if(uEnd == -1)
+			uEnd = CRangeMap<SPartRange>::GetSize();
+		emit RangeChanged(uBegin, uEnd);
+	}
+}
+
+bool CPartMap::IsPlanChange(const ValueType& uState, ESet eMode)
+{
+	// Note: the scheduling and request counters change all the time, but they dont affect the download plan
+	if(uState.bStates && (eMode == eSet || (uState.uStates & (Part::Available | Part::Allocated | Part::Disabled | Part::Stream | Part::Required)) != 0))
+		return true;
+	if(uState.bPriority && (eMode == eSet || uState.iPriority != 0))
+		return true;
+	return false;
+}
+
 QVariantMap CPartMap::Store()
 {
 	ASSERT(!m_PartMap.empty());
@@ -599,7 +621,11 @@ void CSharedPartMap::SetRange(uint64 uBegin, uint64 uEnd, ValueType uState, ESet
 	{
 		CPartMapPtr pMap = pLink->pMap.toStrongRef();
 		if(CJoinedPartMap* pJoinedMap = qobject_cast<CJoinedPartMap*>(pMap.data()))
+		{
 			pJoinedMap->IncrRevision();
+			if(IsPlanChange(uState, eMode))
+				emit pJoinedMap->RangeChanged(uBegin + pLink->uShareBegin, uEnd + pLink->uShareBegin);
+		}
 	}
 }
 
@@ -747,7 +773,7 @@ void CShareMap::Write(CBuffer* Data, bool bI64) const
 	if(bI64)
 		SizeFlag |= 0x80;
 	Data->WriteValue<uint8>(SizeFlag);
-	for(QMap<uint64,ValueType>::const_iterator Part = m_PartMap.begin(); Part != m_PartMap.end(); Part++)
+	for(MapType::const_iterator Part = m_PartMap.begin(); Part != m_PartMap.end(); Part++)
 	{
 		if(bI64)
 			Data->WriteValue<uint64>(Part.key());
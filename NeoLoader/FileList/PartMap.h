@@ -146,10 +146,14 @@ public:
 	virtual QVariantMap	Store();
 	virtual bool		Load(const QVariantMap& Map);
 
+	virtual void		SetRange(uint64 uBegin, uint64 uEnd, ValueType uState, ESet eMode = eSet);
+	static bool			IsPlanChange(const ValueType& uState, ESet eMode);
+
 	virtual void		NotifyChange(bool bPurge = false)	{emit Change(bPurge);}
 
 signals:
 	void				Change(bool bPurge = false);
+	void				RangeChanged(uint64 uBegin, uint64 uEnd); // the download relevant state or priority of this range changed
 
 protected:
 	virtual bool		StateSet(ValueType uCur) const
@@ -16,6 +16,8 @@
 #include "../../../Framework/Cryptography/HashFunction.h"
 #include "../../FileTransfer/HashInspector.h"
 #include "../../../Framework/OtherFunctions.h"
+#include "../../../qbencode/lib/bencode.h"
+#include "../../../Framework/Scope.h"
 
 int	GetMetadataBlockCount(uint64 MetadataSize)
 {
@@ -31,6 +33,8 @@ CTorrent::CTorrent(CFile* pFile)
 	m_TorrentInfo = NULL;
 
 	m_MetadataExchange = NULL;
+
+	m_ProofCache.setMaxCost(KB2B(256));
 }
 
 CTorrent::~CTorrent()
@@ -331,6 +335,46 @@ CFileHashPtr CTorrent::GetHash()
 	return m_pHash;
 }
 
+QByteArray CTorrent::GetPieceProof(uint32 Index)
+{
+	CFileHashTree* pHashTree = qobject_cast<CFileHashTree*>(m_pHash.data());
+	if(!pHashTree)
+	{
+		ASSERT(0);
+		return QByteArray();
+	}
+
+	if(m_pProofHash != m_pHash) // the hash was replaced, what we cached is not valid anymore
+	{
+		m_ProofCache.clear();
+		m_pProofHash = m_pHash;
+	}
+	else if(QByteArray* pProof = m_ProofCache.object(Index))
+		return *pProof;
+
+	uint64 uFrom = Index * m_TorrentInfo->GetPieceLength();
+	uint64 uTo = Min(uFrom + m_TorrentInfo->GetPieceLength(), m_TorrentInfo->GetTotalLength());
+	CScoped<CFileHashTree> pBranche = pHashTree->GetLeafs(uFrom, uTo);
+	if(!pBranche)
+		return QByteArray(); // Note: we dont cache failures, the leafs may still arrive
+
+	SHashTreeDump Leafs(CFileHash::GetSize(HashTorrent));
+	pBranche->Save(Leafs);
+
+	QVariantList List;
+	for(int i = 0; i < Leafs.Count(); i++)
+	{
+		QVariantList Entry;
+		Entry.append(Neo2Merkle(Leafs.ID(i)));
+		Entry.append(QByteArray((const char*)Leafs.Hash(i), Leafs.Size()));
+		List.append((QVariant)Entry);
+	}
+
+	QByteArray Proof = Bencoder::encode(List).buffer();
+	m_ProofCache.insert(Index, new QByteArray(Proof), Proof.size());
+	return Proof;
+}
+
 void CTorrent::OnFileHashed()
 {
 	CFile* pFile = GetFile();
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <QCache>
 #include "../../../Framework/ObjectEx.h"
 #include "../../FileList/File.h"
 #include "../../FileTransfer/BitTorrent/TorrentPeer.h"
@@ -27,6 +28,8 @@ public:
 	virtual CTorrentInfo*			GetInfo()							{ASSERT(m_TorrentInfo); return m_TorrentInfo;}
 	virtual QByteArray				GetInfoHash();
 	virtual CFileHashPtr			GetHash();
+	// Note: returns the bencoded merkle leafs of a piece, as sent in front of its first block, empty if we dont have them
+	virtual QByteArray				GetPieceProof(uint32 Index);
 
 	virtual CFile*					GetFile()							{return qobject_cast<CFile*>(parent());}
 
@@ -57,6 +60,9 @@ protected:
 	CTorrentInfo*					m_TorrentInfo;
 	CFileHashPtr					m_pHash;
 
+	QCache<uint32, QByteArray>		m_ProofCache;
+	CFileHashPtr					m_pProofHash;	// the hash the cached proofs were made from
+
 	struct SMetadata
 	{
 		SMetadata() : MetadataSize(0) {}
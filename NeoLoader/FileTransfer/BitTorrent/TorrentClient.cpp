@@ -328,7 +328,7 @@ void CTorrentClient::ProcessPieceList(CBuffer& Packet)
 // Sends a request for a block.
 void CTorrentClient::RequestBlock(uint32 Index, uint32 Offset, uint32 Length)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("SendRequestBlock"));
 
@@ -348,7 +348,7 @@ void CTorrentClient::RequestBlock(uint32 Index, uint32 Offset, uint32 Length)
 
 void CTorrentClient::ProcessBlockRequest(CBuffer& Packet)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("ProcessBlockRequest"));
 
@@ -416,14 +416,15 @@ void CTorrentClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray&
 		return;
 	}
 
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("QueueBlock"));
 
 	//m_TempPieceSize -= Data.size();
 
 	// Sends a block to the peer.
-	CBuffer Packet; // (1 + 4 + 4 + Data.size());
+	// Note: only the message head is assembled here, the block is queued as the IO handed it to us
+	CBuffer Packet;
 	if(pTorrentInfo->IsMerkle())
 	{
 		if(m_Tr_hashpiece_Extension) // Tribbler Style
@@ -444,46 +445,23 @@ void CTorrentClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray&
 	{
 		if(Offset == 0)
 		{
-			CFileHashTree* pHashTree = qobject_cast<CFileHashTree*>(pTorrent->GetHash().data());
-			if(!pHashTree)
-			{
-				ASSERT(0);
-				return;
-			}
-			uint64 uFrom = Index * pTorrentInfo->GetPieceLength();
-			uint64 uTo = Min(uFrom + pTorrentInfo->GetPieceLength(), pTorrentInfo->GetTotalLength());
-			CScoped<CFileHashTree> pBranche = pHashTree->GetLeafs(uFrom, uTo);
-			if(!pBranche)
+			QByteArray Proof = pTorrent->GetPieceProof(Index);
+			if(Proof.isEmpty())
 			{
 				if(SupportsFAST())
 					RejectRequest(Index, Offset, Length);
 				return;
 			}
 
-			SHashTreeDump Leafs(CFileHash::GetSize(HashTorrent));
-			pBranche->Save(Leafs);
-
-			QVariantList List;
-			for(int Index = 0; Index < Leafs.Count(); Index++)
-			{
-				QVariantList Entry;
-				Entry.append(Neo2Merkle(Leafs.ID(Index)));
-				Entry.append(QByteArray((const char*)Leafs.Hash(Index), Leafs.Size()));
-				List.append((QVariant)Entry);
-			}
-
-			QByteArray Data = Bencoder::encode(List).buffer();
-			Packet.WriteValue<uint32>(Data.size(), true);
-			Packet.WriteQData(Data);
+			Packet.WriteValue<uint32>(Proof.size(), true);
+			Packet.WriteQData(Proof);
 		}
 		else
 			Packet.WriteValue<uint32>(0, true);
 	}
 
-	Packet.WriteData(Data.data(), Data.size());
-
-	m_SentPieceSize += 4 + Packet.GetSize();
-	m_Socket->QueuePacket(uBegin, Packet.ToByteArray());
+	m_SentPieceSize += 4 + Packet.GetSize() + Data.size();
+	m_Socket->QueuePacket(uBegin, Packet.ToByteArray(), Data);
 }
 
 uint64 CTorrentClient::GetSentPieceSize()
@@ -504,7 +482,7 @@ uint64 CTorrentClient::GetSentPieceSize()
 
 void CTorrentClient::ProcessBlock(CBuffer& Packet)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("ProcessBlock"));
 
@@ -1578,7 +1556,7 @@ void CTorrentClient::AddLogLine(time_t uStamp, uint32 uFlag, const CLogMsg& Line
 {
 	Line.AddMark((uint64)m_pPeer);
 
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug >= 2 || (iDebug == 1 && (uFlag & LOG_DEBUG) == 0))
 	{
 		Line.Prefix(QString("TorrentClient - %1:%2").arg(m_Peer.GetIP().ToQString()).arg(m_Peer.Port));
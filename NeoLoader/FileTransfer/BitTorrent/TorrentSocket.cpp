@@ -76,12 +76,21 @@ void CTorrentSocket::StreamIn(byte* Data, size_t Length)
 	CStreamSocket::StreamIn(Data, Length);
 }
 
-void CTorrentSocket::QueuePacket(uint64 ID, const QByteArray& Packet)
+void CTorrentSocket::QueuePacket(uint64 ID, const QByteArray& Packet, const QByteArray& Payload)
 {
-	CBuffer Header(4);
-	Header.WriteValue<uint32>(Packet.size(), true);
+	if(Payload.isEmpty())
+	{
+		CBuffer Header(4);
+		Header.WriteValue<uint32>(Packet.size(), true);
+		QueueStream(ID, Header.ToByteArray(), Packet);
+		return;
+	}
 
-	QueueStream(ID, Header.ToByteArray() + Packet);
+	// Note: the packet is only the message head, the payload follows it unchanged as the second segment
+	CBuffer Header(4 + Packet.size());
+	Header.WriteValue<uint32>(Packet.size() + Payload.size(), true);
+	Header.WriteQData(Packet);
+	QueueStream(ID, Header.ToByteArray(), Payload);
 }
 
 void CTorrentSocket::ProcessStream()
@@ -21,7 +21,7 @@ public:
 
 	virtual void		SendHandshake(const QByteArray& Handshake);
 	virtual void		SendPacket(const QByteArray& Packet);
-	virtual void		QueuePacket(uint64 ID, const QByteArray& Packet);
+	virtual void		QueuePacket(uint64 ID, const QByteArray& Packet, const QByteArray& Payload = QByteArray());
 
 	virtual bool		InitCrypto(const QByteArray& InfoHash);
 	virtual void		ProcessCrypto();
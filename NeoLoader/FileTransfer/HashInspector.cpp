@@ -544,10 +544,12 @@ void CHashInspector::ValidateParts(bool bRecovery)
 	}
 }
 
-void CHashInspector::ResetRange(uint64 uBegin, uint64 uEnd)
+void CHashInspector::ResetRange(uint64 uBegin, uint64 uEnd, bool bHasher)
 {
 	CFile* pFile = GetFile();
 	ResetRange(pFile, uBegin, uEnd);
+	if(bHasher)
+		m_Hasher.Reset(uBegin, uEnd);
 
 	CPartMap* pParts = pFile->GetPartMap();
 	if(CSharedPartMap* pSharedParts = qobject_cast<CSharedPartMap*>(pParts))
@@ -601,6 +603,38 @@ void CHashInspector::ResetRange(CFile* pFile, uint64 uBegin, uint64 uEnd)
 	}
 }
 
+void CHashInspector::OnDataReceived(uint64 uOffset, const QByteArray& Data)
+{
+	if(!theCore->Cfg()->GetBool("Content/HashOnArrival"))
+		return;
+
+	// Note: only the files own hashes are checked, parent hashes of shared parts are left to the regular verification
+	CFile* pFile = GetFile();
+	QList<CFileHashPtr> Hashes;
+	foreach(const CFileHashPtr& pHash, pFile->GetListForHashing())
+	{
+		CFileHashEx* pHashEx = qobject_cast<CFileHashEx*>(pHash.data());
+		if(pHashEx && pHashEx->GetTotalSize() == pFile->GetFileSize())
+			Hashes.append(pHash);
+	}
+	m_Hasher.AddData(Hashes, uOffset, Data);
+}
+
+void CHashInspector::OnDataWriten(uint64 uBegin, uint64 uEnd, bool bOk)
+{
+	if(!bOk)
+	{
+		// Note: the data we hashed did not make it to disk, what we verified in memory is not valid for the file
+		m_Hasher.Reset(uBegin, uEnd);
+		return;
+	}
+
+	// Reset all hashing results for this range, the segments the hasher is still working on stay open
+	ResetRange(uBegin, uEnd, false);
+
+	m_Hasher.Written(uBegin, uEnd, GetFile()->GetPartMap());
+}
+
 void CHashInspector::OnRecoveryData()
 {
 	// Force Hashing
@@ -5,6 +5,7 @@
 #include "../../Framework/ObjectEx.h"
 #include "../../Framework/Address.h"
 #include "../FileList/Hashing/HashingThread.h"
+#include "../FileList/Hashing/IncrementalHasher.h"
 
 class CCorruptionLogger;
 
@@ -20,7 +21,10 @@ public:
 
 	bool				StartValidation(bool bRecovery = false);
 
-	void				ResetRange(uint64 uBegin, uint64 uEnd);
+	void				ResetRange(uint64 uBegin, uint64 uEnd, bool bHasher = true);
+
+	void				OnDataReceived(uint64 uOffset, const QByteArray& Data);
+	void				OnDataWriten(uint64 uBegin, uint64 uEnd, bool bOk);
 
 	EFileHashType		GetIndexSource()		{return m_IndexSource;}
 	void				SetIndexSource(EFileHashType IndexSource) {m_IndexSource = IndexSource;}
@@ -82,4 +86,6 @@ protected:
 	QMap<QByteArray, CCorruptionLogger*>	m_Loggers;
 
 	QMap<CHashingJob*, CHashingJobPtr>	m_HashingJobs;
+
+	CIncrementalHasher	m_Hasher;
 };
\ No newline at end of file
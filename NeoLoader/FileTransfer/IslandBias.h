@@ -0,0 +1,113 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+#include <math.h>
+#include <algorithm>
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Island bias, parts next to the ranges we already have get a boost, the smaller the island the bigger the boost,
+// the boost fades out over ToGo parts in each direction.
+// Note: the bias of a part only depends on the islands within IslandMargin parts, an island that is clipped at that distance
+// is already long enough to get the minimal boost, so the bias of a window of parts can be calculated on its own.
+// For the same reason a change to our ranges only moves the bias of the parts within IslandMargin of it.
+
+inline int IslandMargin(double ToGo)
+{
+	return 2 * (int)ceil(ToGo) + 2;
+}
+
+/**
+* Calculates the island bias of the parts iFrom to iTo - 1
+* @param: pParts: range map with our available ranges
+* @param: uAvailable: the state that makes a range available
+* @param: pBias: receives the bias of the parts, pBias[0] is the one of part iFrom
+*/
+template <class T>
+void CalcIslandBias(const T* pParts, uint32 uAvailable, uint64 PartSize, double ToGo, double* pBias, int iFrom, int iTo)
+{
+	for(int i = iFrom; i < iTo; i++)
+		pBias[i - iFrom] = 0;
+
+	int Margin = IslandMargin(ToGo);
+	uint64 uFrom = iFrom > Margin ? (iFrom - Margin) * PartSize : 0;
+	uint64 uTo = Min((iTo + Margin) * PartSize, pParts->GetSize());
+	if(uFrom >= uTo)
+		return;
+
+	typename T::SIterator Iter(uFrom, uTo);
+	while(pParts->IterateRanges(Iter, uAvailable))
+	{
+		if((Iter.uState & uAvailable) == 0)
+			continue;
+
+		uint64 uLength = Iter.uEnd - Iter.uBegin;
+		int Count = uLength / PartSize;
+
+		// make sure the bias is the bigger the smaller the iland is
+		double MaxBias = (Count <= ToGo) ? 100 - 100 * Count/ToGo : 0;
+		if(MaxBias < 10) // any iland has a boost of at least 10
+			MaxBias = 10;
+
+		int First = (Iter.uBegin + PartSize - 1) / PartSize - 1;
+		int Last = (Iter.uEnd / PartSize) + 1;
+		for(int Cnt = 0, i=First, j=Last; Cnt < ToGo; Cnt++, i--, j++)
+		{
+			double Mod = pow(sqrt(MaxBias) - sqrt(MaxBias * ++Cnt/ToGo), 2);
+			//x                 
+			// x                
+			//  x               
+			//    x             
+			//       x          
+			//             x    
+			// // // // // // // 
+			//		(cnt)
+			if(i >= iFrom && i < iTo) // befoure the iland
+				pBias[i - iFrom] += Mod;
+			if(j >= iFrom && j < iTo) // after the iland
+				pBias[j - iFrom] += Mod;
+		}
+	}
+}
+
+/**
+* Recalculates the bias of the parts around the ranges that changed
+* @param: Bias: bias by part number, only the parts within IslandMargin of a changed range are updated
+* @param: Ranges: byte ranges in which our available ranges may have changed
+* @param: Changed: receives the numbers of the parts whose bias moved
+*/
+template <class T>
+void UpdateIslandBias(const T* pParts, uint32 uAvailable, uint64 PartSize, double ToGo, QVector<double>& Bias, QVector<QPair<uint64, uint64> > Ranges, QVector<int>& Changed)
+{
+	int PartCount = Bias.size();
+	int Margin = IslandMargin(ToGo);
+
+	// merge the windows of close ranges, so that no part is calculated twice
+	std::sort(Ranges.begin(), Ranges.end());
+	QVector<QPair<int, int> > Windows;
+	for(int i=0; i < Ranges.size(); i++)
+	{
+		int From = Max((int)(Ranges[i].first / PartSize) - Margin, 0);
+		int To = Min((int)((Ranges[i].second + PartSize - 1) / PartSize) + Margin, PartCount);
+		if(!Windows.isEmpty() && Windows.last().second >= From)
+			Windows.last().second = Max(Windows.last().second, To);
+		else if(From < To)
+			Windows.append(qMakePair(From, To));
+	}
+
+	QVector<double> Window;
+	for(int k=0; k < Windows.size(); k++)
+	{
+		int From = Windows[k].first;
+		int To = Windows[k].second;
+		Window.resize(To - From);
+		CalcIslandBias(pParts, uAvailable, PartSize, ToGo, Window.data(), From, To);
+		for(int i = From; i < To; i++)
+		{
+			if(Window[i - From] != Bias[i])
+			{
+				Bias[i] = Window[i - From];
+				Changed.append(i);
+			}
+		}
+	}
+}
@@ -695,7 +695,7 @@ void CNeoClient::OfferUpload()
 
 void CNeoClient::RequestBlock(uint64 uOffset, uint32 uLength)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("SendBlockRequest"));
 
@@ -711,7 +711,7 @@ void CNeoClient::RequestBlock(uint64 uOffset, uint32 uLength)
 
 void CNeoClient::ProcessBlockRequest(const QVariantMap& InPacket)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("ProcessBlockRequest"));
 
@@ -744,7 +744,7 @@ void CNeoClient::OnDataRead(uint64 uOffset, uint64 uLength, const QByteArray& Da
 
 	m_UploadedSize += uLength;
 
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("SendDataBlock"));
 
@@ -784,7 +784,7 @@ void CNeoClient::ProcessRequestRejected(const QVariantMap& InPacket)
 
 void CNeoClient::ProcessDataBlock(const QVariantMap& InPacket)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("ProcessDataBlock"));
 
@@ -989,7 +989,7 @@ void CNeoClient::AddLogLine(time_t uStamp, uint32 uFlag, const CLogMsg& Line)
 {
 	Line.AddMark((uint64)m_pNeo);
 
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug >= 2 || (iDebug == 1 && (uFlag & LOG_DEBUG) == 0))
 	{
 		Line.Prefix(QString("NeoEntity - %1@%2").arg(QString::fromLatin1(m_Neo.EntityID.toHex())).arg(QString::fromLatin1(m_Neo.TargetID.toHex())));
@@ -133,7 +133,7 @@ void CNeoManager::Process(UINT Tick)
 			{
 				theCore->Cfg()->SetBlob("NeoKad/EntityKey", pRoute->GetEntityKey()->ToByteArray());
 #ifdef _DEBUG
-				theCore->Cfg()->setValue("NeoKad/EntityID", QString(pRoute->GetEntityID().toHex()));
+				theCore->Cfg()->SetSetting("NeoKad/EntityID", QString(pRoute->GetEntityID().toHex()));
 #endif
 			}
 		}
@@ -6,6 +6,7 @@
 #include "../FileList/FileStats.h"
 #include "../FileList/IOManager.h"
 #include "Transfer.h"
+#include "IslandBias.h"
 #include "../../Framework/OtherFunctions.h"
 #include <math.h>
 
@@ -38,6 +39,40 @@ void CPartDownloader::OnChange(bool Purge)
 	}
 }
 
+void CPartDownloader::OnRangeChanged(uint64 uBegin, uint64 uEnd)
+{
+	// this is triggered when the state or priority of a range in our part map changed
+	for(QMap<QByteArray, SDownloadPlan>::iterator I = m_DownloadPlans.begin(); I != m_DownloadPlans.end(); I++)
+	{
+		SDownloadPlan& DownloadPlan = I.value();
+		MarkDirty(DownloadPlan, uBegin, uEnd);
+
+		// Note: the surrounding parts may get a different island bias, consecutive blocks are merged into one range
+		if(DownloadPlan.bFull || DownloadPlan.bIslands)
+			continue;
+		if(!DownloadPlan.Islands.isEmpty() && DownloadPlan.Islands.last().second >= uBegin && DownloadPlan.Islands.last().first <= uEnd)
+		{
+			QPair<uint64, uint64>& Range = DownloadPlan.Islands.last();
+			Range.first = Min(Range.first, uBegin);
+			Range.second = Max(Range.second, uEnd);
+		}
+		else if(DownloadPlan.Islands.size() < 64)
+			DownloadPlan.Islands.append(qMakePair(uBegin, uEnd));
+		else
+		{
+			DownloadPlan.Islands.clear();
+			DownloadPlan.bIslands = true;
+		}
+	}
+}
+
+void CPartDownloader::OnAvailChanged(uint64 uBegin, uint64 uEnd)
+{
+	// this is triggered when a source announced new parts or went away
+	for(QMap<QByteArray, SDownloadPlan>::iterator I = m_DownloadPlans.begin(); I != m_DownloadPlans.end(); I++)
+		MarkDirty(I.value(), uBegin, uEnd);
+}
+
 const QVector<CPartDownloader::SPart>& CPartDownloader::GetDownloadPlan(CFileHash* pHash)
 {
 	// Z-ToDo: cleanup when a hash was removed
@@ -50,228 +85,270 @@ const QVector<CPartDownloader::SPart>& CPartDownloader::GetDownloadPlan(CFileHas
 	return DownloadPlan.Plan;
 }
 
-struct SSortHolder
+void CPartDownloader::MarkDirty(SDownloadPlan& DownloadPlan, uint64 uBegin, uint64 uEnd)
 {
-	SSortHolder(const SSortHolder& Copy){
-		bErase = true;
-		pScore = new double[Copy.size()];
-		pParts = new QVector<CPartDownloader::SPart>;
-		pParts->resize(Copy.size());
-	}
-	SSortHolder(QVector<CPartDownloader::SPart> &parts, double* score)
-		:pParts(&parts), pScore(score), bErase(false) {}
-	~SSortHolder(){
-		if(bErase)
-			delete pParts;
-		delete pScore;
+	if(DownloadPlan.bFull || DownloadPlan.uPartSize == 0)
+		return; // all parts will be rescored anyways
+
+	int First = uBegin / DownloadPlan.uPartSize;
+	int Last = Min(DivUp(uEnd, DownloadPlan.uPartSize), (uint64)DownloadPlan.Dirty.size());
+	for(int i = First; i < Last; i++)
+	{
+		if(DownloadPlan.Dirty[i])
+			continue;
+		DownloadPlan.Dirty[i] = true;
+		DownloadPlan.DirtyList.append(i);
 	}
-	QVector<CPartDownloader::SPart> *pParts;
-	int size() const {return pParts->size();}
-	double* pScore;
-	bool bErase;
-};
 
-bool PartCmp(SSortHolder& A, uint32 l, uint32 r)
-{
-	return A.pScore[l] >= A.pScore[r];
+	// Note: when a large portion of the parts must be rescored it is cheaper to rebuild the whole plan
+	if(DownloadPlan.DirtyList.size() > DownloadPlan.Dirty.size() / 4)
+		DownloadPlan.bFull = true;
 }
 
-void PartCpy(SSortHolder& T, SSortHolder& S, uint32 t, uint32 s)
+struct SPlanOrder
 {
-	T.pParts->replace(t, S.pParts->at(s));
-	T.pScore[t] = S.pScore[s];
-}
+	SPlanOrder(const QVector<double>& Scores) : m_Scores(Scores) {}
 
-void PartSwap(SSortHolder &A, uint32 r, uint32 l)
-{
-	CPartDownloader::SPart Part = A.pParts->at(r);
-	uint32 uScore = A.pScore[r];
-	A.pParts->replace(r, A.pParts->at(l));
-	A.pScore[r] = A.pScore[l];
-	A.pParts->replace(l, Part);
-	A.pScore[l] = uScore;
-}
+	bool operator()(const CPartDownloader::SPart& A, const CPartDownloader::SPart& B) const
+	{
+		double ScoreA = m_Scores.at(A.iNumber);
+		double ScoreB = m_Scores.at(B.iNumber);
+		if(ScoreA != ScoreB)
+			return ScoreA > ScoreB; // best first
+		return A.iNumber < B.iNumber;
+	}
+
+	const QVector<double>& m_Scores;
+};
 
 void CPartDownloader::UpdatePlan(CFileHash* pHash, SDownloadPlan& DownloadPlan, bool bNow)
 {
 	CFile* pFile = GetFile();
 	CAvailMap* pAvail = pFile->GetStats()->GetAvailMap();
-	bool bWasAllocating = DownloadPlan.bWasAllocating;
-	DownloadPlan.bWasAllocating = pFile->IsAllocating();
-	if(pAvail && (bNow || (
-	 (DownloadPlan.bWasAllocating || bWasAllocating || DownloadPlan.uRevision != pAvail->GetRevision()) && DownloadPlan.uInvalidate < GetCurTick())
-	 ))
+	if(!pAvail)
+		return;
+
+	uint64 PartSize = -1;
+	uint32 PartCount = -1;
+	if(CFileHashSet* pHashSet = qobject_cast<CFileHashSet*>(pHash))
 	{
-		uint64 uStamp = GetCurTick();
+		PartSize = pHashSet->GetPartSize();
+		PartCount = pHashSet->GetPartCount();
+	}
+	else if(CFileHashTree* pHashTree = qobject_cast<CFileHashTree*>(pHash))
+	{
+		PartSize = pHashTree->GetBlockSize();
+		if(pHash->GetType() == HashNeo || pHash->GetType() == HashXNeo)
+			PartSize *= 32;
+		PartCount = DivUp(pHashTree->GetTotalSize(), PartSize);
+	}
 
-		uint64 PartSize = -1;
-		uint32 PartCount = -1;
-		if(CFileHashSet* pHashSet = qobject_cast<CFileHashSet*>(pHash))
-		{
-			PartSize = pHashSet->GetPartSize();
-			PartCount = pHashSet->GetPartCount();
-		}
-		else if(CFileHashTree* pHashTree = qobject_cast<CFileHashTree*>(pHash))
+	if(PartCount == -1)
+		return;
+
+	CPartMap* pParts = pFile->GetPartMap();
+	ASSERT(pParts);
+
+	if(!pParts || pParts->GetSize() != pAvail->GetSize())
+	{
+		ASSERT(0);
+		return;
+	}
+
+	if(DownloadPlan.uPartSize != PartSize || DownloadPlan.Scores.size() != PartCount)
+	{
+		DownloadPlan.uPartSize = PartSize;
+		DownloadPlan.Scores.fill(-1, PartCount);
+		DownloadPlan.Dirty.fill(false, PartCount);
+		DownloadPlan.DirtyList.clear();
+		DownloadPlan.bFull = true;
+	}
+
+	// Note: the plan is rebuild from time to time to reshuffle the random part of the scores
+	if(bNow || DownloadPlan.uNextFull < GetCurTick())
+		DownloadPlan.bFull = true;
+
+	uint32 uCompleteAvail = pFile->GetStats()->GetAvailStatsRaw(DownloadPlan.bFull);
+	if(DownloadPlan.uCompleteAvail != uCompleteAvail)
+	{
+		DownloadPlan.uCompleteAvail = uCompleteAvail;
+		DownloadPlan.bFull = true; // the rarity of every part is relative to the complete sources
+	}
+
+	if(!DownloadPlan.bFull && !DownloadPlan.bIslands && DownloadPlan.Islands.isEmpty() && DownloadPlan.DirtyList.isEmpty())
+		return; // nothing changed
+
+	uint64 uStamp = GetCurTick();
+
+	UpdateBias(DownloadPlan, pParts, PartCount);
+
+	SPlanOrder Order(DownloadPlan.Scores);
+	if(DownloadPlan.bFull)
+	{
+		DownloadPlan.Plan.resize(PartCount);
+		uint32 PlanedParts = 0;
+		for(uint32 i=0; i < PartCount; i++)
 		{
-			PartSize = pHashTree->GetBlockSize();
-			if(pHash->GetType() == HashNeo || pHash->GetType() == HashXNeo)
-				PartSize *= 32;
-			PartCount = DivUp(pHashTree->GetTotalSize(), PartSize);
+			CPartDownloader::SPart Part;
+			double uScore = 0;
+			if(ScorePart(DownloadPlan, i, pParts, pAvail, Part, uScore))
+			{
+				DownloadPlan.Scores[i] = uScore;
+				DownloadPlan.Plan[PlanedParts++] = Part;
+			}
+			else
+				DownloadPlan.Scores[i] = -1;
 		}
+		DownloadPlan.Plan.resize(PlanedParts);
 
-		if(PartCount != -1)
+		std::sort(DownloadPlan.Plan.begin(), DownloadPlan.Plan.end(), Order);
+
+		DownloadPlan.Dirty.fill(false);
+		DownloadPlan.DirtyList.clear();
+		DownloadPlan.bFull = false;
+
+		uint64 uDelay = (GetCurTick() - uStamp) * 100;
+		DownloadPlan.uNextFull = GetCurTick() + Min(SEC2MS(60), Max(SEC2MS(10), uDelay));
+	}
+	else
+	{
+		foreach(int i, DownloadPlan.DirtyList)
 		{
-			CPartMap* pParts = pFile->GetPartMap();
-			ASSERT(pParts);
+			DownloadPlan.Dirty[i] = false;
 
-			if(!pParts || pParts->GetSize() != pAvail->GetSize())
+			// take the part out of the plan, it is found by its old score
+			if(DownloadPlan.Scores[i] >= 0)
 			{
-				ASSERT(0);
-				return;
+				CPartDownloader::SPart Probe;
+				Probe.iNumber = i;
+				QVector<SPart>::iterator I = std::lower_bound(DownloadPlan.Plan.begin(), DownloadPlan.Plan.end(), Probe, Order);
+				ASSERT(I != DownloadPlan.Plan.end() && I->iNumber == i);
+				if(I != DownloadPlan.Plan.end() && I->iNumber == i)
+					DownloadPlan.Plan.erase(I);
 			}
 
-			if(DownloadPlan.Plan.size() != PartCount)
-				DownloadPlan.Plan.resize(PartCount);
-			double* pScore = new double[PartCount];
-
-			QVector<double> Bias;
-			Bias.resize(PartCount);
-			uint64 MaxPartSize = theCore->Cfg()->GetUInt64("HosterCache/PartSize");
-			double ToGo = MaxPartSize / PartSize / 2;
-			if(ToGo <= 0) // part count to go in each direction
-				ToGo = 1;
-			CPartMap::SIterator Iter;
-			while(pParts->IterateRanges(Iter, Part::Available))
+			CPartDownloader::SPart Part;
+			double uScore = 0;
+			if(ScorePart(DownloadPlan, i, pParts, pAvail, Part, uScore))
 			{
-				if((Iter.uState & Part::Available) == 0)
-					continue;
-
-				uint64 uLength = Iter.uEnd - Iter.uBegin;
-				int Count = uLength / PartSize;
-
-				// make sure the bias is the bigger the smaller the iland is
-				double MaxBias = (Count <= ToGo) ? 100 - 100 * Count/ToGo : 0;
-				if(MaxBias < 10) // any iland has a boost of at least 10
-					MaxBias = 10;
-
-				int First = DivUp(Iter.uBegin, PartSize) - 1;
-				int Last = (Iter.uEnd / PartSize) + 1;
-				for(int Cnt = 0, i=First, j=Last; Cnt < ToGo; Cnt++, i--, j++)
-				{
-					double Mod = pow(sqrt(MaxBias) - sqrt(MaxBias * ++Cnt/ToGo), 2);
-					//x                 
-					// x                
-					//  x               
-					//    x             
-					//       x          
-					//             x    
-					// // // // // // // 
-					//		(cnt)
-					if(i >= 0) // befoure the iland
-						Bias[i] += Mod;
-					if(j < PartCount) // after the iland
-						Bias[j] += Mod;
-				}
+				DownloadPlan.Scores[i] = uScore;
+				DownloadPlan.Plan.insert(std::lower_bound(DownloadPlan.Plan.begin(), DownloadPlan.Plan.end(), Part, Order), Part);
 			}
+			else
+				DownloadPlan.Scores[i] = -1;
+		}
+		DownloadPlan.DirtyList.clear();
+	}
 
-			uint32 uCompleteAvail = pFile->GetStats()->GetAvailStatsRaw(true);
+/*#ifdef _DEBUG
+	QString PartsStr;
+	for(int i=0; i < Min(10, DownloadPlan.Plan.size()); i++)
+		PartsStr.append(QString::number(DownloadPlan.Plan[i].iNumber) + ", ");
+	qDebug() << PartsStr;
+#endif*/
+}
 
-			//bool bStream = false;
-			uint32 PlanedParts = 0;
-			for(uint32 i=0; i < PartCount; i++)
-			{
-				CPartDownloader::SPart Part;
-				Part.uBegin = i * PartSize;
-				Part.uEnd = Part.uBegin + PartSize;
-				if(Part.uEnd > pParts->GetSize())
-					Part.uEnd = pParts->GetSize();
-				if(Part.uBegin >= Part.uEnd) // Z-ToDo: fix me
-					continue;
-				Part.iNumber = i;
-
-				SPartRange Inter = pParts->GetRange(Part.uBegin, Part.uEnd, CPartMap::eInter);
-				if((Inter & Part::Available) != 0)
-					continue; // dont plan already completed parts
-				if((Inter & Part::Allocated) == 0)
-					continue; // dont plan parts for that no file was allocated yet
-				if((Inter & Part::Disabled) != 0)
-					continue; // dont plan parts that are dissabled
-				SPartRange Union = pParts->GetRange(Part.uBegin, Part.uEnd, CPartMap::eUnion);
-
-				// start with base score
-				double uScore = 1.0;
-
-				if((Union & Part::Required) != 0)
-				{
-					uScore += 1000 * 100;
-				}
-				else if((Union & Part::Stream) != 0)
-				{
-				//	bStream = true;
-					if(Union.iPriority == 0)
-						continue;
-
-					uScore += 1000 * 10; // that must be bigger than the random part
-				}
-				else
-				{
-					uScore += 500.0 * qrand() / RAND_MAX;
-
-					// stimulate island groth
-					uScore += (Bias[i] >= 1000 ? 1000 : Bias[i]) / 10;
-				}
-				
-				// add part priority
-				if(Union.iPriority)
-				{
-					int iPriority2 = Union.iPriority*Union.iPriority; // ^2
-					uScore += iPriority2; 
-					uScore *= iPriority2; 
-				}
-
-				if((Union & Part::Stream) != 0 || (Union & Part::Required) != 0)
-					Part.bStream = true;
-				else
-				{
-					// rare parts have priority
-					uint32 uAvail = pAvail->GetRange(Part.uBegin, Part.uEnd, CAvailMap::eUnion);
-					if(uCompleteAvail)
-					{
-						if(uAvail > uCompleteAvail)
-							uAvail -= uCompleteAvail;
-						else // uCompleteAvail is out of date
-							uAvail = 1;
-					}
-					if(uAvail < 10) 
-						uScore *= 11 - uAvail; // * 1 - 10
-
-					// partialy completed
-					if((Union & Part::Available) != 0) 
-						uScore *= 100; // incompete bust started parts have super high priority
-				}
-
-				DownloadPlan.Plan[PlanedParts] = Part;
-				pScore[PlanedParts] = uScore;
-				PlanedParts++;
-			}
-			DownloadPlan.Plan.resize(PlanedParts);
+void CPartDownloader::UpdateBias(SDownloadPlan& DownloadPlan, CPartMap* pParts, int PartCount)
+{
+	uint64 PartSize = DownloadPlan.uPartSize;
+	uint64 MaxPartSize = theCore->Cfg()->GetUInt64("HosterCache/PartSize");
+	double ToGo = MaxPartSize / PartSize / 2;
+	if(ToGo <= 0) // part count to go in each direction
+		ToGo = 1;
 
-            SSortHolder Holder(DownloadPlan.Plan, pScore); // this deletes pScore
-			//if(bStream)
-				MergeSort(Holder, &PartCpy, &PartCmp);
-			//else // use unstabile heapsort for better randomization
-			//	HeapSort(Holder, &PartSwap, &PartCmp);
+	if(DownloadPlan.bFull || DownloadPlan.Bias.size() != PartCount)
+	{
+		DownloadPlan.Bias.resize(PartCount);
+		CalcIslandBias(pParts, Part::Available, PartSize, ToGo, DownloadPlan.Bias.data(), 0, PartCount);
+		DownloadPlan.Islands.clear();
+		DownloadPlan.bIslands = false;
+		return;
+	}
 
-/*#ifdef _DEBUG
-			QString PartsStr;
-			for(int i=0; i < Min(10, PlanedParts); i++)
-				PartsStr.append(QString::number(DownloadPlan.Plan[i].iNumber) + ", ");
-			qDebug() << PartsStr;
-#endif*/
+	// Note: only the parts close to a changed range can get a different bias
+	if(DownloadPlan.bIslands)
+	{
+		DownloadPlan.Islands.clear();
+		DownloadPlan.Islands.append(qMakePair((uint64)0, pParts->GetSize()));
+	}
+	QVector<int> Changed;
+	UpdateIslandBias(pParts, Part::Available, PartSize, ToGo, DownloadPlan.Bias, DownloadPlan.Islands, Changed);
+	DownloadPlan.Islands.clear();
+	DownloadPlan.bIslands = false;
+
+	foreach(int i, Changed)
+		MarkDirty(DownloadPlan, i * PartSize, (i + 1) * PartSize);
+}
+
+bool CPartDownloader::ScorePart(SDownloadPlan& DownloadPlan, int Index, CPartMap* pParts, CAvailMap* pAvail, SPart& Part, double& uScore)
+{
+	Part.uBegin = Index * DownloadPlan.uPartSize;
+	Part.uEnd = Part.uBegin + DownloadPlan.uPartSize;
+	if(Part.uEnd > pParts->GetSize())
+		Part.uEnd = pParts->GetSize();
+	if(Part.uBegin >= Part.uEnd) // Z-ToDo: fix me
+		return false;
+	Part.iNumber = Index;
+
+	SPartRange Inter = pParts->GetRange(Part.uBegin, Part.uEnd, CPartMap::eInter);
+	if((Inter & Part::Available) != 0)
+		return false; // dont plan already completed parts
+	if((Inter & Part::Allocated) == 0)
+		return false; // dont plan parts for that no file was allocated yet
+	if((Inter & Part::Disabled) != 0)
+		return false; // dont plan parts that are dissabled
+	SPartRange Union = pParts->GetRange(Part.uBegin, Part.uEnd, CPartMap::eUnion);
+
+	// start with base score
+	uScore = 1.0;
+
+	if((Union & Part::Required) != 0)
+	{
+		uScore += 1000 * 100;
+	}
+	else if((Union & Part::Stream) != 0)
+	{
+		if(Union.iPriority == 0)
+			return false;
+
+		uScore += 1000 * 10; // that must be bigger than the random part
+	}
+	else
+	{
+		uScore += 500.0 * qrand() / RAND_MAX;
 
-			DownloadPlan.uRevision = pAvail->GetRevision();
-			uint64 uDelay = (GetCurTick() - uStamp) * 100;
-			DownloadPlan.uInvalidate = GetCurTick() + Min(SEC2MS(10), Max(SEC2MS(1), uDelay));
+		// stimulate island groth
+		double Bias = DownloadPlan.Bias[Index];
+		uScore += (Bias >= 1000 ? 1000 : Bias) / 10;
+	}
+	
+	// add part priority
+	if(Union.iPriority)
+	{
+		int iPriority2 = Union.iPriority*Union.iPriority; // ^2
+		uScore += iPriority2; 
+		uScore *= iPriority2; 
+	}
+
+	if((Union & Part::Stream) != 0 || (Union & Part::Required) != 0)
+		Part.bStream = true;
+	else
+	{
+		// rare parts have priority
+		uint32 uAvail = pAvail->GetRange(Part.uBegin, Part.uEnd, CAvailMap::eUnion);
+		if(DownloadPlan.uCompleteAvail)
+		{
+			if(uAvail > DownloadPlan.uCompleteAvail)
+				uAvail -= DownloadPlan.uCompleteAvail;
+			else // uCompleteAvail is out of date
+				uAvail = 1;
 		}
+		if(uAvail < 10) 
+			uScore *= 11 - uAvail; // * 1 - 10
+
+		// partialy completed
+		if((Union & Part::Available) != 0) 
+			uScore *= 100; // incompete bust started parts have super high priority
 	}
+	return true;
 }
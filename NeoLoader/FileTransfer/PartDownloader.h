@@ -4,6 +4,13 @@
 //#include "../FileList/FileList.h"
 #include "../FileList/File.h"
 
+class CPartMap;
+class CAvailMap;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// The download plan lists the parts to download best first, it is maintained incrementally,
+// only parts whose state or availability changed are rescored and moved within the plan
+
 class CPartDownloader: public QObjectEx
 {
 	Q_OBJECT
@@ -30,22 +37,34 @@ public:
 
 public slots:
 	void							OnChange(bool Purge);
+	void							OnRangeChanged(uint64 uBegin, uint64 uEnd);
+	void							OnAvailChanged(uint64 uBegin, uint64 uEnd);
 
 protected:
 
 	struct SDownloadPlan
 	{
 		SDownloadPlan() 
-		 : uRevision(0), uInvalidate(0), bWasAllocating(false), Type(HashUnknown) {}
+		 : uPartSize(0), uCompleteAvail(0), uNextFull(0), bFull(true), bIslands(true), Type(HashUnknown) {}
 
-		QVector<SPart>		Plan;
+		QVector<SPart>		Plan;		// planed parts best first
+		QVector<double>		Scores;		// by part number, negative if the part is not planed
+		QVector<double>		Bias;		// island growth bias by part number
+		QVector<bool>		Dirty;		// by part number
+		QVector<int>		DirtyList;	// parts to be rescored
+		QVector<QPair<uint64, uint64> > Islands; // ranges that changed, the island bias around them must be recalculated
 
-		uint32 uRevision;
-		uint64 uInvalidate;
-		bool bWasAllocating;
+		uint64 uPartSize;
+		uint32 uCompleteAvail;
+		uint64 uNextFull;
+		bool bFull;						// rescore all parts
+		bool bIslands;					// to many ranges changed, the island bias must be recalculated for all parts
 		EFileHashType Type;
 	};
 	QMap<QByteArray, SDownloadPlan>		m_DownloadPlans;
 
 	void							UpdatePlan(CFileHash* pHash, SDownloadPlan& DownloadPlan, bool bNow = false);
+	void							MarkDirty(SDownloadPlan& DownloadPlan, uint64 uBegin, uint64 uEnd);
+	void							UpdateBias(SDownloadPlan& DownloadPlan, CPartMap* pParts, int PartCount);
+	bool							ScorePart(SDownloadPlan& DownloadPlan, int Index, CPartMap* pParts, CAvailMap* pAvail, SPart& Part, double& uScore);
 };
@@ -12,6 +12,7 @@
 #include "./NeoShare/NeoEntity.h"
 #include "../Networking/BandwidthControl/BandwidthLimit.h"
 #include "../NeoCore.h"
+#include "UploadManager.h"
 #include "../FileList/IOManager.h"
 #include "PartDownloader.h"
 #include <math.h>
@@ -378,11 +379,16 @@ CP2PTransfer::CP2PTransfer()
 	m_UploadStartTime = 0;
 	m_DownloadedBytes = 0;
 	m_DownloadStartTime = 0;
+
+	m_eQueuedState = eNoUpload;
 }
 
 CP2PTransfer::~CP2PTransfer()
 {
 	ASSERT(m_ReservedSize == 0);
+
+	if(m_eQueuedState != eNoUpload && theCore->m_UploadManager)
+		theCore->m_UploadManager->RemoveTransfer(this);
 }
 
 bool CP2PTransfer::Process(UINT Tick)
@@ -390,6 +396,10 @@ bool CP2PTransfer::Process(UINT Tick)
 	if(IsActiveDownload() && RequestedBlocks() == 0)
 		RequestBlocks();
 
+	// Note: the upload manager does not walk all transfers on every tick, we tell it when our upload state changed
+	if(GetUploadState() != m_eQueuedState)
+		theCore->m_UploadManager->UpdateTransfer(this);
+
 	// if we return false the transfer will be removed
 	return !HasError();
 }
@@ -492,6 +502,7 @@ void CP2PTransfer::RangeReceived(uint64 uBegin, uint64 uEnd, QByteArray Data)
 	ASSERT(pInspector);
 	CCorruptionLogger* pLogger = pInspector->GetLogger(GetHash());
 
+	bool bCached = false;
 	CPartMap::SIterator FileIter(uBegin, uEnd);
 	while(pFileParts->IterateRanges(FileIter, Part::Available | Part::Cached))
 	{
@@ -503,13 +514,13 @@ void CP2PTransfer::RangeReceived(uint64 uBegin, uint64 uEnd, QByteArray Data)
 		uint64 uOffset = FileIter.uBegin - uBegin;
 		ASSERT(FileIter.uEnd <= uEnd);
 		uint64 uLength = FileIter.uEnd - FileIter.uBegin;
-		if(uOffset == 0 && uLength == Data.length()) // default happy case
-			theCore->m_IOManager->WriteData(pFile, pFile->GetFileID(), uBegin, Data, NULL);
-		else // fragmented case, endgame hit!
-		{
-			QByteArray Fragment = Data.mid(uOffset, uLength);
-			theCore->m_IOManager->WriteData(pFile, pFile->GetFileID(), FileIter.uBegin, Fragment, NULL);
-		}
+		// Note: the default happy case is the whole range, a fragment means endgame hit!
+		QByteArray Fragment = (uOffset == 0 && uLength == Data.length()) ? Data : Data.mid(uOffset, uLength);
+
+		// hash the data while we still have it in memory
+		pInspector->OnDataReceived(FileIter.uBegin, Fragment);
+
+		theCore->m_IOManager->WriteData(pFile, pFile->GetFileID(), FileIter.uBegin, Fragment, NULL);
 
 		// Log transfer in case of corruption
 		if(pLogger)
@@ -520,6 +531,25 @@ void CP2PTransfer::RangeReceived(uint64 uBegin, uint64 uEnd, QByteArray Data)
 			pJoinedParts->SetSharedRange(FileIter.uBegin, FileIter.uEnd, Part::Cached, CPartMap::eAdd);
 		else
 			pFileParts->SetRange(FileIter.uBegin, FileIter.uEnd, Part::Cached, CPartMap::eAdd);
+		bCached = true;
+	}
+
+	// Note: the write back cache holds small runs back for a while, once a part is complete we flush it right away,
+	//			so it can be verified and shared without waiting for the write back delay
+	CFileHashPtr& pMasterHash = pFile->GetMasterHash();
+	uint64 uPartSize = pMasterHash.isNull() ? 0 : pMasterHash->GetPartSize();
+	if(bCached && uPartSize && uPartSize != -1 && theCore->Cfg()->GetInt("Content/WriteBackDelay") > 0)
+	{
+		for(uint64 uPartBegin = uBegin - (uBegin % uPartSize); uPartBegin < uEnd; uPartBegin += uPartSize)
+		{
+			uint64 uPartEnd = Min(uPartBegin + uPartSize, pFile->GetFileSize());
+			bool bComplete = true;
+			CPartMap::SIterator PartIter(uPartBegin, uPartEnd);
+			while(bComplete && pFileParts->IterateRanges(PartIter, Part::Available | Part::Cached))
+				bComplete = (PartIter.uState & (Part::Available | Part::Cached)) != 0;
+			if(bComplete)
+				theCore->m_IOManager->FlushData(pFile->GetFileID(), uPartBegin, uPartEnd);
+		}
 	}
 
 	CTransfer::RangeReceived(uBegin, uEnd);
@@ -559,6 +589,17 @@ void CP2PTransfer::PartsAvailable(const QBitArray &Parts, uint64 uPartSize, uint
 	CheckInterest();
 }*/
 
+CP2PTransfer::EUploadState CP2PTransfer::GetUploadState() const
+{
+	if(!IsUpload())
+		return eNoUpload;
+	if(IsActiveUpload())
+		return eActiveUpload;
+	if(IsWaitingUpload())
+		return eWaitingUpload;
+	return eNoUpload;
+}
+
 double CP2PTransfer::GetProbabilityRange()
 {
 	CFile* pFile = GetFile();
@@ -239,6 +239,17 @@ public:
 
 	virtual double					GetProbabilityRange();
 
+	enum EUploadState
+	{
+		eNoUpload = 0,
+		eWaitingUpload,
+		eActiveUpload
+	};
+	EUploadState					GetUploadState() const;
+	// Note: the state the upload manager has on record for this transfer
+	EUploadState					GetQueuedState() const				{return m_eQueuedState;}
+	void							SetQueuedState(EUploadState eState)	{m_eQueuedState = eState;}
+
 	virtual uint64					GetAvailableSize()					{return m_AvailableBytes;}
 
 	virtual void					StopUpload(bool bStalled = false) = 0;
@@ -285,6 +296,8 @@ protected:
 	uint64							m_UploadStartTime;
 	uint64							m_DownloadedBytes;
 	uint64							m_DownloadStartTime;
+
+	EUploadState					m_eQueuedState;
 };
 
 //#define REQ_DEBUG
@@ -24,7 +24,6 @@
 CUploadManager::CUploadManager(QObject* qObject)
 : QObjectEx(qObject)
 {
-	m_WaitingUploads = 0;
 	m_NextUploadStart = 0;
 	m_LastUploadDowngrade = 0;
 	m_LastUploadUpgrade = 0;
@@ -32,7 +31,8 @@ CUploadManager::CUploadManager(QObject* qObject)
 	m_LastFullSlotCount = 0;
 	m_LastTricklSlotCount = 0;
 
-	m_ProbabilityRange = 1.0;
+	m_LastFileID = 0;
+	m_NextFilePass = 0;
 }
 
 #ifndef NO_HOSTERS
@@ -84,6 +84,7 @@ bool CUploadManager::OrderUpload(CFile* pFile, QStringList Hosts, CPartMap* pMap
 					pHosterLink->SetPartMap(pPartMap);
 
 					pFile->AddTransfer(pHosterLink);
+					m_HosterUploads.append(pHosterLink);
 
 					SrcIter.uBegin = SrcIter.uEnd;
 				}
@@ -125,6 +126,7 @@ bool CUploadManager::OrderSolUpload(CFile* pFile, QStringList Hosts)
 		pHosterLink->SetPartMap(pPartMap);
 
 		pFile->AddTransfer(pHosterLink);
+		m_HosterUploads.append(pHosterLink);
 	}
 	return true;
 }
@@ -167,6 +169,7 @@ bool CUploadManager::OrderReUpload(CHosterLink* pOldLink)
 	}
 
 	pFile->AddTransfer(pHosterLink);
+	m_HosterUploads.append(pHosterLink);
 
 	return true;
 }
@@ -185,128 +188,229 @@ void SlotHeapMov(QVector<CUploadManager::SUploadSlot> &refArray, uint32 r, uint3
 }
 
 
-void CUploadManager::Process(UINT Tick)
+static CMuleSource* GetHordeSource(CP2PTransfer* pP2PTransfer)
 {
-	m_Uploads.clear();
+	if(CMuleSource* pMuleSource = qobject_cast<CMuleSource*>(pP2PTransfer))
+	{
+		if(CMuleClient* pMuleClient = pMuleSource->GetClient())
+		{
+			if(pMuleClient->ProtocolRevision() != 0 && (pP2PTransfer->IsWaitingDownload() || pP2PTransfer->IsActiveDownload()))
+				return pMuleSource;
+		}
+	}
+	return NULL;
+}
 
-#ifndef NO_HOSTERS
-	bool bReUpload = theCore->Cfg()->GetBool("Hoster/AutoReUpload");
-	bool bHosterCache = theCore->Cfg()->GetString("HosterCache/CacheMode") != "Off";
-#endif
+void CUploadManager::UpdateTransfer(CP2PTransfer* pP2PTransfer)
+{
+	CP2PTransfer::EUploadState eState = pP2PTransfer->GetUploadState();
+	pP2PTransfer->SetQueuedState(eState);
 
-	// eMule Hording BEGIN
-	int HordeUploads = 0;
-	int HordeActive = 0;
-	QMultiMap<double, CMuleSource*> HordePending;
-	// eMule Hording END
+	if(eState == CP2PTransfer::eActiveUpload)
+		m_ActiveUploads.insert(pP2PTransfer);
+	else
+		m_ActiveUploads.remove(pP2PTransfer);
 
-	m_ProbabilityRange = 0;
-	QMap<double, CP2PTransfer*> ReadyUploads;
-	foreach(CFile* pFile, theCore->m_FileManager->GetFiles())
+	CFile* pFile = pP2PTransfer->GetFile();
+	if(eState == CP2PTransfer::eWaitingUpload && pFile && pFile->IsStarted() && !pFile->IsPaused())
 	{
-		if(!pFile->IsStarted() || pFile->IsPaused())
-			continue;
+		m_Queue.Update(pP2PTransfer, pP2PTransfer->GetProbabilityRange());
 
-#ifndef NO_HOSTERS
-		bool iReUpload = pFile->GetProperty("ReUpload").toInt();
-		if(!iReUpload)
-			iReUpload = bReUpload ? 1 : 0;
-				
-		if((Tick & EPerSec) != 0 && pFile->IsAutoShare())
+		// eMule Hording BEGIN
+		CMuleSource* pMuleSource = qobject_cast<CMuleSource*>(pP2PTransfer);
+		if(pMuleSource && pMuleSource->GetClient() && pMuleSource->GetClient()->ProtocolRevision() != 0)
+			m_HordeQueue.insert(pP2PTransfer);
+		else
+			m_HordeQueue.remove(pP2PTransfer);
+		// eMule Hording END
+	}
+	else
+	{
+		m_Queue.Remove(pP2PTransfer);
+		m_HordeQueue.remove(pP2PTransfer);
+	}
+}
+
+void CUploadManager::RemoveTransfer(CP2PTransfer* pP2PTransfer)
+{
+	m_ActiveUploads.remove(pP2PTransfer);
+	m_Queue.Remove(pP2PTransfer);
+	m_HordeQueue.remove(pP2PTransfer);
+}
+
+void CUploadManager::StartUpload(CP2PTransfer* pP2PTransfer)
+{
+	// Note: a drawn transfer leaves the queues before it is started, if it stays waiting (e.g. the client is not connected)
+	//			it is queued again with its next state report, so it can not take more than one slot in a round
+	m_Queue.Remove(pP2PTransfer);
+	m_HordeQueue.remove(pP2PTransfer);
+
+	pP2PTransfer->StartUpload();
+
+	if(pP2PTransfer->GetUploadState() == CP2PTransfer::eActiveUpload)
+		UpdateTransfer(pP2PTransfer);
+	else
+		pP2PTransfer->SetQueuedState(CP2PTransfer::eNoUpload);
+}
+
+void CUploadManager::ProcessFiles()
+{
+	if(m_LastFileID == 0) // a new pass begins
+	{
+		if(m_NextFilePass > GetCurTick())
+			return; // relevant for short lists only
+		m_NextFilePass = GetCurTick() + SEC2MS(10);
+	}
+
+	// Note: Process runs 4 times a second, so with this slice size every file is visited about once in 10 seconds
+	int Slice = theCore->m_FileManager->GetFileCount() / 40 + 1;
+	for(int i=0; i < Slice; i++)
+	{
+		CFile* pFile = theCore->m_FileManager->GetNextFile(m_LastFileID);
+		if(!pFile)
 		{
-			pFile->SetProperty("HosterUl", bHosterCache);
+			m_LastFileID = 0;
+			break;
 		}
+		m_LastFileID = pFile->GetFileID();
+
+		ProcessFile(pFile);
+	}
+}
+
+void CUploadManager::ProcessFile(CFile* pFile)
+{
+	bool bActive = pFile->IsStarted() && !pFile->IsPaused();
+
+#ifndef NO_HOSTERS
+	bool iReUpload = pFile->GetProperty("ReUpload").toInt();
+	if(!iReUpload)
+		iReUpload = theCore->Cfg()->GetBool("Hoster/AutoReUpload") ? 1 : 0;
+			
+	if(bActive && pFile->IsAutoShare())
+	{
+		pFile->SetProperty("HosterUl", theCore->Cfg()->GetString("HosterCache/CacheMode") != "Off");
+	}
 #endif
 
-		int ActiveUploads = 0;
-		int WaitingUploads = 0;
-		int PendingUploads = 0;
+	int ActiveUploads = 0;
+	int WaitingUploads = 0;
+	int PendingUploads = 0;
 
-		foreach(CTransfer* pTransfer, pFile->GetTransfers())
+	foreach(CTransfer* pTransfer, pFile->GetTransfers())
+	{
+		// Note: this rescores the queued transfers and picks up what they could not report them self, like a paused or resumed file
+		if(CP2PTransfer* pP2PTransfer = qobject_cast<CP2PTransfer*>(pTransfer))
 		{
+			if(pP2PTransfer->GetQueuedState() != CP2PTransfer::eNoUpload || pP2PTransfer->GetUploadState() != CP2PTransfer::eNoUpload)
+				UpdateTransfer(pP2PTransfer);
+		}
+
+		if(!bActive)
+			continue;
+
 #ifndef NO_HOSTERS
-			if(iReUpload == 1 && pTransfer->IsDownload())
+		if(iReUpload == 1 && pTransfer->IsDownload())
+		{
+			if(CHosterLink* pHosterLink = qobject_cast<CHosterLink*>(pTransfer)) // Hoster uplaods get a different threatment
 			{
-				if(CHosterLink* pHosterLink = qobject_cast<CHosterLink*>(pTransfer)) // Hoster uplaods get a different threatment
+				if(pHosterLink->GetUploadInfo() == CHosterLink::eManualUpload)
 				{
-					if(pHosterLink->GetUploadInfo() == CHosterLink::eManualUpload)
+					if(pHosterLink->GetError() == "TaskFailed")
 					{
-						if(pHosterLink->GetError() == "TaskFailed")
-						{
-							OrderReUpload(pHosterLink);
-							pHosterLink->SetDeprecated();
-						}
+						OrderReUpload(pHosterLink);
+						pHosterLink->SetDeprecated();
 					}
 				}
 			}
+		}
 #endif
 
-			if(!pTransfer->IsUpload())
-				continue;
+		if(!pTransfer->IsUpload())
+			continue;
 
-			if(pTransfer->IsActiveUpload())
-			{
-				ActiveUploads++;
-				m_Uploads.append(pTransfer);
-			}
-			else if(pTransfer->IsWaitingUpload())
-				WaitingUploads++;
+		if(pTransfer->IsActiveUpload())
+			ActiveUploads++;
+		else if(pTransfer->IsWaitingUpload())
+			WaitingUploads++;
 
 #ifndef NO_HOSTERS
-			if(CHosterLink* pHosterLink = qobject_cast<CHosterLink*>(pTransfer)) // Hoster uplaods get a different threatment
-			{
-				if(pHosterLink->IsWaitingUpload() && theCore->m_WebManager->GetUploads() < theCore->Cfg()->GetInt("Hoster/MaxUploads"))
-				{
-					if(!pHosterLink->HasError()) // if its a IsWaitingUpload with an error its waiting for a error reset and retry
-						pHosterLink->StartUpload();
-				}
+		if(CHosterLink* pHosterLink = qobject_cast<CHosterLink*>(pTransfer))
+		{
+			if(!m_HosterUploads.contains(pHosterLink))
+				m_HosterUploads.append(pHosterLink);
 
-				PendingUploads++;
-			}
-			else 
+			PendingUploads++;
+		}
 #endif
-				if(CP2PTransfer* pP2PTransfer = qobject_cast<CP2PTransfer*>(pTransfer))
-			{
-				if(pP2PTransfer->IsWaitingUpload())
-				{
-					m_ProbabilityRange += pP2PTransfer->GetProbabilityRange();
-
-					ReadyUploads.insert(m_ProbabilityRange,pP2PTransfer);
-				}
+	}
 
-				// eMule Hording BEGIN
-				if(CMuleSource* pMuleSource = qobject_cast<CMuleSource*>(pP2PTransfer))
-				{
-					if(CMuleClient* pMuleClient = pMuleSource->GetClient())
-					{
-						if(pMuleClient->ProtocolRevision() != 0 && (pTransfer->IsWaitingDownload() || pTransfer->IsActiveDownload()))
-						{
-							if(pTransfer->IsActiveUpload())
-							{
-								HordeUploads++;
-								if(pMuleClient->GetHordeState() != CMuleClient::eRejected)
-									HordeActive++; // count not yet asked horce clients as active
-							}
-							else if(pTransfer->IsWaitingUpload())
-							{
-								HordePending.insert(-pP2PTransfer->GetProbabilityRange(), pMuleSource); // conunt of clients potentialy capable of horde
-							}
-						}
-					}
-				}
-				// eMule Hording END
-			}
-		}
+	if(!bActive)
+		return;
 
-		pFile->SetUploads(ActiveUploads, WaitingUploads);
+	pFile->SetUploads(ActiveUploads, WaitingUploads);
 
 #ifndef NO_HOSTERS
-		if((Tick & EPer10Sec) != 0 && !pFile->IsRawArchive() && pFile->IsHosterUl() && PendingUploads == 0) // only every 10 sec
-			InspectCache(pFile);
+	if(!pFile->IsRawArchive() && pFile->IsHosterUl() && PendingUploads == 0)
+		InspectCache(pFile);
 #endif
+}
+
+void CUploadManager::Process(UINT Tick)
+{
+	// Note: P2P transfers report their upload state changes them self, 
+	//			the files are only visited in slices for bookkeeping and to resync what could not be reported
+	ProcessFiles();
+
+	m_Uploads.clear();
+
+	// eMule Hording BEGIN
+	int HordeUploads = 0;
+	int HordeActive = 0;
+	// eMule Hording END
+
+	foreach(CP2PTransfer* pP2PTransfer, m_ActiveUploads)
+	{
+		CFile* pFile = pP2PTransfer->GetFile();
+		if(!pFile->IsStarted() || pFile->IsPaused())
+			continue;
+
+		m_Uploads.append(pP2PTransfer);
+
+		// eMule Hording BEGIN
+		if(CMuleSource* pMuleSource = GetHordeSource(pP2PTransfer))
+		{
+			HordeUploads++;
+			if(pMuleSource->GetClient()->GetHordeState() != CMuleClient::eRejected)
+				HordeActive++; // count not yet asked horce clients as active
+		}
+		// eMule Hording END
 	}
 
-	m_WaitingUploads = ReadyUploads.count();
+#ifndef NO_HOSTERS
+	for(QList<QPointer<CTransfer> >::iterator I = m_HosterUploads.begin(); I != m_HosterUploads.end();)
+	{
+		CHosterLink* pHosterLink = qobject_cast<CHosterLink*>(I->data());
+		if(!pHosterLink || !pHosterLink->IsUpload())
+		{
+			I = m_HosterUploads.erase(I);
+			continue;
+		}
+		I++;
+
+		CFile* pFile = pHosterLink->GetFile();
+		if(!pFile->IsStarted() || pFile->IsPaused())
+			continue;
+
+		if(pHosterLink->IsActiveUpload())
+			m_Uploads.append(pHosterLink);
+		else if(pHosterLink->IsWaitingUpload() && theCore->m_WebManager->GetUploads() < theCore->Cfg()->GetInt("Hoster/MaxUploads"))
+		{
+			if(!pHosterLink->HasError()) // if its a IsWaitingUpload with an error its waiting for a error reset and retry
+				pHosterLink->StartUpload();
+		}
+	}
+#endif
 
 	int MaxSlotSpeed = theCore->Cfg()->GetInt("Upload/SlotSpeed");
 	if(!MaxSlotSpeed)
@@ -540,7 +644,18 @@ void CUploadManager::Process(UINT Tick)
 		AddTrickle = TrickleVolume - TricklSlotCount;
 
 	// eMule Hording BEGIN
-	while(!HordePending.isEmpty() && HordeActive < theCore->Cfg()->GetInt("Ed2kMule/MinHordeSlots") && (HordeUploads == 0 || AcceptHorde()))
+	int MinHordeSlots = theCore->Cfg()->GetInt("Ed2kMule/MinHordeSlots");
+	QMultiMap<double, CMuleSource*> HordePending;
+	if(HordeActive < MinHordeSlots)
+	{
+		foreach(CP2PTransfer* pP2PTransfer, m_HordeQueue)
+		{
+			if(CMuleSource* pMuleSource = GetHordeSource(pP2PTransfer))
+				HordePending.insert(-pP2PTransfer->GetProbabilityRange(), pMuleSource); // conunt of clients potentialy capable of horde
+		}
+	}
+
+	while(!HordePending.isEmpty() && HordeActive < MinHordeSlots && (HordeUploads == 0 || AcceptHorde()))
 	{
 		HordeActive++;
 		AddSlots--;
@@ -548,11 +663,11 @@ void CUploadManager::Process(UINT Tick)
 		QMap<double, CMuleSource*>::iterator I = HordePending.begin();
 		ASSERT(I != HordePending.end());
 		CMuleSource* pMuleSource = I.value();
-		ReadyUploads.remove(ReadyUploads.key(pMuleSource));
+		HordePending.erase(I);
 
 		AddSlots--;
 		pMuleSource->GetFile()->LogLine(LOG_DEBUG | LOG_INFO, tr("Starting upload of %1 to %2 (hording)").arg(pMuleSource->GetFile()->GetFileName()).arg(pMuleSource->GetDisplayUrl()));
-		pMuleSource->StartUpload();
+		StartUpload(pMuleSource);
 	}
 	// eMule Hording END
 
@@ -562,22 +677,25 @@ void CUploadManager::Process(UINT Tick)
 		if(AddSlots < AddTrickle)
 			AddSlots = AddTrickle;
 		
-		while(!ReadyUploads.isEmpty() && AddSlots > 0)
+		while(m_Queue.GetCount() > 0 && AddSlots > 0)
 		{
 			// U-ToDo-Now: add wait time based uplad start falback for unlucky clients
 
-			double dRand = double(GetRand64() & 0x00000000FFFFFFFF)/1000.0;
-			double dMod = fmod(dRand, m_ProbabilityRange);
-			QMap<double, CP2PTransfer*>::iterator I = ReadyUploads.upperBound(dMod);
-			if(I == ReadyUploads.end()) // fallback
-				I = ReadyUploads.find(ReadyUploads.keys().at(rand()%ReadyUploads.count()));
-			ASSERT(I != ReadyUploads.end());
-			CP2PTransfer* pP2PTransfer = I.value();
-			ReadyUploads.erase(I);
+			CP2PTransfer* pP2PTransfer = m_Queue.Find(GetRand64() % m_Queue.GetTickets());
+			ASSERT(pP2PTransfer);
+
+			// Note: a queued transfer may have left the queue since it last reported, or its file got paused, 
+			//			UpdateTransfer takes it out than and we draw again
+			CFile* pFile = pP2PTransfer->GetFile();
+			if(pP2PTransfer->GetUploadState() != CP2PTransfer::eWaitingUpload || !pFile->IsStarted() || pFile->IsPaused())
+			{
+				UpdateTransfer(pP2PTransfer);
+				continue;
+			}
 
 			AddSlots--;
-			pP2PTransfer->GetFile()->LogLine(LOG_DEBUG | LOG_INFO, tr("Starting upload of %1 to %2").arg(pP2PTransfer->GetFile()->GetFileName()).arg(pP2PTransfer->GetDisplayUrl()));
-			pP2PTransfer->StartUpload();
+			pFile->LogLine(LOG_DEBUG | LOG_INFO, tr("Starting upload of %1 to %2").arg(pFile->GetFileName()).arg(pP2PTransfer->GetDisplayUrl()));
+			StartUpload(pP2PTransfer);
 
 			m_StartHistory.append(GetCurTick());
 			while(m_StartHistory.count() > theCore->Cfg()->GetInt("Upload/HistoryDepth"))
@@ -812,6 +930,7 @@ void CUploadManager::InspectCache(CFile* pFile)
 		pHosterLink->InitCrypto();
 
 	pFile->AddTransfer(pHosterLink);
+	m_HosterUploads.append(pHosterLink);
 }
 
 QString CUploadManager::SelectUploadHost(CFile* pFile, CShareMap* pPartMap)
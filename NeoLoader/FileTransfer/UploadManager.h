@@ -9,6 +9,7 @@ struct SCachePart;
 class CCacheMap;
 
 #include "Transfer.h"
+#include "UploadQueue.h"
 
 class CUploadManager: public QObjectEx
 {
@@ -20,8 +21,8 @@ public:
 
 	void							Process(UINT Tick);
 
-	double							GetProbabilityRange()			{if(m_ProbabilityRange == 0) return 1; 
-																	return m_ProbabilityRange;}
+	double							GetProbabilityRange()			{if(m_Queue.GetTickets() == 0) return 1; 
+																	return m_Queue.GetWeight();}
 	uint64							GetAverageStartTime()			{if(m_StartHistory.count() < 2) return MIN2MS(1); 
 																	return (m_StartHistory.last() - m_StartHistory.first()) / m_StartHistory.size();}
 
@@ -39,8 +40,12 @@ public:
 	bool							AcceptHorde(CP2PTransfer* pP2PTransfer);
 	bool							AcceptHorde();
 
+	// Note: P2P transfers call this when their upload state changed, it (re)queues or dequeues the transfer
+	void							UpdateTransfer(CP2PTransfer* pP2PTransfer);
+	void							RemoveTransfer(CP2PTransfer* pP2PTransfer);
+
 	int								GetActiveCount()				{return m_Uploads.count();}
-	int								GetWaitingCount()				{return m_WaitingUploads;}
+	int								GetWaitingCount()				{return m_Queue.GetCount();}
 
 	const QList<QPointer<CTransfer> >& GetTransfers()				{return m_Uploads;}
 
@@ -75,13 +80,16 @@ public:
 	};
 
 protected:
+	void							ProcessFiles();
+	void							ProcessFile(CFile* pFile);
+	void							StartUpload(CP2PTransfer* pP2PTransfer);
+
 #ifndef NO_HOSTERS
 	void							InspectRange(QMultiMap<int, SCachePart>& CacheQueue, uint64 uBegin, uint64 uEnd, bool bAvail, uint32 uCached, uint32 uNeeded, uint64 FileSize, uint64 PartSize);
 	void							InspectCache(CFile* pFile);
 	QString							SelectUploadHost(CFile* pFile, CShareMap* pPartMap);
 #endif
 
-	int								m_WaitingUploads;
 	uint64							m_NextUploadStart;
 	uint64							m_LastUploadDowngrade;
 	uint64							m_LastUploadUpgrade;
@@ -89,9 +97,17 @@ protected:
 	int								m_LastFullSlotCount;
 	int								m_LastTricklSlotCount;
 
-	double							m_ProbabilityRange;
 	QList<uint64>					m_StartHistory;
 
+	CUploadQueue					m_Queue;		// waiting P2P uploads of started files
+	QSet<CP2PTransfer*>				m_HordeQueue;	// queued mule sources that may be able to horde
+	QSet<CP2PTransfer*>				m_ActiveUploads;
+#ifndef NO_HOSTERS
+	QList<QPointer<CTransfer> >		m_HosterUploads;
+#endif
+	uint64							m_LastFileID;
+	uint64							m_NextFilePass;
+
 	QList<QPointer<CTransfer> >		m_Uploads;
 
 	QVector<SUploadSlot>			m_UploadSlots;
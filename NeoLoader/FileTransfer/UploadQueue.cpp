@@ -0,0 +1,106 @@
+#include "GlobalHeader.h"
+#include "UploadQueue.h"
+
+CUploadQueue::CUploadQueue()
+{
+	m_uTickets = 0;
+}
+
+void CUploadQueue::Update(CP2PTransfer* pTransfer, double Weight)
+{
+	quint64 uWeight = (quint64)(Weight * TicketsPerWeight + 0.5);
+	if(uWeight == 0)
+		uWeight = 1; // Note: every queued transfer must keep a chance to be selected
+
+	int Slot = m_Index.value(pTransfer, -1);
+	if(Slot == -1)
+	{
+		if(m_Free.isEmpty())
+			Grow();
+		Slot = m_Free.takeLast();
+		m_Transfers[Slot] = pTransfer;
+		m_Weights[Slot] = 0;
+		m_Index.insert(pTransfer, Slot);
+	}
+	else if(m_Weights[Slot] == uWeight)
+		return;
+
+	Add(Slot, (qint64)uWeight - (qint64)m_Weights[Slot]);
+	m_Weights[Slot] = uWeight;
+}
+
+void CUploadQueue::Remove(CP2PTransfer* pTransfer)
+{
+	QHash<CP2PTransfer*, int>::iterator I = m_Index.find(pTransfer);
+	if(I == m_Index.end())
+		return;
+	int Slot = I.value();
+	m_Index.erase(I);
+
+	Add(Slot, -(qint64)m_Weights[Slot]);
+	m_Weights[Slot] = 0;
+	m_Transfers[Slot] = NULL;
+	m_Free.append(Slot);
+}
+
+void CUploadQueue::Clear()
+{
+	m_Transfers.clear();
+	m_Weights.clear();
+	m_Tree.clear();
+	m_Free.clear();
+	m_Index.clear();
+	m_uTickets = 0;
+}
+
+CP2PTransfer* CUploadQueue::Find(quint64 uTicket) const
+{
+	if(uTicket >= m_uTickets)
+		return NULL;
+
+	// descend the tree, Pos ends up as the count of slots whose summ stays at or below the ticket
+	int Pos = 0;
+	for(int Step = m_Transfers.size(); Step > 0; Step >>= 1) // Note: the capacity is always a power of 2
+	{
+		int Next = Pos + Step;
+		if(Next < m_Tree.size() && m_Tree[Next] <= uTicket)
+		{
+			Pos = Next;
+			uTicket -= m_Tree[Next];
+		}
+	}
+	ASSERT(Pos < m_Transfers.size() && m_Transfers[Pos]);
+	return m_Transfers.value(Pos);
+}
+
+void CUploadQueue::Add(int Slot, qint64 Delta)
+{
+	m_uTickets += Delta;
+	for(int i = Slot + 1; i < m_Tree.size(); i += i & -i)
+		m_Tree[i] += Delta;
+}
+
+void CUploadQueue::Grow()
+{
+	int OldSize = m_Transfers.size();
+	int NewSize = OldSize ? OldSize * 2 : 64;
+
+	m_Transfers.resize(NewSize);
+	m_Weights.resize(NewSize);
+	for(int i = NewSize - 1; i >= OldSize; i--)
+	{
+		m_Transfers[i] = NULL;
+		m_Weights[i] = 0;
+		m_Free.append(i);
+	}
+
+	// rebuild the partial sums in linear time
+	m_Tree.fill(0, NewSize + 1);
+	for(int i = 1; i <= NewSize; i++)
+	{
+		m_Tree[i] += m_Weights[i - 1];
+		int j = i + (i & -i);
+		if(j <= NewSize)
+			m_Tree[j] += m_Tree[i];
+	}
+}
@@ -0,0 +1,48 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+class CP2PTransfer;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// The upload queue holds the transfers waiting for an upload slot together with their selection weight.
+// The weights live in a binary indexed tree over the entry slots, so inserting, removing and rescoring
+// a transfer as well as drawing a weighted random one all cost O(log n) instead of a rebuild of the whole list.
+// Weights are stored as integer tickets, that way the partial sums dont drift over many updates.
+
+class CUploadQueue
+{
+public:
+	CUploadQueue();
+
+	void							Update(CP2PTransfer* pTransfer, double Weight);
+	void							Remove(CP2PTransfer* pTransfer);
+	bool							Contains(CP2PTransfer* pTransfer) const	{return m_Index.contains(pTransfer);}
+	void							Clear();
+
+	/**
+	* Finds the transfer that owns the given ticket
+	* @param: uTicket must be smaller than GetTickets()
+	*/
+	CP2PTransfer*					Find(quint64 uTicket) const;
+
+	int								GetCount() const						{return m_Index.count();}
+	quint64							GetTickets() const						{return m_uTickets;}
+	double							GetWeight() const						{return (double)m_uTickets / TicketsPerWeight;}
+	QList<CP2PTransfer*>			GetTransfers() const					{return m_Index.keys();}
+
+	enum
+	{
+		TicketsPerWeight = 1000
+	};
+
+protected:
+	void							Add(int Slot, qint64 Delta);
+	void							Grow();
+
+	QVector<CP2PTransfer*>			m_Transfers;	// slot -> transfer, NULL for free slots
+	QVector<quint64>				m_Weights;		// slot -> tickets
+	QVector<quint64>				m_Tree;			// 1 based partial sums over the slots
+	QVector<int>					m_Free;
+	QHash<CP2PTransfer*, int>		m_Index;		// transfer -> slot
+	quint64							m_uTickets;
+};
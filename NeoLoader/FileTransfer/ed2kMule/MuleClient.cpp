@@ -4,6 +4,7 @@
 #include "MuleManager.h"
 #include "MuleServer.h"
 #include "MuleKad.h"
+#include "MulePacker.h"
 #include "../../../Framework/qzlib.h"
 #include "../../FileList/File.h"
 #include "../../FileList/FileStats.h"
@@ -1132,7 +1133,7 @@ void CMuleClient::SendComment(CFile* pFile, QString Description, uint8 Rating)
 
 void CMuleClient::SendBlockRequest(CFile* pFile, uint64 Begins[3], uint64 Ends[3])
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("SendBlockRequest"));
 
@@ -1177,7 +1178,7 @@ void CMuleClient::SendBlockRequest(CFile* pFile, uint64 Begins[3], uint64 Ends[3
 
 void CMuleClient::ProcessBlockRequest(const CBuffer& Packet, bool bI64)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("ProcessBlockRequest"));
 
@@ -1227,6 +1228,7 @@ void CMuleClient::ProcessBlockRequest(const CBuffer& Packet, bool bI64)
 		pBlock->uBegin = Begins[i];
 		pBlock->uEnd = Ends[i];
 		memcpy(pBlock->Hash, Hash.GetHash().data(), 16);
+		pBlock->bSent = false;
 
 		m_OutgoingBlocks.append(pBlock);
 
@@ -1235,6 +1237,8 @@ void CMuleClient::ProcessBlockRequest(const CBuffer& Packet, bool bI64)
 		if(pMap && (pMap->GetRange(pBlock->uBegin, pBlock->uBegin + Length) & Part::Available) == 0)
 		{
 			LogLine(LOG_ERROR | LOG_DEBUG, tr("Client requested a incomplete part"));
+			m_OutgoingBlocks.removeOne(pBlock); // Note: it will never be sent, so the trimming would not drop it
+			delete pBlock;
 			return;
 		}
 
@@ -1269,7 +1273,7 @@ void CMuleClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray& Dat
 		return;
 	}
 
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("QueueBlock"));
 
@@ -1277,8 +1281,32 @@ void CMuleClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray& Dat
 
 	QByteArray PackedData;
 	if(DataCompVer() == 1 && theCore->m_MuleManager->GetServer()->GetUpLimit()->GetRate() < KB2B(128)) // C-ToDo: customize
-		PackedData = Pack(Data);
+	{
+		// Note: the packer works on its own threads, a block that is not in its cache gets to us again through OnBlockPacked
+		if(theCore->m_MuleManager->GetPacker()->Pack(this, pBlock, m_UpSource->GetFile()->GetFileID(), pBlock->uBegin, Data, PackedData) == CMulePacker::ePending)
+			return;
+	}
+
+	SendBlock(pBlock, Data, PackedData);
+}
+
+void CMuleClient::OnBlockPacked(void* Aux, uint64 uBegin, const QByteArray& Data, const QByteArray& Packed)
+{
+	if(!m_UpSource)
+		return;
+
+	SPendingBlock* pBlock = (SPendingBlock*)Aux;
+	if(!m_OutgoingBlocks.contains(pBlock) || pBlock->uBegin != uBegin || pBlock->uEnd - pBlock->uBegin != Data.size())
+		return; // the upload got canceled while the block was being packed
+
+	if(!m_Socket)
+		return;
+
+	SendBlock(pBlock, Data, Packed);
+}
 
+void CMuleClient::SendBlock(SPendingBlock* pBlock, const QByteArray& Data, const QByteArray& PackedData)
+{
 	bool bI64 = SupportsLargeFiles();
 
 	if(!PackedData.isEmpty() && PackedData.size() < Data.size())
@@ -1291,7 +1319,7 @@ void CMuleClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray& Dat
 		{
 			uint64 Size = Min(KB2B(10), PackedData.size() - Pos);
 
-			CBuffer Packet(1 + 16 + (bI64 ? 8 : 4) + 4 + Size);
+			CBuffer Packet(1 + 16 + (bI64 ? 8 : 4) + 4);
 			Packet.WriteValue<uint8>(bI64 ? OP_COMPRESSEDPART_I64 : OP_COMPRESSEDPART);
 			Packet.WriteData(pBlock->Hash,16);
 			if(bI64)
@@ -1299,9 +1327,8 @@ void CMuleClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray& Dat
 			else
 				Packet.WriteValue<uint32>(pBlock->uBegin);
 			Packet.WriteValue<uint32>(PackedData.size());
-			Packet.WriteData((byte*)PackedData.data() + Pos, Size);
 
-			m_Socket->QueuePacket((uint64)Aux, Packet.ToByteArray(), OP_EMULEPROT);
+			m_Socket->QueuePacket((uint64)pBlock, Packet.ToByteArray(), OP_EMULEPROT, PackedData.mid(Pos, Size));
 
 			Pos += Size;
 		}
@@ -1318,7 +1345,7 @@ void CMuleClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray& Dat
 			uint64 uBegin = pBlock->uBegin + Pos;
 			uint64 uEnd = uBegin + Size;
 
-			CBuffer Packet(1 + 16 + (bI64 ? 8 + 8 : 4 + 4) + Size);
+			CBuffer Packet(1 + 16 + (bI64 ? 8 + 8 : 4 + 4));
 			Packet.WriteValue<uint8>(bI64 ? OP_SENDINGPART_I64 : OP_SENDINGPART);
 			Packet.WriteData(pBlock->Hash,16);
 			if(bI64)
@@ -1331,19 +1358,24 @@ void CMuleClient::OnDataRead(uint64 Offset, uint64 Length, const QByteArray& Dat
 				Packet.WriteValue<uint32>(uBegin);
 				Packet.WriteValue<uint32>(uEnd);
 			}
-			Packet.WriteData((byte*)Data.data() + Pos, Size);
 
-			m_Socket->QueuePacket((uint64)Aux, Packet.ToByteArray(), bI64 ? OP_EMULEPROT : OP_EDONKEYPROT);
+			m_Socket->QueuePacket((uint64)pBlock, Packet.ToByteArray(), bI64 ? OP_EMULEPROT : OP_EDONKEYPROT, Data.mid(Pos, Size));
 
 			Pos += Size;
 		}
 	}
 
+	pBlock->bSent = true;
+
 	// we must only keep track of the last 3 blocks
-	while(m_OutgoingBlocks.size() > 3)
+	// Note: blocks may finish packing out of order, only sent blocks are dropped, oldest first,
+	//			a block that is still being read or packed must stay or its data would never get send
+	for(int i=0; m_OutgoingBlocks.size() > 3 && i < m_OutgoingBlocks.size(); )
 	{
-		ASSERT(pBlock != m_OutgoingBlocks.first());
-		delete m_OutgoingBlocks.takeFirst();
+		if(m_OutgoingBlocks.at(i)->bSent)
+			delete m_OutgoingBlocks.takeAt(i);
+		else
+			i++;
 	}
 }
 
@@ -1355,7 +1387,7 @@ void CMuleClient::CancelUpload()
 
 void CMuleClient::ProcessBlock(const CBuffer& Packet, bool bPacked, bool bI64)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug == 3)
 		LogLine(LOG_DEBUG, tr("ProcessBlock"));
 
@@ -3338,7 +3370,7 @@ void CMuleClient::AddLogLine(time_t uStamp, uint32 uFlag, const CLogMsg& Line)
 {
 	Line.AddMark((uint64)this);
 
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug >= 2 || (iDebug == 1 && (uFlag & LOG_DEBUG) == 0))
 	{
 		Line.Prefix(QString("MuleClient - %1:%2").arg(m_Mule.GetIP().ToQString()).arg(m_Mule.TCPPort));
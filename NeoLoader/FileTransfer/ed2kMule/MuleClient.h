@@ -56,6 +56,7 @@ public:
 		uint64			uBegin;
 		uint64			uEnd;
 		byte			Hash[16];
+		bool			bSent;
 	};
 
 	void				SendHelloPacket(bool bAnswer = false);
@@ -187,6 +188,7 @@ protected:
 	friend class		CMuleManager;
 	friend class		CMuleUDP;
 	friend class		CMuleKad;
+	friend class		CMulePacker;
 
 	void				Init();
 
@@ -203,6 +205,8 @@ protected:
 
 	void				ProcessBlockRequest(const CBuffer& Packet, bool bI64 = false);
 	void				ProcessBlock(const CBuffer& Packet, bool bPacked = false, bool bI64 = false);
+	void				OnBlockPacked(void* Aux, uint64 uBegin, const QByteArray& Data, const QByteArray& Packed);
+	void				SendBlock(SPendingBlock* pBlock, const QByteArray& Data, const QByteArray& Packed);
 
 	void				SendHordeRequest(CFile* pFile);
 
@@ -2,6 +2,7 @@
 #include "MuleManager.h"
 #include "MuleKad.h"
 #include "MuleServer.h"
+#include "MulePacker.h"
 #include "../../FileList/FileManager.h"
 #include "../../FileList/Hashing/FileHashTree.h"
 #include "../../FileList/Hashing/FileHashSet.h"
@@ -80,6 +81,8 @@ CMuleManager::CMuleManager(QObject* qObject)
 
 	m_ServerList = new CServerList(m_Server, this);
 
+	m_Packer = new CMulePacker(this);
+
 	m_NextIPRequest = GetCurTick();
 
 	m_LastCallbacksMustWait = 0;
@@ -187,6 +190,8 @@ void CMuleManager::Process(UINT Tick)
 	if((Tick & EPerSec) == 0)
 		return;
 
+	m_Packer->UpdateSettings();
+
 	if(m_bEnabled != theCore->Cfg()->GetBool("Ed2kMule/Enable"))
 	{
 		m_bEnabled = theCore->Cfg()->GetBool("Ed2kMule/Enable");
@@ -13,6 +13,7 @@ class CFile;
 class CMuleKad;
 class CFileHash;
 class CMuleServer;
+class CMulePacker;
 class CServerList;
 struct SMuleSource;
 
@@ -32,6 +33,7 @@ public:
 	const QList<CMuleClient*>&		GetClients()								{return m_Clients;}
 	int								GetConnectionCount();
 	CMuleServer*					GetServer()									{return m_Server;}
+	CMulePacker*					GetPacker()									{return m_Packer;}
 
 	bool							GrantSX(CFile* pFile);
 	void							ConfirmSX(CFile* pFile);
@@ -126,6 +128,7 @@ protected:
 	TEd2kID							m_UserHash;
 
 	CMuleServer*					m_Server;
+	CMulePacker*					m_Packer;
 	QList<CMuleClient*>				m_Clients;
 
 	CMuleKad*						m_Kademlia;
@@ -0,0 +1,182 @@
+#include "GlobalHeader.h"
+#include "MulePacker.h"
+#include "MuleClient.h"
+#include "../../NeoCore.h"
+#include "../../../Framework/qzlib.h"
+#include <QElapsedTimer>
+
+const double CMulePacker::MinGain = 0.05;
+const int CMulePacker::ProbeInterval = 16;
+const int CMulePacker::MaxFiles = 1024;
+
+class CPackJob: public QRunnable
+{
+public:
+	CPackJob(CMulePacker* pPacker, CMulePacker::SPackJob* pJob)
+	{
+		m_pPacker = pPacker;
+		m_pJob = pJob;
+	}
+
+	void run()
+	{
+		QElapsedTimer Timer;
+		Timer.start();
+		m_pJob->Packed = ::Pack(m_pJob->Data);
+		m_pJob->uTime = Timer.nsecsElapsed();
+		m_pPacker->Finished(m_pJob);
+	}
+
+protected:
+	CMulePacker*			m_pPacker;
+	CMulePacker::SPackJob*	m_pJob;
+};
+
+CMulePacker::CMulePacker(QObject* qObject)
+ : QObject(qObject)
+{
+	m_Pool = new QThreadPool(this);
+
+	m_uHits = 0;
+	m_uMisses = 0;
+	m_uSkipped = 0;
+	m_uPackedRaw = 0;
+	m_uPackTime = 0;
+	m_uHitBytes = 0;
+	m_uSavedBytes = 0;
+
+	UpdateSettings();
+}
+
+CMulePacker::~CMulePacker()
+{
+	// Note: the workers push into m_Done, so they must be gone before we clean up
+	m_Pool->waitForDone();
+
+	SPackJob* pJob;
+	while(m_Done.Pop(pJob)); // all finished jobs are still listed in m_Pending
+	qDeleteAll(m_Pending);
+}
+
+void CMulePacker::UpdateSettings()
+{
+	int Threads = theCore->Cfg()->GetInt("Ed2kMule/PackThreads");
+	if(Threads <= 0)
+		Threads = QThread::idealThreadCount() / 2;
+	m_Pool->setMaxThreadCount(Max(Threads, 1));
+
+	m_Cache.setMaxCost(theCore->Cfg()->GetInt("Ed2kMule/PackCacheSize"));
+}
+
+CMulePacker::EResult CMulePacker::Pack(CMuleClient* pClient, void* Aux, uint64 FileID, uint64 uBegin, const QByteArray& Data, QByteArray& Packed)
+{
+	SPackKey Key(FileID, uBegin, uBegin + Data.size());
+	if(QByteArray* pPacked = m_Cache.object(Key))
+	{
+		m_uHits++;
+		m_uHitBytes += Data.size();
+		if(pPacked->isEmpty())
+			return eRaw;
+		m_uSavedBytes += Data.size() - pPacked->size();
+		Packed = *pPacked;
+		return ePacked;
+	}
+
+	// an other client requested the same block just before, wait for that job to finish
+	if(SPackJob* pJob = m_Pending.value(Key))
+	{
+		m_uHits++;
+		m_uHitBytes += Data.size();
+		pJob->Waiting.append(qMakePair(QPointer<CMuleClient>(pClient), Aux));
+		return ePending;
+	}
+
+	QHash<uint64, SFileStats>::iterator I = m_Files.find(FileID);
+	if(I != m_Files.end() && I->Ratio > 1.0 - MinGain && (I->Probe++ % ProbeInterval) != 0)
+	{
+		m_uSkipped++;
+		m_uHitBytes += Data.size();
+		return eRaw;
+	}
+
+	m_uMisses++;
+	m_Files[FileID].Jobs++;
+
+	SPackJob* pJob = new SPackJob;
+	pJob->Key = Key;
+	pJob->Data = Data;
+	pJob->Waiting.append(qMakePair(QPointer<CMuleClient>(pClient), Aux));
+	m_Pending.insert(Key, pJob);
+
+	m_Pool->start(new CPackJob(this, pJob));
+	return ePending;
+}
+
+void CMulePacker::Finished(SPackJob* pJob)
+{
+	m_Done.Push(pJob);
+	// Note: one queued call is enough to drain all jobs that finish before OnPacked runs
+	if(m_Signaled.testAndSetOrdered(0, 1))
+		QMetaObject::invokeMethod(this, "OnPacked", Qt::QueuedConnection);
+}
+
+void CMulePacker::OnPacked()
+{
+	m_Signaled.fetchAndStoreOrdered(0);
+
+	SPackJob* pJob;
+	while(m_Done.Pop(pJob))
+	{
+		m_Pending.remove(pJob->Key);
+
+		m_uPackedRaw += pJob->Data.size();
+		m_uPackTime += pJob->uTime;
+
+		double Ratio = pJob->Packed.isEmpty() ? 1.0 : (double)pJob->Packed.size() / pJob->Data.size();
+		QHash<uint64, SFileStats>::iterator I = m_Files.find(pJob->Key.FileID);
+		ASSERT(I != m_Files.end());
+		I->Ratio = I->Ratio * 0.75 + Ratio * 0.25;
+		// as long as the file compresses well it behaves just like a new one, so we drop it with its last job
+		if(--I->Jobs == 0 && (Ratio <= 1.0 - MinGain || m_Files.size() > MaxFiles))
+			m_Files.erase(I);
+
+		if(Ratio > 1.0 - MinGain)
+			pJob->Packed.clear();
+		m_Cache.insert(pJob->Key, new QByteArray(pJob->Packed), Max(pJob->Packed.size(), 64));
+
+		for(int i=0; i < pJob->Waiting.size(); i++)
+		{
+			CMuleClient* pClient = pJob->Waiting.at(i).first;
+			if(!pClient)
+				continue; // the client got deleted in the mean time
+
+			if(!pJob->Packed.isEmpty())
+				m_uSavedBytes += pJob->Data.size() - pJob->Packed.size();
+			pClient->OnBlockPacked(pJob->Waiting.at(i).second, pJob->Key.uBegin, pJob->Data, pJob->Packed);
+		}
+
+		delete pJob;
+	}
+}
+
+QVariantMap CMulePacker::GetStats() const
+{
+	QVariantMap Packer;
+	Packer["Threads"] = m_Pool->maxThreadCount();
+	Packer["Pending"] = m_Pending.size();
+	Packer["Size"] = m_Cache.totalCost();
+	Packer["Budget"] = m_Cache.maxCost();
+	Packer["Blocks"] = m_Cache.count();
+
+	Packer["Hits"] = m_uHits;
+	Packer["Misses"] = m_uMisses;
+	Packer["Skipped"] = m_uSkipped;
+	uint64 uTotal = m_uHits + m_uMisses + m_uSkipped;
+	Packer["HitRate"] = uTotal ? (100 * (m_uHits + m_uSkipped)) / uTotal : 0; // in %
+
+	Packer["SavedBytes"] = m_uSavedBytes;
+	Packer["PackTime"] = m_uPackTime / 1000000; // in ms
+	// Note: the time saved by hits and skipped blocks is estimated from the zlib throughput seen so far
+	Packer["SavedTime"] = m_uPackedRaw ? (quint64)((double)m_uHitBytes * m_uPackTime / m_uPackedRaw) / 1000000 : 0; // in ms
+	return Packer;
+}
@@ -0,0 +1,97 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+#include <QCache>
+#include <QThreadPool>
+#include "../../../Framework/MT/LockFreeQueue.h"
+
+class CMuleClient;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Compresses upload blocks for ed2k clients on a small worker pool so the main thread does not stall in zlib,
+// the packed blocks are kept in a LRU cache keyed by file and range, as popular blocks get requested by many clients.
+// Files that dont compress are remembered, for them we only probe every few blocks and otherwise send them raw right away.
+
+class CMulePacker: public QObject
+{
+	Q_OBJECT
+
+public:
+	CMulePacker(QObject* qObject = NULL);
+	~CMulePacker();
+
+	enum EResult
+	{
+		eRaw = 0,	// dont pack, send the data as it is
+		ePacked,	// Packed was filled from the cache
+		ePending	// the block is being packed, the client gets it through OnBlockPacked
+	};
+
+	EResult					Pack(CMuleClient* pClient, void* Aux, uint64 FileID, uint64 uBegin, const QByteArray& Data, QByteArray& Packed);
+
+	void					UpdateSettings();
+
+	QVariantMap				GetStats() const;
+
+	static const double		MinGain;		// blocks that dont shrink by at least this much are sent raw
+	static const int		ProbeInterval;	// for poorly compressible files only every n'th block is packed
+	static const int		MaxFiles;		// poorly compressible files we remember without a job in flight
+
+private slots:
+	void					OnPacked();
+
+protected:
+	friend class CPackJob;
+
+	struct SPackKey
+	{
+		SPackKey(uint64 ID = 0, uint64 Begin = 0, uint64 End = 0) : FileID(ID), uBegin(Begin), uEnd(End) {}
+		bool operator==(const SPackKey& Other) const {return FileID == Other.FileID && uBegin == Other.uBegin && uEnd == Other.uEnd;}
+		friend uint qHash(const SPackKey& Key) {return qHash(Key.FileID) ^ qHash(Key.uBegin) ^ qHash(Key.uEnd);}
+
+		uint64				FileID;
+		uint64				uBegin;
+		uint64				uEnd;
+	};
+
+	struct SPackJob
+	{
+		SPackJob() : uTime(0) {}
+		SPackKey			Key;
+		QByteArray			Data;
+		QByteArray			Packed;
+		quint64				uTime;			// ns spent in zlib
+		QList<QPair<QPointer<CMuleClient>, void*> > Waiting;
+	};
+
+	struct SFileStats
+	{
+		SFileStats()
+		{
+			Ratio = 0.5;
+			Probe = 0;
+			Jobs = 0;
+		}
+		double				Ratio;			// running average of packed size / raw size
+		int					Probe;
+		int					Jobs;			// jobs in flight
+	};
+
+	void					Finished(SPackJob* pJob);
+
+	QThreadPool*			m_Pool;
+	CLockFreeQueue<SPackJob*> m_Done;
+	QAtomicInt				m_Signaled;
+
+	QHash<SPackKey, SPackJob*> m_Pending;
+	QCache<SPackKey, QByteArray> m_Cache;	// Note: an empty entry marks a block that did not compress
+	QHash<uint64, SFileStats> m_Files;		// Note: files without a job are only kept while their last block did not compress
+
+	quint64					m_uHits;
+	quint64					m_uMisses;
+	quint64					m_uSkipped;
+	quint64					m_uPackedRaw;	// raw bytes that went through zlib
+	quint64					m_uPackTime;	// ns spent in zlib
+	quint64					m_uHitBytes;	// raw bytes served from the cache or skipped
+	quint64					m_uSavedBytes;	// upload bytes saved by sending packed blocks
+};
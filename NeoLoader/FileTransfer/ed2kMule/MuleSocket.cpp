@@ -63,13 +63,24 @@ void CMuleSocket::StreamIn(byte* Data, size_t Length)
 	CStreamSocket::StreamIn(Data, Length);
 }
 
-void CMuleSocket::QueuePacket(uint64 ID, const QByteArray& Packet, uint8 Prot)
+void CMuleSocket::QueuePacket(uint64 ID, const QByteArray& Packet, uint8 Prot, const QByteArray& Payload)
 {
-	CBuffer Header(1 + 4);
+	if(Payload.isEmpty())
+	{
+		CBuffer Header(1 + 4);
+		Header.WriteValue<uint8>(Prot);
+		Header.WriteValue<uint32>(Packet.size());
+		QueueStream(ID, Header.ToByteArray(), Packet);
+		return;
+	}
+
+	// Note: the packet is only the message head, the payload follows it unchanged as the second segment
+	CBuffer Header(1 + 4 + Packet.size());
 	Header.WriteValue<uint8>(Prot);
-	Header.WriteValue<uint32>(Packet.size());
+	Header.WriteValue<uint32>(Packet.size() + Payload.size());
+	Header.WriteQData(Packet);
 
-	QueueStream(ID, Header.ToByteArray() + Packet);
+	QueueStream(ID, Header.ToByteArray(), Payload);
 }
 
 void CMuleSocket::ProcessStream()
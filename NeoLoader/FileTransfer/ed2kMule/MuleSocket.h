@@ -16,7 +16,7 @@ public:
 	virtual ~CMuleSocket();
 
 	virtual void		SendPacket(const QByteArray& Packet, uint8 Prot);
-	virtual void		QueuePacket(uint64 ID, const QByteArray& Packet, uint8 Prot);
+	virtual void		QueuePacket(uint64 ID, const QByteArray& Packet, uint8 Prot, const QByteArray& Payload = QByteArray());
 
 	virtual void		InitCrypto(const QByteArray& UserHash);
 	virtual void		InitCrypto();
@@ -437,7 +437,7 @@ void CServerClient::ProcessPacket(CBuffer& Packet, uint8 Prot)
 
 void CServerClient::AddLogLine(time_t uStamp, uint32 uFlag, const CLogMsg& Line)
 {
-	int iDebug = theCore->Cfg()->GetInt("Log/Level");
+	int iDebug = theCore->GetLogLevel();
 	if(iDebug >= 2 || (iDebug == 1 && (uFlag & LOG_DEBUG) == 0))
 	{
 		if(CEd2kServer* pServer = GetServer())
@@ -668,7 +668,7 @@ void CServerList::Store()
 		Servers.append(pServer->GetUrl());
 	}
 
-	theCore->Cfg()->setValue("Ed2kMule/StaticServers", Servers);
+	theCore->Cfg()->SetSetting("Ed2kMule/StaticServers", Servers);
 
 	m_Changed = false;
 }
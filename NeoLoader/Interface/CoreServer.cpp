@@ -61,6 +61,7 @@
 #include "../FileTransfer/ed2kMule/MuleManager.h"
 #include "../FileTransfer/ed2kMule/MuleServer.h"
 #include "../FileTransfer/ed2kMule/MuleKad.h"
+#include "../FileTransfer/ed2kMule/MulePacker.h"
 #include "../FileTransfer/ed2kMule/MuleCollection.h"
 #include "../FileTransfer/ed2kMule/ServerClient/ServerList.h"
 #include "../FileTransfer/ed2kMule/ServerClient/Ed2kServer.h"
@@ -478,6 +479,7 @@ QVariantMap CCoreServer::GetInfo(QVariantMap Request)
 			Ed2kMule["AddressV6"] = IPv6.ToQString();
 		}
 		Ed2kMule["Connections"] = theCore->m_MuleManager->GetConnectionCount();
+		Ed2kMule["Compression"] = theCore->m_MuleManager->GetPacker()->GetStats();
 	
 		Ed2kMule["KadStatus"] = theCore->m_MuleManager->GetKad()->GetStatus();
 		Ed2kMule["KadPort"] = theCore->m_MuleManager->GetKad()->GetKadPort();
@@ -543,6 +545,8 @@ QVariantMap CCoreServer::GetInfo(QVariantMap Request)
 	IOStats["PendingWrite"] = theCore->m_IOManager->GetPendingWriteSize();
 	IOStats["HashingCount"] = theCore->m_Hashing->GetCount();
 	IOStats["AllocationCount"] = theCore->m_IOManager->GetAllocationCount();
+	IOStats["Devices"] = theCore->m_IOManager->GetDeviceStats();
+	IOStats["ReadCache"] = theCore->m_IOManager->GetCacheStats();
 	Response["IOStats"] = IOStats;
 
 	QStringList NICs;
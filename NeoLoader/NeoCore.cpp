@@ -38,6 +38,7 @@
 #include "./Networking/Pinger.h"
 #include "./Networking/BandwidthControl/BandwidthLimit.h"
 #include "./FileList/IOManager.h"
+#include "../Framework/Cryptography/HashKernels.h"
 #include "../Framework/Functions.h"
 #include "../MiniUPnP/MiniUPnP.h"
 #include "./FileSearch/SearchManager.h"
@@ -92,6 +93,8 @@ CNeoCore::CNeoCore(CSettings* Settings)
 	m_UpLimit = 0;
 	m_DownLimit = 0;
 
+	m_LogLevelSlot = -1;
+
 	m_Server = NULL;
 	m_Interfaces = NULL;
 
@@ -124,6 +127,7 @@ void CNeoCore::Initialise()
 	qsrand(QTime::currentTime().msec()); // needs to be done in every thread we use random numbers
 
 	m_CoreSettings = new CSettings("NeoCore", GetDefaultCoreSettings(), this);
+	m_LogLevelSlot = m_CoreSettings->GetSlot("Log/Level");
 
 	SetLogLimit(Cfg()->GetInt("Log/Limit"));
 	if(Cfg()->GetBool("Log/Store"))
@@ -173,6 +177,9 @@ void CNeoCore::Initialise()
 	m_SearchManager->LoadFromFile();
 	m_FileGrabber->LoadFromFile();
 	m_Hashing->start();
+	LogLine(LOG_INFO | LOG_DEBUG, tr("Hash acceleration: %1").arg(CHashKernels::GetName()));
+	if(CHashKernels::HasFailed())
+		LogLine(LOG_WARNING, tr("A hash acceleration kernel failed its self test and was disabled"));
 
 #ifdef CRAWLER
 	m_CrawlerManager = new CCrawlerManager(this);
@@ -560,7 +567,25 @@ QMap<QString, CSettings::SSetting> CNeoCore::GetDefaultCoreSettings()
 	Settings.insert("Content/Shared", CSettings::SSetting(QStringList("")));
 	Settings.insert("Content/VerifyTime", CSettings::SSetting(30));
 	Settings.insert("Content/VerifySize", CSettings::SSetting(MB2B(5)));
+	Settings.insert("Content/HashOnArrival", CSettings::SSetting(true));
 	Settings.insert("Content/CacheLimit", CSettings::SSetting(MB2B(256), MB2B(128), MB2B(1024)));
+	Settings.insert("Content/IOThreads", CSettings::SSetting(2, 1, 16)); // worker threads per physical device
+	Settings.insert("Content/WriteBackDelay", CSettings::SSetting(SEC2MS(2), 0, SEC2MS(30))); // 0 disables the write back cache
+	Settings.insert("Content/WriteBackBlock", CSettings::SSetting(MB2B(1), KB2B(64), MB2B(16)));
+	Settings.insert("Content/ReadCacheSize", CSettings::SSetting(MB2B(64), 0, MB2B(1024))); // 0 disables the upload block cache
+	Settings.insert("Content/ReadAhead", CSettings::SSetting(MB2B(1), 0, MB2B(16)));
+	Settings.insert("Content/FileHandles", CSettings::SSetting(0, 0, 65536)); // 0 means derive from the descriptor limit
+	Settings.insert("Content/HandleTimeout", CSettings::SSetting(MIN2S(5), 0, HR2S(24)));
+	Settings.insert("Content/MemoryMapping", CSettings::SSetting(true));
+	Settings.insert("Content/HashingThreads", CSettings::SSetting(0, 0, 64)); // 0 means one per core
+	Settings.insert("Content/HashingPerDevice", CSettings::SSetting(4, 1, 64)); // spinning disks always get only one
+	Settings.insert("Content/HashingSplitSize", CSettings::SSetting(MB2B(256), 0, GB2B(4ull)));
+	Settings.insert("Content/MapWindow", CSettings::SSetting(MB2B(64), MB2B(1), MB2B(1024)));
+#if QT_POINTER_SIZE == 4
+	Settings.insert("Content/MapLimit", CSettings::SSetting(MB2B(512), MB2B(16), GB2B(1)));
+#else
+	Settings.insert("Content/MapLimit", CSettings::SSetting(GB2B(16ull), MB2B(16), GB2B(1024ull)));
+#endif
 	Settings.insert("Content/AddPaused", CSettings::SSetting(false));
 	Settings.insert("Content/ShareNew", CSettings::SSetting(true));
 	//Settings.insert("Content/ShowTemp", CSettings::SSetting(false));
@@ -587,6 +612,7 @@ QMap<QString, CSettings::SSetting> CNeoCore::GetDefaultCoreSettings()
 	Settings.insert("Content/BackLoadSize", CSettings::SSetting(MB2B(2)));
 
 	Settings.insert("Content/Preallocation", CSettings::SSetting(MB2B(100)));
+	Settings.insert("Content/AllocationMode", CSettings::SSetting("Fallocate", QString("Sparse|Fallocate|ZeroFill").split("|")));
 	Settings.insert("Content/CalculateHashes", CSettings::SSetting(true));
 
 	Settings.insert("Content/SaveSearch", CSettings::SSetting(true));
@@ -608,6 +634,7 @@ QMap<QString, CSettings::SSetting> CNeoCore::GetDefaultCoreSettings()
 	Settings.insert("Bandwidth/DefaultNIC",CSettings::SSetting(""));
 	Settings.insert("Bandwidth/WebProxy", CSettings::SSetting(""));
 	Settings.insert("Bandwidth/MaxConnections", CSettings::SSetting(2500));
+	Settings.insert("Bandwidth/SocketShards", CSettings::SSetting(0, -1, 8)); // 0 means derive from the core count, -1 keeps all sockets in the socket thread
 	Settings.insert("Bandwidth/MaxNewPer5Sec", CSettings::SSetting(250));
 	Settings.insert("Bandwidth/TransportLimiting", CSettings::SSetting(true));
 	Settings.insert("Bandwidth/FrameOverhead", CSettings::SSetting(18));
@@ -660,6 +687,7 @@ QMap<QString, CSettings::SSetting> CNeoCore::GetDefaultCoreSettings()
 
 	Settings.insert("NeoKad/Port", CSettings::SSetting(GetRandomInt(9000, 9999)));
 	Settings.insert("NeoKad/TargetID", CSettings::SSetting(""));
+	Settings.insert("NeoKad/EntityID", CSettings::SSetting("")); // only written by debug builds
 	Settings.insert("NeoKad/LastDistance", CSettings::SSetting(0));
 	Settings.insert("NeoKad/EntityKey", CSettings::SSetting(""));
 	Settings.insert("NeoKad/StoreKey", CSettings::SSetting(""));
@@ -722,6 +750,8 @@ QMap<QString, CSettings::SSetting> CNeoCore::GetDefaultCoreSettings()
 	Settings.insert("Ed2kMule/StaticServers", CSettings::SSetting(QString("ed2k://|server|91.200.42.46|1176|/\r\ned2k://|server|91.200.42.47|3883|/\r\ned2k://|server|91.200.42.119|9939|/\r\ned2k://|server|176.103.48.36|4184|/\r\ned2k://|server|77.120.115.66|5041|/\r\ned2k://|server|46.105.126.71|4661|/").split("\r\n")));
 	Settings.insert("Ed2kMule/KeepServers",CSettings::SSetting(MIN2S(10),MIN2S(5),MIN2S(58)));
 	Settings.insert("Ed2kMule/MinHordeSlots",CSettings::SSetting(1,0,10));
+	Settings.insert("Ed2kMule/PackThreads", CSettings::SSetting(0, 0, 64)); // 0 means one per two cores
+	Settings.insert("Ed2kMule/PackCacheSize", CSettings::SSetting(MB2B(16), 0, MB2B(256)));
 
 	Settings.insert("Hoster/MinWebTasks", CSettings::SSetting(10));
 	Settings.insert("Hoster/MaxNewPer5Sec", CSettings::SSetting(25));
@@ -66,6 +66,8 @@ public:
 	void				LoadLoginTokens();
 
 	CSettings*			Cfg(bool bCore = true)		{return bCore ? m_CoreSettings : m_Settings;}
+	// Note: the log level is checked on per packet paths, so it is read from its snapshot slot directly
+	int					GetLogLevel()				{return (int)m_CoreSettings->GetValue(m_LogLevelSlot);}
 	QSettings*			Stats()						{return m_Stats;}
 
 	CCoreServer*		m_Server;
@@ -130,6 +132,8 @@ protected:
 	int					m_UpLimit;
 	int					m_DownLimit;
 
+	int					m_LogLevelSlot;
+
 	CCoreThread*		m_pThread;
 
 	QMutex				m_Mutex;
@@ -14,6 +14,7 @@ HEADERS += ./NeoVersion.h \
     ./Common/SimpleDH.h \
     ./Common/TuringTools.h \
     ./Common/ValueMap.h \
+    ./Common/FlatMap.h \
     ./Common/Xml2.h \
     ./Common/Variant.h \
     ./Common/MemInfo.h \
@@ -29,12 +30,14 @@ HEADERS += ./NeoVersion.h \
     ./GUI/ScriptDebugger/ResourceView/ResourceWidget.h \
     ./GUI/ScriptDebugger/ResourceView/XmlHighlighter.h \
     ./FileTransfer/PartDownloader.h \
+    ./FileTransfer/IslandBias.h \
     ./FileTransfer/DownloadManager.h \
     ./FileTransfer/HashInspector.h \
     ./FileTransfer/FileGrabber.h \
     ./FileTransfer/PeerWatch.h \
     ./FileTransfer/Transfer.h \
     ./FileTransfer/UploadManager.h \
+    ./FileTransfer/UploadQueue.h \
     ./FileTransfer/CorruptionLogger.h \
     ./FileTransfer/FWWatch.h \
     ./FileTransfer/HosterTransfer/HosterTask.h \
@@ -75,6 +78,7 @@ HEADERS += ./NeoVersion.h \
     ./FileTransfer/ed2kMule/MuleClient.h \
     ./FileTransfer/ed2kMule/MuleKad.h \
     ./FileTransfer/ed2kMule/MuleManager.h \
+    ./FileTransfer/ed2kMule/MulePacker.h \
     ./FileTransfer/ed2kMule/MuleSocket.h \
     ./FileTransfer/ed2kMule/MuleSource.h \
     ./FileTransfer/ed2kMule/MuleTags.h \
@@ -108,8 +112,12 @@ HEADERS += ./NeoVersion.h \
     ./FileList/File.h \
     ./FileList/FileDetails.h \
     ./FileList/FileList.h \
+    ./FileList/FileIndex.h \
     ./FileList/FileManager.h \
     ./FileList/IOManager.h \
+    ./FileList/IOQueue.h \
+    ./FileList/BlockCache.h \
+    ./FileList/HandleCache.h \
     ./FileList/PartMap.h \
     ./FileList/Hashing/FileHashTreeEx.h \
     ./FileList/Hashing/FileHash.h \
@@ -118,6 +126,7 @@ HEADERS += ./NeoVersion.h \
     ./FileList/Hashing/HashingThread.h \
     ./FileList/Hashing/UntrustedFileHash.h \
     ./FileList/Hashing/HashingJobs.h \
+    ./FileList/Hashing/IncrementalHasher.h \
     ./FileList/Archiving/FileArchiver.h \
     ./FileSearch/Search.h \
     ./FileSearch/SearchAgent.h \
@@ -134,12 +143,16 @@ HEADERS += ./NeoVersion.h \
     ./Networking/TCPSocket.h \
     ./Networking/UTPSocket.h \
     ./Networking/StreamSocket.h \
+    ./Networking/SendQueue.h \
     ./Networking/SocketThread.h \
+    ./Networking/SocketReactor.h \
+    ./Networking/SocketShard.h \
     ./Networking/ListenSocket.h \
     ./Networking/Pinger.h \
     ./Networking/BandwidthControl/BandwidthLimiter.h \
     ./Networking/BandwidthControl/BandwidthManager.h \
     ./Networking/BandwidthControl/BandwidthLimit.h \
+    ./Networking/BandwidthControl/BandwidthShare.h \
     ./Networking/BandwidthControl/BandwidthCounter.h
 SOURCES += ./GlobalHeader.cpp \
     ./main.cpp \
@@ -168,6 +181,7 @@ SOURCES += ./GlobalHeader.cpp \
     ./FileTransfer/PeerWatch.cpp \
     ./FileTransfer/Transfer.cpp \
     ./FileTransfer/UploadManager.cpp \
+    ./FileTransfer/UploadQueue.cpp \
     ./FileTransfer/HosterTransfer/ArchiveDownloader.cpp \
     ./FileTransfer/HosterTransfer/ArchiveUploader.cpp \
     ./FileTransfer/HosterTransfer/ArchiveSet.cpp \
@@ -206,6 +220,7 @@ SOURCES += ./GlobalHeader.cpp \
     ./FileTransfer/ed2kMule/MuleClient.cpp \
     ./FileTransfer/ed2kMule/MuleKad.cpp \
     ./FileTransfer/ed2kMule/MuleManager.cpp \
+    ./FileTransfer/ed2kMule/MulePacker.cpp \
     ./FileTransfer/ed2kMule/MuleSocket.cpp \
     ./FileTransfer/ed2kMule/MuleSource.cpp \
     ./FileTransfer/ed2kMule/MuleTags.cpp \
@@ -239,6 +254,9 @@ SOURCES += ./GlobalHeader.cpp \
     ./FileList/FileList.cpp \
     ./FileList/FileManager.cpp \
     ./FileList/IOManager.cpp \
+    ./FileList/IOQueue.cpp \
+    ./FileList/BlockCache.cpp \
+    ./FileList/HandleCache.cpp \
     ./FileList/PartMap.cpp \
     ./FileList/Hashing/FileHashTreeEx.cpp \
     ./FileList/Hashing/HashingJobs.cpp \
@@ -246,6 +264,7 @@ SOURCES += ./GlobalHeader.cpp \
     ./FileList/Hashing/FileHashSet.cpp \
     ./FileList/Hashing/FileHashTree.cpp \
     ./FileList/Hashing/HashingThread.cpp \
+    ./FileList/Hashing/IncrementalHasher.cpp \
     ./FileList/Hashing/UntrustedFileHash.cpp \
     ./FileList/Archiving/FileArchiver.cpp \
     ./FileSearch/Search.cpp \
@@ -263,7 +282,10 @@ SOURCES += ./GlobalHeader.cpp \
     ./Networking/ListenSocket.cpp \
     ./Networking/Pinger.cpp \
     ./Networking/SocketThread.cpp \
+    ./Networking/SocketReactor.cpp \
+    ./Networking/SocketShard.cpp \
     ./Networking/StreamSocket.cpp \
+    ./Networking/SendQueue.cpp \
     ./Networking/TCPSocket.cpp \
     ./Networking/UTPSocket.cpp \
     ./Networking/BandwidthControl/BandwidthCounter.cpp \
@@ -49,7 +49,7 @@ protected:
 		int Bytes[eCount];
 	};
 	QList<SStat>		m_RateStat;
-	int					m_TotalBytes[eCount];
+	qint64				m_TotalBytes[eCount];
 	int					m_TotalTime;
 	QAtomicInt			m_LastBytes[eCount];
 };
@@ -5,9 +5,12 @@
 CBandwidthLimit::CBandwidthLimit(QObject* parent)
 : CBandwidthCounter(parent)
 {
-	m_iQuotaLeft = 0;
 	m_iLimit = 0;
 	m_iDistributeQuota = 0;
+	m_iPrioritySum = 0;
+
+	m_uRefillTime = GetCurTickNs();
+	m_uRemainder = 0;
 	
 	m_iTmp = 0;
 
@@ -66,8 +69,6 @@ void CBandwidthLimit::SetLimit(int iLimit)
 		iLimit = 0;
 
 	ASSERT(iLimit >= 0);
-	// if the throttle is more than this, we might overflow
-	ASSERT(iLimit < INT_MAX / 31);
 	m_iLimit = iLimit;
 }
 
@@ -87,17 +88,57 @@ void CBandwidthLimit::Process(int iInterval)
 	if (m_iLimit == 0) 
 		return;
 
-	m_iQuotaLeft += (m_iLimit * iInterval + 500) / 1000;
-	if (m_iQuotaLeft > m_iLimit * 3) 
-		m_iQuotaLeft = m_iLimit * 3;
-	m_iDistributeQuota = Max(m_iQuotaLeft, 0);
+	Refill();
+	int iTokens = m_Tokens.fetchAndAddOrdered(0);
+	m_iDistributeQuota = Max(iTokens, 0);
+}
+
+void CBandwidthLimit::Refill()
+{
+	// Note: only one thread refills at a time, the others just take what is already there
+	if(!m_Refill.testAndSetAcquire(0, 1))
+		return;
+
+	uint64 uNow = GetCurTickNs();
+	uint64 uElapsed = uNow - m_uRefillTime;
+	m_uRefillTime = uNow;
+	if(uElapsed > SEC2MS(3) * 1000000ULL) 
+		uElapsed = SEC2MS(3) * 1000000ULL;
+
+	if(int iLimit = m_iLimit)
+	{
+		// Note: the fraction of a byte is kept so that slow limits are not rounded away
+		uint64 uCredit = (uint64)iLimit * uElapsed + m_uRemainder;
+		qint64 iAdd = uCredit / 1000000000ULL;
+		m_uRemainder = uCredit % 1000000000ULL;
+
+		int iDepth = GetDepth(iLimit);
+		for(;;)
+		{
+			int iTokens = m_Tokens.fetchAndAddOrdered(0);
+			if(iTokens >= iDepth) // the bucket is full, the rest is lost
+			{
+				m_uRemainder = 0;
+				break;
+			}
+			int iNew = (int)Min(iTokens + iAdd, (qint64)iDepth);
+			if(m_Tokens.testAndSetOrdered(iTokens, iNew))
+				break;
+		}
+	}
+	else
+		m_uRemainder = 0;
+
+	m_Refill.fetchAndStoreRelease(0);
 }
 
-int CBandwidthLimit::QuotaLeft() const
+int CBandwidthLimit::QuotaLeft()
 {
 	if (m_iLimit == 0) 
 		return INT_MAX;
-	return Max(m_iQuotaLeft, 0);
+	Refill();
+	int iTokens = m_Tokens.fetchAndAddOrdered(0);
+	return Max(iTokens, 0);
 }
 
 void CBandwidthLimit::ReturnQuota(int iAmount)
@@ -105,8 +146,7 @@ void CBandwidthLimit::ReturnQuota(int iAmount)
 	ASSERT(iAmount >= 0);
 	if (m_iLimit == 0) 
 		return;
-	ASSERT(m_iQuotaLeft <= m_iQuotaLeft + iAmount);
-	m_iQuotaLeft += iAmount;
+	m_Tokens.fetchAndAddOrdered(iAmount);
 }
 
 void CBandwidthLimit::UseQuota(int iAmount)
@@ -115,5 +155,6 @@ void CBandwidthLimit::UseQuota(int iAmount)
 	ASSERT(m_iLimit >= 0);
 	if (m_iLimit == 0) 
 		return;
-	m_iQuotaLeft -= iAmount;
+	// Note: concurrent takers can push the bucket slightly below zero, the debt is paid by the next refills
+	m_Tokens.fetchAndAddOrdered(-iAmount);
 }
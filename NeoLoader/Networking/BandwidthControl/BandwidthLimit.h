@@ -8,6 +8,9 @@ class CBandwidthLimiter;
 #define BW_PRIO_NORMAL	100
 #define BW_PRIO_LOWEST	20
 
+#define BW_BURST_MS		100			// depth of the token bucket in ms of the limit
+#define BW_BURST_MIN	(16*1024)	// but at least this many bytes so slow limits can still send full frames
+
 class CBandwidthLimit: public CBandwidthCounter
 {
 	Q_OBJECT
@@ -26,7 +29,8 @@ public:
 	void				SetPriority(int iPriority);
 	int					GetPriority()				{return m_iPriority;}
 
-	int					QuotaLeft() const;
+	// Note: QuotaLeft, UseQuota and ReturnQuota may be called from any thread without locking
+	int					QuotaLeft();
 
 	void				Process(int iInterval);
 
@@ -39,16 +43,37 @@ public:
 
 	int					GetDistributeQuota() const	{return m_iDistributeQuota;}
 
+	// the summ of the priorities of the limiters that used this limit in the managers last round
+	int					GetPrioritySum() const		{return m_iPrioritySum;}
+
+	// number of queued requests that are waiting for quota from this limit
+	bool				HasWaiting()				{return m_Waiting.fetchAndAddOrdered(0) > 0;}
+	void				XcrWaiting(int x)			{m_Waiting.fetchAndAddOrdered(x);}
+
 	// used as temporary storage while distributing bandwidth
 	int					m_iTmp;
 
 protected:
+	friend class CBandwidthManager;
+
+	// adds the tokens for the time passed since the last refill
+	void				Refill();
+	int					GetDepth(int iLimit) const	{return Max(int((qint64)iLimit * BW_BURST_MS / 1000), BW_BURST_MIN);}
 
 	// this is the number of bytes to distribute this round
 	int					m_iDistributeQuota;
 
-	// this is the amount of bandwidth we have been assigned without using yet.
-	int					m_iQuotaLeft;
+	volatile int		m_iPrioritySum;
+
+	// this is the amount of bandwidth we have been assigned without using yet, the token bucket.
+	QAtomicInt			m_Tokens;
+
+	// refill state, only touched by the thread that holds m_Refill
+	QAtomicInt			m_Refill;
+	uint64				m_uRefillTime;	// ns
+	uint64				m_uRemainder;	// byte*ns/s that did not make a full byte yet
+
+	QAtomicInt			m_Waiting;
 
 	// the limit is the number of bytes per second we are allowed to use.
 	volatile int		m_iLimit;
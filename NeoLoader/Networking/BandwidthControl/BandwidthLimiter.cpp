@@ -49,7 +49,30 @@ void CBandwidthLimiter::RequestBandwidth(UINT Channel, int iAmount)
 
 	int Quota = GetQuota(Channel);
 	if(Quota < iAmount)
-		m_pManager[Channel]->RequestBandwidth(m_Limits[Channel], this, iAmount - Quota);
+		RequestQuota(Channel, iAmount - Quota);
+}
+
+void CBandwidthLimiter::RequestQuota(UINT Channel, int iAmount)
+{
+	// Note: the mutex must already be locked
+
+	// as long as the manager knows us and we are not queued, we take the bandwidth right from the limits,
+	// this way we dont have to wait for the next round of the manager nor to lock it,
+	// but only up to our priority weighted share of the round, what is missing is requested from the manager
+	if(m_Tracked[Channel].fetchAndAddOrdered(0) && !m_Waiting[Channel].fetchAndAddOrdered(0))
+	{
+		int iQuota = CBandwidthManager::TakeBandwidth(m_Limits[Channel], iAmount, m_Active[Channel].fetchAndAddOrdered(0));
+		if(iQuota > 0)
+		{
+			m_Active[Channel].fetchAndAddOrdered(iQuota);
+			AssignBandwidth(Channel, iQuota);
+			if(iQuota >= iAmount)
+				return;
+			iAmount -= iQuota;
+		}
+	}
+
+	m_pManager[Channel]->RequestBandwidth(m_Limits[Channel], this, iAmount);
 }
 
 void CBandwidthLimiter::AssignBandwidth(UINT Channel, int iAmount)
@@ -69,7 +92,7 @@ void CBandwidthLimiter::CountBandwidth(UINT Channel, int iAmount, CBandwidthCoun
 
 	int Quota = GetQuota(Channel);
 	if(Quota < 0) // if we are in det request imminetly
-		m_pManager[Channel]->RequestBandwidth(m_Limits[Channel], this, -Quota);
+		RequestQuota(Channel, -Quota);
 }
 
 void CBandwidthLimiter::AddLimit(CBandwidthLimit* pLimit, UINT Channel)
@@ -42,7 +42,12 @@ public:
 protected:
 	friend class CBandwidthManager;
 
+	void				RequestQuota(UINT Channel, int iAmount);
+
 	QAtomicInt			m_Quota[eCount];
+	QAtomicInt			m_Tracked[eCount];	// the manager has an entry for us
+	QAtomicInt			m_Waiting[eCount];	// our request is queued in the manager
+	QAtomicInt			m_Active[eCount];	// bandwidth we took directly since the managers last round
 	CBandwidthManager*  m_pManager[eCount];
 	QMutex				m_LimitMutex; // this mutex locks the limits
 	QList<CBandwidthLimit*>	m_Limits[eCount];
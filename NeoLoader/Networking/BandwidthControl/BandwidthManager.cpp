@@ -1,6 +1,7 @@
 #include "GlobalHeader.h"
 #include "BandwidthManager.h"
 #include "BandwidthLimit.h"
+#include "BandwidthShare.h"
 
 /*#include "SocketThread.h"
 #include "../NeoCore.h"
@@ -44,23 +45,51 @@ void CBandwidthManager::RequestBandwidth(const QList<CBandwidthLimit*>& Limits,
 		m_iQueuedBytes -= pEntry->iRequestSize;
 		pEntry->iRequestSize = 0;
 		pEntry->iAssigned = 0;
+		SetWaiting(pLimiter, pEntry, false);
 		// Note: we must still put in on the queue so that bandwidth gets measured
 		//pLimiter->BandwidthAssigned(m_Channel);
 		//m_Queue.remove(pLimiter);
 	}
+	else
+		SetWaiting(pLimiter, pEntry, true);
+}
+
+int CBandwidthManager::TakeBandwidth(const QList<CBandwidthLimit*>& Limits, int iAmount, int iTaken)
+{
+	int iPriority = GetPriority(Limits);
+	int iQuota = iAmount;
+	foreach(CBandwidthLimit* pLimit, Limits)
+	{
+		if (pLimit->GetLimit() == 0)
+			continue;
+		// Note: we must not cut in front of requests that are queued for this limit
+		if (pLimit->HasWaiting())
+			return 0;
+		int iLeft = pLimit->QuotaLeft();
+		iQuota = Min(iLeft, iQuota);
+		// Note: without this a limiter that asks often would drain the bucket before the manager can weight the others in
+		int iShare = DirectShare(pLimit->GetDistributeQuota(), iPriority, pLimit->GetPrioritySum(), iTaken);
+		iQuota = Min(iShare, iQuota);
+	}
+	if(iQuota <= 0)
+		return 0;
+
+	foreach(CBandwidthLimit* pLimit, Limits)
+		pLimit->UseQuota(iQuota);
+	return iQuota;
 }
 
 bool CBandwidthManager::UpdateEntry(SEntry* pEntry, const QList<CBandwidthLimit*>& Limits)
 {
 	int ActiveLimits = 0;
-	int iPrioritySumm = 0;
-	int iPriorityCount = 0;
 
 	for (int j = 0; j < pEntry->Limits.size(); j++)
 	{
 		CBandwidthLimit* pLimit = pEntry->Limits[j];
 		if(!Limits.contains(pLimit))
 		{
+			if(pEntry->WaitingOn.removeOne(pLimit))
+				pLimit->XcrWaiting(-1);
 			pLimit->XcrLock(-1);
 			pEntry->Limits.removeAt(j--);
 		}
@@ -71,12 +100,6 @@ bool CBandwidthManager::UpdateEntry(SEntry* pEntry, const QList<CBandwidthLimit*
 		if(pLimit->GetLimit() != 0)
 			ActiveLimits++;
 
-		if(int iPriority = pLimit->GetPriority())
-		{
-			iPrioritySumm += iPriority;
-			iPriorityCount++;
-		}
-
 		if(!pEntry->Limits.contains(pLimit))
 		{
 			pEntry->Limits.append(pLimit);
@@ -84,13 +107,28 @@ bool CBandwidthManager::UpdateEntry(SEntry* pEntry, const QList<CBandwidthLimit*
 		}
 	}
 
-	if(iPriorityCount > 0)
-		pEntry->iPriority = iPrioritySumm/iPriorityCount;
-	else
-		pEntry->iPriority = BW_PRIO_NORMAL; // no priority all use default priority
+	pEntry->iPriority = GetPriority(Limits);
 	return ActiveLimits > 0;
 }
 
+int CBandwidthManager::GetPriority(const QList<CBandwidthLimit*>& Limits)
+{
+	int iPrioritySumm = 0;
+	int iPriorityCount = 0;
+	foreach(CBandwidthLimit* pLimit, Limits)
+	{
+		if(int iPriority = pLimit->GetPriority())
+		{
+			iPrioritySumm += iPriority;
+			iPriorityCount++;
+		}
+	}
+
+	if(iPriorityCount > 0)
+		return iPrioritySumm/iPriorityCount;
+	return BW_PRIO_NORMAL; // no priority all use default priority
+}
+
 void CBandwidthManager::UpdateLimits(const QList<CBandwidthLimit*>& Limits, CBandwidthLimiter* pLimiter)
 {
 	QMutexLocker Locker(&m_Mutex);
@@ -115,7 +153,8 @@ void CBandwidthManager::ReturnBandwidth(CBandwidthLimiter* pLimiter)
 			pLimit->ReturnQuota(pEntry->iAssigned);
 		}
 		
-		m_Queue.remove(pLimiter);
+		QMap<CBandwidthLimiter*, SEntry>::iterator I = m_Queue.find(pLimiter);
+		Remove(I);
 	}
 }
 
@@ -153,10 +192,19 @@ void CBandwidthManager::Process(int iInterval)
 		}
 	}
 
+	// Note: the limiters that take bandwidth directly until the next round are weighted against this summ
+	for(QMap<CBandwidthLimiter*, SEntry>::iterator I = m_Queue.begin(); I != m_Queue.end(); ++I)
+	{
+		SEntry* pEntry = &I.value();
+		for (int j = 0; j < pEntry->Limits.size(); j++)
+			pEntry->Limits[j]->m_iPrioritySum = pEntry->Limits[j]->m_iTmp;
+	}
+
 	for(QMap<CBandwidthLimiter*, SEntry>::iterator I = m_Queue.begin(); I != m_Queue.end();)
 	{
 		CBandwidthLimiter* pLimiter = I.key();
 		SEntry* pEntry = &I.value();
+		int iDirect = pLimiter->m_Active[m_Channel].fetchAndStoreOrdered(0);
 		int iQuota = AssignBandwidth(pEntry);
 		ASSERT(m_iQueuedBytes >= iQuota);
 		m_iQueuedBytes -= iQuota;
@@ -178,17 +226,29 @@ void CBandwidthManager::Process(int iInterval)
 		}
 
 		if(pEntry->iRequestSize > 0)
+		{
+			pEntry->iIdle = 0;
+			// Note: the limits that are short may have changed since the request was queued
+			SetWaiting(pLimiter, pEntry, false);
+			SetWaiting(pLimiter, pEntry, true);
+		}
+		else if(iDirect != 0)
+		{
+			// the limiter got its bandwidth right from the limits since the last round
+			SetWaiting(pLimiter, pEntry, false);
 			pEntry->iIdle = 0;
+		}
 		else
 		{
+			SetWaiting(pLimiter, pEntry, false);
+
 			// Note: we have to keep calling Process untill the caunted datarate will become 0 
 			//			on controlles that are exclusive to this limiter
 			if(pEntry->iIdle <= AVG_INTERVAL + SEC2MS(3))
 				pEntry->iIdle += iInterval;
 			else
 			{
-				UpdateEntry(pEntry, QList<CBandwidthLimit*>()); // release limits
-				I = m_Queue.erase(I);
+				Remove(I);
 				continue;
 			}
 		}
@@ -205,10 +265,48 @@ CBandwidthManager::SEntry* CBandwidthManager::Get(CBandwidthLimiter* pLimiter, b
 		if(!bAdd)
 			return NULL;
 		I = m_Queue.insert(pLimiter, SEntry());
+		pLimiter->m_Tracked[m_Channel].fetchAndStoreOrdered(1);
 	}
 	return &I.value();
 }
 
+void CBandwidthManager::Remove(QMap<CBandwidthLimiter*, SEntry>::iterator& I)
+{
+	SEntry* pEntry = &I.value();
+	SetWaiting(I.key(), pEntry, false);
+	UpdateEntry(pEntry, QList<CBandwidthLimit*>()); // release limits
+	I.key()->m_Tracked[m_Channel].fetchAndStoreOrdered(0);
+	I = m_Queue.erase(I);
+}
+
+void CBandwidthManager::SetWaiting(CBandwidthLimiter* pLimiter, SEntry* pEntry, bool bWaiting)
+{
+	if(pEntry->bWaiting == bWaiting)
+		return;
+	pEntry->bWaiting = bWaiting;
+	pLimiter->m_Waiting[m_Channel].fetchAndStoreOrdered(bWaiting ? 1 : 0);
+
+	if(bWaiting)
+	{
+		int iMissing = pEntry->iRequestSize - pEntry->iAssigned;
+		for (int j = 0; j < pEntry->Limits.size(); j++)
+		{
+			CBandwidthLimit* pLimit = pEntry->Limits[j];
+			if (pLimit->GetLimit() != 0 && pLimit->QuotaLeft() < iMissing)
+			{
+				pLimit->XcrWaiting(1);
+				pEntry->WaitingOn.append(pLimit);
+			}
+		}
+	}
+	else
+	{
+		foreach(CBandwidthLimit* pLimit, pEntry->WaitingOn)
+			pLimit->XcrWaiting(-1);
+		pEntry->WaitingOn.clear();
+	}
+}
+
 int CBandwidthManager::AssignBandwidth(SEntry* pEntry)
 {
 	ASSERT(pEntry->iAssigned <= pEntry->iRequestSize);
@@ -221,8 +319,7 @@ int CBandwidthManager::AssignBandwidth(SEntry* pEntry)
 		CBandwidthLimit* pLimit = pEntry->Limits[j];
 		if (pLimit->GetLimit() == 0)
 			continue;
-		// unsigned math to prevent a overflow
-		iQuota = Min(uint32(pLimit->GetDistributeQuota()) * pEntry->iPriority / pLimit->m_iTmp, iQuota);
+		iQuota = Min(WeightedShare(pLimit->GetDistributeQuota(), pEntry->iPriority, pLimit->m_iTmp), iQuota);
 	}
 	ASSERT(iQuota >= 0);
 
@@ -22,6 +22,14 @@ public:
 	// this is used by web seeds
 	void				RequestBandwidth(const QList<CBandwidthLimit*>& Limits, CBandwidthLimiter* pLimiter, int iAmount);
 
+	// takes up to iAmount bytes right from the limits token buckets without queuing,
+	// returns 0 when some one is already waiting in the queue for one of the limits,
+	// a limiter gets at most its priority weighted share of each limits round quota, less the iTaken it already took directly
+	static int			TakeBandwidth(const QList<CBandwidthLimit*>& Limits, int iAmount, int iTaken);
+
+	// the priority of a limiter is the average of the priorities of its limits
+	static int			GetPriority(const QList<CBandwidthLimit*>& Limits);
+
 	void				UpdateLimits(const QList<CBandwidthLimit*>& Limits, CBandwidthLimiter* pLimiter);
 
 	void				ReturnBandwidth(CBandwidthLimiter* pLimiter);
@@ -56,6 +64,7 @@ protected:
 			iTTL = 20;
 #endif
 			iIdle = 0;
+			bWaiting = false;
 		}
 
 		// 1 is normal prio
@@ -78,10 +87,19 @@ protected:
 		// holds for how long the entry was idle
 		int iIdle;
 
+		// the request is queued, the limiter must not take bandwidth directly
+		bool bWaiting;
+
+		// the limits that were short on quota when the request got queued,
+		// they must not give bandwidth directly to others untill we got ours
+		QList<CBandwidthLimit*> WaitingOn;
+
 		QList<CBandwidthLimit*> Limits;
 	};
 
 	SEntry*				Get(CBandwidthLimiter* pLimiter, bool bAdd = false);
+	void				Remove(QMap<CBandwidthLimiter*, SEntry>::iterator& I);
+	void				SetWaiting(CBandwidthLimiter* pLimiter, SEntry* pEntry, bool bWaiting);
 
 	// loops over the bandwidth channels and assigns bandwidth
 	// from the most limiting one
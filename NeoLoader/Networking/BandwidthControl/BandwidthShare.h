@@ -0,0 +1,31 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Priority weighting of a limits quota, the manager hands out a limits quota each round weighted by the priorities
+// of the limiters that use it. A limiter that takes bandwidth directly between the rounds is held to the same weight,
+// so being called more often does not give it more than its share.
+
+/**
+* Returns the part of iQuota a limiter with iPriority gets, when the limiters using the limit add up to iPrioritySum
+*/
+inline int WeightedShare(int iQuota, int iPriority, int iPrioritySum)
+{
+	if(iPrioritySum < iPriority)
+		iPrioritySum = iPriority;
+	if(iQuota <= 0 || iPrioritySum <= 0)
+		return 0;
+	// unsigned math to prevent a overflow
+	return (int)((unsigned long long)iQuota * iPriority / iPrioritySum);
+}
+
+/**
+* Returns how much a limiter may still take directly from a limit, before the managers next round
+* @param: iQuota: the quota the limit distributes this round
+* @param: iTaken: what the limiter already took directly since the last round
+*/
+inline int DirectShare(int iQuota, int iPriority, int iPrioritySum, int iTaken)
+{
+	int iShare = WeightedShare(iQuota, iPriority, iPrioritySum) - iTaken;
+	return iShare > 0 ? iShare : 0;
+}
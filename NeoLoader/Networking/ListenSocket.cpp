@@ -3,6 +3,7 @@
 #include "StreamSocket.h"
 #include "TCPSocket.h"
 #include "UTPSocket.h"
+#include "SocketShard.h"
 #include "../NeoCore.h"
 
 //int _CStreamSocket_pType = qRegisterMetaType<CStreamSocket*>("CStreamSocket*");
@@ -201,15 +202,22 @@ void CStreamServer::SetupSockets()
 
 void CStreamServer::AddSocket(CStreamSocket* pSocket)
 {
-	pSocket->moveToThread(thread());
-	QMutexLocker Locker(&m_Mutex);
-	m_Sockets.insert(pSocket, 0);
+	CSocketShard* pShard = pSocket->GetShard();
+	pSocket->moveToThread(pShard ? (QThread*)pShard : thread());
+	{
+		QMutexLocker Locker(&m_Mutex);
+		m_Sockets.insert(pSocket, 0);
+	}
+	// Note: the shard picks the socket up with its next tick
+	if(pShard)
+		pShard->AddSocket(pSocket);
 }
 
 void CStreamServer::RemoveSocket(CStreamSocket* pSocket)
 {
 	QMutexLocker Locker(&m_Mutex);
 	m_Sockets.remove(pSocket);
+	m_Ready.remove(pSocket);
 }
 
 void CStreamServer::Process()
@@ -219,12 +227,30 @@ void CStreamServer::Process()
 	if(m_ServerV6)
 		m_ServerV6->Process();
 
+	// Note: datagrams sent while the listeners and sockets are processed go out in one batch at the end
 	if(m_ServerV4uTP)
+	{
+		m_ServerV4uTP->StartBatch();
 		m_ServerV4uTP->Process();
+	}
 
 	if(m_ServerV6uTP)
+	{
+		m_ServerV6uTP->StartBatch();
 		m_ServerV6uTP->Process();
+	}
+
+	ProcessSockets();
 
+	if(m_ServerV4uTP)
+		m_ServerV4uTP->FlushBatch();
+
+	if(m_ServerV6uTP)
+		m_ServerV6uTP->FlushBatch();
+}
+
+void CStreamServer::ProcessSockets()
+{
 	QMutexLocker Locker(&m_Mutex);
 
 	m_Counter ++;
@@ -233,6 +259,9 @@ void CStreamServer::Process()
 
 	for(QMap<CStreamSocket*, int>::iterator I = m_Sockets.begin(); I != m_Sockets.end(); ++I)
 	{
+		if(I.key()->GetShard())
+			continue; // processed by its shard
+
 		int &Counter = I.value();
 		if(Counter && (m_Counter % Counter) != 0)
 			continue; // socket was idle dont recheck it to often
@@ -246,10 +275,45 @@ void CStreamServer::Process()
 	}
 }
 
+void CStreamServer::WakeSocket(CStreamSocket* pSocket)
+{
+	if(CSocketShard* pShard = pSocket->GetShard())
+	{
+		pShard->WakeSocket(pSocket);
+		return;
+	}
+
+	QMutexLocker Locker(&m_Mutex);
+	m_Ready.insert(pSocket);
+}
+
+void CStreamServer::ProcessReady()
+{
+	QMutexLocker Locker(&m_Mutex);
+	if(m_Ready.isEmpty())
+		return;
+
+	foreach(CStreamSocket* pSocket, m_Ready)
+	{
+		QMap<CStreamSocket*, int>::iterator I = m_Sockets.find(pSocket);
+		if(I == m_Sockets.end())
+			continue; // the socket has not been added yet, it will be processed with the next tick
+
+		pSocket->Process();
+		I.value() = 0; // Note: after an event the socket is checked on every tick again untill it gets idle
+	}
+	m_Ready.clear();
+}
+
 void CStreamServer::FreeSocket(CStreamSocket* pSocket)
 {
 	ASSERT(pSocket);
-	if(pSocket)
+	if(!pSocket)
+		return;
+	// Note: a sharded socket must be disposed by the thread it lives in
+	if(CSocketShard* pShard = pSocket->GetShard())
+		pShard->FreeSocket(pSocket);
+	else
 		QMetaObject::invokeMethod(this, "OnFreeSocket", Qt::BlockingQueuedConnection, Q_ARG(CStreamSocket*, pSocket));	
 }
 
@@ -294,6 +358,8 @@ CUtpListener* CStreamServer::GetUTPListener(const CAddress& Address)
 
 void CStreamServer::Init(CStreamSocket* pSocket, SOCKET Sock)
 {
+	// Note: the shard must be known before the socket is set, so it does not get registered with the wrong reactor
+	pSocket->SetShard(theCore->m_Network->SelectShard());
 	CTcpSocket* pTcpSocket = new CTcpSocket(pSocket);
 	if(Sock != INVALID_SOCKET)
 		pTcpSocket->SetSocket(Sock, true);
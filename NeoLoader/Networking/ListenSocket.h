@@ -30,6 +30,9 @@ public:
 	virtual	void				SetIPs(const CAddress& IPv4 = CAddress(CAddress::IPv4), const CAddress& IPv6 = CAddress(CAddress::IPv6));
 
 	virtual	void				Process();
+	virtual	void				ProcessSockets();
+	virtual	void				ProcessReady();
+	virtual	void				WakeSocket(CStreamSocket* pSocket);
 
 	virtual bool				IsExpected(const CAddress& Address)		{return false;}
 
@@ -92,6 +95,7 @@ protected:
 	quint16						m_FallbackIncr;
 
 	QMap<CStreamSocket*, int>	m_Sockets;
+	QSet<CStreamSocket*>		m_Ready;		// sockets the reactor reported an event for
 
 	int							m_Counter;
 
@@ -0,0 +1,87 @@
+#include "GlobalHeader.h"
+#include "SendQueue.h"
+
+CSendQueue::CSendQueue()
+{
+	m_uOffset = 0;
+	m_uSize = 0;
+	m_bTailOpen = false;
+}
+
+void CSendQueue::Append(const QByteArray& Chunk)
+{
+	if(Chunk.isEmpty())
+		return;
+
+	m_Chunks.append(Chunk);
+	m_uSize += Chunk.size();
+	m_bTailOpen = false; // Note: we must not write into a buffer we share with someone else
+}
+
+void CSendQueue::Append(const byte* pData, size_t uLength)
+{
+	if(uLength == 0)
+		return;
+
+	if(m_bTailOpen && m_Chunks.last().size() + uLength <= (size_t)ChunkSize)
+		m_Chunks.last().append((const char*)pData, (int)uLength);
+	else
+	{
+		QByteArray Chunk;
+		if(uLength < (size_t)ChunkSize)
+		{
+			Chunk.reserve(ChunkSize);
+			m_bTailOpen = true;
+		}
+		else
+			m_bTailOpen = false;
+		Chunk.append((const char*)pData, (int)uLength);
+		m_Chunks.append(Chunk);
+	}
+	m_uSize += uLength;
+}
+
+int CSendQueue::Peek(SSendBuffer* pBuffers, int Count, qint64* pLength) const
+{
+	int Index = 0;
+	qint64 uLength = 0;
+	for(; Index < Count && Index < m_Chunks.size(); Index++)
+	{
+		const QByteArray& Chunk = m_Chunks.at(Index);
+		int Offset = (Index == 0) ? m_uOffset : 0;
+		pBuffers[Index].pData = Chunk.constData() + Offset;
+		pBuffers[Index].uLength = Chunk.size() - Offset;
+		uLength += pBuffers[Index].uLength;
+	}
+	if(pLength)
+		*pLength = uLength;
+	return Index;
+}
+
+void CSendQueue::Consume(size_t uLength)
+{
+	ASSERT(uLength <= m_uSize);
+	m_uSize -= uLength;
+	while(uLength > 0 && !m_Chunks.isEmpty())
+	{
+		size_t uLeft = m_Chunks.first().size() - m_uOffset;
+		if(uLength < uLeft)
+		{
+			m_uOffset += (int)uLength;
+			break;
+		}
+		uLength -= uLeft;
+		m_Chunks.removeFirst();
+		m_uOffset = 0;
+	}
+	if(m_Chunks.isEmpty())
+		m_bTailOpen = false;
+}
+
+void CSendQueue::Clear()
+{
+	m_Chunks.clear();
+	m_uOffset = 0;
+	m_uSize = 0;
+	m_bTailOpen = false;
+}
@@ -0,0 +1,38 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+struct SSendBuffer
+{
+	const char*			pData;
+	qint64				uLength;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Outgoing data of a stream socket kept as a list of chunks, large streams are kept as they are
+// and small writes are collected in the last chunk. The front chunks can be handed to the socket
+// as one scatter gather send, sent data is dropped from the front without moving the rest.
+
+class CSendQueue
+{
+public:
+	CSendQueue();
+
+	static const int	MaxBuffers = 16;	// buffers handed to one send
+	static const int	ChunkSize = 16*1024;
+
+	void				Append(const QByteArray& Chunk);
+	void				Append(const byte* pData, size_t uLength);
+
+	size_t				GetSize() const							{return m_uSize;}
+	bool				IsEmpty() const							{return m_uSize == 0;}
+
+	int					Peek(SSendBuffer* pBuffers, int Count, qint64* pLength = NULL) const;
+	void				Consume(size_t uLength);
+	void				Clear();
+
+protected:
+	QList<QByteArray>	m_Chunks;
+	int					m_uOffset;		// bytes of the first chunk that are already sent
+	size_t				m_uSize;
+	bool				m_bTailOpen;	// the last chunk is our own and can take more data
+};
@@ -0,0 +1,174 @@
+#include "GlobalHeader.h"
+#include "SocketReactor.h"
+
+#ifndef WIN32
+   #include <unistd.h>
+   #include <errno.h>
+   #include <cstring>
+#ifdef Q_OS_LINUX
+   #include <sys/epoll.h>
+   #define USE_EPOLL
+#endif
+#endif
+
+CSocketReactor::CSocketReactor()
+{
+	m_Handle = -1;
+#ifdef USE_EPOLL
+	m_Handle = epoll_create1(EPOLL_CLOEXEC); // Note: if this fails we fall back to poll
+#endif
+	m_Ready.reserve(MaxEvents);
+}
+
+CSocketReactor::~CSocketReactor()
+{
+	ASSERT(m_Handlers.isEmpty());
+#ifndef WIN32
+	if(m_Handle != -1)
+		close(m_Handle);
+#endif
+}
+
+bool CSocketReactor::IsValid() const
+{
+#ifndef WIN32
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool CSocketReactor::Register(SOCKET Socket, CSocketHandler* pHandler, bool bWrite)
+{
+#ifndef WIN32
+	ASSERT(!m_Handlers.contains(Socket));
+#ifdef USE_EPOLL
+	if(m_Handle != -1)
+	{
+		// Note: the socket is armed once for both directions, edge triggered events only report changes
+		//			so the handler must remember them until it hits EWOULDBLOCK
+		epoll_event Event;
+		memset(&Event, 0, sizeof(Event));
+		Event.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET;
+		Event.data.fd = Socket;
+		if(epoll_ctl(m_Handle, EPOLL_CTL_ADD, Socket, &Event) == -1)
+			return false;
+		m_Handlers.insert(Socket, pHandler);
+		return true;
+	}
+#endif
+	pollfd Poll;
+	Poll.fd = Socket;
+	Poll.events = POLLIN | (bWrite ? POLLOUT : 0);
+	Poll.revents = 0;
+	m_Index.insert(Socket, m_Polls.size());
+	m_Polls.append(Poll);
+	m_Handlers.insert(Socket, pHandler);
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CSocketReactor::WantWrite(SOCKET Socket, bool bWrite)
+{
+#ifndef WIN32
+	if(m_Handle != -1)
+		return; // epoll reports writability edges anyways
+
+	// Note: poll is level triggered, a writable socket would be reported all the time
+	QHash<SOCKET, int>::iterator I = m_Index.find(Socket);
+	if(I == m_Index.end())
+		return;
+	pollfd& Poll = m_Polls[I.value()];
+	if(bWrite)
+		Poll.events |= POLLOUT;
+	else
+		Poll.events &= ~POLLOUT;
+#endif
+}
+
+void CSocketReactor::Unregister(SOCKET Socket)
+{
+#ifndef WIN32
+	if(m_Handlers.remove(Socket) == 0)
+		return;
+#ifdef USE_EPOLL
+	if(m_Handle != -1)
+	{
+		epoll_event Event; // Note: kernels before 2.6.9 require a non NULL event
+		epoll_ctl(m_Handle, EPOLL_CTL_DEL, Socket, &Event);
+		return;
+	}
+#endif
+	int Index = m_Index.take(Socket);
+	int Last = m_Polls.size() - 1;
+	if(Index != Last)
+	{
+		m_Polls[Index] = m_Polls.at(Last);
+		m_Index[m_Polls.at(Index).fd] = Index;
+	}
+	m_Polls.resize(Last);
+#endif
+}
+
+int CSocketReactor::Dispatch(int iTimeout)
+{
+#ifndef WIN32
+	ASSERT(m_Ready.isEmpty());
+#ifdef USE_EPOLL
+	if(m_Handle != -1)
+	{
+		epoll_event Events[MaxEvents];
+		int Count = epoll_wait(m_Handle, Events, MaxEvents, iTimeout);
+		for(int i=0; i < Count; i++)
+		{
+			int Flags = 0;
+			if(Events[i].events & EPOLLIN)
+				Flags |= eRead;
+			if(Events[i].events & EPOLLOUT)
+				Flags |= eWrite;
+			if(Events[i].events & EPOLLERR)
+				Flags |= eError;
+			if(Events[i].events & (EPOLLHUP | EPOLLRDHUP))
+				Flags |= eHangup;
+			m_Ready.append(SReady(Events[i].data.fd, Flags));
+		}
+	}
+	else
+#endif
+	{
+		int Count = m_Polls.isEmpty() ? 0 : poll(m_Polls.data(), m_Polls.size(), iTimeout);
+		for(int i=0; i < m_Polls.size() && Count > 0; i++)
+		{
+			short revents = m_Polls.at(i).revents;
+			if(!revents)
+				continue;
+			Count--;
+
+			int Flags = 0;
+			if(revents & (POLLIN | POLLPRI))
+				Flags |= eRead;
+			if(revents & POLLOUT)
+				Flags |= eWrite;
+			if(revents & (POLLERR | POLLNVAL))
+				Flags |= eError;
+			if(revents & POLLHUP)
+				Flags |= eHangup;
+			m_Ready.append(SReady(m_Polls.at(i).fd, Flags));
+		}
+	}
+
+	// Note: a handler may register or unregister sockets, so we look each one up only when we get to it
+	int Count = m_Ready.size();
+	for(int i=0; i < m_Ready.size(); i++)
+	{
+		if(CSocketHandler* pHandler = m_Handlers.value(m_Ready.at(i).Socket))
+			pHandler->OnSocketEvent(m_Ready.at(i).Events);
+	}
+	m_Ready.resize(0);
+	return Count;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,69 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+#ifndef WIN32
+   #include <poll.h>
+   #define SOCKET int
+   #define INVALID_SOCKET (-1)
+#else
+   #include <winsock2.h>
+#endif
+
+class CSocketHandler
+{
+public:
+	virtual ~CSocketHandler() {}
+
+	virtual void			OnSocketEvent(int Events) = 0;
+};
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Watches all sockets of the socket thread at once, each socket is registered once and its
+// handler is called when the socket becomes readable, writable or fails.
+// On linux epoll is used, the epoll handle can be watched by the event loop to sleep until something happens,
+// other posix systems fall back to a single poll over all sockets, on windows the reactor is not available.
+
+class CSocketReactor
+{
+public:
+	CSocketReactor();
+	~CSocketReactor();
+
+	enum EEvents
+	{
+		eRead	= 0x01,
+		eWrite	= 0x02,
+		eError	= 0x04,
+		eHangup	= 0x08
+	};
+
+	bool					IsValid() const;
+	int						GetHandle() const						{return m_Handle;} // -1 when polling
+
+	bool					Register(SOCKET Socket, CSocketHandler* pHandler, bool bWrite = false);
+	void					WantWrite(SOCKET Socket, bool bWrite);
+	void					Unregister(SOCKET Socket);
+	int						GetCount() const						{return m_Handlers.count();}
+
+	int						Dispatch(int iTimeout = 0);
+
+protected:
+	static const int		MaxEvents = 256;
+
+	int						m_Handle;
+	QHash<SOCKET, CSocketHandler*> m_Handlers;
+
+	struct SReady
+	{
+		SReady(SOCKET s = INVALID_SOCKET, int e = 0) : Socket(s), Events(e) {}
+		SOCKET				Socket;
+		int					Events;
+	};
+	QVector<SReady>			m_Ready;
+
+#ifndef WIN32
+	// poll fallback
+	QVector<pollfd>			m_Polls;
+	QHash<SOCKET, int>		m_Index;
+#endif
+};
@@ -0,0 +1,193 @@
+#include "GlobalHeader.h"
+#include "SocketShard.h"
+#include "SocketThread.h"
+#include "SocketReactor.h"
+#include "StreamSocket.h"
+#include "ListenSocket.h"
+#include <QSocketNotifier>
+
+CSocketShard::CSocketShard(int Index, QObject* qObject)
+ : QThread(qObject), m_Worker(NULL), m_Reactor(NULL)
+{
+	m_Index = Index;
+	m_Counter = 0;
+}
+
+CSocketShard::~CSocketShard()
+{
+	StopThread();
+}
+
+void CSocketShard::StartThread()
+{
+	start();
+	m_Lock.Lock();
+}
+
+void CSocketShard::StopThread()
+{
+	quit();
+	wait();
+}
+
+void CSocketShard::run()
+{
+	m_Reactor = new CSocketReactor();
+	if(!m_Reactor->IsValid())
+	{
+		delete m_Reactor;
+		m_Reactor = NULL;
+	}
+
+	m_Worker = new CShardWorker(this, m_Reactor ? m_Reactor->GetHandle() : -1);
+
+	m_Lock.Release();
+	exec();
+
+	// Note: the remaining sockets go back to the socket thread, they are disposed there together with their servers
+	ReleaseSockets();
+
+	delete m_Worker;
+	m_Worker = NULL;
+
+	delete m_Reactor;
+	m_Reactor = NULL;
+}
+
+int CSocketShard::GetCount()
+{
+#if QT_VERSION < 0x050000
+	return m_Count;
+#else
+	return m_Count.load();
+#endif
+}
+
+void CSocketShard::AddSocket(CStreamSocket* pSocket)
+{
+	ASSERT(pSocket->thread() == this);
+	m_Count.ref();
+	m_Incoming.Push(pSocket);
+}
+
+void CSocketShard::FreeSocket(CStreamSocket* pSocket)
+{
+	if(QThread::currentThread() == this)
+		DisposeSocket(pSocket);
+	else
+		QMetaObject::invokeMethod(m_Worker, "OnFreeSocket", Qt::BlockingQueuedConnection, Q_ARG(CStreamSocket*, pSocket));
+}
+
+void CSocketShard::WakeSocket(CStreamSocket* pSocket)
+{
+	m_Ready.insert(pSocket);
+}
+
+void CSocketShard::TakeSockets()
+{
+	CStreamSocket* pSocket;
+	while(m_Incoming.Pop(pSocket))
+	{
+		m_Sockets.insert(pSocket, 0);
+		pSocket->AttachReactor(); // the socket may have been opened by an other thread without our reactor
+	}
+}
+
+void CSocketShard::DisposeSocket(CStreamSocket* pSocket)
+{
+	TakeSockets(); // the socket may still be waiting in the queue
+
+	if(m_Sockets.remove(pSocket))
+		m_Count.deref();
+	m_Ready.remove(pSocket);
+
+	if(CStreamServer* pServer = pSocket->GetServer())
+		pServer->RemoveSocket(pSocket);
+	pSocket->Dispose();
+	pSocket->deleteLater();
+}
+
+void CSocketShard::ReleaseSockets()
+{
+	TakeSockets();
+
+	foreach(CStreamSocket* pSocket, m_Sockets.keys())
+	{
+		pSocket->DetachReactor();
+		pSocket->SetShard(NULL);
+		pSocket->moveToThread(thread());
+		m_Count.deref();
+	}
+	m_Sockets.clear();
+	m_Ready.clear();
+}
+
+void CSocketShard::ProcessReady()
+{
+	if(!m_Reactor)
+		return;
+
+	TakeSockets();
+
+	m_Reactor->Dispatch();
+	if(m_Ready.isEmpty())
+		return;
+
+	foreach(CStreamSocket* pSocket, m_Ready)
+	{
+		QMap<CStreamSocket*, int>::iterator I = m_Sockets.find(pSocket);
+		if(I == m_Sockets.end())
+			continue;
+
+		pSocket->Process();
+		I.value() = 0; // Note: after an event the socket is checked on every tick again untill it gets idle
+	}
+	m_Ready.clear();
+}
+
+void CSocketShard::Process()
+{
+	// Note: when polling this is the only place the reactor is checked
+	ProcessReady();
+
+	TakeSockets();
+
+	m_Counter ++;
+	if(m_Counter > 32)
+		m_Counter = 0;
+
+	for(QMap<CStreamSocket*, int>::iterator I = m_Sockets.begin(); I != m_Sockets.end(); ++I)
+	{
+		int &Counter = I.value();
+		if(Counter && (m_Counter % Counter) != 0)
+			continue; // socket was idle dont recheck it to often
+
+		if(I.key()->Process())
+			Counter = 0;
+		else if(Counter == 0)
+			Counter = 1;
+		else if(Counter < 32)
+			Counter <<= 1; // *= 2;
+	}
+}
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+//
+
+CShardWorker::CShardWorker(CSocketShard* pShard, int Handle)
+{
+	m_pShard = pShard;
+	m_uTimerID = startTimer(1000/TICKS_PER_SEC);
+
+	// Note: see CSocketWorker, the event loop wakes up as soon as the reactor has something for us
+	if(Handle != -1)
+	{
+		QSocketNotifier* pNotifier = new QSocketNotifier(Handle, QSocketNotifier::Read, this);
+		connect(pNotifier, SIGNAL(activated(int)), this, SLOT(OnReactor()));
+	}
+}
+
+CShardWorker::~CShardWorker()
+{
+	killTimer(m_uTimerID);
+}
@@ -0,0 +1,81 @@
+#pragma once
+//#include "GlobalHeader.h"
+
+#include "../../Framework/MT/ThreadLock.h"
+#include "../../Framework/MT/LockFreeQueue.h"
+
+class CStreamSocket;
+class CSocketReactor;
+class CShardWorker;
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// A socket shard is an additional network thread that services a part of the TCP connections,
+// with its own reactor and tick. The listeners, the uTP sockets and the bandwidth managers stay in the socket thread.
+// New sockets are handed over through a lock free queue and picked up by the shard on its next tick.
+
+class CSocketShard: public QThread
+{
+	Q_OBJECT
+
+public:
+	CSocketShard(int Index, QObject* qObject = NULL);
+	~CSocketShard();
+
+	void						StartThread();
+	void						StopThread();
+
+	void						run();
+
+	int							GetIndex()			{return m_Index;}
+	int							GetCount();
+	CSocketReactor*				GetReactor()		{return m_Reactor;}
+
+	// Note: AddSocket and FreeSocket can be called from any thread, the socket must already be moved to this thread
+	void						AddSocket(CStreamSocket* pSocket);
+	void						FreeSocket(CStreamSocket* pSocket);
+	void						WakeSocket(CStreamSocket* pSocket);
+
+protected:
+	friend class CShardWorker;
+	void						Process();
+	void						ProcessReady();
+	void						TakeSockets();
+	void						DisposeSocket(CStreamSocket* pSocket);
+	void						ReleaseSockets();
+
+	int							m_Index;
+	CShardWorker*				m_Worker;
+	CSocketReactor*				m_Reactor;
+	CThreadLock					m_Lock;
+
+	QAtomicInt					m_Count;		// sockets assigned to this shard, including the ones not taken yet
+	int							m_Counter;
+
+	CLockFreeQueue<CStreamSocket*> m_Incoming;
+	QMap<CStreamSocket*, int>	m_Sockets;		// only touched by the shard thread
+	QSet<CStreamSocket*>		m_Ready;
+};
+
+class CShardWorker: public QObject
+{
+	Q_OBJECT
+
+public:
+	CShardWorker(CSocketShard* pShard, int Handle);
+	~CShardWorker();
+
+public slots:
+	void						OnFreeSocket(CStreamSocket* pSocket)	{m_pShard->DisposeSocket(pSocket);}
+
+private slots:
+	void						OnReactor()								{m_pShard->ProcessReady();}
+
+protected:
+	void						timerEvent(QTimerEvent* pEvent)	{
+		if(pEvent->timerId() == m_uTimerID)
+			m_pShard->Process();
+	}
+
+	CSocketShard*				m_pShard;
+	int							m_uTimerID;
+};
@@ -6,12 +6,14 @@
 #include "BandwidthControl/BandwidthManager.h"
 #include "BandwidthControl/BandwidthLimit.h"
 #include "UTPSocket.h"
+#include "SocketReactor.h"
+#include "SocketShard.h"
 #include <QNetworkInterface>
 
 int _QList_QHostAddress_pType = qRegisterMetaType<QList<QHostAddress> >("QList<QHostAddress>");
 
 CSocketThread::CSocketThread(QObject* qObject)
- : QThread(qObject), m_Worker(NULL)
+ : QThread(qObject), m_Worker(NULL), m_Reactor(NULL)
 {
 	m_OpenSockets = 0;
 	m_IntervalCounter = 0;
@@ -120,32 +122,95 @@ void CSocketThread::run()
 {
 	CUtpTimer* pTimer = new CUtpTimer();
 
-	m_Worker = new CSocketWorker();
+	m_Reactor = new CSocketReactor();
+	if(!m_Reactor->IsValid())
+	{
+		delete m_Reactor;
+		m_Reactor = NULL;
+	}
+
+	m_Worker = new CSocketWorker(m_Reactor ? m_Reactor->GetHandle() : -1);
 
 	m_UpManager = new CBandwidthManager(CBandwidthLimiter::eUpChannel);
 	m_UpLimit = new CBandwidthLimit();
 	m_DownManager = new CBandwidthManager(CBandwidthLimiter::eDownChannel);
 	m_DownLimit = new CBandwidthLimit();
 
+	// Note: by default we leave one core to the main thread and one to this one
+	int Shards = theCore->Cfg()->GetInt("Bandwidth/SocketShards");
+	if(Shards == 0)
+	{
+		int Threads = QThread::idealThreadCount();
+		Shards = Min(Threads - 2, 8);
+	}
+	for(int i=0; i < Shards; i++)
+	{
+		CSocketShard* pShard = new CSocketShard(i);
+		pShard->StartThread();
+		m_Shards.append(pShard);
+	}
+
 	m_Lock.Release();
 	exec();
 
+	// Note: the shards give their sockets back to us, so they can be disposed together with their servers
+	foreach(CSocketShard* pShard, m_Shards)
+		pShard->StopThread();
+
 	delete m_Worker;
 
 	QMutexLocker Locker (&m_Mutex);
 	foreach(CStreamServer* pServer, m_Servers)
 		delete pServer;
 
+	foreach(CSocketShard* pShard, m_Shards)
+		delete pShard;
+	m_Shards.clear();
+
 	delete m_UpLimit;
 	delete m_UpManager;
 	delete m_DownLimit;
 	delete m_DownManager;
 
+	delete m_Reactor;
+	m_Reactor = NULL;
+
 	delete pTimer;
 }
 
+CSocketShard* CSocketThread::SelectShard()
+{
+	CSocketShard* pBest = NULL;
+	int BestCount = 0;
+	foreach(CSocketShard* pShard, m_Shards)
+	{
+		int Count = pShard->GetCount();
+		if(!pBest || Count < BestCount)
+		{
+			pBest = pShard;
+			BestCount = Count;
+		}
+	}
+	return pBest;
+}
+
+void CSocketThread::ProcessReady()
+{
+	if(!m_Reactor)
+		return;
+
+	QMutexLocker Locker (&m_Mutex);
+	if(m_Reactor->Dispatch() == 0)
+		return;
+	foreach(CStreamServer* pServer, m_Servers)
+		pServer->ProcessReady();
+}
+
 void CSocketThread::Process()
 {
+	// Note: when polling this is the only place the reactor is checked
+	ProcessReady();
+
 	int OpenSockets = 0;
 	QMutexLocker Locker (&m_Mutex);
 	foreach(CStreamServer* pServer, m_Servers)
@@ -6,12 +6,15 @@
 #include "../../Framework/MT/ThreadEx.h"
 #include "../../Framework/MT/ThreadLock.h"
 #include "../FileTransfer/Transfer.h"
+#include <QSocketNotifier>
 
 class CStreamServer;
 class CSocketWorker;
 class CBandwidthManager;
 class CBandwidthLimit;
 class CBandwidthCounter;
+class CSocketReactor;
+class CSocketShard;
 
 #define TICKS_PER_SEC 100
 
@@ -52,6 +55,9 @@ public:
 	CBandwidthLimit*			GetUpLimit()		{return m_UpLimit;}
 	CBandwidthLimit*			GetDownLimit()		{return m_DownLimit;}
 
+	CSocketReactor*				GetReactor()		{return m_Reactor;}
+	CSocketShard*				SelectShard();
+
 	QList<QHostAddress>			GetAddressSample(int Count);
 
 	const STransferStats&		GetStats()			{return m_TransferStats;}
@@ -68,10 +74,14 @@ public slots:
 protected:
 	friend class CSocketWorker;
 	void						Process();
+	void						ProcessReady();
 
 	CSocketWorker*				m_Worker;
+	CSocketReactor*				m_Reactor;
 	CThreadLock					m_Lock;
 
+	QList<CSocketShard*>		m_Shards;		// only changed before the thread is up and after it stopped
+
 	QMutex						m_Mutex;
 	QList<CStreamServer*>		m_Servers;
 
@@ -113,13 +123,24 @@ class CSocketWorker: public QObject
 	Q_OBJECT
 
 public:
-	CSocketWorker(){
+	CSocketWorker(int Handle){
 		m_uTimerID = startTimer(1000/TICKS_PER_SEC);
+
+		// Note: the epoll handle becomes readable when any registered socket has an event,
+		//			so the event loop wakes up right away instead of waiting for the next tick
+		if(Handle != -1)
+		{
+			QSocketNotifier* pNotifier = new QSocketNotifier(Handle, QSocketNotifier::Read, this);
+			connect(pNotifier, SIGNAL(activated(int)), this, SLOT(OnReactor()));
+		}
 	}
 	~CSocketWorker(){
 		killTimer(m_uTimerID);
 	}
 
+private slots:
+	void						OnReactor()						{((CSocketThread*)thread())->ProcessReady();}
+
 protected:
 	void						timerEvent(QTimerEvent* pEvent)	{
 		if(pEvent->timerId() == m_uTimerID)
@@ -2,6 +2,7 @@
 #include "StreamSocket.h"
 #include "../NeoCore.h"
 #include "TCPSocket.h"
+#include "SocketShard.h"
 
 CAbstractSocket::CAbstractSocket(CStreamSocket* pStream) 
  : QObject(pStream) 
@@ -53,6 +54,61 @@ qint64 CAbstractSocket::Write(const char *data, qint64 len)
 	return uWriten;
 }
 
+qint64 CAbstractSocket::WriteV(const SSendBuffer* pBuffers, int Count)
+{
+	ASSERT(Count <= CSendQueue::MaxBuffers);
+
+	qint64 len = 0;
+	for(int i=0; i < Count; i++)
+		len += pBuffers[i].uLength;
+
+	CStreamSocket* pStreamSocket = GetStream();
+	pStreamSocket->RequestBandwidth(CBandwidthLimiter::eUpChannel, len);
+
+	qint64 uToWrite = Min(len, pStreamSocket->GetQuota(CBandwidthLimiter::eUpChannel));
+	if(uToWrite <= 0)
+		return 0;
+#ifdef MSS
+	if(theCore->m_Network->UseTransportLimiting() && pStreamSocket->GetQuota(CBandwidthLimiter::eDownChannel) < 0)
+		return 0;
+#endif
+	ASSERT(uToWrite > 0);
+
+	// cut the buffer list at the quota
+	SSendBuffer Buffers[CSendQueue::MaxBuffers];
+	int Used = 0;
+	for(qint64 uLeft = uToWrite; Used < Count && uLeft > 0; Used++)
+	{
+		Buffers[Used].pData = pBuffers[Used].pData;
+		Buffers[Used].uLength = Min(pBuffers[Used].uLength, uLeft);
+		uLeft -= Buffers[Used].uLength;
+	}
+
+	qint64 uWriten = SendV(Buffers, Used);
+	if(uWriten == -1)
+		return -1;
+	ASSERT(uToWrite >= uWriten);
+
+	pStreamSocket->CountBandwidth(CBandwidthLimiter::eUpChannel, uWriten, pStreamSocket->IsUpload() ? CBandwidthCounter::ePayload : CBandwidthCounter::eProtocol);
+	return uWriten;
+}
+
+qint64 CAbstractSocket::SendV(const SSendBuffer* pBuffers, int Count)
+{
+	// Note: sockets that can not gather buffers send them one by one
+	qint64 Total = 0;
+	for(int i=0; i < Count; i++)
+	{
+		qint64 uSent = Send(pBuffers[i].pData, pBuffers[i].uLength);
+		if(uSent == -1)
+			return Total ? Total : -1;
+		Total += uSent;
+		if(uSent < pBuffers[i].uLength)
+			break;
+	}
+	return Total;
+}
+
 /////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
@@ -69,8 +125,11 @@ CStreamSocket::CStreamSocket(CSocketThread* pSocketThread)
 	m_bDownload = false;
 
 	m_Server = NULL;
+	m_pShard = NULL;
 	m_pSocket = NULL;
 	m_Port = 0;
+
+	m_pOutStream = NULL;
 }
 
 CStreamSocket::~CStreamSocket() 
@@ -98,6 +157,14 @@ void CStreamSocket::Init(CAbstractSocket* pSocket, CStreamServer* pServer)
 	}
 }
 
+CSocketReactor* CStreamSocket::GetReactor()
+{
+	// Note: a reactor may only be used by the thread it belongs to
+	if(m_pShard)
+		return QThread::currentThread() == m_pShard ? m_pShard->GetReactor() : NULL;
+	return QThread::currentThread() == theCore->m_Network ? theCore->m_Network->GetReactor() : NULL;
+}
+
 void CStreamSocket::Dispose()
 {
 	delete m_pSocket;
@@ -122,25 +189,34 @@ bool CStreamSocket::Process()
 
 void CStreamSocket::StreamOut(byte* Data, size_t Length)
 {
-	m_OutBuffer.AppendData(Data, Length);
+	// Note: a queued stream arrives here after subclasses encoded it in place, so we can take it without copying
+	if(m_pOutStream && Data == (byte*)m_pOutStream->constData() && Length == (size_t)m_pOutStream->size())
+		m_OutQueue.Append(*m_pOutStream);
+	else
+		m_OutQueue.Append(Data, Length);
 	//if(m_State == eConnected)
 	//	emit bytesWritten(0);
 }
 
 void CStreamSocket::StreamIn(byte* Data, size_t Length)
 {
-	m_InBuffer.AppendData(Data, Length);
+	// Note: ReadFromSocket receives right behind the data in the input buffer, than there is nothing to copy
+	if(Data == m_InBuffer.GetBuffer() + m_InBuffer.GetSize())
+		m_InBuffer.SetSize(m_InBuffer.GetSize() + Length);
+	else
+		m_InBuffer.AppendData(Data, Length);
 }
 
-void CStreamSocket::QueueStream(uint64 ID, const QByteArray& Stream)
+void CStreamSocket::QueueStream(uint64 ID, const QByteArray& Header, const QByteArray& Stream)
 {
 	SQueueEntry Entry;
+	Entry.Header = Header;
 	Entry.Stream = Stream;
 	Entry.ID = ID;
 
 	QMutexLocker Locker(&m_Mutex);
 	m_QueuedStreams.append(Entry);
-	m_QueuedSize += Entry.Stream.size();
+	m_QueuedSize += Entry.Header.size() + Entry.Stream.size();
 
 	//if(m_State == eConnected)
 	//	emit bytesWritten(0);
@@ -160,7 +236,7 @@ void CStreamSocket::CancelStream(uint64 ID)
 	{
 		if(m_QueuedStreams.at(i).ID == ID)
 		{
-			m_QueuedSize -= m_QueuedStreams.at(i).Stream.size();
+			m_QueuedSize -= m_QueuedStreams.at(i).Header.size() + m_QueuedStreams.at(i).Stream.size();
 			m_QueuedStreams.removeAt(i);
 			break;
 		}
@@ -172,23 +248,34 @@ qint64 CStreamSocket::WriteToSocket()
 	QMutexLocker Locker(&m_Mutex);
 	
 	uint64 Total = 0;
-	while(m_OutBuffer.GetSize() > 0 || !m_QueuedStreams.isEmpty())
+	while(!m_OutQueue.IsEmpty() || !m_QueuedStreams.isEmpty())
 	{
-		if(m_OutBuffer.GetSize() == 0 && !m_QueuedStreams.isEmpty())
+		if(m_OutQueue.IsEmpty() && !m_QueuedStreams.isEmpty())
 		{
 			SQueueEntry Entry = m_QueuedStreams.takeFirst();
-			m_QueuedSize -= Entry.Stream.size();
+			m_QueuedSize -= Entry.Header.size() + Entry.Stream.size();
+			if(!Entry.Header.isEmpty())
+			{
+				m_pOutStream = &Entry.Header;
+				StreamOut((byte*)Entry.Header.data(), Entry.Header.size());
+			}
+			// Note: we hold the only reference to the stream by now, so data() does not detach and an encrypting subclass works in place
+			m_pOutStream = &Entry.Stream;
 			StreamOut((byte*)Entry.Stream.data(), Entry.Stream.size());
+			m_pOutStream = NULL;
 			emit NextPacketSend();
 		}
 
-		quint64 uWriten = m_pSocket->Write((char*)m_OutBuffer.GetBuffer(), m_OutBuffer.GetSize());
+		SSendBuffer Buffers[CSendQueue::MaxBuffers];
+		qint64 uLength = 0;
+		int Count = m_OutQueue.Peek(Buffers, CSendQueue::MaxBuffers, &uLength);
+		qint64 uWriten = m_pSocket->WriteV(Buffers, Count);
 		if(uWriten == 0 || uWriten == -1)
 			break;
-		m_OutBuffer.ShiftData(uWriten);
+		m_OutQueue.Consume(uWriten);
 		Total += uWriten;
 
-		if(m_OutBuffer.GetSize() > 0)
+		if(uWriten < uLength)
 			break; // if we did not send all it means the socket blocked, so we dont try again or else we would set the blocking flag
 	}
 	return Total;
@@ -201,12 +288,16 @@ qint64 CStreamSocket::ReadFromSocket()
 	quint64 Total = 0;
 	while(m_pSocket->RecvPending())
 	{
+		// Note: we receive right into the free space at the end of the input buffer and let StreamIn work on it in place
 		const qint64 Size = 16*1024;
-		char Buffer[Size];
-		qint64 uRead = m_pSocket->Read(Buffer,Size);
+		size_t uSize = m_InBuffer.GetSize();
+		if(m_InBuffer.GetLengthLeft() < (size_t)Size)
+			m_InBuffer.SetSize(uSize, true, Max((size_t)Size, uSize));
+		byte* Buffer = m_InBuffer.GetBuffer() + uSize;
+		qint64 uRead = m_pSocket->Read((char*)Buffer,Size);
 		if(uRead == 0 || uRead == -1)
 			break;
-		StreamIn((byte*)Buffer, uRead);
+		StreamIn(Buffer, uRead);
 		Total += uRead;
 	}
 	if(Total)
@@ -4,9 +4,12 @@
 #include "../../Framework/ObjectEx.h"
 #include "../../Framework/Address.h"
 #include "./BandwidthControl/BandwidthLimiter.h"
+#include "SendQueue.h"
 
 class CStreamServer;
 class CStreamSocket;
+class CSocketShard;
+class CSocketReactor;
 
 #define SOCK_ERR_NONE		0
 #define SOCK_ERR_NETWORK	1
@@ -37,12 +40,17 @@ public:
 
 	virtual qint64		Read(char *data, qint64 maxlen);
     virtual qint64		Write(const char *data, qint64 len);
+	virtual qint64		WriteV(const SSendBuffer* pBuffers, int Count);
 	virtual qint64		Recv(char *data, qint64 maxlen) = 0;
     virtual qint64		Send(const char *data, qint64 len) = 0;
+	virtual qint64		SendV(const SSendBuffer* pBuffers, int Count);
 
 	virtual qint64		RecvPending() const = 0;
 	virtual bool		SendBlocking() const  {return m_Blocking;}
 
+	virtual void		AttachReactor(CSocketReactor* pReactor) {}
+	virtual void		DetachReactor() {}
+
 signals:
 	void				Connected();
 	void				Disconnected(int Error = 0);
@@ -104,6 +112,12 @@ public:
 
 	CStreamServer*		GetServer()									{return m_Server;}
 
+	void				SetShard(CSocketShard* pShard)				{m_pShard = pShard;}
+	CSocketShard*		GetShard()									{return m_pShard;}
+	CSocketReactor*		GetReactor();
+	void				AttachReactor()								{if(m_pSocket) m_pSocket->AttachReactor(GetReactor());}
+	void				DetachReactor()								{if(m_pSocket) m_pSocket->DetachReactor();}
+
 	virtual bool		IsBlocking() const							{return m_pSocket ? m_pSocket->SendBlocking() : false;}
 
 	void				AcceptConnect()								{if(m_State == eIncoming) m_State = eConnected;}
@@ -125,7 +139,9 @@ signals:
 protected:
 	virtual void		DisconnectFromHost(int Error);
 
-	virtual void		QueueStream(uint64 ID, const QByteArray& Stream);
+	virtual void		QueueStream(uint64 ID, const QByteArray& Stream)	{QueueStream(ID, QByteArray(), Stream);}
+	// Note: header and stream are passed on as separate segments, so a large payload is never copied to prepend a few bytes
+	virtual void		QueueStream(uint64 ID, const QByteArray& Header, const QByteArray& Stream);
 	virtual void		StreamOut(byte* Data, size_t Length);
 	virtual void		StreamIn(byte* Data, size_t Length);
 	virtual void		ProcessStream() = 0;
@@ -134,11 +150,13 @@ protected:
 
 	volatile uint64		m_LastActivity;
 
-	CBuffer				m_OutBuffer;
+	CSendQueue			m_OutQueue;
+	QByteArray*			m_pOutStream;	// queued stream that is being passed to StreamOut
 	CBuffer				m_InBuffer;
 
 	struct SQueueEntry
 	{
+		QByteArray Header;
 		QByteArray Stream;
 		uint64 ID;
 	};
@@ -151,6 +169,7 @@ protected:
 	bool				m_bDownload;
 
 	CStreamServer*		m_Server;
+	CSocketShard*		m_pShard;
 
 	CAbstractSocket*	m_pSocket;
 	CAddress			m_Address;
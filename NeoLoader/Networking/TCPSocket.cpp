@@ -14,6 +14,7 @@
    #include <netinet/in.h>
    #include <fcntl.h>
    #include <sys/ioctl.h>
+   #include <sys/uio.h>
    #define SOCKET_ERROR (-1)
    #define closesocket close
    #define WSAGetLastError() errno
@@ -27,12 +28,14 @@
 #endif
 #endif
 
-#define CHK_THREAD ASSERT(QThread::currentThread() == theCore->m_Network);
+#define CHK_THREAD ASSERT(QThread::currentThread() == thread());
 
 CTcpListener::CTcpListener(QObject* qObject)
 : QObject(qObject) 
 {
 	m_Socket = INVALID_SOCKET;
+	m_pReactor = NULL;
+	m_Pending = false;
 
 	m_sa = NULL;
 	m_sa_len = 0;
@@ -54,6 +57,11 @@ void CTcpListener::Close()
 
 	if(m_Socket != INVALID_SOCKET)
 	{
+		if(m_pReactor)
+		{
+			m_pReactor->Unregister(m_Socket);
+			m_pReactor = NULL;
+		}
 		closesocket(m_Socket);
 		m_Socket = INVALID_SOCKET;
 	}
@@ -131,6 +139,11 @@ bool CTcpListener::Listen(quint16 Port, const CAddress& IP)
 	int iMode = fcntl(m_Socket, F_GETFL, 0);
 	fcntl(m_Socket, F_SETFL, iMode | O_NONBLOCK);
 #endif
+
+	m_pReactor = theCore->m_Network->GetReactor();
+	if(m_pReactor && !m_pReactor->Register(m_Socket, this))
+		m_pReactor = NULL;
+	m_Pending = true;
 	return true;
 }
 
@@ -139,6 +152,13 @@ void CTcpListener::Process()
 	if(m_Socket == INVALID_SOCKET)
 		return;
 
+	if(m_pReactor)
+	{
+		if(!m_Pending)
+			return; // no connections are waiting
+		m_Pending = false;
+	}
+
 	CStreamServer* pServer = ((CStreamServer*)parent());
 	int MaxCon = theCore->Cfg()->GetInt("Bandwidth/MaxConnections");
 
@@ -148,7 +168,12 @@ void CTcpListener::Process()
 		socklen_t sa_len = sizeof(sa);
 		SOCKET Socket = accept(m_Socket, (sockaddr*)&sa, &sa_len);
 		if (Socket == INVALID_SOCKET)
+		{
+			// Note: the reactor reports only new connections, if accept failed for an other reason we must retry on the next tick
+			if(m_pReactor && WSAGetLastError() != WSAEWOULDBLOCK)
+				m_Pending = true;
 			break;
+		}
 
 		if(theCore->m_Network->GetCount() > MaxCon)
 		{
@@ -166,6 +191,12 @@ void CTcpListener::Process()
 	}
 }
 
+void CTcpListener::OnSocketEvent(int Events)
+{
+	m_Pending = true;
+	Process();
+}
+
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
 //
 
@@ -175,6 +206,8 @@ CTcpSocket::CTcpSocket(CStreamSocket* parent)
 	m_Socket = INVALID_SOCKET;
 	//m_State = CStreamSocket::eNotConnected;
 	m_Connected = false;
+	m_pReactor = NULL;
+	m_Events = 0;
 
 #ifdef MSS
 	m_FrameOH = 0;
@@ -211,6 +244,12 @@ void CTcpSocket::SetSocket(SOCKET Socket, bool Connected)
 	fcntl(m_Socket, F_SETFL, iMode | O_NONBLOCK);
 #endif
 
+	// Note: without a reactor we fall back to checking the socket on every tick
+	m_Events = 0;
+	m_pReactor = GetStream()->GetReactor();
+	if(m_pReactor && !m_pReactor->Register(m_Socket, this, !Connected))
+		m_pReactor = NULL;
+
 	//if(Connected)
 	//	m_State = CStreamSocket::eConnected;
 
@@ -221,11 +260,42 @@ void CTcpSocket::SetSocket(SOCKET Socket, bool Connected)
 #endif
 }
 
+void CTcpSocket::AttachReactor(CSocketReactor* pReactor)
+{
+	CHK_THREAD;
+	if(m_Socket == INVALID_SOCKET || m_pReactor || !pReactor)
+		return;
+
+	if(!pReactor->Register(m_Socket, this, !m_Connected))
+		return;
+	m_pReactor = pReactor;
+	// Note: we may have missed events before we were registered, so try reading and writing once
+	m_Events = CSocketReactor::eRead | CSocketReactor::eWrite;
+}
+
+void CTcpSocket::DetachReactor()
+{
+	CHK_THREAD;
+	if(m_pReactor)
+	{
+		m_pReactor->Unregister(m_Socket);
+		m_pReactor = NULL;
+	}
+	m_Events = 0;
+}
+
 void CTcpSocket::ClearSocket(bool Closed)
 {
 	CHK_THREAD;
 	ASSERT(m_Socket != INVALID_SOCKET);
 
+	if(m_pReactor)
+	{
+		m_pReactor->Unregister(m_Socket);
+		m_pReactor = NULL;
+	}
+	m_Events = 0;
+
 	closesocket(m_Socket);
 	m_Socket = INVALID_SOCKET;
 
@@ -306,18 +376,40 @@ bool CTcpSocket::Process()
 	if(m_Socket == INVALID_SOCKET)
 		return false;
 
-    struct timeval tv;
-    fd_set writefds;
-    tv.tv_sec = 0;
-    tv.tv_usec = 0;
+	bool bWritable;
+	if(m_pReactor)
+	{
+		if(m_Events & CSocketReactor::eHangup)
+		{
+			// Note: the remote side closed the connection, we still read what it sent before
+			if(RecvPending() == 0)
+			{
+				DisconnectFromHost(SOCK_ERR_RESET);
+				return false;
+			}
+		}
 
-    FD_ZERO(&writefds);
-	FD_SET(m_Socket, &writefds);
-    int ret = select(m_Socket + 1, NULL, &writefds, NULL, &tv);
-	if (ret == SOCKET_ERROR)
+		if(!(m_Events & (CSocketReactor::eWrite | CSocketReactor::eError)))
+			return false; // nothing happened since the last check
+		bWritable = (m_Events & CSocketReactor::eWrite) != 0;
+		m_Events &= ~(CSocketReactor::eWrite | CSocketReactor::eError);
+	}
+	else
 	{
-		DisconnectFromHost(m_Connected ? SOCK_ERR_RESET : SOCK_ERR_REFUSED);
-		return false;
+		struct timeval tv;
+		fd_set writefds;
+		tv.tv_sec = 0;
+		tv.tv_usec = 0;
+
+		FD_ZERO(&writefds);
+		FD_SET(m_Socket, &writefds);
+		int ret = select(m_Socket + 1, NULL, &writefds, NULL, &tv);
+		if (ret == SOCKET_ERROR)
+		{
+			DisconnectFromHost(m_Connected ? SOCK_ERR_RESET : SOCK_ERR_REFUSED);
+			return false;
+		}
+		bWritable = FD_ISSET(m_Socket, &writefds) != 0;
 	}
 
 	int so_error;
@@ -337,16 +429,19 @@ bool CTcpSocket::Process()
 		return false;
 	}
 
+	if(bWritable && m_pReactor)
+		m_pReactor->WantWrite(m_Socket, false);
+
 	if(!m_Connected)
 	{
-		if(!FD_ISSET(m_Socket, &writefds))
+		if(!bWritable)
 			return true;
 		m_Connected = true;
 		emit Connected();
 	}
 	else
 	{
-		if(FD_ISSET(m_Socket, &writefds))
+		if(bWritable)
 			m_Blocking = false;
 	}
 
@@ -366,6 +461,7 @@ qint64 CTcpSocket::Recv(char *data, qint64 maxlen)
 			DisconnectFromHost(SOCK_ERR_RESET);
 			return -1;
 		}
+		m_Events &= ~CSocketReactor::eRead;
 		return 0;
 	}
 #ifdef MSS
@@ -378,6 +474,8 @@ qint64 CTcpSocket::Send(const char *data, qint64 len)
 {
 	if(!m_Connected)
 		return 0;
+	if(m_pReactor && m_Blocking)
+		return 0; // wait for the reactor to report the socket writable again
 	int Sent = send(m_Socket, data, len, 0);
 	if (Sent == SOCKET_ERROR)
 	{
@@ -388,7 +486,63 @@ qint64 CTcpSocket::Send(const char *data, qint64 len)
 			return -1;
 		}
 		else
+		{
 			m_Blocking = true;
+			if(m_pReactor)
+				m_pReactor->WantWrite(m_Socket, true);
+		}
+		return 0;
+	}
+#ifdef MSS
+	AddFrameOH(Sent, CBandwidthCounter::eAck, CBandwidthCounter::eHeader);
+#endif
+	return Sent;
+}
+
+qint64 CTcpSocket::SendV(const SSendBuffer* pBuffers, int Count)
+{
+	if(!m_Connected)
+		return 0;
+	if(m_pReactor && m_Blocking)
+		return 0; // wait for the reactor to report the socket writable again
+	ASSERT(Count <= CSendQueue::MaxBuffers);
+
+#ifdef WIN32
+	WSABUF Buffers[CSendQueue::MaxBuffers];
+	for(int i=0; i < Count; i++)
+	{
+		Buffers[i].buf = (char*)pBuffers[i].pData;
+		Buffers[i].len = (u_long)pBuffers[i].uLength;
+	}
+	DWORD dwSent = 0;
+	int Sent = WSASend(m_Socket, Buffers, Count, &dwSent, 0, NULL, NULL) == SOCKET_ERROR ? SOCKET_ERROR : (int)dwSent;
+#else
+	struct iovec Buffers[CSendQueue::MaxBuffers];
+	for(int i=0; i < Count; i++)
+	{
+		Buffers[i].iov_base = (void*)pBuffers[i].pData;
+		Buffers[i].iov_len = (size_t)pBuffers[i].uLength;
+	}
+	struct msghdr Msg;
+	memset(&Msg, 0, sizeof(Msg));
+	Msg.msg_iov = Buffers;
+	Msg.msg_iovlen = Count;
+	int Sent = sendmsg(m_Socket, &Msg, 0);
+#endif
+	if (Sent == SOCKET_ERROR)
+	{
+		uint32 Error = WSAGetLastError();
+		if (Error != WSAEWOULDBLOCK)
+		{
+			DisconnectFromHost(SOCK_ERR_RESET);
+			return -1;
+		}
+		else
+		{
+			m_Blocking = true;
+			if(m_pReactor)
+				m_pReactor->WantWrite(m_Socket, true);
+		}
 		return 0;
 	}
 #ifdef MSS
@@ -399,15 +553,30 @@ qint64 CTcpSocket::Send(const char *data, qint64 len)
 
 qint64 CTcpSocket::RecvPending() const
 {
-	u_long uBytes;
+	if(m_pReactor && !(m_Events & CSocketReactor::eRead))
+		return 0; // nothing arrived since we last drained the socket
+
 #ifdef WIN32
+	u_long uBytes = 0;
 	ioctlsocket(m_Socket, FIONREAD, &uBytes);
 #else
-	fcntl(m_Socket, FIONREAD, &uBytes);
+	int uBytes = 0;
+	ioctl(m_Socket, FIONREAD, &uBytes);
 #endif
+	if(uBytes == 0)
+		m_Events &= ~CSocketReactor::eRead;
 	return uBytes;
 }
 
+void CTcpSocket::OnSocketEvent(int Events)
+{
+	m_Events |= Events;
+
+	CStreamSocket* pSocket = GetStream();
+	if(CStreamServer* pServer = pSocket->GetServer())
+		pServer->WakeSocket(pSocket);
+}
+
 #ifdef MSS
 void CTcpSocket::AddFrameOH(int Size, CBandwidthCounter::EType TypeDown, CBandwidthCounter::EType TypeUp)
 {
@@ -4,9 +4,10 @@
 #include "../../Framework/ObjectEx.h"
 #include "StreamSocket.h"
 #include "ListenSocket.h"
+#include "SocketReactor.h"
 
 //class CTcpListener: public QTcpServer
-class CTcpListener: public QObject
+class CTcpListener: public QObject, public CSocketHandler
 {
 	Q_OBJECT
 
@@ -20,6 +21,8 @@ public:
 
 	void				Process();
 
+	virtual void		OnSocketEvent(int Events);
+
 signals:
 	void				Connection(CStreamSocket* pSocket);
 
@@ -29,6 +32,8 @@ protected:
 	sockaddr*			m_sa;
 	int					m_sa_len;
 	SOCKET				m_Socket;
+	CSocketReactor*		m_pReactor;
+	bool				m_Pending;
 };
 
 ///////////////////////////////////////////////////////////////////////////////////////////////////////////
@@ -36,7 +41,7 @@ protected:
 
 #define SOCK_TCP 'tcp'
 
-class CTcpSocket: public CAbstractSocket
+class CTcpSocket: public CAbstractSocket, public CSocketHandler
 {
 	Q_OBJECT
 
@@ -51,6 +56,9 @@ public:
 	virtual void		SetSocket(SOCKET Socket, bool Connected = false);
 	virtual void		ClearSocket(bool Closed = false);
 
+	virtual void		AttachReactor(CSocketReactor* pReactor);
+	virtual void		DetachReactor();
+
 	virtual void		ConnectToHost(const CAddress& Address, quint16 Port);
 	virtual void		DisconnectFromHost(int Error = 0);
 	virtual	CAddress GetAddress(quint16* pPort = NULL) const;
@@ -59,13 +67,18 @@ public:
 
 	virtual qint64		Recv(char *data, qint64 maxlen);
     virtual qint64		Send(const char *data, qint64 len);
+	virtual qint64		SendV(const SSendBuffer* pBuffers, int Count);
 
 	virtual qint64		RecvPending() const;
 
+	virtual void		OnSocketEvent(int Events);
+
 protected:
 	SOCKET				m_Socket;
 	//CStreamSocket::EState m_State;
 	bool				m_Connected;
+	CSocketReactor*		m_pReactor;
+	mutable int			m_Events;	// readiness reported by the reactor and not yet consumed
 #ifdef MSS
 	void				AddFrameOH(int Size, CBandwidthCounter::EType TypeDown, CBandwidthCounter::EType TypeUp);
 	void				AddSynOH(bool In);
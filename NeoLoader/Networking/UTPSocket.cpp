@@ -70,10 +70,12 @@ void CUtpTimer::timerEvent(QTimerEvent* pEvent)
 //int CUtpListener::m_Counter = 0;
 //CUtpTimer* CUtpListener::m_pTimer = NULL;
 
+// Note: uTP stays below the path MTU, 4KB leaves room for the ed2k and DHT datagrams that share the port
 CUtpListener::CUtpListener(QObject* qObject)
-: QObject(qObject)
+: QObject(qObject), m_Batch(32, 4*1024)
 {
 	m_Socket = INVALID_SOCKET;
+	m_Batching = false;
 }
 
 CUtpListener::~CUtpListener()
@@ -100,6 +102,8 @@ void CUtpListener::Close()
 
 	if(m_Socket != INVALID_SOCKET)
 	{
+		m_Batch.Flush();
+		m_Batch.SetSocket(INVALID_SOCKET);
 		closesocket(m_Socket);
 		m_Socket = INVALID_SOCKET;
 	}
@@ -164,6 +168,8 @@ bool CUtpListener::Bind(quint16 Port, const CAddress& IP)
 	int iMode = fcntl(m_Socket, F_GETFL, 0);
 	fcntl(m_Socket, F_SETFL, iMode | O_NONBLOCK);
 #endif
+
+	m_Batch.SetSocket(m_Socket);
 	return true;
 }
 
@@ -318,7 +324,9 @@ void CUtpListener::SendDatagram(const char *data, qint64 len, const CAddress &ho
 	int sa_len = sizeof(sockaddr_in6);
 	host.ToSA((struct sockaddr*)&sa, &sa_len, port);
 
-	sendto(m_Socket, data, len, 0, (struct sockaddr*)&sa, sa_len);
+	m_Batch.Send((const byte*)data, len, (struct sockaddr*)&sa, sa_len);
+	if(!m_Batching)
+		m_Batch.Flush();
 }
 
 void CUtpListener::ReciveDatagram(const char *data, qint64 len, const CAddress &host, quint16 port)
@@ -335,34 +343,25 @@ void CUtpListener::Process()
 	if(m_Socket == INVALID_SOCKET)
 		return;
 
-	byte buffer[0xFFFF];
-	sockaddr_in6 sa; // sockaddr_in is smaller
-	socklen_t sa_len = sizeof(sa);
-
 	for (;;) 
 	{
-		int len = recvfrom(m_Socket, (char*)buffer, sizeof(buffer), 0, (struct sockaddr*)&sa, &sa_len);
-		if (len < 0) 
+		int Count = m_Batch.Receive();
+		for(int i=0; i < Count; i++)
 		{
-			int err = WSAGetLastError();
-			// ECONNRESET - On a UDP-datagram socket
-			// this error indicates a previous send operation
-			// resulted in an ICMP Port Unreachable message.
-			if (err == ECONNRESET) 
-				continue;
-			// EMSGSIZE - The message was too large to fit into
-			// the buffer pointed to by the buf parameter and was
-			// truncated.
-			if (err == EMSGSIZE) 
-				continue;
-			// any other error (such as EWOULDBLOCK) results in breaking the loop
-			break;
+			int len = m_Batch.GetLength(i);
+			if(len < 0)
+				continue; // the message was too large and got truncated
+
+			int sa_len = 0;
+			const struct sockaddr* sa = m_Batch.GetAddress(i, &sa_len);
+			CAddress Address;
+			quint16 Port;
+			Address.FromSA(sa, sa_len, &Port);
+			ReciveDatagram((const char*)m_Batch.GetData(i), len, Address, Port);
 		}
 
-		CAddress Address;
-		quint16 Port;
-		Address.FromSA((const struct sockaddr*)&sa, sa_len, &Port);
-		ReciveDatagram((const char*)buffer, len, Address, Port);
+		if(Count < m_Batch.GetSlots())
+			break; // Note: a ring that was not filled means the socket is drained
 	}
 }
 
@@ -4,6 +4,7 @@
 #include "../../Framework/ObjectEx.h"
 #include "../../Framework/Buffer.h"
 #include "../../Framework/Address.h"
+#include "../../Framework/UdpBatch.h"
 #include "StreamSocket.h"
 #include "ListenSocket.h"
 
@@ -32,6 +33,10 @@ public:
 
 	virtual void		Process();
 
+	// Note: between StartBatch and FlushBatch outgoing datagrams are collected and sent with one call
+	virtual void		StartBatch()								{m_Batching = true;}
+	virtual void		FlushBatch()								{m_Batching = false; m_Batch.Flush();}
+
 	virtual void		SendDatagram(const char *data, qint64 len, const CAddress &host, quint16 port);
 	virtual void		ReciveDatagram(const char *data, qint64 len, const CAddress &host, quint16 port);
 
@@ -42,6 +47,8 @@ protected:
 	friend void got_incoming_connection(void *userdata, struct UTPSocket *socket);
 
 	SOCKET				m_Socket;
+	CUdpBatch			m_Batch;
+	bool				m_Batching;
 
 	//static int			m_Counter;
 	//static CUtpTimer*	m_pTimer;
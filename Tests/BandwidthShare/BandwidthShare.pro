@@ -0,0 +1,5 @@
+TARGET = BandwidthShare
+include(../Tests.pri)
+
+HEADERS += ../../NeoLoader/Networking/BandwidthControl/BandwidthShare.h
+SOURCES += main.cpp
@@ -0,0 +1,131 @@
+#include "TestHeader.h"
+#include "NeoLoader/Networking/BandwidthControl/BandwidthShare.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Simulates limiters with different priorities competing for one limit, the manager hands out the quota in weighted rounds
+// every 10 ms and in between the limiters take bandwidth directly from the token bucket, like CBandwidthLimiter::RequestQuota.
+// A low priority limiter that asks very often must not get more than its weighted share through the direct path.
+
+#define LIMIT		(1000*1000)		// bytes per second
+#define DEPTH		(LIMIT/10)		// BW_BURST_MS
+#define ROUND		10				// ms between the managers rounds
+#define SECONDS		20
+
+struct SLimiter
+{
+	SLimiter(int Priority, int Calls, int Amount)
+	{
+		iPriority = Priority;
+		iCalls = Calls;
+		iAmount = Amount;
+		iRequest = 0;
+		iTaken = 0;
+		uTotal = 0;
+	}
+	int				iPriority;
+	int				iCalls;		// requests per ms
+	int				iAmount;	// bytes per request
+	int				iRequest;	// queued in the manager, while non zero no one may take directly
+	int				iTaken;		// taken directly since the last round
+	uint64			uTotal;
+};
+
+void Simulate(QList<SLimiter>& Limiters, bool bWeighted)
+{
+	int iTokens = 0;
+	int iDistribute = 0;
+	int iPrioritySum = 0;
+	for(int i=0; i < Limiters.size(); i++)
+		iPrioritySum += Limiters[i].iPriority;
+
+	for(int Tick = 0; Tick < SECONDS * 1000; Tick++)
+	{
+		iTokens = Min(iTokens + LIMIT / 1000, DEPTH);
+
+		if(Tick % ROUND == 0)
+		{
+			iDistribute = iTokens;
+			for(int i=0; i < Limiters.size(); i++)
+			{
+				SLimiter& Limiter = Limiters[i];
+				int iQuota = Min(WeightedShare(iDistribute, Limiter.iPriority, iPrioritySum), Limiter.iRequest);
+				iTokens -= iQuota;
+				Limiter.iRequest -= iQuota;
+				Limiter.uTotal += iQuota;
+				Limiter.iTaken = 0;
+			}
+		}
+
+		bool bWaiting = false;
+		for(int i=0; i < Limiters.size(); i++)
+			bWaiting |= Limiters[i].iRequest > 0;
+
+		// Note: the eager limiters come first, that is the worst case for the direct path
+		for(int i=0; i < Limiters.size(); i++)
+		{
+			SLimiter& Limiter = Limiters[i];
+			for(int j=0; j < Limiter.iCalls && Limiter.iRequest == 0; j++)
+			{
+				int iQuota = bWaiting ? 0 : Min(Limiter.iAmount, iTokens);
+				if(bWeighted)
+					iQuota = Min(iQuota, DirectShare(iDistribute, Limiter.iPriority, iPrioritySum, Limiter.iTaken));
+				iTokens -= iQuota;
+				Limiter.iTaken += iQuota;
+				Limiter.uTotal += iQuota;
+				if(iQuota < Limiter.iAmount)
+				{
+					Limiter.iRequest = Limiter.iAmount - iQuota;
+					bWaiting = true;
+				}
+			}
+		}
+	}
+}
+
+double Report(const char* Name, QList<SLimiter> Limiters, bool bWeighted)
+{
+	Simulate(Limiters, bWeighted);
+
+	int iPrioritySum = 0;
+	uint64 uTotal = 0;
+	for(int i=0; i < Limiters.size(); i++)
+	{
+		iPrioritySum += Limiters[i].iPriority;
+		uTotal += Limiters[i].uTotal;
+	}
+
+	// the deviation is how far the worst limiter is off its priority weighted share of what was sent
+	double Worst = 0;
+	printf("%s:", Name);
+	for(int i=0; i < Limiters.size(); i++)
+	{
+		double Fair = (double)uTotal * Limiters[i].iPriority / iPrioritySum;
+		double Ratio = Limiters[i].uTotal / Fair;
+		printf(" prio %d calls %d: %.2f", Limiters[i].iPriority, Limiters[i].iCalls, Ratio);
+		Worst = Max(Worst, Ratio > 1 ? Ratio - 1 : 1 - Ratio);
+	}
+	printf(", %.0f KB/s, worst deviation %.0f%%\n", uTotal / 1024.0 / SECONDS, Worst * 100);
+	return Worst;
+}
+
+int main(int argc, char *argv[])
+{
+	QList<SLimiter> Limiters;
+	Limiters.append(SLimiter(20, 8, 1500));		// lowest priority, asks very often
+	Limiters.append(SLimiter(100, 1, 16*1024));
+	Limiters.append(SLimiter(100, 1, 16*1024));
+	Limiters.append(SLimiter(500, 1, 16*1024));	// highest priority
+
+	double Old = Report("direct path unweighted", Limiters, false);
+	double New = Report("direct path weighted", Limiters, true);
+	CHECK(New < 0.15);
+	CHECK(New < Old);
+
+	// a limiter alone on the limit must still get all of it through the direct path
+	QList<SLimiter> Single;
+	Single.append(SLimiter(20, 8, 1500));
+	Simulate(Single, true);
+	printf("single limiter: %.0f KB/s of %d KB/s\n", Single[0].uTotal / 1024.0 / SECONDS, LIMIT / 1024);
+	CHECK(Single[0].uTotal >= (uint64)LIMIT * SECONDS * 95 / 100);
+	return 0;
+}
@@ -0,0 +1,5 @@
+TARGET = FileIndex
+include(../Tests.pri)
+
+HEADERS += ../../NeoLoader/FileList/FileIndex.h
+SOURCES += main.cpp
@@ -0,0 +1,151 @@
+#include "TestHeader.h"
+#include <QHash>
+#include <QSet>
+#include <QByteArray>
+#include "NeoLoader/FileList/FileIndex.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Checks the file list indexes against a full scan while files are added, removed and changed,
+// a file that changes without calling Reindex must be found by Verify and be correct after it.
+
+struct SFile
+{
+	QList<QByteArray>		GetHashKeys() const		{return HashKeys;}
+	QString					GetFileName() const		{return FileName;}
+	QString					GetFilePath() const		{return FilePath;}
+
+	QList<QByteArray>		HashKeys;
+	QString					FileName;
+	QString					FilePath;
+};
+
+typedef CFileIndex<SFile> CIndex;
+
+QByteArray RandomKey()		{return QByteArray(1, (char)(1 + qrand() % 4)) + QByteArray(QString::number(qrand() % 300).c_str());}
+QString RandomName()		{return QString(qrand() % 2 ? "File" : "FILE") + QString::number(qrand() % 200) + ".bin";}
+QString RandomPath()		{return QString("/incoming/") + QString::number(qrand() % 200) + "/" + RandomName();}
+
+void Randomize(SFile* pFile)
+{
+	switch(qrand() % 3)
+	{
+		case 0:
+			pFile->HashKeys.clear();
+			for(int Count = qrand() % 4; Count > 0; Count--)
+				pFile->HashKeys.append(RandomKey());
+			break;
+		case 1:	pFile->FileName = RandomName();	break;
+		case 2:	pFile->FilePath = RandomPath();	break;
+	}
+}
+
+// Note: the index only preselects, so like CFileList we filter the candidates by the real value
+bool CheckLookups(CIndex& Index, const QList<SFile*>& Files)
+{
+	for(int i=0; i < 50; i++)
+	{
+		QByteArray Key = RandomKey();
+		QString Name = RandomName();
+		QString Path = RandomPath();
+
+		QSet<SFile*> ByHash, ByName, ByPath;
+		foreach(SFile* pFile, Files)
+		{
+			if(pFile->HashKeys.contains(Key))
+				ByHash.insert(pFile);
+			if(pFile->FileName.toCaseFolded() == Name.toCaseFolded())
+				ByName.insert(pFile);
+			if(pFile->FilePath == Path)
+				ByPath.insert(pFile);
+		}
+
+		QSet<SFile*> Found;
+		foreach(SFile* pFile, Index.FindByHash(Key))
+		{
+			if(pFile->HashKeys.contains(Key))
+				Found.insert(pFile);
+		}
+		if(Found != ByHash)
+			return false;
+
+		Found.clear();
+		foreach(SFile* pFile, Index.FindByName(Name))
+		{
+			if(pFile->FileName.toCaseFolded() == Name.toCaseFolded())
+				Found.insert(pFile);
+		}
+		if(Found != ByName)
+			return false;
+
+		Found.clear();
+		foreach(SFile* pFile, Index.FindByPath(Path))
+		{
+			if(pFile->FilePath == Path)
+				Found.insert(pFile);
+		}
+		if(Found != ByPath)
+			return false;
+	}
+	return true;
+}
+
+int main(int argc, char *argv[])
+{
+	qsrand(1);
+
+	CIndex Index;
+	QList<SFile*> Files;
+	int Silent = 0;
+	int Found = 0;
+	for(int Step = 0; Step < 20000; Step++)
+	{
+		int Op = qrand() % 10;
+		if(Op < 3 || Files.isEmpty())
+		{
+			SFile* pFile = new SFile();
+			Randomize(pFile);
+			Randomize(pFile);
+			Randomize(pFile);
+			Files.append(pFile);
+			Index.Add(pFile);
+		}
+		else if(Op < 5)
+		{
+			int i = qrand() % Files.size();
+			Index.Remove(Files[i]);
+			delete Files[i];
+			Files.removeAt(i);
+		}
+		else if(Op < 9)
+		{
+			SFile* pFile = Files[qrand() % Files.size()];
+			Randomize(pFile);
+			Index.Reindex(pFile);
+		}
+		else
+		{
+			// a change the file did not report, Verify must find it
+			// Note: a file that is already marked gets reindexed anyways
+			SFile* pFile = Files[qrand() % Files.size()];
+			SFile Old = *pFile;
+			Randomize(pFile);
+			if(!Index.IsDirty(pFile) && (pFile->HashKeys != Old.HashKeys || pFile->FileName.toCaseFolded() != Old.FileName.toCaseFolded() || pFile->FilePath != Old.FilePath))
+			{
+				Silent++;
+				Found += Index.Verify();
+			}
+		}
+
+		CHECK(Index.GetCount() == Files.size());
+		if(Step % 10 == 0)
+		{
+			CHECK(Index.Verify() == 0);
+			CHECK(CheckLookups(Index, Files));
+		}
+	}
+	CHECK(Found == Silent);
+	printf("%d steps, %d files, %d unreported changes found by Verify: ok\n", 20000, Files.size(), Found);
+
+	qDeleteAll(Files);
+	return 0;
+}
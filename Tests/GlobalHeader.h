@@ -0,0 +1,12 @@
+#pragma once
+
+// Note: stands in for the GlobalHeader.h of the application, so the tests can build module sources that include it
+
+#include <string>
+#include <vector>
+#include <map>
+
+using namespace std;
+
+#include "TestHeader.h"
+#include <QHash>
@@ -0,0 +1,12 @@
+TARGET = HashKernels
+include(../Tests.pri)
+
+# Note: crypto++ must be build first, with its GNUmakefile on linux and mac
+DEFINES += NEOHELPER_STATIC
+LIBS += -L$$PWD/../../crypto++/ -lcryptopp
+
+# Note: the ARMv8 kernels are only compiled in with the crypto extensions
+linux-*:contains(QT_ARCH, arm64):QMAKE_CXXFLAGS += -march=armv8-a+crypto
+
+HEADERS += ../../Framework/Cryptography/HashKernels.h
+SOURCES += main.cpp ../../Framework/Cryptography/HashKernels.cpp
@@ -0,0 +1,115 @@
+#include "GlobalHeader.h"
+#include "Framework/Cryptography/HashKernels.h"
+#include "crypto++/sha.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Checks the accelerated SHA-1 and SHA-256 kernels of this cpu against known digests and against the generic
+// CryptoPP implementation on random messages, and times both on a large buffer.
+
+#define BENCH_SIZE	(64*1024*1024)
+
+void ToHex(const byte* pData, size_t uSize, char* pHex)
+{
+	for(size_t i = 0; i < uSize; i++)
+		sprintf(pHex + 2 * i, "%02x", pData[i]);
+}
+
+// Note: the message is fed in random pieces, so the kernel sees every mix of buffered and directly hashed blocks
+void Digest(CryptoPP::HashFunction* pHash, const byte* pData, size_t uSize, byte* pDigest, bool bSplit)
+{
+	for(size_t uPos = 0; uPos < uSize; )
+	{
+		size_t uLength = uSize - uPos;
+		if(bSplit && uLength > 0)
+			uLength = 1 + qrand() % uLength;
+		pHash->Update(pData + uPos, uLength);
+		uPos += uLength;
+	}
+	pHash->Final(pDigest);
+}
+
+bool CheckKnown(CryptoPP::HashFunction* pHash, const byte* pData, size_t uSize, const char* pExpected)
+{
+	byte Digest[64];
+	char Hex[129];
+	::Digest(pHash, pData, uSize, Digest, true);
+	ToHex(Digest, pHash->DigestSize(), Hex);
+	return strcmp(Hex, pExpected) == 0;
+}
+
+double Bench(CryptoPP::HashFunction* pHash, const QByteArray& Data)
+{
+	byte Digest[64];
+	QElapsedTimer Timer;
+	Timer.start();
+	pHash->Update((const byte*)Data.data(), Data.size());
+	pHash->Final(Digest);
+	return (double)Data.size() / (1024*1024) / (Timer.nsecsElapsed() / 1000000000.0);
+}
+
+void CheckKernel(const char* pName, CryptoPP::HashFunction* pKernel, CryptoPP::HashFunction* pGeneric, const char* pAbc, const char* pLong, const char* pMillion)
+{
+	// FIPS 180 test vectors, the generic one must match too, or the test itself is broken
+	const char* pLongMsg = "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+	QByteArray Million(1000000, 'a');
+	CHECK(CheckKnown(pGeneric, (const byte*)"abc", 3, pAbc));
+	CHECK(CheckKnown(pKernel, (const byte*)"abc", 3, pAbc));
+	CHECK(CheckKnown(pGeneric, (const byte*)pLongMsg, strlen(pLongMsg), pLong));
+	CHECK(CheckKnown(pKernel, (const byte*)pLongMsg, strlen(pLongMsg), pLong));
+	CHECK(CheckKnown(pGeneric, (const byte*)Million.data(), Million.size(), pMillion));
+	CHECK(CheckKnown(pKernel, (const byte*)Million.data(), Million.size(), pMillion));
+
+	QByteArray Data(5000, 0);
+	for(int i = 0; i < 3000; i++)
+	{
+		size_t uSize = qrand() % Data.size();
+		for(size_t j = 0; j < uSize; j++)
+			Data[j] = (char)qrand();
+
+		byte Test[64];
+		byte Reference[64];
+		Digest(pKernel, (const byte*)Data.data(), uSize, Test, true);
+		Digest(pGeneric, (const byte*)Data.data(), uSize, Reference, false);
+		CHECK(memcmp(Test, Reference, pGeneric->DigestSize()) == 0);
+	}
+
+	QByteArray Big(BENCH_SIZE, 0);
+	for(int i = 0; i < Big.size(); i++)
+		Big[i] = (char)(i * 7 + (i >> 12));
+	double Generic = Bench(pGeneric, Big);
+	double Kernel = Bench(pKernel, Big);
+	printf("%s: known digests and 3000 random messages ok, generic %.0f MB/s, %s %.0f MB/s\n", pName, Generic, CHashKernels::GetName(), Kernel);
+
+	delete pKernel;
+	delete pGeneric;
+}
+
+int main(int argc, char *argv[])
+{
+	qsrand(1);
+
+	printf("kernels: %s\n", CHashKernels::GetName());
+	// Note: a kernel that fails the self test at startup is not used, this must not pass as a cpu without one
+	CHECK(!CHashKernels::HasFailed());
+
+	if(CHashKernels::HasSHA1())
+	{
+		CheckKernel("SHA-1", CHashKernels::NewSHA1(), new CryptoPP::SHA1,
+			"a9993e364706816aba3e25717850c26c9cd0d89d",
+			"84983e441c3bd26ebaae4aa1f95129e5e54670f1",
+			"34aa973cd4c4daa4f61eeb2bdbad27316534016f");
+	}
+	else
+		printf("SHA-1: no accelerated kernel on this cpu, skipped\n");
+
+	if(CHashKernels::HasSHA256())
+	{
+		CheckKernel("SHA-256", CHashKernels::NewSHA256(), new CryptoPP::SHA256,
+			"ba7816bf8f01cfea414140de5dae2223b00361a396177a9cb410ff61f20015ad",
+			"248d6a61d20638b8e5c026930c3e6039a33ce45964ff2167f6ecedd419db06c1",
+			"cdc76e5c9914fb9281a1c7e284d73e67f1809a48a497200e046d39ccc7112cd0");
+	}
+	else
+		printf("SHA-256: no accelerated kernel on this cpu, skipped\n");
+	return 0;
+}
@@ -0,0 +1,5 @@
+TARGET = HashStore
+include(../Tests.pri)
+
+QT += sql
+SOURCES += main.cpp
@@ -0,0 +1,122 @@
+#include "TestHeader.h"
+#include <QDir>
+#include <QFile>
+#include <QSqlDatabase>
+#include <QSqlQuery>
+#include <QSqlError>
+#include <QCryptographicHash>
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Bulk import and load of hash sets into HashData.sq3, the way CHashingThread used to store them,
+// a SELECT followed by an UPDATE or INSERT per hash without a transaction,
+// against how it stores them now, cached INSERT OR REPLACE statements in batches of 256 within a transaction in WAL mode.
+
+const int HashCount = 20000;
+const int BlobSize = 2048;
+const int BatchSize = 256;	// as CHashingThread::BatchSize
+
+QByteArray MakeHash(int i)
+{
+	return QCryptographicHash::hash(QByteArray::number(i), QCryptographicHash::Md5);
+}
+
+QSqlDatabase OpenDB(const QString& Name, const QString& Journal)
+{
+	QString Path = QDir::tempPath() + "/" + Name + ".sq3";
+	QFile::remove(Path);
+	QFile::remove(Path + "-wal");
+	QFile::remove(Path + "-shm");
+	QSqlDatabase DataBase = QSqlDatabase::addDatabase("QSQLITE", Name);
+	DataBase.setDatabaseName(Path);
+	CHECK(DataBase.open());
+	DataBase.exec("pragma synchronous = off");
+	DataBase.exec("pragma journal_mode = " + Journal);
+	DataBase.exec("pragma locking_mode = exclusive");
+	DataBase.exec("pragma cache_size = 100000");
+	DataBase.exec("CREATE TABLE hashsets (hash VARCHAR(255) PRIMARY KEY, hashset BLOB)");
+	return DataBase;
+}
+
+qint64 StoreOld(QSqlDatabase& DataBase, const QByteArray& Blob)
+{
+	QElapsedTimer Timer;
+	Timer.start();
+	for(int i=0; i < HashCount; i++)
+	{
+		QSqlQuery Query1(DataBase);
+		Query1.prepare("SELECT hashset FROM hashsets WHERE hash = :hash");
+		Query1.bindValue(":hash", MakeHash(i));
+		Query1.exec();
+		bool Found = Query1.next();
+
+		QSqlQuery Query2(DataBase);
+		if(Found)
+			Query2.prepare("UPDATE hashsets SET hashset = :hashset WHERE hash = :hash");
+		else
+			Query2.prepare("INSERT INTO hashsets (hash, hashset) VALUES (:hash, :hashset)");
+		Query2.bindValue(":hash", MakeHash(i));
+		Query2.bindValue(":hashset", Blob);
+		CHECK(Query2.exec());
+	}
+	return Timer.elapsed();
+}
+
+qint64 StoreNew(QSqlDatabase& DataBase, const QByteArray& Blob)
+{
+	QElapsedTimer Timer;
+	Timer.start();
+	QSqlQuery Query(DataBase);
+	Query.prepare("INSERT OR REPLACE INTO hashsets (hash, hashset) VALUES (:hash, :hashset)");
+	for(int i=0; i < HashCount; i += BatchSize)
+	{
+		CHECK(DataBase.transaction());
+		for(int j = i; j < Min(i + BatchSize, HashCount); j++)
+		{
+			Query.bindValue(":hash", MakeHash(j));
+			Query.bindValue(":hashset", Blob);
+			CHECK(Query.exec());
+		}
+		CHECK(DataBase.commit());
+	}
+	return Timer.elapsed();
+}
+
+qint64 LoadAll(QSqlDatabase& DataBase, const QByteArray& Blob)
+{
+	QElapsedTimer Timer;
+	Timer.start();
+	QSqlQuery Query(DataBase);
+	Query.prepare("SELECT hashset FROM hashsets WHERE hash = :hash");
+	for(int i=0; i < HashCount; i++)
+	{
+		Query.bindValue(":hash", MakeHash(i));
+		CHECK(Query.exec());
+		CHECK(Query.next());
+		CHECK(Query.value(0).toByteArray() == Blob);
+		Query.finish();
+	}
+	return Timer.elapsed();
+}
+
+int main(int argc, char *argv[])
+{
+	QByteArray Blob(BlobSize, 0);
+	for(int i=0; i < BlobSize; i++)
+		Blob[i] = (char)qrand();
+
+	{
+		QSqlDatabase Old = OpenDB("HashStoreOld", "off");
+		qint64 uStore = StoreOld(Old, Blob);
+		qint64 uLoad = LoadAll(Old, Blob);
+		printf("old: import %d hash sets %lld ms, load %lld ms\n", HashCount, uStore, uLoad);
+		Old.close();
+	}
+	{
+		QSqlDatabase New = OpenDB("HashStoreNew", "wal");
+		qint64 uStore = StoreNew(New, Blob);
+		qint64 uLoad = LoadAll(New, Blob);
+		printf("new: import %d hash sets %lld ms, load %lld ms\n", HashCount, uStore, uLoad);
+		New.close();
+	}
+	return 0;
+}
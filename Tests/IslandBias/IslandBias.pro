@@ -0,0 +1,5 @@
+TARGET = IslandBias
+include(../Tests.pri)
+
+HEADERS += ../../NeoLoader/FileTransfer/IslandBias.h
+SOURCES += main.cpp
@@ -0,0 +1,137 @@
+#include "TestHeader.h"
+#include "NeoLoader/Common/ValueMap.h"
+#include "NeoLoader/FileTransfer/IslandBias.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Checks that the island bias recalculated around changed ranges matches a full recalculation,
+// and compares the cost of both while a simulated swarm of peers completes blocks of a large file.
+
+typedef CValueMap<uint32> CAvailMap;
+
+bool SameBias(const QVector<double>& A, const QVector<double>& B)
+{
+	for(int i=0; i < A.size(); i++)
+	{
+		if(A[i] != B[i])
+		{
+			printf("bias of part %d differs: %f != %f\n", i, A[i], B[i]);
+			return false;
+		}
+	}
+	return A.size() == B.size();
+}
+
+void TestRandom()
+{
+	for(int Round = 0; Round < 200; Round++)
+	{
+		uint64 PartSize = 1000 + qrand() % 1000;
+		int PartCount = 1 + qrand() % 300;
+		uint64 Size = PartCount * PartSize - qrand() % PartSize;
+		double ToGo = 1 + qrand() % 12;
+		CAvailMap Parts(Size);
+
+		QVector<double> Bias(PartCount);
+		CalcIslandBias(&Parts, 1, PartSize, ToGo, Bias.data(), 0, PartCount);
+
+		for(int Step = 0; Step < 200; Step++)
+		{
+			QVector<QPair<uint64, uint64> > Ranges;
+			for(int Count = 1 + qrand() % 3; Count > 0; Count--)
+			{
+				uint64 uBegin = (uint64)qrand() * 7919 % Size;
+				uint64 uLength = 1 + (uint64)qrand() % (PartSize * (qrand() % 4 == 0 ? 30 : 2));
+				uint64 uEnd = Min(uBegin + uLength, Size);
+				// Note: mostly fill in, but also lose ranges, like a corrupted part does
+				Parts.SetRange(uBegin, uEnd, 1, qrand() % 5 == 0 ? CAvailMap::eClr : CAvailMap::eAdd);
+				Ranges.append(qMakePair(uBegin, uEnd));
+			}
+
+			QVector<int> Changed;
+			UpdateIslandBias(&Parts, 1, PartSize, ToGo, Bias, Ranges, Changed);
+
+			QVector<double> Full(PartCount);
+			CalcIslandBias(&Parts, 1, PartSize, ToGo, Full.data(), 0, PartCount);
+			CHECK(SameBias(Bias, Full));
+		}
+	}
+	printf("random ranges: ok\n");
+}
+
+void BenchSwarm(int PeerCount)
+{
+	const uint64 PartSize = 9728000;	// ed2k part
+	const uint64 BlockSize = 184320;	// ed2k block
+	const int PartCount = 2000;
+	const uint64 Size = PartCount * PartSize;
+	double ToGo = MB2B(100) / PartSize / 2; // as with the default HosterCache/PartSize
+	CAvailMap Parts(Size);
+
+	QVector<double> Bias(PartCount);
+	CalcIslandBias(&Parts, 1, PartSize, ToGo, Bias.data(), 0, PartCount);
+
+	// every peer fills a random part block by block
+	QVector<uint64> Cursor(PeerCount, -1);
+	QVector<bool> Taken(PartCount, false);
+	int Free = PartCount;
+	qsrand(1);
+
+	quint64 uFullTime = 0;
+	quint64 uWindowTime = 0;
+	quint64 uChanged = 0;
+	int Blocks = 0;
+	QElapsedTimer Timer;
+	for(bool bActive = true; bActive && Blocks < 100000;)
+	{
+		bActive = false;
+		for(int Peer = 0; Peer < PeerCount; Peer++)
+		{
+			if(Cursor[Peer] == (uint64)-1 || Cursor[Peer] % PartSize == 0)
+			{
+				if(Free == 0)
+					continue;
+				int Part = qrand() % PartCount;
+				while(Taken[Part])
+					Part = (Part + 1) % PartCount;
+				Taken[Part] = true;
+				Free--;
+				Cursor[Peer] = Part * PartSize;
+			}
+			bActive = true;
+
+			uint64 uBegin = Cursor[Peer];
+			uint64 uEnd = Min(uBegin + BlockSize, (uBegin / PartSize + 1) * PartSize);
+			Cursor[Peer] = uEnd;
+			Parts.SetRange(uBegin, uEnd, 1, CAvailMap::eAdd);
+			Blocks++;
+
+			// the plan is updated for every completed block
+			Timer.start();
+			QVector<double> Full(PartCount);
+			CalcIslandBias(&Parts, 1, PartSize, ToGo, Full.data(), 0, PartCount);
+			uFullTime += Timer.nsecsElapsed();
+
+			Timer.start();
+			QVector<QPair<uint64, uint64> > Ranges;
+			Ranges.append(qMakePair(uBegin, uEnd));
+			QVector<int> Changed;
+			UpdateIslandBias(&Parts, 1, PartSize, ToGo, Bias, Ranges, Changed);
+			uWindowTime += Timer.nsecsElapsed();
+			uChanged += Changed.size();
+
+			if(Blocks % 1000 == 0) {
+				CHECK(SameBias(Bias, Full));
+			}
+		}
+	}
+
+	printf("swarm of %d peers, %d parts, %d blocks: full %.2f us/block, incremental %.2f us/block, %.2f parts rescored/block\n", 
+		PeerCount, PartCount, Blocks, uFullTime / 1000.0 / Blocks, uWindowTime / 1000.0 / Blocks, (double)uChanged / Blocks);
+}
+
+int main(int argc, char *argv[])
+{
+	TestRandom();
+	BenchSwarm(500);
+	return 0;
+}
@@ -0,0 +1,5 @@
+TARGET = RangeMap
+include(../Tests.pri)
+
+HEADERS += ../../NeoLoader/Common/FlatMap.h ../../NeoLoader/Common/ValueMap.h
+SOURCES += main.cpp
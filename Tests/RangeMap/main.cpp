@@ -0,0 +1,152 @@
+#include "TestHeader.h"
+#include "NeoLoader/Common/ValueMap.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Runs random set, add and clear operations on a CValueMap and on the QMap based SetRange it replaced,
+// after every operation both maps must hold exactly the same ranges.
+
+// Note: this is the SetRange of CRangeMap from befoure it used CFlatMap, with the states of CValueMap
+class COldMap
+{
+public:
+	typedef QMap<uint64,uint32> MapType;
+
+	COldMap(uint64 Size)		{m_PartMap.insert(Size, 0);}
+
+	void		SetRange(uint64 uBegin, uint64 uEnd, uint32 uState, CRangeMap<uint32>::ESet eMode)
+	{
+		if(uEnd == -1)
+			uEnd = (--m_PartMap.end()).key();
+
+		MapType::iterator End = m_PartMap.lowerBound(uEnd);
+		CHECK(End != m_PartMap.end());
+		if(End.key() != uEnd) 
+			End = m_PartMap.insert(uEnd,End.value()); 
+		MapType::iterator Begin = m_PartMap.lowerBound(uBegin);
+		CHECK(Begin != m_PartMap.end());
+		if(Begin.key() != uBegin)
+			Begin = m_PartMap.insert(uBegin,Begin.value()); 
+
+		for(MapType::iterator Part = End; Part != Begin ;Part--)
+			Part.value() = MakeState(Part.value(), uState, eMode); 
+
+		MapType::iterator Part = Begin == m_PartMap.begin() ? Begin : --Begin;
+		MapType::iterator PartEnd = ++End == m_PartMap.end() ? End : ++End;
+		MapType::iterator PrevPart = Part;
+		for(Part++; Part != PartEnd; Part++)
+		{
+			if(PrevPart.value() == Part.value() || PrevPart.key() == 0)
+				m_PartMap.erase(PrevPart);
+			PrevPart = Part;
+		}
+	}
+
+	static uint32 MakeState(uint32 uCur, uint32 uState, CRangeMap<uint32>::ESet eMode)
+	{
+		switch(eMode)
+		{
+		case CRangeMap<uint32>::eAdd:	return uCur | uState;
+		case CRangeMap<uint32>::eClr:	return uCur & ~uState;
+		default:						return uState;
+		}
+	}
+
+	MapType		m_PartMap;
+};
+
+class CNewMap: public CValueMap<uint32>
+{
+public:
+	CNewMap(uint64 Size) : CValueMap<uint32>(Size) {}
+
+	bool		Matches(const COldMap& Old) const
+	{
+		if(m_PartMap.size() != Old.m_PartMap.size())
+			return false;
+		int Index = 0;
+		for(COldMap::MapType::const_iterator Part = Old.m_PartMap.begin(); Part != Old.m_PartMap.end(); Part++, Index++)
+		{
+			if(m_PartMap.keyAt(Index) != Part.key() || m_PartMap.valueAt(Index) != Part.value())
+				return false;
+		}
+		return true;
+	}
+};
+
+uint64 RandomPos(uint64 uSize)
+{
+	// Note: mostly pick from a coarse grid so that ranges often start or end on existing boundaries
+	if(qrand() % 4)
+		return (qrand() % 257) * (uSize / 256);
+	return ((uint64)qrand() * qrand()) % (uSize + 1);
+}
+
+int main(int argc, char *argv[])
+{
+	qsrand(1);
+
+	const uint32 States[] = {0, 1, 2, 4, 3, 6};
+	const CRangeMap<uint32>::ESet Modes[] = {CRangeMap<uint32>::eSet, CRangeMap<uint32>::eAdd, CRangeMap<uint32>::eClr};
+
+	int Ops = 0;
+	int MaxCount = 0;
+	for(int Round = 0; Round < 2000; Round++)
+	{
+		uint64 uSize = 256 * (1 + qrand() % 1000);
+		COldMap Old(uSize);
+		CNewMap New(uSize);
+		for(int Step = qrand() % 300; Step > 0; Step--)
+		{
+			uint64 uBegin = RandomPos(uSize);
+			uint64 uEnd = RandomPos(uSize);
+			if(qrand() % 2) // short ranges fragment the map
+			{
+				uEnd = uBegin + 1 + qrand() % (uSize / 32);
+				if(uEnd > uSize)
+					uEnd = uSize;
+			}
+			if(uBegin > uEnd)
+				qSwap(uBegin, uEnd);
+			if(uBegin == uEnd)
+				continue;
+			if(uEnd == uSize && qrand() % 2)
+				uEnd = -1;
+			uint32 uState = States[qrand() % 6];
+			CRangeMap<uint32>::ESet eMode = Modes[qrand() % 3];
+
+			Old.SetRange(uBegin, uEnd, uState, eMode);
+			New.SetRange(uBegin, uEnd, uState, eMode);
+			CHECK(New.Matches(Old));
+			CHECK(New.GetSize() == uSize);
+			Ops++;
+			MaxCount = Max(MaxCount, (int)New.GetCount());
+		}
+	}
+	printf("%d random operations on 2000 maps, up to %d ranges: ok\n", Ops, MaxCount);
+
+	// Note: like a download, many small ranges get appended to existing ones all over a large file
+	const uint64 uSize = 100ULL*1024*1024*1024;
+	const uint64 uBlock = 16*1024;
+	QElapsedTimer Timer;
+	for(int Impl = 0; Impl < 2; Impl++)
+	{
+		COldMap Old(uSize);
+		CNewMap New(uSize);
+		QVector<uint64> Streams(10000);
+		for(int i = 0; i < Streams.size(); i++)
+			Streams[i] = i * (uSize / Streams.size());
+		qsrand(2);
+		Timer.start();
+		for(int i = 0; i < 200000; i++)
+		{
+			uint64& uBegin = Streams[qrand() % Streams.size()];
+			if(Impl == 0)
+				Old.SetRange(uBegin, uBegin + uBlock, 1, CRangeMap<uint32>::eAdd);
+			else
+				New.SetRange(uBegin, uBegin + uBlock, 1, CRangeMap<uint32>::eAdd);
+			uBegin += uBlock;
+		}
+		printf("%s: 200000 appends to %d ranges in %d ms\n", Impl == 0 ? "QMap" : "CValueMap", Impl == 0 ? Old.m_PartMap.size() : (int)New.GetCount(), (int)Timer.elapsed());
+	}
+	return 0;
+}
@@ -0,0 +1,26 @@
+#pragma once
+
+// Note: the tests only use the Qt core and self contained code of the modules, this replaces their GlobalHeader.h
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <QVector>
+#include <QList>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QElapsedTimer>
+
+#include "Framework/Types.h"
+
+#define ASSERT(x)			Q_ASSERT(x)
+
+#ifndef Max
+#define Max(a,b)            (((a) > (b)) ? (a) : (b))
+#endif
+
+#ifndef Min
+#define Min(a,b)            (((a) < (b)) ? (a) : (b))
+#endif
+
+#define CHECK(x)			if(!(x)) {printf("%s:%d: check failed: %s\n", __FILE__, __LINE__, #x); exit(1);}
@@ -0,0 +1,12 @@
+# common settings of all test projects
+
+TEMPLATE = app
+QT = core
+CONFIG += console testcase
+CONFIG -= app_bundle
+!mac:!win32:QMAKE_CXXFLAGS += -std=c++0x
+mac:QMAKE_CXXFLAGS += -std=c++11
+
+INCLUDEPATH += $$PWD $$PWD/..
+DEPENDPATH += .
+HEADERS += $$PWD/TestHeader.h
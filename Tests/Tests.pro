@@ -0,0 +1,14 @@
+# ----------------------------------------------------
+# Unit tests and benchmarks, they are not part of the application build,
+# build and run them with: qmake Tests.pro && make && make check
+# ------------------------------------------------------
+
+TEMPLATE = subdirs
+SUBDIRS += \
+    IslandBias/IslandBias.pro \
+    HashStore/HashStore.pro \
+    BandwidthShare/BandwidthShare.pro \
+    FileIndex/FileIndex.pro \
+    RangeMap/RangeMap.pro \
+    UploadQueue/UploadQueue.pro \
+    HashKernels/HashKernels.pro
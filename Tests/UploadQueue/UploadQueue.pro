@@ -0,0 +1,5 @@
+TARGET = UploadQueue
+include(../Tests.pri)
+
+HEADERS += ../../NeoLoader/FileTransfer/UploadQueue.h
+SOURCES += main.cpp ../../NeoLoader/FileTransfer/UploadQueue.cpp
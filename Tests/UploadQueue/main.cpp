@@ -0,0 +1,215 @@
+#include "GlobalHeader.h"
+#include <math.h>
+#include "NeoLoader/FileTransfer/UploadQueue.h"
+
+///////////////////////////////////////////////////////////////////////////////////////////////
+// Deterministic simulation of the upload slot lottery, queued transfers get a slot for a while and queue again,
+// and their weights change all the time. It runs the CUploadQueue draw of CUploadManager and the QMap lottery
+// it replaced on the same scenario, and compares the slots each weight class got with what its weight entitles it to.
+
+#define OCTAVES		8		// weight classes, 0.125 to 32
+#define SLOT_TICKS	40		// ticks an upload keeps its slot
+#define RESCORES	5		// weight changes per tick
+
+struct SRandom
+{
+	SRandom(quint64 Seed)	{uState = Seed;}
+	quint64			Next()	{uState ^= uState << 13; uState ^= uState >> 7; uState ^= uState << 17; return uState;}
+	double			Unit()	{return (Next() >> 11) * (1.0 / 9007199254740992.0);}
+	quint64			uState;
+};
+
+struct STransfer
+{
+	int				Octave;
+	double			Weight;
+	int				SlotEnd;	// tick the upload ends, 0 while waiting
+};
+
+CP2PTransfer* Ptr(STransfer* pTransfer)	{return (CP2PTransfer*)pTransfer;}
+
+class CSimulation
+{
+public:
+	CSimulation(bool bOld, int Count, quint64 Seed)
+	 : m_Random(Seed)
+	{
+		m_bOld = bOld;
+		m_uTime = 0;
+		for(int i = 0; i < OCTAVES; i++)
+		{
+			m_Expected[i] = 0;
+			m_Observed[i] = 0;
+			m_Weights[i] = 0;
+		}
+		m_Transfers.resize(Count);
+		for(int i = 0; i < Count; i++)
+		{
+			STransfer& Transfer = m_Transfers[i];
+			Transfer.Octave = i % OCTAVES;
+			Transfer.SlotEnd = 0;
+			Transfer.Weight = RandomWeight(Transfer.Octave);
+			Enqueue(&Transfer);
+		}
+	}
+
+	double			RandomWeight(int Octave)	{return ldexp(1.0 + m_Random.Unit(), Octave - 3);}
+
+	void			Enqueue(STransfer* pTransfer)
+	{
+		m_Weights[pTransfer->Octave] += pTransfer->Weight;
+		if(!m_bOld)
+			m_Queue.Update(Ptr(pTransfer), pTransfer->Weight);
+	}
+
+	void			Dequeue(STransfer* pTransfer)
+	{
+		m_Weights[pTransfer->Octave] -= pTransfer->Weight;
+		if(!m_bOld)
+			m_Queue.Remove(Ptr(pTransfer));
+	}
+
+	void			Tick(int Tick, int Starts)
+	{
+		for(int i = 0; i < m_Transfers.size(); i++)
+		{
+			STransfer& Transfer = m_Transfers[i];
+			if(Transfer.SlotEnd == Tick)
+			{
+				Transfer.SlotEnd = 0;
+				Enqueue(&Transfer);
+			}
+		}
+
+		// Note: a rescore changes the weight within its class, so the class of a transfer is fixed
+		for(int i = 0; i < RESCORES; i++)
+		{
+			STransfer& Transfer = m_Transfers[m_Random.Next() % m_Transfers.size()];
+			if(Transfer.SlotEnd != 0)
+				continue;
+			m_Weights[Transfer.Octave] -= Transfer.Weight;
+			Transfer.Weight = RandomWeight(Transfer.Octave);
+			m_Weights[Transfer.Octave] += Transfer.Weight;
+			if(!m_bOld)
+				m_Queue.Update(Ptr(&Transfer), Transfer.Weight);
+		}
+
+		m_Timer.start();
+		QList<STransfer*> Drawn = m_bOld ? DrawOld(Starts) : DrawNew(Starts);
+		m_uTime += m_Timer.nsecsElapsed();
+
+		foreach(STransfer* pTransfer, Drawn)
+		{
+			CHECK(pTransfer && pTransfer->SlotEnd == 0);
+			// every draw entitles each class to its share of the weight waiting at that time
+			double Total = 0;
+			for(int i = 0; i < OCTAVES; i++)
+				Total += m_Weights[i];
+			for(int i = 0; i < OCTAVES; i++)
+				m_Expected[i] += m_Weights[i] / Total;
+			m_Observed[pTransfer->Octave]++;
+
+			Dequeue(pTransfer);
+			pTransfer->SlotEnd = Tick + SLOT_TICKS;
+		}
+	}
+
+	// Note: this is the lottery of CUploadManager::Process from befoure CUploadQueue, rebuild on every tick
+	QList<STransfer*> DrawOld(int Starts)
+	{
+		double ProbabilityRange = 0;
+		QMap<double, STransfer*> ReadyUploads;
+		for(int i = 0; i < m_Transfers.size(); i++)
+		{
+			STransfer& Transfer = m_Transfers[i];
+			if(Transfer.SlotEnd != 0)
+				continue;
+			ProbabilityRange += Transfer.Weight;
+			ReadyUploads.insert(ProbabilityRange, &Transfer);
+		}
+
+		QList<STransfer*> Drawn;
+		while(!ReadyUploads.isEmpty() && Drawn.size() < Starts)
+		{
+			double dRand = double(m_Random.Next() & 0x00000000FFFFFFFF)/1000.0;
+			double dMod = fmod(dRand, ProbabilityRange);
+			QMap<double, STransfer*>::iterator I = ReadyUploads.upperBound(dMod);
+			if(I == ReadyUploads.end()) // fallback
+				I = ReadyUploads.find(ReadyUploads.keys().at(m_Random.Next() % ReadyUploads.count()));
+			Drawn.append(I.value());
+			ReadyUploads.erase(I);
+		}
+		return Drawn;
+	}
+
+	QList<STransfer*> DrawNew(int Starts)
+	{
+		QList<STransfer*> Drawn;
+		while(m_Queue.GetCount() > 0 && Drawn.size() < Starts)
+		{
+			STransfer* pTransfer = (STransfer*)m_Queue.Find(m_Random.Next() % m_Queue.GetTickets());
+			m_Queue.Remove(Ptr(pTransfer)); // Note: like StartUpload, a drawn transfer leaves the queue right away
+			Drawn.append(pTransfer);
+		}
+		return Drawn;
+	}
+
+	/**
+	* @return: chi square of the slots each class got against its share, with OCTAVES - 1 degrees of freedom
+	*/
+	double			ChiSquare() const
+	{
+		double Sum = 0;
+		for(int i = 0; i < OCTAVES; i++)
+			Sum += (m_Observed[i] - m_Expected[i]) * (m_Observed[i] - m_Expected[i]) / m_Expected[i];
+		return Sum;
+	}
+
+	bool			m_bOld;
+	SRandom			m_Random;
+	QVector<STransfer> m_Transfers;
+	CUploadQueue	m_Queue;
+	double			m_Weights[OCTAVES];
+	double			m_Expected[OCTAVES];
+	int				m_Observed[OCTAVES];
+	QElapsedTimer	m_Timer;
+	quint64			m_uTime;
+};
+
+int main(int argc, char *argv[])
+{
+	struct SCase
+	{
+		int Count;
+		int Starts;
+		int Ticks;
+	} Cases[] = {{5000, 2, 5000}, {20000, 8, 1500}};
+
+	for(int i = 0; i < 2; i++)
+	{
+		SCase& Case = Cases[i];
+		CSimulation Old(true, Case.Count, 1234567);
+		CSimulation New(false, Case.Count, 1234567);
+		for(int Tick = 1; Tick <= Case.Ticks; Tick++)
+		{
+			Old.Tick(Tick, Case.Starts);
+			New.Tick(Tick, Case.Starts);
+		}
+
+		// the ticket sums must not drift over all the updates
+		quint64 uTickets = 0;
+		for(int j = 0; j < New.m_Transfers.size(); j++)
+		{
+			if(New.m_Transfers[j].SlotEnd == 0)
+				uTickets += (quint64)(New.m_Transfers[j].Weight * CUploadQueue::TicketsPerWeight + 0.5);
+		}
+		CHECK(New.m_Queue.GetTickets() == uTickets);
+
+		printf("%d transfers, %d starts per tick, %d ticks: old chi2=%.1f %.1f us/tick, new chi2=%.1f %.2f us/tick\n", Case.Count, Case.Starts, Case.Ticks,
+			Old.ChiSquare(), Old.m_uTime / 1000.0 / Case.Ticks, New.ChiSquare(), New.m_uTime / 1000.0 / Case.Ticks);
+
+		// Note: 24.3 is the 0.1% critical value for 7 degrees of freedom
+		CHECK(New.ChiSquare() < 24.3);
+	}
+	return 0;
+}